@@ -27,6 +27,7 @@ typedef struct minizip_opt_s {
     uint8_t     include_path;
     int16_t     compress_level;
     uint8_t     compress_method;
+    uint8_t     compress_auto;
     uint8_t     overwrite;
     uint8_t     append;
     int64_t     disk_size;
@@ -35,6 +36,9 @@ typedef struct minizip_opt_s {
     uint8_t     zip_cd;
     int32_t     encoding;
     uint8_t     verbose;
+    int32_t     threads;
+    mz_zip_stats
+                stats;
     uint8_t     aes;
     const char *cert_path;
     const char *cert_pwd;
@@ -45,6 +49,8 @@ typedef struct minizip_opt_s {
 int32_t minizip_banner(void);
 int32_t minizip_help(void);
 
+int32_t minizip_stats_print(const mz_zip_stats *stats);
+
 int32_t minizip_list(const char *path);
 
 int32_t minizip_add_entry_cb(void *handle, void *userdata, mz_zip_file *file_info);
@@ -57,6 +63,9 @@ int32_t minizip_extract_progress_cb(void *handle, void *userdata, mz_zip_file *f
 int32_t minizip_extract_overwrite_cb(void *handle, void *userdata, mz_zip_file *file_info, const char *path);
 int32_t minizip_extract(const char *path, const char *pattern, const char *destination, const char *password, minizip_opt *options);
 
+void    minizip_test_cb(void *handle, void *userdata, mz_zip_file *file_info, int32_t result);
+int32_t minizip_test(const char *path, const char *pattern, const char *password, minizip_opt *options);
+
 int32_t minizip_erase(const char *src_path, const char *target_path, int32_t arg_count, const char **args);
 
 /***************************************************************************/
@@ -68,21 +77,24 @@ int32_t minizip_banner(void) {
 }
 
 int32_t minizip_help(void) {
-    printf("Usage: minizip [-x][-d dir|-l|-e][-o][-f][-y][-c cp][-a][-0 to -9][-b|-m|-t][-k 512][-p pwd][-s] file.zip [files]\n\n" \
+    printf("Usage: minizip [-x][-d dir|-l|-e|-u][-j n][-o][-f][-y][-c cp][-a][-0 to -9][-g][-b|-m|-t][-k 512][-p pwd][-s] file.zip [files]\n\n" \
            "  -x  Extract files\n" \
            "  -l  List files\n" \
            "  -d  Destination directory\n" \
            "  -e  Erase files\n" \
+           "  -u  Test files, checking crc and stored hashes without extracting\n" \
+           "  -j  Threads used to test files\n" \
            "  -o  Overwrite existing files\n" \
            "  -c  File names use cp437 encoding (or specified codepage)\n" \
            "  -a  Append to existing zip file\n" \
            "  -i  Include full path of files\n" \
            "  -f  Follow symbolic links\n" \
            "  -y  Store symbolic links\n" \
-           "  -v  Verbose info\n" \
+           "  -v  Verbose info and stream statistics\n" \
            "  -0  Store only\n" \
            "  -1  Compress faster\n" \
            "  -9  Compress better\n" \
+           "  -g  Guess compression per file from its data\n" \
            "  -k  Disk size in KB\n" \
            "  -z  Zip central directory\n" \
            "  -p  Encryption password\n" \
@@ -98,6 +110,34 @@ int32_t minizip_help(void) {
 
 /***************************************************************************/
 
+static void minizip_stats_print_layer(const char *name, const mz_stream_stats *stats) {
+    if (stats->read_calls == 0 && stats->write_calls == 0 && stats->seek_calls == 0)
+        return;
+
+    printf("%-8s %10" PRId64 " %10" PRId64 " %8" PRId64 " %14" PRId64 " %14" PRId64 " %10.2f %10.2f",
+        name, stats->read_calls, stats->write_calls, stats->seek_calls, stats->bytes_read, stats->bytes_written,
+        stats->read_time / 1000000.0, stats->write_time / 1000000.0);
+
+    if (stats->buffer_hits + stats->buffer_misses > 0)
+        printf(" %8.2f%%\n", ((double)stats->buffer_hits / (stats->buffer_hits + stats->buffer_misses)) * 100);
+    else
+        printf("         -\n");
+}
+
+int32_t minizip_stats_print(const mz_zip_stats *stats) {
+    /* Times include the time spent in the layers below */
+    printf("\nStream        Reads     Writes    Seeks     Bytes read  Bytes written  Read (ms) Write (ms)  Buf hits\n");
+    printf("------        -----     ------    -----     ----------  -------------  --------- ----------  --------\n");
+    minizip_stats_print_layer("compress", &stats->compress);
+    minizip_stats_print_layer("crypt", &stats->crypt);
+    minizip_stats_print_layer("split", &stats->split);
+    minizip_stats_print_layer("buffered", &stats->buffered);
+    minizip_stats_print_layer("file", &stats->file);
+    return MZ_OK;
+}
+
+/***************************************************************************/
+
 int32_t minizip_list(const char *path) {
     mz_zip_file *file_info = NULL;
     uint32_t ratio = 0;
@@ -252,12 +292,15 @@ int32_t minizip_add(const char *path, const char *password, minizip_opt *options
     mz_zip_writer_set_aes(writer, options->aes);
     mz_zip_writer_set_compress_method(writer, options->compress_method);
     mz_zip_writer_set_compress_level(writer, options->compress_level);
+    mz_zip_writer_set_compress_auto(writer, options->compress_auto);
     mz_zip_writer_set_follow_links(writer, options->follow_links);
     mz_zip_writer_set_store_links(writer, options->store_links);
     mz_zip_writer_set_overwrite_cb(writer, options, minizip_add_overwrite_cb);
     mz_zip_writer_set_progress_cb(writer, options, minizip_add_progress_cb);
     mz_zip_writer_set_entry_cb(writer, options, minizip_add_entry_cb);
     mz_zip_writer_set_zip_cd(writer, options->zip_cd);
+    if (options->verbose)
+        mz_zip_writer_set_stats(writer, &options->stats);
     if (options->cert_path != NULL)
         mz_zip_writer_set_certificate(writer, options->cert_path, options->cert_pwd);
 
@@ -282,6 +325,9 @@ int32_t minizip_add(const char *path, const char *password, minizip_opt *options
         err = err_close;
     }
 
+    if (options->verbose)
+        minizip_stats_print(&options->stats);
+
     mz_zip_writer_delete(&writer);
     return err;
 }
@@ -364,6 +410,8 @@ int32_t minizip_extract(const char *path, const char *pattern, const char *desti
     mz_zip_reader_set_entry_cb(reader, options, minizip_extract_entry_cb);
     mz_zip_reader_set_progress_cb(reader, options, minizip_extract_progress_cb);
     mz_zip_reader_set_overwrite_cb(reader, options, minizip_extract_overwrite_cb);
+    if (options->verbose)
+        mz_zip_reader_set_stats(reader, &options->stats);
 
     err = mz_zip_reader_open_file(reader, path);
 
@@ -391,6 +439,78 @@ int32_t minizip_extract(const char *path, const char *pattern, const char *desti
         err = err_close;
     }
 
+    if (options->verbose)
+        minizip_stats_print(&options->stats);
+
+    mz_zip_reader_delete(&reader);
+    return err;
+}
+
+/***************************************************************************/
+
+void minizip_test_cb(void *handle, void *userdata, mz_zip_file *file_info, int32_t result) {
+    MZ_UNUSED(handle);
+    MZ_UNUSED(userdata);
+
+    /* Print the result of each entry as it is checked */
+    if (result == MZ_OK)
+        printf("Testing %s - OK\n", file_info->filename);
+    else
+        printf("Testing %s - Error %" PRId32 "\n", file_info->filename, result);
+}
+
+int32_t minizip_test(const char *path, const char *pattern, const char *password, minizip_opt *options) {
+    mz_zip_reader_test_result result;
+    void *reader = NULL;
+    int32_t err = MZ_OK;
+    int32_t err_close = MZ_OK;
+
+
+    printf("Archive %s\n", path);
+
+    memset(&result, 0, sizeof(result));
+
+    mz_zip_reader_create(&reader);
+    mz_zip_reader_set_pattern(reader, pattern, 1);
+    mz_zip_reader_set_password(reader, password);
+    mz_zip_reader_set_encoding(reader, options->encoding);
+    mz_zip_reader_set_test_cb(reader, options, minizip_test_cb);
+    mz_zip_reader_set_test_threads(reader, options->threads);
+    if (options->verbose)
+        mz_zip_reader_set_stats(reader, &options->stats);
+
+    err = mz_zip_reader_open_file(reader, path);
+
+    if (err != MZ_OK) {
+        printf("Error %" PRId32 " opening archive %s\n", err, path);
+    } else {
+        /* Read all entries in archive without saving them */
+        err = mz_zip_reader_test_all(reader, &result);
+
+        if (err == MZ_END_OF_LIST) {
+            if (pattern != NULL) {
+                printf("Files matching %s not found in archive\n", pattern);
+            } else {
+                printf("No files in archive\n");
+                err = MZ_OK;
+            }
+        } else {
+            printf("Tested %" PRId64 " entries (%" PRId64 " with hash, %" PRId64 " skipped), %" PRId64 " failed\n",
+                result.entries, result.hashed, result.skipped, result.failed);
+            printf("Read %" PRId64 " bytes in %.2f ms (%.2f MB/s)\n", result.bytes,
+                result.elapsed_ns / 1000000.0, result.bytes_per_sec / (1024.0 * 1024.0));
+        }
+    }
+
+    err_close = mz_zip_reader_close(reader);
+    if (err_close != MZ_OK) {
+        printf("Error %" PRId32 " closing archive for reading\n", err_close);
+        err = err_close;
+    }
+
+    if (options->verbose)
+        minizip_stats_print(&options->stats);
+
     mz_zip_reader_delete(&reader);
     return err;
 }
@@ -399,11 +519,10 @@ int32_t minizip_extract(const char *path, const char *pattern, const char *desti
 
 int32_t minizip_erase(const char *src_path, const char *target_path, int32_t arg_count, const char **args) {
     mz_zip_file *file_info = NULL;
-    const char *filename_in_zip = NULL;
     const char *target_path_ptr = target_path;
     void *reader = NULL;
     void *writer = NULL;
-    int32_t skip = 0;
+    void *patterns = NULL;
     int32_t err = MZ_OK;
     int32_t i = 0;
     uint8_t zip_cd = 0;
@@ -418,6 +537,15 @@ int32_t minizip_erase(const char *src_path, const char *target_path, int32_t arg
         target_path_ptr = tmp_path;
     }
 
+    /* Entries are checked against all of the patterns at once */
+    mz_pattern_create(&patterns);
+    for (i = 0; i < arg_count && err == MZ_OK; i += 1)
+        err = mz_pattern_add(patterns, args[i], 1);
+    if (err != MZ_OK) {
+        mz_pattern_delete(&patterns);
+        return err;
+    }
+
     mz_zip_reader_create(&reader);
     mz_zip_writer_create(&writer);
 
@@ -426,6 +554,7 @@ int32_t minizip_erase(const char *src_path, const char *target_path, int32_t arg
     if (err != MZ_OK) {
         printf("Error %" PRId32 " opening archive for reading %s\n", err, src_path);
         mz_zip_reader_delete(&reader);
+        mz_pattern_delete(&patterns);
         return err;
     }
 
@@ -435,6 +564,7 @@ int32_t minizip_erase(const char *src_path, const char *target_path, int32_t arg
         printf("Error %" PRId32 " opening archive for writing %s\n", err, target_path_ptr);
         mz_zip_reader_delete(&reader);
         mz_zip_writer_delete(&writer);
+        mz_pattern_delete(&patterns);
         return err;
     }
 
@@ -452,14 +582,7 @@ int32_t minizip_erase(const char *src_path, const char *target_path, int32_t arg
 
         /* Copy all entries from original archive to temporary archive
            except the ones we don't want */
-        for (i = 0, skip = 0; i < arg_count; i += 1) {
-            filename_in_zip = args[i];
-
-            if (mz_path_compare_wc(file_info->filename, filename_in_zip, 1) == MZ_OK)
-                skip = 1;
-        }
-
-        if (skip) {
+        if (mz_pattern_match(patterns, file_info->filename) == MZ_OK) {
             printf("Skipping %s\n", file_info->filename);
         } else {
             printf("Copying %s\n", file_info->filename);
@@ -486,6 +609,8 @@ int32_t minizip_erase(const char *src_path, const char *target_path, int32_t arg
     mz_zip_writer_close(writer);
     mz_zip_writer_delete(&writer);
 
+    mz_pattern_delete(&patterns);
+
     if (err == MZ_END_OF_LIST) {
         if (target_path == NULL) {
             /* Swap original archive with temporary archive, backup old archive if possible */
@@ -520,6 +645,7 @@ int main(int argc, const char *argv[]) {
     uint8_t do_list = 0;
     uint8_t do_extract = 0;
     uint8_t do_erase = 0;
+    uint8_t do_test = 0;
     const char *path = NULL;
     const char *password = NULL;
     const char *destination = NULL;
@@ -548,6 +674,8 @@ int main(int argc, const char *argv[]) {
                 do_extract = 1;
             else if ((c == 'e') || (c == 'E'))
                 do_erase = 1;
+            else if ((c == 'u') || (c == 'U'))
+                do_test = 1;
             else if ((c == 'a') || (c == 'A'))
                 options.append = 1;
             else if ((c == 'o') || (c == 'O'))
@@ -560,6 +688,8 @@ int main(int argc, const char *argv[]) {
                 options.include_path = 1;
             else if ((c == 'z') || (c == 'Z'))
                 options.zip_cd = 1;
+            else if ((c == 'g') || (c == 'G'))
+                options.compress_auto = 1;
             else if ((c == 'v') || (c == 'V'))
                 options.verbose = 1;
             else if ((c >= '0') && (c <= '9')) {
@@ -615,6 +745,10 @@ int main(int argc, const char *argv[]) {
             } else if (((c == 'c') || (c == 'C')) && (i + 1 < argc)) {
                 options.encoding = (int32_t)atoi(argv[i + 1]);
                 i += 1;
+            } else if (((c == 'j') || (c == 'J')) && (i + 1 < argc)) {
+                options.threads = (int32_t)atoi(argv[i + 1]);
+                printf("%s ", argv[i + 1]);
+                i += 1;
             } else if (((c == 'k') || (c == 'K')) && (i + 1 < argc)) {
                 options.disk_size = (int64_t)atoi(argv[i + 1]) * 1024;
                 printf("%s ", argv[i + 1]);
@@ -658,6 +792,12 @@ int main(int argc, const char *argv[]) {
 
         /* Extract archive */
         err = minizip_extract(path, filename_to_extract, destination, password, &options);
+    } else if (do_test) {
+        if (argc > path_arg + 1)
+            filename_to_extract = argv[path_arg + 1];
+
+        /* Test archive */
+        err = minizip_test(path, filename_to_extract, password, &options);
     } else if (do_erase) {
         /* Erase file in archive */
         err = minizip_erase(path, NULL, argc - (path_arg + 1), &argv[path_arg + 1]);
@@ -66,12 +66,21 @@
 #define MZ_COMPRESS_METHOD_ZSTD         (93)
 #define MZ_COMPRESS_METHOD_XZ           (95)
 #define MZ_COMPRESS_METHOD_AES          (99)
+#define MZ_COMPRESS_METHOD_DICT         (0xd1c7)
 
 #define MZ_COMPRESS_LEVEL_DEFAULT       (-1)
 #define MZ_COMPRESS_LEVEL_FAST          (2)
 #define MZ_COMPRESS_LEVEL_NORMAL        (6)
 #define MZ_COMPRESS_LEVEL_BEST          (9)
 
+/* MZ_CODEC */
+#define MZ_CODEC_COMPRESS               (1 << 0)
+#define MZ_CODEC_DECOMPRESS             (1 << 1)
+#define MZ_CODEC_DICTIONARY             (1 << 2)
+#define MZ_CODEC_STREAMING              (1 << 3)
+#define MZ_CODEC_ONE_SHOT               (1 << 4)
+#define MZ_CODEC_THREADED               (1 << 5)
+
 /* MZ_ZIP_FLAG */
 #define MZ_ZIP_FLAG_ENCRYPTED           (1 << 0)
 #define MZ_ZIP_FLAG_LZMA_EOS_MARKER     (1 << 1)
@@ -92,6 +101,7 @@
 #define MZ_ZIP_EXTENSION_SIGN           (0x10c5)
 #define MZ_ZIP_EXTENSION_HASH           (0x1a51)
 #define MZ_ZIP_EXTENSION_CDCD           (0xcdcd)
+#define MZ_ZIP_EXTENSION_DICT           (0xd1c7)
 
 /* MZ_ZIP64 */
 #define MZ_ZIP64_AUTO                   (0)
@@ -270,4 +280,16 @@ typedef unsigned long long uint64_t;
 
 /***************************************************************************/
 
+/* MZ_ALLOCATOR */
+typedef void*   (*mz_alloc_cb)(void *opaque, size_t size);
+typedef void    (*mz_free_cb)(void *opaque, void *ptr);
+
+typedef struct mz_alloc_s {
+    mz_alloc_cb alloc;
+    mz_free_cb  free;
+    void        *opaque;
+} mz_alloc;
+
+/***************************************************************************/
+
 #endif
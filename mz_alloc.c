@@ -0,0 +1,145 @@
+/* mz_alloc.c -- Pluggable allocators
+   part of the MiniZip project
+
+   Copyright (C) 2010-2020 Nathan Moinvaziri
+     https://github.com/nmoinvaz/minizip
+
+   This program is distributed under the terms of the same license as zlib.
+   See the accompanying LICENSE file for the full text of the license.
+*/
+
+#include "mz.h"
+#include "mz_alloc.h"
+
+/***************************************************************************/
+
+#define MZ_ALLOC_ARENA_ALIGN            (16)
+
+/***************************************************************************/
+
+void *mz_alloc_malloc(const mz_alloc *alloc, size_t size) {
+    if (alloc == NULL || alloc->alloc == NULL)
+        return MZ_ALLOC(size);
+    return alloc->alloc(alloc->opaque, size);
+}
+
+void mz_alloc_free(const mz_alloc *alloc, void *ptr) {
+    if (ptr == NULL)
+        return;
+    if (alloc == NULL || alloc->free == NULL) {
+        MZ_FREE(ptr);
+        return;
+    }
+    alloc->free(alloc->opaque, ptr);
+}
+
+/***************************************************************************/
+
+typedef struct mz_alloc_arena_s {
+    mz_alloc        alloc;
+    mz_alloc_stats  stats;
+    uint8_t         *block;
+    int64_t         capacity;
+} mz_alloc_arena;
+
+/***************************************************************************/
+
+static void *mz_alloc_arena_alloc(void *opaque, size_t size) {
+    mz_alloc_arena *arena = (mz_alloc_arena *)opaque;
+    int64_t aligned_size = 0;
+    void *ptr = NULL;
+
+    arena->stats.alloc_calls += 1;
+
+    aligned_size = ((int64_t)size + MZ_ALLOC_ARENA_ALIGN - 1) & ~(int64_t)(MZ_ALLOC_ARENA_ALIGN - 1);
+    if ((arena->block == NULL) || (aligned_size > arena->capacity - arena->stats.bytes_used)) {
+        /* Keep going when the arena is too small, the counters show it needs to grow */
+        arena->stats.fallback_calls += 1;
+        return MZ_ALLOC(size);
+    }
+
+    ptr = arena->block + arena->stats.bytes_used;
+    arena->stats.bytes_used += aligned_size;
+    if (arena->stats.bytes_used > arena->stats.bytes_peak)
+        arena->stats.bytes_peak = arena->stats.bytes_used;
+    return ptr;
+}
+
+static void mz_alloc_arena_free(void *opaque, void *ptr) {
+    mz_alloc_arena *arena = (mz_alloc_arena *)opaque;
+    uint8_t *ptr8 = (uint8_t *)ptr;
+
+    arena->stats.free_calls += 1;
+
+    /* Memory from the block is only given back on reset */
+    if ((arena->block != NULL) && (ptr8 >= arena->block) && (ptr8 < arena->block + arena->capacity))
+        return;
+    MZ_FREE(ptr);
+}
+
+int32_t mz_alloc_arena_reserve(void *handle, int32_t capacity) {
+    mz_alloc_arena *arena = (mz_alloc_arena *)handle;
+
+    if (arena == NULL || capacity <= 0)
+        return MZ_PARAM_ERROR;
+    if (arena->block != NULL)
+        MZ_FREE(arena->block);
+
+    arena->capacity = 0;
+    arena->stats.bytes_used = 0;
+
+    arena->block = (uint8_t *)MZ_ALLOC(capacity);
+    if (arena->block == NULL)
+        return MZ_MEM_ERROR;
+    arena->capacity = capacity;
+    return MZ_OK;
+}
+
+void mz_alloc_arena_reset(void *handle) {
+    mz_alloc_arena *arena = (mz_alloc_arena *)handle;
+    arena->stats.bytes_used = 0;
+}
+
+mz_alloc *mz_alloc_arena_get_alloc(void *handle) {
+    mz_alloc_arena *arena = (mz_alloc_arena *)handle;
+    if (arena == NULL)
+        return NULL;
+    return &arena->alloc;
+}
+
+int32_t mz_alloc_arena_get_stats(void *handle, mz_alloc_stats *stats) {
+    mz_alloc_arena *arena = (mz_alloc_arena *)handle;
+    if (arena == NULL || stats == NULL)
+        return MZ_PARAM_ERROR;
+    memcpy(stats, &arena->stats, sizeof(mz_alloc_stats));
+    return MZ_OK;
+}
+
+void *mz_alloc_arena_create(void **handle) {
+    mz_alloc_arena *arena = NULL;
+
+    arena = (mz_alloc_arena *)MZ_ALLOC(sizeof(mz_alloc_arena));
+    if (arena != NULL) {
+        memset(arena, 0, sizeof(mz_alloc_arena));
+        arena->alloc.alloc = mz_alloc_arena_alloc;
+        arena->alloc.free = mz_alloc_arena_free;
+        arena->alloc.opaque = arena;
+    }
+    if (handle != NULL)
+        *handle = arena;
+
+    return arena;
+}
+
+void mz_alloc_arena_delete(void **handle) {
+    mz_alloc_arena *arena = NULL;
+    if (handle == NULL)
+        return;
+    arena = (mz_alloc_arena *)*handle;
+    if (arena != NULL) {
+        if (arena->block != NULL)
+            MZ_FREE(arena->block);
+        MZ_FREE(arena);
+    }
+    *handle = NULL;
+}
@@ -0,0 +1,62 @@
+/* mz_alloc.h -- Pluggable allocators
+   part of the MiniZip project
+
+   Copyright (C) 2010-2020 Nathan Moinvaziri
+     https://github.com/nmoinvaz/minizip
+
+   This program is distributed under the terms of the same license as zlib.
+   See the accompanying LICENSE file for the full text of the license.
+*/
+
+#ifndef MZ_ALLOC_H
+#define MZ_ALLOC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************************************************/
+
+typedef struct mz_alloc_stats_s {
+    int64_t     alloc_calls;        /* allocations requested */
+    int64_t     free_calls;         /* frees requested */
+    int64_t     fallback_calls;     /* allocations that did not fit and used MZ_ALLOC */
+    int64_t     bytes_used;         /* bytes handed out since the last reset */
+    int64_t     bytes_peak;         /* most bytes handed out between resets */
+} mz_alloc_stats;
+
+/***************************************************************************/
+
+void*   mz_alloc_malloc(const mz_alloc *alloc, size_t size);
+/* Allocates memory with the allocator, or MZ_ALLOC if there is none */
+
+void    mz_alloc_free(const mz_alloc *alloc, void *ptr);
+/* Frees memory allocated with mz_alloc_malloc */
+
+/***************************************************************************/
+
+int32_t mz_alloc_arena_reserve(void *handle, int32_t capacity);
+/* Allocates the block the arena hands out memory from */
+
+void    mz_alloc_arena_reset(void *handle);
+/* Makes the whole block available again, nothing allocated from it may still be in use */
+
+mz_alloc* mz_alloc_arena_get_alloc(void *handle);
+/* Gets the allocator interface backed by the arena */
+
+int32_t mz_alloc_arena_get_stats(void *handle, mz_alloc_stats *stats);
+/* Gets the allocation counters of the arena */
+
+void*   mz_alloc_arena_create(void **handle);
+/* Create arena allocator instance */
+
+void    mz_alloc_arena_delete(void **handle);
+/* Delete arena allocator instance and its block */
+
+/***************************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
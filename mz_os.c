@@ -80,49 +80,346 @@ int32_t mz_path_convert_slashes(char *path, char slash) {
     return MZ_OK;
 }
 
+static int32_t mz_path_compare_char(char path_char, char wildcard_char, uint8_t ignore_case) {
+    /* Ignore differences in path slashes on platforms */
+    if ((path_char == '\\' || path_char == '/') && (wildcard_char == '\\' || wildcard_char == '/'))
+        return 1;
+    if (ignore_case)
+        return tolower((uint8_t)path_char) == tolower((uint8_t)wildcard_char);
+    return path_char == wildcard_char;
+}
+
 int32_t mz_path_compare_wc(const char *path, const char *wildcard, uint8_t ignore_case) {
+    const char *star = NULL;
+    const char *star_path = NULL;
+
+    /* Only the last star is backtracked to, so it never takes more than path times wildcard steps */
     while (*path != 0) {
-        switch (*wildcard) {
-        case '*':
+        if (*wildcard == '*') {
+            star = wildcard;
+            star_path = path;
+            wildcard += 1;
+        } else if (*wildcard != 0 && mz_path_compare_char(*path, *wildcard, ignore_case)) {
+            path += 1;
+            wildcard += 1;
+        } else if (star != NULL) {
+            /* Let the star take one more character and try again */
+            star_path += 1;
+            path = star_path;
+            wildcard = star + 1;
+        } else {
+            return MZ_EXIST_ERROR;
+        }
+    }
 
-            if (*(wildcard + 1) == 0)
-                return MZ_OK;
+    while (*wildcard == '*')
+        wildcard += 1;
+    if (*wildcard != 0)
+        return MZ_EXIST_ERROR;
 
-            while (*path != 0) {
-                if (mz_path_compare_wc(path, (wildcard + 1), ignore_case) == MZ_OK)
-                    return MZ_OK;
+    return MZ_OK;
+}
 
-                path += 1;
-            }
+/***************************************************************************/
 
-            return MZ_EXIST_ERROR;
+#define MZ_PATTERN_LITERAL  (0)
+#define MZ_PATTERN_PREFIX   (1)
+#define MZ_PATTERN_SUFFIX   (2)
+#define MZ_PATTERN_GENERAL  (3)
+
+typedef struct mz_pattern_item_s {
+    char     *wildcard;
+    uint8_t  ignore_case;
+    uint8_t  kind;
+    int32_t  literal_size;      /* characters hashed for literal, prefix and suffix patterns */
+    uint32_t hash;
+    int32_t  next;              /* next item in the same bucket */
+} mz_pattern_item;
+
+typedef struct mz_pattern_s {
+    mz_pattern_item *items;
+    int32_t  count;
+    int32_t  capacity;
+    int32_t  *buckets;
+    int32_t  bucket_count;
+    int32_t  *prefix_sizes;     /* distinct prefix sizes, ascending */
+    int32_t  prefix_size_count;
+    int32_t  *suffix_sizes;     /* distinct suffix sizes, ascending */
+    int32_t  suffix_size_count;
+    int32_t  *general;          /* items matched one by one */
+    int32_t  general_count;
+    uint8_t  match_all;
+    uint8_t  compiled;
+} mz_pattern;
+
+static uint32_t mz_pattern_hash_char(uint32_t hash, char c) {
+    /* Folded so that patterns with and without case sensitivity share the table */
+    if (c == '\\')
+        c = '/';
+    return (hash ^ (uint8_t)tolower((uint8_t)c)) * 16777619u;
+}
 
-        default:
-            /* Ignore differences in path slashes on platforms */
-            if ((*path == '\\' && *wildcard == '/') || (*path == '/' && *wildcard == '\\'))
-                break;
+static int32_t mz_pattern_size_compare(const void *a, const void *b) {
+    int32_t size_a = *(const int32_t *)a;
+    int32_t size_b = *(const int32_t *)b;
+    return (size_a > size_b) - (size_a < size_b);
+}
 
-            if (ignore_case) {
-                if (tolower(*path) != tolower(*wildcard))
-                    return MZ_EXIST_ERROR;
-            } else {
-                if (*path != *wildcard)
-                    return MZ_EXIST_ERROR;
-            }
+static int32_t mz_pattern_sizes_create(mz_pattern *pattern, uint8_t kind, int32_t **sizes, int32_t *size_count) {
+    int32_t count = 0;
+    int32_t i = 0;
 
-            break;
+    *sizes = (int32_t *)MZ_ALLOC((pattern->count + 1) * sizeof(int32_t));
+    if (*sizes == NULL)
+        return MZ_MEM_ERROR;
+    for (i = 0; i < pattern->count; i += 1) {
+        if (pattern->items[i].kind == kind)
+            (*sizes)[count++] = pattern->items[i].literal_size;
+    }
+    qsort(*sizes, count, sizeof(int32_t), mz_pattern_size_compare);
+
+    *size_count = 0;
+    for (i = 0; i < count; i += 1) {
+        if (*size_count == 0 || (*sizes)[*size_count - 1] != (*sizes)[i])
+            (*sizes)[(*size_count)++] = (*sizes)[i];
+    }
+    return MZ_OK;
+}
+
+static void mz_pattern_reset(mz_pattern *pattern) {
+    MZ_FREE(pattern->buckets);
+    MZ_FREE(pattern->prefix_sizes);
+    MZ_FREE(pattern->suffix_sizes);
+    MZ_FREE(pattern->general);
+    pattern->buckets = NULL;
+    pattern->prefix_sizes = NULL;
+    pattern->suffix_sizes = NULL;
+    pattern->general = NULL;
+    pattern->bucket_count = 0;
+    pattern->prefix_size_count = 0;
+    pattern->suffix_size_count = 0;
+    pattern->general_count = 0;
+    pattern->compiled = 0;
+}
+
+static int32_t mz_pattern_compile(mz_pattern *pattern) {
+    mz_pattern_item *item = NULL;
+    int32_t bucket = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    mz_pattern_reset(pattern);
+
+    pattern->bucket_count = 16;
+    while (pattern->bucket_count < pattern->count * 2)
+        pattern->bucket_count *= 2;
+
+    pattern->buckets = (int32_t *)MZ_ALLOC(pattern->bucket_count * sizeof(int32_t));
+    pattern->general = (int32_t *)MZ_ALLOC((pattern->count + 1) * sizeof(int32_t));
+    if (pattern->buckets == NULL || pattern->general == NULL)
+        err = MZ_MEM_ERROR;
+    if (err == MZ_OK)
+        err = mz_pattern_sizes_create(pattern, MZ_PATTERN_PREFIX, &pattern->prefix_sizes, &pattern->prefix_size_count);
+    if (err == MZ_OK)
+        err = mz_pattern_sizes_create(pattern, MZ_PATTERN_SUFFIX, &pattern->suffix_sizes, &pattern->suffix_size_count);
+    if (err != MZ_OK) {
+        mz_pattern_reset(pattern);
+        return err;
+    }
+
+    for (i = 0; i < pattern->bucket_count; i += 1)
+        pattern->buckets[i] = -1;
+
+    for (i = 0; i < pattern->count; i += 1) {
+        item = &pattern->items[i];
+        if (item->kind == MZ_PATTERN_GENERAL) {
+            pattern->general[pattern->general_count++] = i;
+            continue;
         }
+        bucket = (int32_t)(item->hash & (uint32_t)(pattern->bucket_count - 1));
+        item->next = pattern->buckets[bucket];
+        pattern->buckets[bucket] = i;
+    }
 
-        path += 1;
-        wildcard += 1;
+    pattern->compiled = 1;
+    return MZ_OK;
+}
+
+static int32_t mz_pattern_lookup(mz_pattern *pattern, const char *path, uint8_t kind, int32_t literal_size,
+    uint32_t hash) {
+    mz_pattern_item *item = NULL;
+    int32_t i = pattern->buckets[hash & (uint32_t)(pattern->bucket_count - 1)];
+
+    for (; i >= 0; i = item->next) {
+        item = &pattern->items[i];
+        if (item->hash != hash || item->kind != kind || item->literal_size != literal_size)
+            continue;
+        if (mz_path_compare_wc(path, item->wildcard, item->ignore_case) == MZ_OK)
+            return MZ_OK;
     }
+    return MZ_EXIST_ERROR;
+}
 
-    if ((*wildcard != 0) && (*wildcard != '*'))
-        return MZ_EXIST_ERROR;
+void *mz_pattern_create(void **handle) {
+    mz_pattern *pattern = NULL;
+
+    pattern = (mz_pattern *)MZ_ALLOC(sizeof(mz_pattern));
+    if (pattern != NULL)
+        memset(pattern, 0, sizeof(mz_pattern));
+    if (handle != NULL)
+        *handle = pattern;
+
+    return pattern;
+}
+
+void mz_pattern_delete(void **handle) {
+    mz_pattern *pattern = NULL;
+    int32_t i = 0;
+    if (handle == NULL)
+        return;
+    pattern = (mz_pattern *)*handle;
+    if (pattern != NULL) {
+        mz_pattern_reset(pattern);
+        for (i = 0; i < pattern->count; i += 1)
+            MZ_FREE(pattern->items[i].wildcard);
+        MZ_FREE(pattern->items);
+        MZ_FREE(pattern);
+    }
+    *handle = NULL;
+}
+
+int32_t mz_pattern_add(void *handle, const char *wildcard, uint8_t ignore_case) {
+    mz_pattern *pattern = (mz_pattern *)handle;
+    mz_pattern_item *items = NULL;
+    mz_pattern_item *item = NULL;
+    const char *literal = NULL;
+    char *copy = NULL;
+    int32_t capacity = 0;
+    int32_t stars = 0;
+    int32_t size = 0;
+    int32_t i = 0;
+
+    if (pattern == NULL || wildcard == NULL)
+        return MZ_PARAM_ERROR;
+
+    /* Runs of stars match the same as one star */
+    copy = (char *)MZ_ALLOC(strlen(wildcard) + 1);
+    if (copy == NULL)
+        return MZ_MEM_ERROR;
+    for (i = 0; wildcard[i] != 0; i += 1) {
+        if (wildcard[i] == '*' && size > 0 && copy[size - 1] == '*')
+            continue;
+        if (wildcard[i] == '*')
+            stars += 1;
+        copy[size++] = wildcard[i];
+    }
+    copy[size] = 0;
+
+    if (pattern->count == pattern->capacity) {
+        capacity = (pattern->capacity == 0) ? 16 : pattern->capacity * 2;
+        items = (mz_pattern_item *)MZ_ALLOC(capacity * sizeof(mz_pattern_item));
+        if (items == NULL) {
+            MZ_FREE(copy);
+            return MZ_MEM_ERROR;
+        }
+        if (pattern->items != NULL)
+            memcpy(items, pattern->items, pattern->count * sizeof(mz_pattern_item));
+        MZ_FREE(pattern->items);
+        pattern->items = items;
+        pattern->capacity = capacity;
+    }
 
+    item = &pattern->items[pattern->count];
+    memset(item, 0, sizeof(mz_pattern_item));
+    item->wildcard = copy;
+    item->ignore_case = ignore_case;
+    item->kind = MZ_PATTERN_GENERAL;
+    item->hash = 2166136261u;
+    item->next = -1;
+
+    if (stars == 1 && size == 1) {
+        pattern->match_all = 1;
+    } else if (stars == 0) {
+        item->kind = MZ_PATTERN_LITERAL;
+        literal = copy;
+        item->literal_size = size;
+    } else if (stars == 1 && copy[size - 1] == '*') {
+        item->kind = MZ_PATTERN_PREFIX;
+        literal = copy;
+        item->literal_size = size - 1;
+    } else if (stars == 1 && copy[0] == '*') {
+        item->kind = MZ_PATTERN_SUFFIX;
+        literal = copy + 1;
+        item->literal_size = size - 1;
+    }
+
+    /* Suffixes are hashed from their last character back so they can be hashed along a path from its end */
+    if (item->kind == MZ_PATTERN_SUFFIX) {
+        for (i = item->literal_size - 1; i >= 0; i -= 1)
+            item->hash = mz_pattern_hash_char(item->hash, literal[i]);
+    } else if (literal != NULL) {
+        for (i = 0; i < item->literal_size; i += 1)
+            item->hash = mz_pattern_hash_char(item->hash, literal[i]);
+    }
+
+    pattern->count += 1;
+    pattern->compiled = 0;
     return MZ_OK;
 }
 
+int32_t mz_pattern_match(void *handle, const char *path) {
+    mz_pattern *pattern = (mz_pattern *)handle;
+    uint32_t hash = 2166136261u;
+    int32_t path_size = 0;
+    int32_t size = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    if (pattern == NULL || path == NULL)
+        return MZ_PARAM_ERROR;
+    if (pattern->match_all)
+        return MZ_OK;
+    if (!pattern->compiled) {
+        err = mz_pattern_compile(pattern);
+        if (err != MZ_OK)
+            return err;
+    }
+
+    path_size = (int32_t)strlen(path);
+
+    /* Prefixes are looked up as the path is hashed, at each size a prefix pattern has */
+    for (i = 0, size = 0; i < pattern->prefix_size_count; i += 1) {
+        if (pattern->prefix_sizes[i] > path_size)
+            break;
+        for (; size < pattern->prefix_sizes[i]; size += 1)
+            hash = mz_pattern_hash_char(hash, path[size]);
+        if (mz_pattern_lookup(pattern, path, MZ_PATTERN_PREFIX, size, hash) == MZ_OK)
+            return MZ_OK;
+    }
+    for (; size < path_size; size += 1)
+        hash = mz_pattern_hash_char(hash, path[size]);
+    if (mz_pattern_lookup(pattern, path, MZ_PATTERN_LITERAL, path_size, hash) == MZ_OK)
+        return MZ_OK;
+
+    hash = 2166136261u;
+    for (i = 0, size = 0; i < pattern->suffix_size_count; i += 1) {
+        if (pattern->suffix_sizes[i] > path_size)
+            break;
+        for (; size < pattern->suffix_sizes[i]; size += 1)
+            hash = mz_pattern_hash_char(hash, path[path_size - size - 1]);
+        if (mz_pattern_lookup(pattern, path, MZ_PATTERN_SUFFIX, size, hash) == MZ_OK)
+            return MZ_OK;
+    }
+
+    for (i = 0; i < pattern->general_count; i += 1) {
+        if (mz_path_compare_wc(path, pattern->items[pattern->general[i]].wildcard,
+            pattern->items[pattern->general[i]].ignore_case) == MZ_OK)
+            return MZ_OK;
+    }
+
+    return MZ_EXIST_ERROR;
+}
+
 int32_t mz_path_resolve(const char *path, char *output, int32_t max_output) {
     const char *source = path;
     const char *check = output;
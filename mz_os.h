@@ -58,6 +58,8 @@ typedef void* DIR;
 #include <dirent.h>
 #endif
 
+typedef void (*mz_os_thread_cb)(void *userdata, int32_t index);
+
 /***************************************************************************/
 /* Shared functions */
 
@@ -79,6 +81,18 @@ int32_t mz_path_convert_slashes(char *path, char slash);
 int32_t mz_path_compare_wc(const char *path, const char *wildcard, uint8_t ignore_case);
 /* Compare two paths with wildcard */
 
+void *  mz_pattern_create(void **handle);
+/* Create a set of wildcard patterns */
+
+void    mz_pattern_delete(void **handle);
+/* Delete a set of wildcard patterns */
+
+int32_t mz_pattern_add(void *handle, const char *wildcard, uint8_t ignore_case);
+/* Adds a wildcard pattern to the set */
+
+int32_t mz_pattern_match(void *handle, const char *path);
+/* Checks whether a path matches any pattern in the set */
+
 int32_t mz_path_resolve(const char *path, char *target, int32_t max_target);
 /* Resolves path */
 
@@ -166,6 +180,19 @@ int32_t  mz_os_read_symlink(const char *path, char *target_path, int32_t max_tar
 uint64_t mz_os_ms_time(void);
 /* Gets the time in milliseconds */
 
+uint64_t mz_os_ns_time(void);
+/* Gets a monotonic time in nanoseconds for measuring intervals */
+
+int32_t  mz_os_map_file(const char *path, const void **buf, int64_t *size);
+/* Maps a whole file read only into memory */
+
+int32_t  mz_os_unmap_file(const void *buf, int64_t size);
+/* Unmaps a file mapped with mz_os_map_file */
+
+int32_t  mz_os_run_threads(int32_t thread_count, mz_os_thread_cb cb, void *userdata);
+/* Calls back with each index below the thread count on its own thread and waits for all of them,
+   index 0 is run on the calling thread */
+
 /***************************************************************************/
 
 #ifdef __cplusplus
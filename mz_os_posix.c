@@ -24,11 +24,16 @@
 #ifndef _WIN32
 #  include <utime.h>
 #  include <unistd.h>
+#  include <fcntl.h> /* open */
+#  include <sys/mman.h> /* mmap */
 #endif
 #if defined(__APPLE__)
 #  include <mach/clock.h>
 #  include <mach/mach.h>
 #endif
+#ifdef HAVE_THREADS
+#  include <pthread.h>
+#endif
 
 /***************************************************************************/
 
@@ -315,3 +320,126 @@ uint64_t mz_os_ms_time(void) {
 
     return ((uint64_t)ts.tv_sec * 1000) + ((uint64_t)ts.tv_nsec / 1000000);
 }
+
+uint64_t mz_os_ns_time(void) {
+    struct timespec ts;
+
+#if defined(__APPLE__)
+    clock_serv_t cclock;
+    mach_timespec_t mts;
+
+    host_get_clock_service(mach_host_self(), SYSTEM_CLOCK, &cclock);
+    clock_get_time(cclock, &mts);
+    mach_port_deallocate(mach_task_self(), cclock);
+
+    ts.tv_sec = mts.tv_sec;
+    ts.tv_nsec = mts.tv_nsec;
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+
+    return ((uint64_t)ts.tv_sec * 1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+int32_t mz_os_map_file(const char *path, const void **buf, int64_t *size) {
+#ifdef MAP_PRIVATE
+    struct stat path_stat;
+    void *map = NULL;
+    int fd = 0;
+
+    if (path == NULL || buf == NULL || size == NULL)
+        return MZ_PARAM_ERROR;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return MZ_OPEN_ERROR;
+    memset(&path_stat, 0, sizeof(path_stat));
+    if (fstat(fd, &path_stat) != 0 || path_stat.st_size <= 0 ||
+        (int64_t)(size_t)path_stat.st_size != (int64_t)path_stat.st_size) {
+        close(fd);
+        return MZ_OPEN_ERROR;
+    }
+    /* Mapping stays valid after the descriptor is closed */
+    map = mmap(NULL, (size_t)path_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return MZ_SUPPORT_ERROR;
+
+    *buf = map;
+    *size = path_stat.st_size;
+    return MZ_OK;
+#else
+    MZ_UNUSED(path);
+    MZ_UNUSED(buf);
+    MZ_UNUSED(size);
+    return MZ_SUPPORT_ERROR;
+#endif
+}
+
+int32_t mz_os_unmap_file(const void *buf, int64_t size) {
+#ifdef MAP_PRIVATE
+    if (buf == NULL)
+        return MZ_PARAM_ERROR;
+    if (munmap((void *)buf, (size_t)size) != 0)
+        return MZ_CLOSE_ERROR;
+    return MZ_OK;
+#else
+    MZ_UNUSED(buf);
+    MZ_UNUSED(size);
+    return MZ_SUPPORT_ERROR;
+#endif
+}
+
+#ifdef HAVE_THREADS
+typedef struct mz_os_thread_s {
+    pthread_t       thread;
+    mz_os_thread_cb cb;
+    void            *userdata;
+    int32_t         index;
+} mz_os_thread;
+
+static void *mz_os_thread_start(void *arg) {
+    mz_os_thread *thread = (mz_os_thread *)arg;
+    thread->cb(thread->userdata, thread->index);
+    return NULL;
+}
+#endif
+
+int32_t mz_os_run_threads(int32_t thread_count, mz_os_thread_cb cb, void *userdata) {
+#ifdef HAVE_THREADS
+    mz_os_thread *threads = NULL;
+    int32_t started = 0;
+    int32_t i = 0;
+
+    if (thread_count <= 0 || cb == NULL)
+        return MZ_PARAM_ERROR;
+
+    threads = (mz_os_thread *)MZ_ALLOC(thread_count * sizeof(mz_os_thread));
+    if (threads == NULL)
+        return MZ_MEM_ERROR;
+    memset(threads, 0, thread_count * sizeof(mz_os_thread));
+
+    for (i = 1; i < thread_count; i += 1) {
+        threads[i].cb = cb;
+        threads[i].userdata = userdata;
+        threads[i].index = i;
+        if (pthread_create(&threads[i].thread, NULL, mz_os_thread_start, &threads[i]) != 0)
+            break;
+        started += 1;
+    }
+    /* Work of threads that could not be started is done on the calling thread */
+    cb(userdata, 0);
+    for (i = started + 1; i < thread_count; i += 1)
+        cb(userdata, i);
+    for (i = 1; i <= started; i += 1)
+        pthread_join(threads[i].thread, NULL);
+
+    MZ_FREE(threads);
+    return MZ_OK;
+#else
+    MZ_UNUSED(thread_count);
+    MZ_UNUSED(cb);
+    MZ_UNUSED(userdata);
+    return MZ_SUPPORT_ERROR;
+#endif
+}
@@ -632,3 +632,130 @@ uint64_t mz_os_ms_time(void) {
 
     return quad_file_time / 10000 - 11644473600000LL;
 }
+
+uint64_t mz_os_ns_time(void) {
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000 +
+        (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+}
+
+int32_t mz_os_map_file(const char *path, const void **buf, int64_t *size) {
+#ifdef MZ_WINRT_API
+    MZ_UNUSED(path);
+    MZ_UNUSED(buf);
+    MZ_UNUSED(size);
+    return MZ_SUPPORT_ERROR;
+#else
+    HANDLE handle = NULL;
+    HANDLE mapping = NULL;
+    LARGE_INTEGER large_size;
+    wchar_t *path_wide = NULL;
+    void *map = NULL;
+
+    if (path == NULL || buf == NULL || size == NULL)
+        return MZ_PARAM_ERROR;
+    path_wide = mz_os_unicode_string_create(path, MZ_ENCODING_UTF8);
+    if (path_wide == NULL)
+        return MZ_PARAM_ERROR;
+    handle = CreateFileW(path_wide, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    mz_os_unicode_string_delete(&path_wide);
+    if (handle == INVALID_HANDLE_VALUE)
+        return MZ_OPEN_ERROR;
+
+    large_size.QuadPart = 0;
+    if (!GetFileSizeEx(handle, &large_size) || large_size.QuadPart <= 0 ||
+        (int64_t)(SIZE_T)large_size.QuadPart != large_size.QuadPart) {
+        CloseHandle(handle);
+        return MZ_OPEN_ERROR;
+    }
+    /* View stays valid after the file and mapping handles are closed */
+    mapping = CreateFileMappingW(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) {
+        map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+    CloseHandle(handle);
+    if (map == NULL)
+        return MZ_SUPPORT_ERROR;
+
+    *buf = map;
+    *size = large_size.QuadPart;
+    return MZ_OK;
+#endif
+}
+
+int32_t mz_os_unmap_file(const void *buf, int64_t size) {
+    MZ_UNUSED(size);
+#ifdef MZ_WINRT_API
+    MZ_UNUSED(buf);
+    return MZ_SUPPORT_ERROR;
+#else
+    if (buf == NULL)
+        return MZ_PARAM_ERROR;
+    if (!UnmapViewOfFile(buf))
+        return MZ_CLOSE_ERROR;
+    return MZ_OK;
+#endif
+}
+
+#if defined(HAVE_THREADS) && !defined(MZ_WINRT_API)
+typedef struct mz_os_thread_s {
+    HANDLE          handle;
+    mz_os_thread_cb cb;
+    void            *userdata;
+    int32_t         index;
+} mz_os_thread;
+
+static DWORD WINAPI mz_os_thread_start(LPVOID arg) {
+    mz_os_thread *thread = (mz_os_thread *)arg;
+    thread->cb(thread->userdata, thread->index);
+    return 0;
+}
+#endif
+
+int32_t mz_os_run_threads(int32_t thread_count, mz_os_thread_cb cb, void *userdata) {
+#if defined(HAVE_THREADS) && !defined(MZ_WINRT_API)
+    mz_os_thread *threads = NULL;
+    int32_t started = 0;
+    int32_t i = 0;
+
+    if (thread_count <= 0 || cb == NULL)
+        return MZ_PARAM_ERROR;
+
+    threads = (mz_os_thread *)MZ_ALLOC(thread_count * sizeof(mz_os_thread));
+    if (threads == NULL)
+        return MZ_MEM_ERROR;
+    memset(threads, 0, thread_count * sizeof(mz_os_thread));
+
+    for (i = 1; i < thread_count; i += 1) {
+        threads[i].cb = cb;
+        threads[i].userdata = userdata;
+        threads[i].index = i;
+        threads[i].handle = CreateThread(NULL, 0, mz_os_thread_start, &threads[i], 0, NULL);
+        if (threads[i].handle == NULL)
+            break;
+        started += 1;
+    }
+    /* Work of threads that could not be started is done on the calling thread */
+    cb(userdata, 0);
+    for (i = started + 1; i < thread_count; i += 1)
+        cb(userdata, i);
+    for (i = 1; i <= started; i += 1) {
+        WaitForSingleObject(threads[i].handle, INFINITE);
+        CloseHandle(threads[i].handle);
+    }
+
+    MZ_FREE(threads);
+    return MZ_OK;
+#else
+    MZ_UNUSED(thread_count);
+    MZ_UNUSED(cb);
+    MZ_UNUSED(userdata);
+    return MZ_SUPPORT_ERROR;
+#endif
+}
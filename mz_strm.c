@@ -9,11 +9,15 @@
 */
 
 #include "mz.h"
+#include "mz_os.h"
 #include "mz_strm.h"
+#include "mz_trace.h"
 
 /***************************************************************************/
 
-#define MZ_STREAM_FIND_SIZE (1024)
+#ifndef MZ_STREAM_FIND_SIZE
+#  define MZ_STREAM_FIND_SIZE (64 * 1024)
+#endif
 
 /***************************************************************************/
 
@@ -33,11 +37,36 @@ int32_t mz_stream_is_open(void *stream) {
 
 int32_t mz_stream_read(void *stream, void *buf, int32_t size) {
     mz_stream *strm = (mz_stream *)stream;
+    uint64_t start = 0;
+    int32_t read = 0;
+
     if (strm == NULL || strm->vtbl == NULL || strm->vtbl->read == NULL)
         return MZ_PARAM_ERROR;
     if (mz_stream_is_open(stream) != MZ_OK)
         return MZ_STREAM_ERROR;
-    return strm->vtbl->read(strm, buf, size);
+    if (strm->stats == NULL)
+        return strm->vtbl->read(strm, buf, size);
+
+    start = mz_os_ns_time();
+    read = strm->vtbl->read(strm, buf, size);
+    strm->stats->read_time += (int64_t)(mz_os_ns_time() - start);
+    strm->stats->read_calls += 1;
+    if (read > 0)
+        strm->stats->bytes_read += read;
+    return read;
+}
+
+int32_t mz_stream_read_at(void *stream, int64_t offset, void *buf, int32_t size) {
+    mz_stream *strm = (mz_stream *)stream;
+
+    if (strm == NULL || strm->vtbl == NULL || buf == NULL || offset < 0 || size < 0)
+        return MZ_PARAM_ERROR;
+    if (strm->vtbl->read_at == NULL)
+        return MZ_SUPPORT_ERROR;
+    if (mz_stream_is_open(stream) != MZ_OK)
+        return MZ_STREAM_ERROR;
+    /* Stats are left alone so concurrent callers do not race on them */
+    return strm->vtbl->read_at(strm, offset, buf, size);
 }
 
 static int32_t mz_stream_read_value(void *stream, uint64_t *value, int32_t len) {
@@ -100,13 +129,25 @@ int32_t mz_stream_read_uint64(void *stream, uint64_t *value) {
 
 int32_t mz_stream_write(void *stream, const void *buf, int32_t size) {
     mz_stream *strm = (mz_stream *)stream;
+    uint64_t start = 0;
+    int32_t written = 0;
+
     if (size == 0)
         return size;
     if (strm == NULL || strm->vtbl == NULL || strm->vtbl->write == NULL)
         return MZ_PARAM_ERROR;
     if (mz_stream_is_open(stream) != MZ_OK)
         return MZ_STREAM_ERROR;
-    return strm->vtbl->write(strm, buf, size);
+    if (strm->stats == NULL)
+        return strm->vtbl->write(strm, buf, size);
+
+    start = mz_os_ns_time();
+    written = strm->vtbl->write(strm, buf, size);
+    strm->stats->write_time += (int64_t)(mz_os_ns_time() - start);
+    strm->stats->write_calls += 1;
+    if (written > 0)
+        strm->stats->bytes_written += written;
+    return written;
 }
 
 static int32_t mz_stream_write_value(void *stream, uint64_t value, int32_t len) {
@@ -222,57 +263,121 @@ int64_t mz_stream_tell(void *stream) {
 
 int32_t mz_stream_seek(void *stream, int64_t offset, int32_t origin) {
     mz_stream *strm = (mz_stream *)stream;
+    uint64_t start = 0;
+    int32_t err = MZ_OK;
+
     if (strm == NULL || strm->vtbl == NULL || strm->vtbl->seek == NULL)
         return MZ_PARAM_ERROR;
     if (mz_stream_is_open(stream) != MZ_OK)
         return MZ_STREAM_ERROR;
     if (origin == MZ_SEEK_SET && offset < 0)
         return MZ_SEEK_ERROR;
-    return strm->vtbl->seek(strm, offset, origin);
+    MZ_TRACE3(stream__seek, stream, offset, origin);
+    if (strm->stats == NULL)
+        return strm->vtbl->seek(strm, offset, origin);
+
+    start = mz_os_ns_time();
+    err = strm->vtbl->seek(strm, offset, origin);
+    strm->stats->seek_time += (int64_t)(mz_os_ns_time() - start);
+    strm->stats->seek_calls += 1;
+    return err;
+}
+
+static int32_t mz_stream_find_buf(const uint8_t *buf, int32_t size, const uint8_t *find, int32_t find_size) {
+    const uint8_t *ptr = buf;
+    const uint8_t *last = NULL;
+
+    /* Looks for the first byte with memchr and only compares the rest where it is found */
+    if (size < find_size)
+        return -1;
+    if (find_size == 0)
+        return 0;
+
+    last = buf + size - find_size;
+    while (ptr <= last) {
+        ptr = (const uint8_t *)memchr(ptr, find[0], (size_t)(last - ptr) + 1);
+        if (ptr == NULL)
+            break;
+        if (memcmp(ptr + 1, find + 1, find_size - 1) == 0)
+            return (int32_t)(ptr - buf);
+        ptr += 1;
+    }
+    return -1;
+}
+
+static int32_t mz_stream_find_buf_reverse(const uint8_t *buf, int32_t size, const uint8_t *find, int32_t find_size) {
+    int32_t i = 0;
+
+    if (size < find_size)
+        return -1;
+    if (find_size == 0)
+        return size;
+
+    for (i = size - find_size; i >= 0; i -= 1) {
+        if (buf[i] == find[0] && memcmp(buf + i + 1, find + 1, find_size - 1) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static int32_t mz_stream_find_buf_size(int32_t find_size, int64_t max_seek) {
+    /* Searches that can only look at a few bytes do not need the whole window */
+    if (max_seek < 0)
+        return find_size + 1;
+    if (max_seek < MZ_STREAM_FIND_SIZE - find_size - 1)
+        return (int32_t)max_seek + find_size + 1;
+    return MZ_STREAM_FIND_SIZE;
 }
 
 int32_t mz_stream_find(void *stream, const void *find, int32_t find_size, int64_t max_seek, int64_t *position) {
-    uint8_t buf[MZ_STREAM_FIND_SIZE];
+    uint8_t *buf = NULL;
+    int32_t buf_size = 0;
     int32_t buf_pos = 0;
-    int32_t read_size = sizeof(buf);
+    int32_t read_size = 0;
     int32_t read = 0;
     int64_t read_pos = 0;
     int64_t start_pos = 0;
     int64_t disk_pos = 0;
     int32_t i = 0;
     uint8_t first = 1;
-    int32_t err = MZ_OK;
+    int32_t err = MZ_EXIST_ERROR;
 
     if (stream == NULL || find == NULL || position == NULL)
         return MZ_PARAM_ERROR;
-    if (find_size < 0 || find_size >= (int32_t)sizeof(buf))
+    if (find_size < 0 || find_size >= MZ_STREAM_FIND_SIZE)
         return MZ_PARAM_ERROR;
 
     *position = -1;
 
+    buf_size = mz_stream_find_buf_size(find_size, max_seek);
+    buf = (uint8_t *)MZ_ALLOC(buf_size);
+    if (buf == NULL)
+        return MZ_MEM_ERROR;
+    read_size = buf_size;
+
     start_pos = mz_stream_tell(stream);
 
     while (read_pos < max_seek) {
-        if (read_size > (int32_t)(max_seek - read_pos - buf_pos) && (max_seek - read_pos - buf_pos) < (int64_t)sizeof(buf))
+        if (read_size > (int32_t)(max_seek - read_pos - buf_pos) && (max_seek - read_pos - buf_pos) < (int64_t)buf_size)
             read_size = (int32_t)(max_seek - read_pos - buf_pos);
 
         read = mz_stream_read(stream, buf + buf_pos, read_size);
         if ((read <= 0) || (read + buf_pos < find_size))
             break;
 
-        for (i = 0; i <= read + buf_pos - find_size; i += 1) {
-            if (memcmp(&buf[i], find, find_size) != 0)
-                continue;
-
+        i = mz_stream_find_buf(buf, read + buf_pos, (const uint8_t *)find, find_size);
+        if (i >= 0) {
             disk_pos = mz_stream_tell(stream);
 
             /* Seek to position on disk where the data was found */
             err = mz_stream_seek(stream, disk_pos - ((int64_t)read + buf_pos - i), MZ_SEEK_SET);
-            if (err != MZ_OK)
-                return MZ_EXIST_ERROR;
+            if (err != MZ_OK) {
+                err = MZ_EXIST_ERROR;
+                break;
+            }
 
             *position = start_pos + read_pos + i;
-            return MZ_OK;
+            break;
         }
 
         if (first) {
@@ -286,55 +391,70 @@ int32_t mz_stream_find(void *stream, const void *find, int32_t find_size, int64_
         read_pos += read;
     }
 
-    return MZ_EXIST_ERROR;
+    MZ_FREE(buf);
+    return err;
 }
 
 int32_t mz_stream_find_reverse(void *stream, const void *find, int32_t find_size, int64_t max_seek, int64_t *position) {
-    uint8_t buf[MZ_STREAM_FIND_SIZE];
+    uint8_t *buf = NULL;
+    int32_t buf_size = 0;
     int32_t buf_pos = 0;
-    int32_t read_size = MZ_STREAM_FIND_SIZE;
+    int32_t read_size = 0;
     int64_t read_pos = 0;
     int32_t read = 0;
     int64_t start_pos = 0;
     int64_t disk_pos = 0;
     uint8_t first = 1;
     int32_t i = 0;
-    int32_t err = MZ_OK;
+    int32_t err = MZ_EXIST_ERROR;
 
     if (stream == NULL || find == NULL || position == NULL)
         return MZ_PARAM_ERROR;
-    if (find_size < 0 || find_size >= (int32_t)sizeof(buf))
+    if (find_size < 0 || find_size >= MZ_STREAM_FIND_SIZE)
         return MZ_PARAM_ERROR;
 
     *position = -1;
 
+    buf_size = mz_stream_find_buf_size(find_size, max_seek);
+    buf = (uint8_t *)MZ_ALLOC(buf_size);
+    if (buf == NULL)
+        return MZ_MEM_ERROR;
+    read_size = buf_size;
+
     start_pos = mz_stream_tell(stream);
 
     while (read_pos < max_seek) {
-        if (read_size > (int32_t)(max_seek - read_pos) && (max_seek - read_pos) < (int64_t)sizeof(buf))
+        if (read_size > (int32_t)(max_seek - read_pos) && (max_seek - read_pos) < (int64_t)buf_size)
             read_size = (int32_t)(max_seek - read_pos);
+        /* Do not seek before the start of the stream */
+        if (read_size > start_pos - read_pos)
+            read_size = (int32_t)(start_pos - read_pos);
 
         if (mz_stream_seek(stream, start_pos - (read_pos + read_size), MZ_SEEK_SET) != MZ_OK)
             break;
         read = mz_stream_read(stream, buf, read_size);
         if ((read <= 0) || (read + buf_pos < find_size))
             break;
-        if (read + buf_pos < MZ_STREAM_FIND_SIZE)
-            memmove(buf + MZ_STREAM_FIND_SIZE - (read + buf_pos), buf, read);
+        if (read + buf_pos < buf_size)
+            memmove(buf + buf_size - (read + buf_pos), buf, read);
 
-        for (i = find_size; i <= (read + buf_pos); i += 1) {
-            if (memcmp(&buf[MZ_STREAM_FIND_SIZE - i], find, find_size) != 0)
-                continue;
+        /* Nearest match is the one furthest into the buffer */
+        i = mz_stream_find_buf_reverse(buf + buf_size - (read + buf_pos), read + buf_pos,
+            (const uint8_t *)find, find_size);
+        if (i >= 0) {
+            i = read + buf_pos - i;
 
             disk_pos = mz_stream_tell(stream);
 
             /* Seek to position on disk where the data was found */
             err = mz_stream_seek(stream, disk_pos + buf_pos - i, MZ_SEEK_SET);
-            if (err != MZ_OK)
-                return MZ_EXIST_ERROR;
+            if (err != MZ_OK) {
+                err = MZ_EXIST_ERROR;
+                break;
+            }
 
             *position = start_pos - (read_pos - buf_pos + i);
-            return MZ_OK;
+            break;
         }
 
         if (first) {
@@ -351,16 +471,28 @@ int32_t mz_stream_find_reverse(void *stream, const void *find, int32_t find_size
         read_pos += read;
     }
 
-    return MZ_EXIST_ERROR;
+    MZ_FREE(buf);
+    return err;
 }
 
 int32_t mz_stream_close(void *stream) {
     mz_stream *strm = (mz_stream *)stream;
+    uint64_t start = 0;
+    int32_t err = MZ_OK;
+
     if (strm == NULL || strm->vtbl == NULL || strm->vtbl->close == NULL)
         return MZ_PARAM_ERROR;
     if (mz_stream_is_open(stream) != MZ_OK)
         return MZ_STREAM_ERROR;
-    return strm->vtbl->close(strm);
+    if (strm->stats == NULL)
+        return strm->vtbl->close(strm);
+
+    /* Streams flush pending output when closed, so it counts as writing */
+    start = mz_os_ns_time();
+    err = strm->vtbl->close(strm);
+    if (strm->stats->write_calls > 0)
+        strm->stats->write_time += (int64_t)(mz_os_ns_time() - start);
+    return err;
 }
 
 int32_t mz_stream_error(void *stream) {
@@ -376,6 +508,36 @@ int32_t mz_stream_set_base(void *stream, void *base) {
     return MZ_OK;
 }
 
+int32_t mz_stream_set_stats(void *stream, mz_stream_stats *stats) {
+    mz_stream *strm = (mz_stream *)stream;
+    if (strm == NULL)
+        return MZ_PARAM_ERROR;
+    strm->stats = stats;
+    return MZ_OK;
+}
+
+mz_stream_stats* mz_stream_get_stats(void *stream) {
+    mz_stream *strm = (mz_stream *)stream;
+    if (strm == NULL)
+        return NULL;
+    return strm->stats;
+}
+
+int32_t mz_stream_set_alloc(void *stream, mz_alloc *alloc) {
+    mz_stream *strm = (mz_stream *)stream;
+    if (strm == NULL)
+        return MZ_PARAM_ERROR;
+    strm->alloc = alloc;
+    return MZ_OK;
+}
+
+mz_alloc* mz_stream_get_alloc(void *stream) {
+    mz_stream *strm = (mz_stream *)stream;
+    if (strm == NULL)
+        return NULL;
+    return strm->alloc;
+}
+
 void* mz_stream_get_interface(void *stream) {
     mz_stream *strm = (mz_stream *)stream;
     if (strm == NULL || strm->vtbl == NULL)
@@ -427,10 +589,13 @@ typedef struct mz_stream_raw_s {
 /***************************************************************************/
 
 int32_t mz_stream_raw_open(void *stream, const char *path, int32_t mode) {
-    MZ_UNUSED(stream);
+    mz_stream_raw *raw = (mz_stream_raw *)stream;
+
     MZ_UNUSED(path);
     MZ_UNUSED(mode);
 
+    raw->total_in = 0;
+    raw->total_out = 0;
     return MZ_OK;
 }
 
@@ -530,7 +695,8 @@ static mz_stream_vtbl mz_stream_raw_vtbl = {
     mz_stream_raw_create,
     mz_stream_raw_delete,
     mz_stream_raw_get_prop_int64,
-    mz_stream_raw_set_prop_int64
+    mz_stream_raw_set_prop_int64,
+    NULL
 };
 
 /***************************************************************************/
@@ -28,6 +28,7 @@ extern "C" {
 #define MZ_STREAM_PROP_COMPRESS_LEVEL       (9)
 #define MZ_STREAM_PROP_COMPRESS_METHOD      (10)
 #define MZ_STREAM_PROP_COMPRESS_WINDOW      (11)
+#define MZ_STREAM_PROP_COMPRESS_FRAME_SIZE  (12)
 
 /***************************************************************************/
 
@@ -45,6 +46,8 @@ typedef void    (*mz_stream_destroy_cb)        (void **stream);
 typedef int32_t (*mz_stream_get_prop_int64_cb) (void *stream, int32_t prop, int64_t *value);
 typedef int32_t (*mz_stream_set_prop_int64_cb) (void *stream, int32_t prop, int64_t value);
 
+typedef int32_t (*mz_stream_read_at_cb)        (void *stream, int64_t offset, void *buf, int32_t size);
+
 typedef int32_t (*mz_stream_find_cb)           (void *stream, const void *find, int32_t find_size,
                                                 int64_t max_seek, int64_t *position);
 
@@ -64,11 +67,28 @@ typedef struct mz_stream_vtbl_s {
 
     mz_stream_get_prop_int64_cb get_prop_int64;
     mz_stream_set_prop_int64_cb set_prop_int64;
+
+    mz_stream_read_at_cb        read_at;
 } mz_stream_vtbl;
 
+typedef struct mz_stream_stats_s {
+    int64_t                     read_calls;
+    int64_t                     write_calls;
+    int64_t                     seek_calls;
+    int64_t                     bytes_read;
+    int64_t                     bytes_written;
+    int64_t                     read_time;      /* nanoseconds, including lower layers */
+    int64_t                     write_time;     /* nanoseconds, including lower layers */
+    int64_t                     seek_time;      /* nanoseconds, including lower layers */
+    int64_t                     buffer_hits;
+    int64_t                     buffer_misses;
+} mz_stream_stats;
+
 typedef struct mz_stream_s {
     mz_stream_vtbl              *vtbl;
     struct mz_stream_s          *base;
+    mz_stream_stats             *stats;
+    mz_alloc                    *alloc;
 } mz_stream;
 
 /***************************************************************************/
@@ -81,6 +101,7 @@ int32_t mz_stream_read_uint16(void *stream, uint16_t *value);
 int32_t mz_stream_read_uint32(void *stream, uint32_t *value);
 int32_t mz_stream_read_int64(void *stream, int64_t *value);
 int32_t mz_stream_read_uint64(void *stream, uint64_t *value);
+int32_t mz_stream_read_at(void *stream, int64_t offset, void *buf, int32_t size);
 int32_t mz_stream_write(void *stream, const void *buf, int32_t size);
 int32_t mz_stream_write_uint8(void *stream, uint8_t value);
 int32_t mz_stream_write_uint16(void *stream, uint16_t value);
@@ -99,6 +120,10 @@ int32_t mz_stream_close(void *stream);
 int32_t mz_stream_error(void *stream);
 
 int32_t mz_stream_set_base(void *stream, void *base);
+int32_t mz_stream_set_stats(void *stream, mz_stream_stats *stats);
+mz_stream_stats* mz_stream_get_stats(void *stream);
+int32_t mz_stream_set_alloc(void *stream, mz_alloc *alloc);
+mz_alloc* mz_stream_get_alloc(void *stream);
 void*   mz_stream_get_interface(void *stream);
 int32_t mz_stream_get_prop_int64(void *stream, int32_t prop, int64_t *value);
 int32_t mz_stream_set_prop_int64(void *stream, int32_t prop, int64_t value);
@@ -28,20 +28,25 @@ static mz_stream_vtbl mz_stream_buffered_vtbl = {
     mz_stream_buffered_create,
     mz_stream_buffered_delete,
     NULL,
-    NULL
+    NULL,
+    mz_stream_buffered_read_at
 };
 
 /***************************************************************************/
 
+#define MZ_STREAM_BUFFERED_SIZE         (INT16_MAX)
+
+/***************************************************************************/
+
 typedef struct mz_stream_buffered_s {
     mz_stream stream;
     int32_t   error;
-    char      readbuf[INT16_MAX];
+    char      *readbuf;         /* allocated on first read */
     int32_t   readbuf_len;
     int32_t   readbuf_pos;
     int32_t   readbuf_hits;
     int32_t   readbuf_misses;
-    char      writebuf[INT16_MAX];
+    char      *writebuf;        /* allocated on first write */
     int32_t   writebuf_len;
     int32_t   writebuf_pos;
     int32_t   writebuf_hits;
@@ -71,6 +76,24 @@ static int32_t mz_stream_buffered_reset(void *stream) {
     return MZ_OK;
 }
 
+static int32_t mz_stream_buffered_alloc(char **buf) {
+    if (*buf == NULL)
+        *buf = (char *)MZ_ALLOC(MZ_STREAM_BUFFERED_SIZE);
+    if (*buf == NULL)
+        return MZ_MEM_ERROR;
+    return MZ_OK;
+}
+
+static void mz_stream_buffered_free(void *stream) {
+    mz_stream_buffered *buffered = (mz_stream_buffered *)stream;
+    if (buffered->readbuf != NULL)
+        MZ_FREE(buffered->readbuf);
+    buffered->readbuf = NULL;
+    if (buffered->writebuf != NULL)
+        MZ_FREE(buffered->writebuf);
+    buffered->writebuf = NULL;
+}
+
 int32_t mz_stream_buffered_open(void *stream, const char *path, int32_t mode) {
     mz_stream_buffered *buffered = (mz_stream_buffered *)stream;
     mz_stream_buffered_print("Buffered - Open (mode %" PRId32 ")\n", mode);
@@ -100,6 +123,8 @@ static int32_t mz_stream_buffered_flush(void *stream, int32_t *written) {
             return MZ_WRITE_ERROR;
 
         buffered->writebuf_misses += 1;
+        if (buffered->stream.stats != NULL)
+            buffered->stream.stats->buffer_misses += 1;
 
         mz_stream_buffered_print("Buffered - Write flush (%" PRId32 ":%" PRId32 " len %" PRId32 ")\n",
             bytes_to_write, bytes_left_to_write, buffered->writebuf_len);
@@ -123,27 +148,47 @@ int32_t mz_stream_buffered_read(void *stream, void *buf, int32_t size) {
     int32_t bytes_to_copy = 0;
     int32_t bytes_left_to_read = size;
     int32_t bytes_read = 0;
+    int32_t bytes_flushed = 0;
+    int64_t position = 0;
+    int32_t err = MZ_OK;
 
     mz_stream_buffered_print("Buffered - Read (size %" PRId32 " pos %" PRId64 ")\n", size, buffered->position);
 
+    err = mz_stream_buffered_alloc(&buffered->readbuf);
+    if (err != MZ_OK)
+        return err;
+
     if (buffered->writebuf_len > 0) {
-        mz_stream_buffered_print("Buffered - Switch from write to read, not yet supported (pos %" PRId64 ")\n",
-            buffered->position);
+        position = buffered->position + buffered->writebuf_pos;
+
+        mz_stream_buffered_print("Buffered - Switch from write to read (pos %" PRId64 ")\n", position);
+
+        err = mz_stream_buffered_flush(stream, &bytes_flushed);
+        if (err != MZ_OK)
+            return err;
+
+        buffered->position = position;
+
+        err = mz_stream_seek(buffered->stream.base, buffered->position, MZ_SEEK_SET);
+        if (err != MZ_OK)
+            return err;
     }
 
     while (bytes_left_to_read > 0) {
         if ((buffered->readbuf_len == 0) || (buffered->readbuf_pos == buffered->readbuf_len)) {
-            if (buffered->readbuf_len == sizeof(buffered->readbuf)) {
+            if (buffered->readbuf_len == MZ_STREAM_BUFFERED_SIZE) {
                 buffered->readbuf_pos = 0;
                 buffered->readbuf_len = 0;
             }
 
-            bytes_to_read = (int32_t)sizeof(buffered->readbuf) - (buffered->readbuf_len - buffered->readbuf_pos);
+            bytes_to_read = MZ_STREAM_BUFFERED_SIZE - (buffered->readbuf_len - buffered->readbuf_pos);
             bytes_read = mz_stream_read(buffered->stream.base, buffered->readbuf + buffered->readbuf_pos, bytes_to_read);
             if (bytes_read < 0)
                 return bytes_read;
 
             buffered->readbuf_misses += 1;
+            if (buffered->stream.stats != NULL)
+                buffered->stream.stats->buffer_misses += 1;
             buffered->readbuf_len += bytes_read;
             buffered->position += bytes_read;
 
@@ -165,6 +210,8 @@ int32_t mz_stream_buffered_read(void *stream, void *buf, int32_t size) {
             bytes_left_to_read -= bytes_to_copy;
 
             buffered->readbuf_hits += 1;
+            if (buffered->stream.stats != NULL)
+                buffered->stream.stats->buffer_hits += 1;
             buffered->readbuf_pos += bytes_to_copy;
 
             mz_stream_buffered_print("Buffered - Emptied (copied %" PRId32 " remaining %" PRId32 " buf %" PRId32 ":%" PRId32 " pos %" PRId64 ")\n",
@@ -175,6 +222,12 @@ int32_t mz_stream_buffered_read(void *stream, void *buf, int32_t size) {
     return size - bytes_left_to_read;
 }
 
+int32_t mz_stream_buffered_read_at(void *stream, int64_t offset, void *buf, int32_t size) {
+    mz_stream_buffered *buffered = (mz_stream_buffered *)stream;
+    /* Buffers belong to sequential reads, the base reads at the offset directly */
+    return mz_stream_read_at(buffered->stream.base, offset, buf, size);
+}
+
 int32_t mz_stream_buffered_write(void *stream, const void *buf, int32_t size) {
     mz_stream_buffered *buffered = (mz_stream_buffered *)stream;
     int32_t bytes_to_write = size;
@@ -188,6 +241,10 @@ int32_t mz_stream_buffered_write(void *stream, const void *buf, int32_t size) {
     mz_stream_buffered_print("Buffered - Write (size %" PRId32 " len %" PRId32 " pos %" PRId64 ")\n",
         size, buffered->writebuf_len, buffered->position);
 
+    err = mz_stream_buffered_alloc(&buffered->writebuf);
+    if (err != MZ_OK)
+        return err;
+
     if (buffered->readbuf_len > 0) {
         buffered->position -= buffered->readbuf_len;
         buffered->position += buffered->readbuf_pos;
@@ -206,7 +263,7 @@ int32_t mz_stream_buffered_write(void *stream, const void *buf, int32_t size) {
         bytes_used = buffered->writebuf_len;
         if (bytes_used > buffered->writebuf_pos)
             bytes_used = buffered->writebuf_pos;
-        bytes_to_copy = (int32_t)sizeof(buffered->writebuf) - bytes_used;
+        bytes_to_copy = MZ_STREAM_BUFFERED_SIZE - bytes_used;
         if (bytes_to_copy > bytes_left_to_write)
             bytes_to_copy = bytes_left_to_write;
 
@@ -230,6 +287,8 @@ int32_t mz_stream_buffered_write(void *stream, const void *buf, int32_t size) {
 
         buffered->writebuf_pos += bytes_to_copy;
         buffered->writebuf_hits += 1;
+        if (buffered->stream.stats != NULL)
+            buffered->stream.stats->buffer_hits += 1;
         if (buffered->writebuf_pos > buffered->writebuf_len)
             buffered->writebuf_len += buffered->writebuf_pos - buffered->writebuf_len;
     }
@@ -287,12 +346,16 @@ int32_t mz_stream_buffered_seek(void *stream, int64_t offset, int32_t origin) {
     case MZ_SEEK_CUR:
 
         if (buffered->readbuf_len > 0) {
-            if (offset <= ((int64_t)buffered->readbuf_len - buffered->readbuf_pos)) {
+            if ((offset >= -(int64_t)buffered->readbuf_pos) &&
+                (offset <= ((int64_t)buffered->readbuf_len - buffered->readbuf_pos))) {
                 buffered->readbuf_pos += (uint32_t)offset;
                 return MZ_OK;
             }
             offset -= ((int64_t)buffered->readbuf_len - buffered->readbuf_pos);
             buffered->position += offset;
+        } else if (buffered->writebuf_len == 0) {
+            /* Nothing buffered, the base stream is at the tracked position */
+            buffered->position += offset;
         }
         if (buffered->writebuf_len > 0) {
             if (offset <= ((int64_t)buffered->writebuf_len - buffered->writebuf_pos)) {
@@ -342,11 +405,48 @@ int32_t mz_stream_buffered_close(void *stream) {
             (buffered->writebuf_hits / ((float)buffered->writebuf_hits + buffered->writebuf_misses)) * 100);
     }
 
+    /* Buffers are kept for the next open, they are freed on release or delete */
     mz_stream_buffered_reset(buffered);
 
     return mz_stream_close(buffered->stream.base);
 }
 
+int32_t mz_stream_buffered_release(void *stream) {
+    mz_stream_buffered *buffered = (mz_stream_buffered *)stream;
+    int64_t position = 0;
+    int32_t bytes_flushed = 0;
+    int32_t err = MZ_OK;
+
+    if (buffered->readbuf == NULL && buffered->writebuf == NULL)
+        return MZ_OK;
+
+    /* Write out or drop what is buffered and leave the base at the logical position */
+    position = buffered->position;
+    if (buffered->readbuf_len > 0)
+        position -= ((int64_t)buffered->readbuf_len - buffered->readbuf_pos);
+    if (buffered->writebuf_len > 0)
+        position += buffered->writebuf_pos;
+
+    mz_stream_buffered_print("Buffered - Release (pos %" PRId64 ")\n", position);
+
+    err = mz_stream_buffered_flush(stream, &bytes_flushed);
+    if (err != MZ_OK)
+        return err;
+
+    if (buffered->position != position) {
+        err = mz_stream_seek(buffered->stream.base, position, MZ_SEEK_SET);
+        if (err != MZ_OK)
+            return err;
+    }
+
+    buffered->readbuf_len = 0;
+    buffered->readbuf_pos = 0;
+    buffered->position = position;
+
+    mz_stream_buffered_free(buffered);
+    return MZ_OK;
+}
+
 int32_t mz_stream_buffered_error(void *stream) {
     mz_stream_buffered *buffered = (mz_stream_buffered *)stream;
     return mz_stream_error(buffered->stream.base);
@@ -371,8 +471,10 @@ void mz_stream_buffered_delete(void **stream) {
     if (stream == NULL)
         return;
     buffered = (mz_stream_buffered *)*stream;
-    if (buffered != NULL)
+    if (buffered != NULL) {
+        mz_stream_buffered_free(buffered);
         MZ_FREE(buffered);
+    }
     *stream = NULL;
 }
 
@@ -10,6 +10,7 @@
 
 
 #include "mz.h"
+#include "mz_alloc.h"
 #include "mz_strm.h"
 #include "mz_strm_bzip.h"
 
@@ -29,7 +30,8 @@ static mz_stream_vtbl mz_stream_bzip_vtbl = {
     mz_stream_bzip_create,
     mz_stream_bzip_delete,
     mz_stream_bzip_get_prop_int64,
-    mz_stream_bzip_set_prop_int64
+    mz_stream_bzip_set_prop_int64,
+    NULL
 };
 
 /***************************************************************************/
@@ -51,6 +53,16 @@ typedef struct mz_stream_bzip_s {
 
 /***************************************************************************/
 
+static void *mz_stream_bzip_alloc(void *opaque, int items, int size) {
+    return mz_alloc_malloc((mz_alloc *)opaque, (size_t)items * (size_t)size);
+}
+
+static void mz_stream_bzip_free(void *opaque, void *address) {
+    mz_alloc_free((mz_alloc *)opaque, address);
+}
+
+/***************************************************************************/
+
 int32_t mz_stream_bzip_open(void *stream, const char *path, int32_t mode) {
     mz_stream_bzip *bzip = (mz_stream_bzip *)stream;
 
@@ -59,6 +71,11 @@ int32_t mz_stream_bzip_open(void *stream, const char *path, int32_t mode) {
     bzip->bzstream.bzalloc = 0;
     bzip->bzstream.bzfree = 0;
     bzip->bzstream.opaque = 0;
+    if (bzip->stream.alloc != NULL) {
+        bzip->bzstream.bzalloc = mz_stream_bzip_alloc;
+        bzip->bzstream.bzfree = mz_stream_bzip_free;
+        bzip->bzstream.opaque = bzip->stream.alloc;
+    }
     bzip->bzstream.total_in_lo32 = 0;
     bzip->bzstream.total_in_hi32 = 0;
     bzip->bzstream.total_out_lo32 = 0;
@@ -29,7 +29,8 @@ static mz_stream_vtbl mz_stream_libcomp_vtbl = {
     mz_stream_libcomp_create,
     mz_stream_libcomp_delete,
     mz_stream_libcomp_get_prop_int64,
-    mz_stream_libcomp_set_prop_int64
+    mz_stream_libcomp_set_prop_int64,
+    NULL
 };
 
 /***************************************************************************/
@@ -369,7 +370,8 @@ static mz_stream_vtbl mz_stream_zlib_vtbl = {
     mz_stream_zlib_create,
     mz_stream_libcomp_delete,
     mz_stream_libcomp_get_prop_int64,
-    mz_stream_libcomp_set_prop_int64
+    mz_stream_libcomp_set_prop_int64,
+    NULL
 };
 
 void *mz_stream_zlib_create(void **stream) {
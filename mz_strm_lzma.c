@@ -10,6 +10,7 @@
 
 
 #include "mz.h"
+#include "mz_alloc.h"
 #include "mz_strm.h"
 #include "mz_strm_lzma.h"
 
@@ -35,7 +36,8 @@ static mz_stream_vtbl mz_stream_lzma_vtbl = {
     mz_stream_lzma_create,
     mz_stream_lzma_delete,
     mz_stream_lzma_get_prop_int64,
-    mz_stream_lzma_set_prop_int64
+    mz_stream_lzma_set_prop_int64,
+    NULL
 };
 
 /***************************************************************************/
@@ -43,6 +45,7 @@ static mz_stream_vtbl mz_stream_lzma_vtbl = {
 typedef struct mz_stream_lzma_s {
     mz_stream   stream;
     lzma_stream lstream;
+    lzma_allocator lallocator;
     int32_t     mode;
     int32_t     error;
     uint8_t     buffer[INT16_MAX];
@@ -60,6 +63,16 @@ typedef struct mz_stream_lzma_s {
 
 /***************************************************************************/
 
+static void *mz_stream_lzma_alloc(void *opaque, size_t items, size_t size) {
+    return mz_alloc_malloc((mz_alloc *)opaque, items * size);
+}
+
+static void mz_stream_lzma_free(void *opaque, void *address) {
+    mz_alloc_free((mz_alloc *)opaque, address);
+}
+
+/***************************************************************************/
+
 int32_t mz_stream_lzma_open(void *stream, const char *path, int32_t mode) {
     mz_stream_lzma *lzma = (mz_stream_lzma *)stream;
     lzma_filter filters[LZMA_FILTERS_MAX + 1];
@@ -74,6 +87,14 @@ int32_t mz_stream_lzma_open(void *stream, const char *path, int32_t mode) {
 
     lzma->lstream.total_in = 0;
     lzma->lstream.total_out = 0;
+    lzma->lstream.allocator = NULL;
+
+    if (lzma->stream.alloc != NULL) {
+        lzma->lallocator.alloc = mz_stream_lzma_alloc;
+        lzma->lallocator.free = mz_stream_lzma_free;
+        lzma->lallocator.opaque = lzma->stream.alloc;
+        lzma->lstream.allocator = &lzma->lallocator;
+    }
 
     lzma->total_in = 0;
     lzma->total_out = 0;
@@ -35,7 +35,8 @@ static mz_stream_vtbl mz_stream_mem_vtbl = {
     mz_stream_mem_create,
     mz_stream_mem_delete,
     NULL,
-    NULL
+    NULL,
+    mz_stream_mem_read_at
 };
 
 /***************************************************************************/
@@ -78,13 +79,21 @@ int32_t mz_stream_mem_open(void *stream, const char *path, int32_t mode) {
 
     MZ_UNUSED(path);
 
+    if (mode & MZ_OPEN_MODE_CREATE) {
+        /* Keep the buffer we allocated the last time the stream was created */
+        if ((mem->mode & MZ_OPEN_MODE_CREATE) == 0) {
+            mem->buffer = NULL;
+            mem->size = 0;
+        }
+        if (mem->size < mem->grow_size)
+            err = mz_stream_mem_set_size(stream, mem->grow_size);
+    }
+
     mem->mode = mode;
     mem->limit = 0;
     mem->position = 0;
 
-    if (mem->mode & MZ_OPEN_MODE_CREATE)
-        err = mz_stream_mem_set_size(stream, mem->grow_size);
-    else
+    if ((mem->mode & MZ_OPEN_MODE_CREATE) == 0)
         mem->limit = mem->size;
 
     return err;
@@ -114,6 +123,18 @@ int32_t mz_stream_mem_read(void *stream, void *buf, int32_t size) {
     return size;
 }
 
+int32_t mz_stream_mem_read_at(void *stream, int64_t offset, void *buf, int32_t size) {
+    mz_stream_mem *mem = (mz_stream_mem *)stream;
+
+    if (offset >= mem->limit)
+        return 0;
+    if (size > mem->limit - offset)
+        size = (int32_t)(mem->limit - offset);
+
+    memcpy(buf, mem->buffer + offset, size);
+    return size;
+}
+
 int32_t mz_stream_mem_write(void *stream, const void *buf, int32_t size) {
     mz_stream_mem *mem = (mz_stream_mem *)stream;
     int32_t new_size = 0;
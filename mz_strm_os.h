@@ -17,15 +17,26 @@ extern "C" {
 
 /***************************************************************************/
 
+#define MZ_STREAM_ADVISE_SEQUENTIAL     (1)
+#define MZ_STREAM_ADVISE_WILLNEED       (2)
+#define MZ_STREAM_ADVISE_DONTNEED       (3)
+
+/***************************************************************************/
+
 int32_t mz_stream_os_open(void *stream, const char *path, int32_t mode);
 int32_t mz_stream_os_is_open(void *stream);
 int32_t mz_stream_os_read(void *stream, void *buf, int32_t size);
+int32_t mz_stream_os_read_at(void *stream, int64_t offset, void *buf, int32_t size);
 int32_t mz_stream_os_write(void *stream, const void *buf, int32_t size);
 int64_t mz_stream_os_tell(void *stream);
 int32_t mz_stream_os_seek(void *stream, int64_t offset, int32_t origin);
 int32_t mz_stream_os_close(void *stream);
 int32_t mz_stream_os_error(void *stream);
 
+int32_t mz_stream_os_advise(void *stream, int64_t offset, int64_t length, int32_t advice);
+int32_t mz_stream_os_map(void *stream, int64_t size, void **buf);
+int32_t mz_stream_os_unmap(void *stream);
+
 void*   mz_stream_os_create(void **stream);
 void    mz_stream_os_delete(void **stream);
 
@@ -20,6 +20,9 @@
 
 #include <stdio.h> /* fopen, fread.. */
 #include <errno.h>
+#include <fcntl.h> /* posix_fadvise, posix_fallocate */
+#include <sys/mman.h> /* mmap */
+#include <unistd.h> /* ftruncate */
 
 /***************************************************************************/
 
@@ -54,7 +57,8 @@ static mz_stream_vtbl mz_stream_os_vtbl = {
     mz_stream_os_create,
     mz_stream_os_delete,
     NULL,
-    NULL
+    NULL,
+    mz_stream_os_read_at
 };
 
 /***************************************************************************/
@@ -63,6 +67,8 @@ typedef struct mz_stream_posix_s {
     mz_stream   stream;
     int32_t     error;
     FILE        *handle;
+    void        *map;
+    int64_t     map_size;
 } mz_stream_posix;
 
 /***************************************************************************/
@@ -78,6 +84,8 @@ int32_t mz_stream_os_open(void *stream, const char *path, int32_t mode) {
         mode_fopen = "rb";
     else if (mode & MZ_OPEN_MODE_APPEND)
         mode_fopen = "r+b";
+    else if ((mode & MZ_OPEN_MODE_CREATE) && (mode & MZ_OPEN_MODE_READ))
+        mode_fopen = "w+b";
     else if (mode & MZ_OPEN_MODE_CREATE)
         mode_fopen = "wb";
     else
@@ -112,6 +120,27 @@ int32_t mz_stream_os_read(void *stream, void *buf, int32_t size) {
     return read;
 }
 
+int32_t mz_stream_os_read_at(void *stream, int64_t offset, void *buf, int32_t size) {
+    mz_stream_posix *posix = (mz_stream_posix*)stream;
+    ssize_t result = 0;
+    int32_t read = 0;
+    int fd = fileno(posix->handle);
+
+    /* Reads at an offset leave the file position and stdio buffer untouched */
+    while (read < size) {
+        result = pread(fd, (uint8_t *)buf + read, (size_t)(size - read), (off_t)(offset + read));
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            return MZ_READ_ERROR;
+        }
+        if (result == 0)
+            break;
+        read += (int32_t)result;
+    }
+    return read;
+}
+
 int32_t mz_stream_os_write(void *stream, const void *buf, int32_t size) {
     mz_stream_posix *posix = (mz_stream_posix*)stream;
     int32_t written = (int32_t)fwrite(buf, 1, (size_t)size, posix->handle);
@@ -161,6 +190,7 @@ int32_t mz_stream_os_seek(void *stream, int64_t offset, int32_t origin) {
 int32_t mz_stream_os_close(void *stream) {
     mz_stream_posix *posix = (mz_stream_posix*)stream;
     int32_t closed = 0;
+    mz_stream_os_unmap(stream);
     if (posix->handle != NULL) {
         closed = fclose(posix->handle);
         posix->handle = NULL;
@@ -172,6 +202,104 @@ int32_t mz_stream_os_close(void *stream) {
     return MZ_OK;
 }
 
+int32_t mz_stream_os_advise(void *stream, int64_t offset, int64_t length, int32_t advice) {
+    mz_stream_posix *posix = (mz_stream_posix *)stream;
+#ifdef POSIX_FADV_WILLNEED
+    int native_advice = 0;
+
+    if (posix->handle == NULL)
+        return MZ_OPEN_ERROR;
+
+    switch (advice) {
+    case MZ_STREAM_ADVISE_SEQUENTIAL:
+        native_advice = POSIX_FADV_SEQUENTIAL;
+        break;
+    case MZ_STREAM_ADVISE_WILLNEED:
+        native_advice = POSIX_FADV_WILLNEED;
+        break;
+    case MZ_STREAM_ADVISE_DONTNEED:
+        native_advice = POSIX_FADV_DONTNEED;
+        break;
+    default:
+        return MZ_PARAM_ERROR;
+    }
+
+    if (posix_fadvise(fileno(posix->handle), (off_t)offset, (off_t)length, native_advice) != 0)
+        return MZ_SUPPORT_ERROR;
+    return MZ_OK;
+#else
+    MZ_UNUSED(posix);
+    MZ_UNUSED(offset);
+    MZ_UNUSED(length);
+    MZ_UNUSED(advice);
+    return MZ_SUPPORT_ERROR;
+#endif
+}
+
+int32_t mz_stream_os_map(void *stream, int64_t size, void **buf) {
+    mz_stream_posix *posix = (mz_stream_posix *)stream;
+#if defined(MAP_SHARED) && defined(POSIX_FADV_WILLNEED)
+    void *map = NULL;
+    int fd = 0;
+    int result = 0;
+
+    if (posix->handle == NULL)
+        return MZ_OPEN_ERROR;
+    if (buf == NULL || size <= 0 || (int64_t)(size_t)size != size || posix->map != NULL)
+        return MZ_PARAM_ERROR;
+
+    /* File must be opened for reading and writing to be mapped for writing */
+    fd = fileno(posix->handle);
+    if (ftruncate(fd, (off_t)size) != 0) {
+        posix->error = errno;
+        return MZ_WRITE_ERROR;
+    }
+    /* Reserve the blocks up front, a full disk would otherwise raise SIGBUS on the mapped store */
+    result = posix_fallocate(fd, 0, (off_t)size);
+    if (result != 0) {
+        posix->error = result;
+        if (ftruncate(fd, 0) != 0)
+            posix->error = errno;
+        return MZ_WRITE_ERROR;
+    }
+    map = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        posix->error = errno;
+        if (ftruncate(fd, 0) != 0)
+            posix->error = errno;
+        return MZ_SUPPORT_ERROR;
+    }
+
+    posix->map = map;
+    posix->map_size = size;
+    *buf = map;
+    return MZ_OK;
+#else
+    MZ_UNUSED(posix);
+    MZ_UNUSED(size);
+    MZ_UNUSED(buf);
+    return MZ_SUPPORT_ERROR;
+#endif
+}
+
+int32_t mz_stream_os_unmap(void *stream) {
+    mz_stream_posix *posix = (mz_stream_posix *)stream;
+    int32_t err = MZ_OK;
+#ifdef MAP_SHARED
+    if (posix->map == NULL)
+        return MZ_OK;
+    if (munmap(posix->map, (size_t)posix->map_size) != 0) {
+        posix->error = errno;
+        err = MZ_CLOSE_ERROR;
+    }
+    posix->map = NULL;
+    posix->map_size = 0;
+#else
+    MZ_UNUSED(posix);
+#endif
+    return err;
+}
+
 int32_t mz_stream_os_error(void *stream) {
     mz_stream_posix *posix = (mz_stream_posix*)stream;
     return posix->error;
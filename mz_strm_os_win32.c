@@ -51,7 +51,8 @@ static mz_stream_vtbl mz_stream_os_vtbl = {
     mz_stream_os_create,
     mz_stream_os_delete,
     NULL,
-    NULL
+    NULL,
+    mz_stream_os_read_at
 };
 
 /***************************************************************************/
@@ -152,6 +153,15 @@ int32_t mz_stream_os_read(void *stream, void *buf, int32_t size) {
     return read;
 }
 
+int32_t mz_stream_os_read_at(void *stream, int64_t offset, void *buf, int32_t size) {
+    /* ReadFile at an offset moves the file pointer that the other reads depend on */
+    MZ_UNUSED(stream);
+    MZ_UNUSED(offset);
+    MZ_UNUSED(buf);
+    MZ_UNUSED(size);
+    return MZ_SUPPORT_ERROR;
+}
+
 int32_t mz_stream_os_write(void *stream, const void *buf, int32_t size) {
     mz_stream_win32 *win32 = (mz_stream_win32 *)stream;
     int32_t written = 0;
@@ -257,6 +267,27 @@ int32_t mz_stream_os_close(void *stream) {
     return MZ_OK;
 }
 
+int32_t mz_stream_os_advise(void *stream, int64_t offset, int64_t length, int32_t advice) {
+    /* Windows only takes access hints when the file is opened */
+    MZ_UNUSED(stream);
+    MZ_UNUSED(offset);
+    MZ_UNUSED(length);
+    MZ_UNUSED(advice);
+    return MZ_SUPPORT_ERROR;
+}
+
+int32_t mz_stream_os_map(void *stream, int64_t size, void **buf) {
+    MZ_UNUSED(stream);
+    MZ_UNUSED(size);
+    MZ_UNUSED(buf);
+    return MZ_SUPPORT_ERROR;
+}
+
+int32_t mz_stream_os_unmap(void *stream) {
+    MZ_UNUSED(stream);
+    return MZ_OK;
+}
+
 int32_t mz_stream_os_error(void *stream) {
     mz_stream_win32 *win32 = (mz_stream_win32 *)stream;
     return win32->error;
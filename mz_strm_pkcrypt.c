@@ -26,6 +26,7 @@
 #include "mz_crypt.h"
 #include "mz_strm.h"
 #include "mz_strm_pkcrypt.h"
+#include "mz_trace.h"
 
 /***************************************************************************/
 
@@ -41,7 +42,8 @@ static mz_stream_vtbl mz_stream_pkcrypt_vtbl = {
     mz_stream_pkcrypt_create,
     mz_stream_pkcrypt_delete,
     mz_stream_pkcrypt_get_prop_int64,
-    mz_stream_pkcrypt_set_prop_int64
+    mz_stream_pkcrypt_set_prop_int64,
+    NULL
 };
 
 /***************************************************************************/
@@ -50,7 +52,7 @@ typedef struct mz_stream_pkcrypt_s {
     mz_stream       stream;
     int32_t         error;
     int16_t         initialized;
-    uint8_t         buffer[UINT16_MAX];
+    uint8_t         *buffer;        /* allocated on first write */
     int64_t         total_in;
     int64_t         max_total_in;
     int64_t         total_out;
@@ -136,6 +138,7 @@ int32_t mz_stream_pkcrypt_open(void *stream, const char *path, int32_t mode) {
         return MZ_PARAM_ERROR;
 
     mz_stream_pkcrypt_init_keys(stream, password);
+    MZ_TRACE1(crypt__pkcrypt__init, mode);
 
     if (mode & MZ_OPEN_MODE_WRITE) {
 #ifdef MZ_ZIP_NO_COMPRESSION
@@ -222,7 +225,7 @@ int32_t mz_stream_pkcrypt_read(void *stream, void *buf, int32_t size) {
 int32_t mz_stream_pkcrypt_write(void *stream, const void *buf, int32_t size) {
     mz_stream_pkcrypt *pkcrypt = (mz_stream_pkcrypt *)stream;
     const uint8_t *buf_ptr = (const uint8_t *)buf;
-    int32_t bytes_to_write = sizeof(pkcrypt->buffer);
+    int32_t bytes_to_write = UINT16_MAX;
     int32_t total_written = 0;
     int32_t written = 0;
     int32_t i = 0;
@@ -231,6 +234,11 @@ int32_t mz_stream_pkcrypt_write(void *stream, const void *buf, int32_t size) {
     if (size < 0)
         return MZ_PARAM_ERROR;
 
+    if (pkcrypt->buffer == NULL)
+        pkcrypt->buffer = (uint8_t *)MZ_ALLOC(UINT16_MAX);
+    if (pkcrypt->buffer == NULL)
+        return MZ_MEM_ERROR;
+
     do {
         if (bytes_to_write > (size - total_written))
             bytes_to_write = (size - total_written);
@@ -344,8 +352,11 @@ void mz_stream_pkcrypt_delete(void **stream) {
     if (stream == NULL)
         return;
     pkcrypt = (mz_stream_pkcrypt *)*stream;
-    if (pkcrypt != NULL)
+    if (pkcrypt != NULL) {
+        if (pkcrypt->buffer != NULL)
+            MZ_FREE(pkcrypt->buffer);
         MZ_FREE(pkcrypt);
+    }
     *stream = NULL;
 }
 
@@ -24,6 +24,10 @@
 
 #define MZ_ZIP_MAGIC_DISKHEADER (0x08074b50)
 
+#ifndef MZ_STREAM_SPLIT_CACHE_SIZE
+#  define MZ_STREAM_SPLIT_CACHE_SIZE (8)
+#endif
+
 /***************************************************************************/
 
 static mz_stream_vtbl mz_stream_split_vtbl = {
@@ -38,11 +42,18 @@ static mz_stream_vtbl mz_stream_split_vtbl = {
     mz_stream_split_create,
     mz_stream_split_delete,
     mz_stream_split_get_prop_int64,
-    mz_stream_split_set_prop_int64
+    mz_stream_split_set_prop_int64,
+    mz_stream_split_read_at
 };
 
 /***************************************************************************/
 
+typedef struct mz_stream_split_handle_s {
+    void        *stream;
+    int32_t     number_disk;
+    uint32_t    last_used;
+} mz_stream_split_handle;
+
 typedef struct mz_stream_split_s {
     mz_stream   stream;
     int32_t     is_open;
@@ -60,6 +71,11 @@ typedef struct mz_stream_split_s {
     int32_t     current_disk;
     int64_t     current_disk_size;
     int32_t     reached_end;
+    mz_stream_split_handle
+                handles[MZ_STREAM_SPLIT_CACHE_SIZE];
+    uint32_t    handle_clock;
+    int64_t     *disk_sizes;
+    int32_t     disk_sizes_max;
 } mz_stream_split;
 
 /***************************************************************************/
@@ -72,6 +88,84 @@ typedef struct mz_stream_split_s {
 
 /***************************************************************************/
 
+static int64_t mz_stream_split_get_disk_size(void *stream, int32_t number_disk) {
+    mz_stream_split *split = (mz_stream_split *)stream;
+    /* Sizes are indexed from the disk with the central directory which is -1 */
+    if ((number_disk + 1 < 0) || (number_disk + 1 >= split->disk_sizes_max))
+        return -1;
+    return split->disk_sizes[number_disk + 1];
+}
+
+static void mz_stream_split_set_disk_size(void *stream, int32_t number_disk, int64_t disk_size) {
+    mz_stream_split *split = (mz_stream_split *)stream;
+    int64_t *new_disk_sizes = NULL;
+    int32_t new_max = 0;
+    int32_t i = 0;
+
+    if (number_disk + 1 < 0)
+        return;
+
+    if (number_disk + 1 >= split->disk_sizes_max) {
+        new_max = (split->disk_sizes_max > 0) ? split->disk_sizes_max : 16;
+        while (number_disk + 1 >= new_max)
+            new_max *= 2;
+
+        new_disk_sizes = (int64_t *)MZ_ALLOC(new_max * sizeof(int64_t));
+        if (new_disk_sizes == NULL)
+            return;
+        for (i = 0; i < new_max; i += 1)
+            new_disk_sizes[i] = -1;
+        if (split->disk_sizes != NULL) {
+            memcpy(new_disk_sizes, split->disk_sizes, split->disk_sizes_max * sizeof(int64_t));
+            MZ_FREE(split->disk_sizes);
+        }
+        split->disk_sizes = new_disk_sizes;
+        split->disk_sizes_max = new_max;
+    }
+
+    split->disk_sizes[number_disk + 1] = disk_size;
+}
+
+static void mz_stream_split_delete_base(void **stream) {
+    mz_stream *layer = (mz_stream *)*stream;
+    mz_stream *base = NULL;
+
+    /* Each layer of a cloned chain is owned by the split stream */
+    while (layer != NULL) {
+        base = layer->base;
+        mz_stream_delete((void **)&layer);
+        layer = base;
+    }
+    *stream = NULL;
+}
+
+static void *mz_stream_split_clone_base(void *stream) {
+    mz_stream_split *split = (mz_stream_split *)stream;
+    mz_stream *layer = NULL;
+    mz_stream *clone = NULL;
+    mz_stream *top = NULL;
+    mz_stream *bottom = NULL;
+
+    /* Create another chain of the same stream types as the first handle to open a disk with */
+    for (layer = (mz_stream *)split->handles[0].stream; layer != NULL; layer = layer->base) {
+        clone = NULL;
+        if (mz_stream_create((void **)&clone, layer->vtbl) == NULL)
+            break;
+        mz_stream_set_stats(clone, layer->stats);
+        if (bottom != NULL)
+            mz_stream_set_base(bottom, clone);
+        else
+            top = clone;
+        bottom = clone;
+    }
+
+    if ((layer != NULL) && (top != NULL)) {
+        mz_stream_split_delete_base((void **)&top);
+        return NULL;
+    }
+    return top;
+}
+
 static int32_t mz_stream_split_open_disk(void *stream, int32_t number_disk) {
     mz_stream_split *split = (mz_stream_split *)stream;
     uint32_t magic = 0;
@@ -106,7 +200,7 @@ static int32_t mz_stream_split_open_disk(void *stream, int32_t number_disk) {
     mz_stream_split_print("Split - Goto disk - %s (disk %" PRId32 ")\n", split->path_disk, number_disk);
 
     /* If disk part doesn't exist during reading then return MZ_EXIST_ERROR */
-    if (disk_part == MZ_OPEN_MODE_READ)
+    if ((disk_part == MZ_OPEN_MODE_READ) && (mz_stream_split_get_disk_size(stream, number_disk) < 0))
         err = mz_os_file_exists(split->path_disk);
 
     if (err == MZ_OK)
@@ -134,11 +228,19 @@ static int32_t mz_stream_split_open_disk(void *stream, int32_t number_disk) {
     }
 
     if (err == MZ_OK) {
-        /* Get the size of the current disk we are on */
-        position = mz_stream_tell(split->stream.base);
-        mz_stream_seek(split->stream.base, 0, MZ_SEEK_END);
-        split->current_disk_size = mz_stream_tell(split->stream.base);
-        mz_stream_seek(split->stream.base, position, MZ_SEEK_SET);
+        /* Get the size of the current disk we are on, disks being read do not change size */
+        split->current_disk_size = -1;
+        if ((split->mode & MZ_OPEN_MODE_WRITE) == 0)
+            split->current_disk_size = mz_stream_split_get_disk_size(stream, number_disk);
+        if (split->current_disk_size < 0) {
+            position = mz_stream_tell(split->stream.base);
+            mz_stream_seek(split->stream.base, 0, MZ_SEEK_END);
+            split->current_disk_size = mz_stream_tell(split->stream.base);
+            mz_stream_seek(split->stream.base, position, MZ_SEEK_SET);
+
+            if ((split->mode & MZ_OPEN_MODE_WRITE) == 0)
+                mz_stream_split_set_disk_size(stream, number_disk, split->current_disk_size);
+        }
 
         split->is_open = 1;
     }
@@ -156,6 +258,58 @@ static int32_t mz_stream_split_close_disk(void *stream) {
     return mz_stream_close(split->stream.base);
 }
 
+static int32_t mz_stream_split_select_disk(void *stream, int32_t number_disk) {
+    mz_stream_split *split = (mz_stream_split *)stream;
+    mz_stream_split_handle *handle = NULL;
+    mz_stream_split_handle *oldest = NULL;
+    int32_t i = 0;
+
+    for (i = 0; i < MZ_STREAM_SPLIT_CACHE_SIZE; i += 1) {
+        if (split->handles[i].stream == NULL) {
+            if ((handle == NULL) && (i > 0))
+                handle = &split->handles[i];
+            continue;
+        }
+        if (mz_stream_is_open(split->handles[i].stream) != MZ_OK) {
+            handle = &split->handles[i];
+            continue;
+        }
+        if (split->handles[i].number_disk == number_disk) {
+            /* Switch to the handle already open on the disk */
+            handle = &split->handles[i];
+            handle->last_used = ++split->handle_clock;
+
+            split->stream.base = (mz_stream *)handle->stream;
+            split->total_in_disk = 0;
+            split->current_disk = number_disk;
+            split->current_disk_size = mz_stream_split_get_disk_size(stream, number_disk);
+
+            mz_stream_split_print("Split - Cached disk - %" PRId32 "\n", number_disk);
+            return mz_stream_seek(split->stream.base, (number_disk == 0) ? 4 : 0, MZ_SEEK_SET);
+        }
+        if ((oldest == NULL) || (split->handles[i].last_used < oldest->last_used))
+            oldest = &split->handles[i];
+    }
+
+    if ((handle != NULL) && (handle->stream == NULL)) {
+        handle->stream = mz_stream_split_clone_base(stream);
+        if (handle->stream == NULL)
+            handle = NULL;
+    }
+    if (handle == NULL) {
+        /* Close the disk used least recently to open the new one */
+        handle = oldest;
+        mz_stream_split_print("Split - Close disk - %" PRId32 "\n", handle->number_disk);
+        mz_stream_close(handle->stream);
+    }
+
+    handle->number_disk = number_disk;
+    handle->last_used = ++split->handle_clock;
+
+    split->stream.base = (mz_stream *)handle->stream;
+    return mz_stream_split_open_disk(stream, number_disk);
+}
+
 static int32_t mz_stream_split_goto_disk(void *stream, int32_t number_disk) {
     mz_stream_split *split = (mz_stream_split *)stream;
     int32_t err = MZ_OK;
@@ -167,12 +321,16 @@ static int32_t mz_stream_split_goto_disk(void *stream, int32_t number_disk) {
         if (err_is_open != MZ_OK)
             err = mz_stream_split_open_disk(stream, number_disk);
     } else if ((number_disk != split->current_disk) || (err_is_open != MZ_OK)) {
-        err = mz_stream_split_close_disk(stream);
-        if (err == MZ_OK) {
-            err = mz_stream_split_open_disk(stream, number_disk);
+        if ((split->mode & MZ_OPEN_MODE_WRITE) == 0) {
+            /* Disks being read are kept open so switching back to them is cheap */
+            err = mz_stream_split_select_disk(stream, number_disk);
+        } else {
+            err = mz_stream_split_close_disk(stream);
             if (err == MZ_OK)
-                split->number_disk = number_disk;
+                err = mz_stream_split_open_disk(stream, number_disk);
         }
+        if (err == MZ_OK)
+            split->number_disk = number_disk;
     }
 
     return err;
@@ -180,26 +338,52 @@ static int32_t mz_stream_split_goto_disk(void *stream, int32_t number_disk) {
 
 int32_t mz_stream_split_open(void *stream, const char *path, int32_t mode) {
     mz_stream_split *split = (mz_stream_split *)stream;
+    uint32_t path_size = 0;
     int32_t number_disk = 0;
+    int32_t i = 0;
 
     split->mode = mode;
+    split->total_in = 0;
+    split->total_out = 0;
+
+    /* The stream set as base is the first handle, others are created like it when needed */
+    split->handles[0].stream = split->stream.base;
+    split->handles[0].number_disk = -1;
+    split->handles[0].last_used = 0;
+    split->handle_clock = 0;
+
+    /* Disks may have changed since the last open */
+    for (i = 0; i < split->disk_sizes_max; i += 1)
+        split->disk_sizes[i] = -1;
+
+    /* Path buffers from the last open are reused when they are large enough */
+    path_size = (uint32_t)strlen(path) + 1;
+    if (split->path_cd_size < path_size) {
+        if (split->path_cd != NULL)
+            MZ_FREE(split->path_cd);
+        split->path_cd_size = path_size;
+        split->path_cd = (char *)MZ_ALLOC(split->path_cd_size);
+    }
 
-    split->path_cd_size = (uint32_t)strlen(path) + 1;
-    split->path_cd = (char *)MZ_ALLOC(split->path_cd_size);
-
-    if (split->path_cd == NULL)
+    if (split->path_cd == NULL) {
+        split->path_cd_size = 0;
         return MZ_MEM_ERROR;
+    }
 
     strncpy(split->path_cd, path, split->path_cd_size - 1);
     split->path_cd[split->path_cd_size - 1] = 0;
 
     mz_stream_split_print("Split - Open - %s (disk %" PRId32 ")\n", split->path_cd, number_disk);
 
-    split->path_disk_size = (uint32_t)strlen(path) + 10;
-    split->path_disk = (char *)MZ_ALLOC(split->path_disk_size);
+    if (split->path_disk_size < path_size + 9) {
+        if (split->path_disk != NULL)
+            MZ_FREE(split->path_disk);
+        split->path_disk_size = path_size + 9;
+        split->path_disk = (char *)MZ_ALLOC(split->path_disk_size);
+    }
 
     if (split->path_disk == NULL) {
-        MZ_FREE(split->path_cd);
+        split->path_disk_size = 0;
         return MZ_MEM_ERROR;
     }
 
@@ -245,6 +429,8 @@ int32_t mz_stream_split_read(void *stream, void *buf, int32_t size) {
         if (read == 0) {
             if (split->current_disk < 0) /* No more disks to goto */
                 break;
+            if (split->mode & MZ_OPEN_MODE_WRITE) /* Only read back from the disk being written */
+                break;
             err = mz_stream_split_goto_disk(stream, split->current_disk + 1);
             if (err == MZ_EXIST_ERROR) {
                 split->current_disk = -1;
@@ -262,6 +448,12 @@ int32_t mz_stream_split_read(void *stream, void *buf, int32_t size) {
     return size - bytes_left;
 }
 
+int32_t mz_stream_split_read_at(void *stream, int64_t offset, void *buf, int32_t size) {
+    mz_stream_split *split = (mz_stream_split *)stream;
+    /* Offsets are relative to the disk currently open */
+    return mz_stream_read_at(split->stream.base, offset, buf, size);
+}
+
 int32_t mz_stream_split_write(void *stream, const void *buf, int32_t size) {
     mz_stream_split *split = (mz_stream_split *)stream;
     int64_t position = 0;
@@ -359,8 +551,28 @@ int32_t mz_stream_split_seek(void *stream, int64_t offset, int32_t origin) {
 int32_t mz_stream_split_close(void *stream) {
     mz_stream_split *split = (mz_stream_split *)stream;
     int32_t err = MZ_OK;
+    int32_t i = 0;
 
-    err = mz_stream_split_close_disk(stream);
+    if (split->handles[0].stream == NULL) {
+        err = mz_stream_split_close_disk(stream);
+        split->is_open = 0;
+        return err;
+    }
+
+    for (i = 0; i < MZ_STREAM_SPLIT_CACHE_SIZE; i += 1) {
+        if (split->handles[i].stream == NULL)
+            continue;
+        if (mz_stream_is_open(split->handles[i].stream) == MZ_OK) {
+            if (mz_stream_close(split->handles[i].stream) != MZ_OK)
+                err = MZ_CLOSE_ERROR;
+        }
+        if (i > 0)
+            mz_stream_split_delete_base(&split->handles[i].stream);
+    }
+
+    /* Leave the stream set as base in place for the next open */
+    split->stream.base = (mz_stream *)split->handles[0].stream;
+    split->handles[0].stream = NULL;
     split->is_open = 0;
     return err;
 }
@@ -419,6 +631,7 @@ void *mz_stream_split_create(void **stream) {
 
 void mz_stream_split_delete(void **stream) {
     mz_stream_split *split = NULL;
+    int32_t i = 0;
     if (stream == NULL)
         return;
     split = (mz_stream_split *)*stream;
@@ -427,6 +640,12 @@ void mz_stream_split_delete(void **stream) {
             MZ_FREE(split->path_cd);
         if (split->path_disk)
             MZ_FREE(split->path_disk);
+        if (split->disk_sizes)
+            MZ_FREE(split->disk_sizes);
+        for (i = 1; i < MZ_STREAM_SPLIT_CACHE_SIZE; i += 1) {
+            if (split->handles[i].stream != NULL)
+                mz_stream_split_delete_base(&split->handles[i].stream);
+        }
 
         MZ_FREE(split);
     }
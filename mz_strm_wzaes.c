@@ -14,6 +14,7 @@
 #include "mz_crypt.h"
 #include "mz_strm.h"
 #include "mz_strm_wzaes.h"
+#include "mz_trace.h"
 
 /***************************************************************************/
 
@@ -38,7 +39,8 @@ static mz_stream_vtbl mz_stream_wzaes_vtbl = {
     mz_stream_wzaes_create,
     mz_stream_wzaes_delete,
     mz_stream_wzaes_get_prop_int64,
-    mz_stream_wzaes_set_prop_int64
+    mz_stream_wzaes_set_prop_int64,
+    NULL
 };
 
 /***************************************************************************/
@@ -48,7 +50,7 @@ typedef struct mz_stream_wzaes_s {
     int32_t         mode;
     int32_t         error;
     int16_t         initialized;
-    uint8_t         buffer[UINT16_MAX];
+    uint8_t         *buffer;        /* allocated on first write */
     int64_t         total_in;
     int64_t         max_total_in;
     int64_t         total_out;
@@ -112,8 +114,10 @@ int32_t mz_stream_wzaes_open(void *stream, const char *path, int32_t mode) {
     key_length = MZ_AES_KEY_LENGTH(wzaes->encryption_mode);
 
     /* Derive the encryption and authentication keys and the password verifier */
+    MZ_TRACE2(crypt__pbkdf2__start, wzaes->encryption_mode, MZ_AES_KEYING_ITERATIONS);
     mz_crypt_pbkdf2((uint8_t *)password, password_length, salt_value, salt_length,
         MZ_AES_KEYING_ITERATIONS, kbuf, 2 * key_length + MZ_AES_PW_VERIFY_SIZE);
+    MZ_TRACE1(crypt__pbkdf2__done, wzaes->encryption_mode);
 
     /* Initialize the encryption nonce and buffer pos */
     wzaes->crypt_pos = MZ_AES_BLOCK_SIZE;
@@ -218,13 +222,18 @@ int32_t mz_stream_wzaes_read(void *stream, void *buf, int32_t size) {
 int32_t mz_stream_wzaes_write(void *stream, const void *buf, int32_t size) {
     mz_stream_wzaes *wzaes = (mz_stream_wzaes *)stream;
     const uint8_t *buf_ptr = (const uint8_t *)buf;
-    int32_t bytes_to_write = sizeof(wzaes->buffer);
+    int32_t bytes_to_write = UINT16_MAX;
     int32_t total_written = 0;
     int32_t written = 0;
 
     if (size < 0)
         return MZ_PARAM_ERROR;
 
+    if (wzaes->buffer == NULL)
+        wzaes->buffer = (uint8_t *)MZ_ALLOC(UINT16_MAX);
+    if (wzaes->buffer == NULL)
+        return MZ_MEM_ERROR;
+
     do {
         if (bytes_to_write > (size - total_written))
             bytes_to_write = (size - total_written);
@@ -360,6 +369,8 @@ void mz_stream_wzaes_delete(void **stream) {
     if (wzaes != NULL) {
         mz_crypt_aes_delete(&wzaes->aes);
         mz_crypt_hmac_delete(&wzaes->hmac);
+        if (wzaes->buffer != NULL)
+            MZ_FREE(wzaes->buffer);
         MZ_FREE(wzaes);
     }
     *stream = NULL;
@@ -10,6 +10,7 @@
 
 
 #include "mz.h"
+#include "mz_alloc.h"
 #include "mz_strm.h"
 #include "mz_strm_zlib.h"
 
@@ -17,6 +18,9 @@
 #if defined(ZLIBNG_VERNUM) && !defined(ZLIB_COMPAT)
 #  include "zlib-ng.h"
 #endif
+#ifdef HAVE_LIBDEFLATE
+#  include "libdeflate.h"
+#endif
 
 /***************************************************************************/
 
@@ -36,6 +40,13 @@
 #  endif
 #endif
 
+/* Largest entry inflated or deflated in one libdeflate call instead of streamed */
+#define MZ_STREAM_ZLIB_WHOLE_MAX (1024 * 1024)
+
+/* Access points keep the window inflate needs to resume mid stream */
+#define MZ_STREAM_ZLIB_WINDOW_SIZE  (32768)
+#define MZ_STREAM_ZLIB_INDEX_MAGIC  (0x5844495a)
+
 /***************************************************************************/
 
 static mz_stream_vtbl mz_stream_zlib_vtbl = {
@@ -50,11 +61,29 @@ static mz_stream_vtbl mz_stream_zlib_vtbl = {
     mz_stream_zlib_create,
     mz_stream_zlib_delete,
     mz_stream_zlib_get_prop_int64,
-    mz_stream_zlib_set_prop_int64
+    mz_stream_zlib_set_prop_int64,
+    NULL
 };
 
 /***************************************************************************/
 
+typedef struct mz_stream_zlib_point_s {
+    int64_t     total_in;           /* compressed offset of the first byte after the point */
+    int64_t     total_out;          /* uncompressed offset of the point */
+    int32_t     bits;               /* bits of the byte before total_in not yet inflated */
+    int32_t     window_size;
+    uint8_t     *window;            /* uncompressed data preceding the point */
+} mz_stream_zlib_point;
+
+typedef struct mz_stream_zlib_index_s {
+    mz_stream_zlib_point
+                *points;
+    int32_t     count;
+    int32_t     capacity;
+    int64_t     total_in;           /* size of the indexed deflate data */
+    int64_t     total_out;
+} mz_stream_zlib_index;
+
 typedef struct mz_stream_zlib_s {
     mz_stream   stream;
     zlib_stream zstream;
@@ -63,30 +92,102 @@ typedef struct mz_stream_zlib_s {
     int64_t     total_in;
     int64_t     total_out;
     int64_t     max_total_in;
+    int64_t     max_total_out;
     int8_t      initialized;
     int16_t     level;
     int32_t     window_bits;
     int32_t     mode;
     int32_t     error;
+    int32_t     zstream_mode;       /* mode zstream was initialized with, kept across opens */
+    int16_t     zstream_level;
+    int32_t     zstream_window_bits;
+    mz_alloc    *zstream_alloc;
+    const uint8_t
+                *dictionary;
+    int32_t     dictionary_size;
+    mz_stream_zlib_index
+                *index;             /* index access points are recorded into while inflating */
+    int64_t     index_span;
+#ifdef HAVE_LIBDEFLATE
+    int8_t      whole;              /* entry passed to libdeflate in one call */
+    uint8_t     *whole_in;
+    int32_t     whole_in_size;
+    int32_t     whole_in_len;
+    uint8_t     *whole_out;
+    int32_t     whole_out_size;
+    int32_t     whole_out_len;
+    int32_t     whole_out_pos;
+    mz_alloc    *whole_alloc;
+    struct libdeflate_compressor
+                *compressor;
+    int16_t     compressor_level;
+    struct libdeflate_decompressor
+                *decompressor;
+#endif
 } mz_stream_zlib;
 
 /***************************************************************************/
 
-int32_t mz_stream_zlib_open(void *stream, const char *path, int32_t mode) {
+static void *mz_stream_zlib_zalloc(void *opaque, unsigned int items, unsigned int size) {
+    return mz_alloc_malloc((mz_alloc *)opaque, (size_t)items * size);
+}
+
+static void mz_stream_zlib_zfree(void *opaque, void *address) {
+    mz_alloc_free((mz_alloc *)opaque, address);
+}
+
+static void mz_stream_zlib_end(void *stream) {
     mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
 
-    MZ_UNUSED(path);
+#ifndef MZ_ZIP_NO_COMPRESSION
+    if (zlib->zstream_mode & MZ_OPEN_MODE_WRITE)
+        ZLIB_PREFIX(deflateEnd)(&zlib->zstream);
+#endif
+#ifndef MZ_ZIP_NO_DECOMPRESSION
+    if (zlib->zstream_mode & MZ_OPEN_MODE_READ)
+        ZLIB_PREFIX(inflateEnd)(&zlib->zstream);
+#endif
+    zlib->zstream_mode = 0;
+}
+
+static int32_t mz_stream_zlib_reusable(void *stream, int32_t mode) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+
+    /* Resetting is much cheaper than init, but only valid for a healthy stream with the same settings */
+    if ((zlib->zstream_mode != mode) || (zlib->error != Z_OK))
+        return 0;
+    if (zlib->zstream_alloc != zlib->stream.alloc)
+        return 0;
+    if (zlib->zstream_window_bits != zlib->window_bits)
+        return 0;
+    if ((mode & MZ_OPEN_MODE_WRITE) && (zlib->zstream_level != zlib->level))
+        return 0;
+    return 1;
+}
+
+static int32_t mz_stream_zlib_init(void *stream, int32_t mode) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+    uint8_t reuse = 0;
+
+    reuse = (uint8_t)mz_stream_zlib_reusable(stream, mode);
+    if (!reuse) {
+        mz_stream_zlib_end(stream);
+
+        zlib->zstream.zalloc = Z_NULL;
+        zlib->zstream.zfree = Z_NULL;
+        zlib->zstream.opaque = Z_NULL;
+
+        if (zlib->stream.alloc != NULL) {
+            zlib->zstream.zalloc = mz_stream_zlib_zalloc;
+            zlib->zstream.zfree = mz_stream_zlib_zfree;
+            zlib->zstream.opaque = zlib->stream.alloc;
+        }
+    }
 
     zlib->zstream.data_type = Z_BINARY;
-    zlib->zstream.zalloc = Z_NULL;
-    zlib->zstream.zfree = Z_NULL;
-    zlib->zstream.opaque = Z_NULL;
     zlib->zstream.total_in = 0;
     zlib->zstream.total_out = 0;
 
-    zlib->total_in = 0;
-    zlib->total_out = 0;
-
     if (mode & MZ_OPEN_MODE_WRITE) {
 #ifdef MZ_ZIP_NO_COMPRESSION
         return MZ_SUPPORT_ERROR;
@@ -94,8 +195,15 @@ int32_t mz_stream_zlib_open(void *stream, const char *path, int32_t mode) {
         zlib->zstream.next_out = zlib->buffer;
         zlib->zstream.avail_out = sizeof(zlib->buffer);
 
-        zlib->error = ZLIB_PREFIX(deflateInit2)(&zlib->zstream, (int8_t)zlib->level, Z_DEFLATED,
-            zlib->window_bits, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+        if (reuse)
+            zlib->error = ZLIB_PREFIX(deflateReset)(&zlib->zstream);
+        else
+            zlib->error = ZLIB_PREFIX(deflateInit2)(&zlib->zstream, (int8_t)zlib->level, Z_DEFLATED,
+                zlib->window_bits, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+
+        if ((zlib->error == Z_OK) && (zlib->dictionary != NULL))
+            zlib->error = ZLIB_PREFIX(deflateSetDictionary)(&zlib->zstream, zlib->dictionary,
+                (uint32_t)zlib->dictionary_size);
 #endif
     } else if (mode & MZ_OPEN_MODE_READ) {
 #ifdef MZ_ZIP_NO_DECOMPRESSION
@@ -104,13 +212,133 @@ int32_t mz_stream_zlib_open(void *stream, const char *path, int32_t mode) {
         zlib->zstream.next_in = zlib->buffer;
         zlib->zstream.avail_in = 0;
 
-        zlib->error = ZLIB_PREFIX(inflateInit2)(&zlib->zstream, zlib->window_bits);
+        if (reuse)
+            zlib->error = ZLIB_PREFIX(inflateReset)(&zlib->zstream);
+        else
+            zlib->error = ZLIB_PREFIX(inflateInit2)(&zlib->zstream, zlib->window_bits);
+
+        /* Raw inflate accepts the dictionary before any data is read */
+        if ((zlib->error == Z_OK) && (zlib->dictionary != NULL))
+            zlib->error = ZLIB_PREFIX(inflateSetDictionary)(&zlib->zstream, zlib->dictionary,
+                (uint32_t)zlib->dictionary_size);
 #endif
     }
 
     if (zlib->error != Z_OK)
         return MZ_OPEN_ERROR;
 
+    zlib->zstream_mode = mode;
+    zlib->zstream_level = zlib->level;
+    zlib->zstream_window_bits = zlib->window_bits;
+    zlib->zstream_alloc = zlib->stream.alloc;
+    return MZ_OK;
+}
+
+#ifdef HAVE_LIBDEFLATE
+static void mz_stream_zlib_whole_free(void *stream) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+
+    mz_alloc_free(zlib->whole_alloc, zlib->whole_in);
+    mz_alloc_free(zlib->whole_alloc, zlib->whole_out);
+    zlib->whole_in = NULL;
+    zlib->whole_in_size = 0;
+    zlib->whole_out = NULL;
+    zlib->whole_out_size = 0;
+    zlib->whole_alloc = zlib->stream.alloc;
+}
+
+static int32_t mz_stream_zlib_whole_reserve(void *stream, uint8_t **buf, int32_t *buf_size,
+    int32_t keep, int32_t size) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+    uint8_t *new_buf = NULL;
+
+    if (*buf_size >= size)
+        return MZ_OK;
+
+    new_buf = (uint8_t *)mz_alloc_malloc(zlib->whole_alloc, (size_t)size);
+    if (new_buf == NULL)
+        return MZ_MEM_ERROR;
+    if (keep > 0)
+        memcpy(new_buf, *buf, keep);
+    mz_alloc_free(zlib->whole_alloc, *buf);
+
+    *buf = new_buf;
+    *buf_size = size;
+    return MZ_OK;
+}
+
+static int8_t mz_stream_zlib_whole_start(void *stream, int32_t mode) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+
+    /* libdeflate has no preset dictionaries and only handles raw deflate */
+    if ((zlib->dictionary != NULL) || (zlib->window_bits != -MAX_WBITS))
+        return 0;
+
+    if (mode & MZ_OPEN_MODE_WRITE) {
+#ifdef MZ_ZIP_NO_COMPRESSION
+        return 0;
+#endif
+    } else if (mode & MZ_OPEN_MODE_READ) {
+#ifdef MZ_ZIP_NO_DECOMPRESSION
+        return 0;
+#endif
+        /* Both sizes have to be known up front to inflate in one call */
+        if ((zlib->max_total_in <= 0) || (zlib->max_total_in > MZ_STREAM_ZLIB_WHOLE_MAX))
+            return 0;
+        if ((zlib->max_total_out <= 0) || (zlib->max_total_out > MZ_STREAM_ZLIB_WHOLE_MAX))
+            return 0;
+    } else {
+        return 0;
+    }
+
+    if (zlib->whole_alloc != zlib->stream.alloc)
+        mz_stream_zlib_whole_free(stream);
+    /* Entries that fall back to zlib must not reset a zstream left in error */
+    if (zlib->error != Z_OK)
+        mz_stream_zlib_end(stream);
+
+    zlib->error = Z_OK;
+    zlib->whole_in_len = 0;
+    zlib->whole_out_len = 0;
+    zlib->whole_out_pos = 0;
+    return 1;
+}
+
+static int32_t mz_stream_zlib_whole_fallback(void *stream) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+    int32_t err = MZ_OK;
+
+    err = mz_stream_zlib_init(stream, zlib->mode);
+    if (err != MZ_OK)
+        return err;
+
+    /* Input already gathered for libdeflate is consumed by zlib first */
+    zlib->whole = 0;
+    zlib->zstream.next_in = zlib->whole_in;
+    zlib->zstream.avail_in = (uInt)zlib->whole_in_len;
+    zlib->whole_in_len = 0;
+    return MZ_OK;
+}
+#endif
+
+int32_t mz_stream_zlib_open(void *stream, const char *path, int32_t mode) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+    int32_t err = MZ_OK;
+
+    MZ_UNUSED(path);
+
+    zlib->total_in = 0;
+    zlib->total_out = 0;
+    zlib->buffer_len = 0;
+
+#ifdef HAVE_LIBDEFLATE
+    zlib->whole = mz_stream_zlib_whole_start(stream, mode);
+    if (!zlib->whole)
+#endif
+        err = mz_stream_zlib_init(stream, mode);
+    if (err != MZ_OK)
+        return err;
+
     zlib->initialized = 1;
     zlib->mode = mode;
     return MZ_OK;
@@ -123,6 +351,168 @@ int32_t mz_stream_zlib_is_open(void *stream) {
     return MZ_OK;
 }
 
+#if defined(HAVE_LIBDEFLATE) && !defined(MZ_ZIP_NO_DECOMPRESSION)
+static int32_t mz_stream_zlib_whole_read(void *stream, void *buf, int32_t size) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+    enum libdeflate_result result = LIBDEFLATE_SUCCESS;
+    uint8_t *out = NULL;
+    size_t actual_in = 0;
+    size_t actual_out = 0;
+    int32_t in_len = (int32_t)zlib->max_total_in;
+    int32_t out_len = (int32_t)zlib->max_total_out;
+    int32_t read = 0;
+    int32_t err = MZ_OK;
+
+    if (zlib->whole == 1) {
+        err = mz_stream_zlib_whole_reserve(stream, &zlib->whole_in, &zlib->whole_in_size, 0, in_len);
+        if (err != MZ_OK)
+            return err;
+
+        while (zlib->whole_in_len < in_len) {
+            read = mz_stream_read(zlib->stream.base, zlib->whole_in + zlib->whole_in_len,
+                in_len - zlib->whole_in_len);
+            if (read < 0)
+                return read;
+            if (read == 0)
+                break;
+            zlib->whole_in_len += read;
+        }
+
+        if (zlib->decompressor == NULL)
+            zlib->decompressor = libdeflate_alloc_decompressor();
+        if (zlib->decompressor == NULL)
+            return MZ_MEM_ERROR;
+
+        /* Inflate straight into the caller's buffer when the whole entry fits */
+        if (size >= out_len) {
+            out = (uint8_t *)buf;
+        } else {
+            err = mz_stream_zlib_whole_reserve(stream, &zlib->whole_out, &zlib->whole_out_size, 0, out_len);
+            if (err != MZ_OK)
+                return err;
+            out = zlib->whole_out;
+        }
+
+        result = libdeflate_deflate_decompress_ex(zlib->decompressor, zlib->whole_in,
+            (size_t)zlib->whole_in_len, out, (size_t)out_len, &actual_in, &actual_out);
+        if (result != LIBDEFLATE_SUCCESS) {
+            /* Sizes that do not match the data are left to zlib to report or cope with */
+            err = mz_stream_zlib_whole_fallback(stream);
+            if (err != MZ_OK)
+                return err;
+            return mz_stream_zlib_read(stream, buf, size);
+        }
+
+        zlib->whole = 2;
+        zlib->total_in = (int64_t)actual_in;
+
+        if (out == buf) {
+            zlib->total_out = (int64_t)actual_out;
+            return (int32_t)actual_out;
+        }
+
+        zlib->whole_out_len = (int32_t)actual_out;
+        zlib->whole_out_pos = 0;
+    }
+
+    if (size > zlib->whole_out_len - zlib->whole_out_pos)
+        size = zlib->whole_out_len - zlib->whole_out_pos;
+    if (size > 0)
+        memcpy(buf, zlib->whole_out + zlib->whole_out_pos, size);
+    zlib->whole_out_pos += size;
+    zlib->total_out += size;
+    return size;
+}
+#endif
+
+static void mz_stream_zlib_index_clear(mz_stream_zlib_index *index) {
+    int32_t i = 0;
+
+    for (i = 0; i < index->count; i += 1)
+        MZ_FREE(index->points[i].window);
+    index->count = 0;
+    index->total_in = 0;
+    index->total_out = 0;
+}
+
+static mz_stream_zlib_point *mz_stream_zlib_index_push(mz_stream_zlib_index *index) {
+    mz_stream_zlib_point *points = NULL;
+    mz_stream_zlib_point *point = NULL;
+    int32_t capacity = 0;
+
+    if (index->count == index->capacity) {
+        capacity = (index->capacity == 0) ? 16 : index->capacity * 2;
+        points = (mz_stream_zlib_point *)MZ_ALLOC(capacity * sizeof(mz_stream_zlib_point));
+        if (points == NULL)
+            return NULL;
+        if (index->count > 0)
+            memcpy(points, index->points, index->count * sizeof(mz_stream_zlib_point));
+        MZ_FREE(index->points);
+        index->points = points;
+        index->capacity = capacity;
+    }
+
+    point = &index->points[index->count];
+    memset(point, 0, sizeof(mz_stream_zlib_point));
+    index->count += 1;
+    return point;
+}
+
+static int32_t mz_stream_zlib_index_locate(void *handle, int64_t offset, mz_stream_zlib_point **point) {
+    mz_stream_zlib_index *index = (mz_stream_zlib_index *)handle;
+    int32_t left = 0;
+    int32_t right = 0;
+    int32_t middle = 0;
+
+    if (index == NULL || point == NULL || offset < 0)
+        return MZ_PARAM_ERROR;
+    if ((index->count == 0) || (offset > index->total_out))
+        return MZ_PARAM_ERROR;
+
+    /* Last point at or before the offset */
+    right = index->count - 1;
+    while (left < right) {
+        middle = left + (right - left + 1) / 2;
+        if (index->points[middle].total_out <= offset)
+            left = middle;
+        else
+            right = middle - 1;
+    }
+
+    *point = &index->points[left];
+    return MZ_OK;
+}
+
+#ifndef MZ_ZIP_NO_DECOMPRESSION
+static int32_t mz_stream_zlib_index_add(void *stream) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+    mz_stream_zlib_index *index = zlib->index;
+    mz_stream_zlib_point *point = NULL;
+    uInt window_size = 0;
+
+    /* Only block boundaries other than the end of the last block can be resumed from */
+    if (((zlib->zstream.data_type & 128) == 0) || (zlib->zstream.data_type & 64))
+        return Z_OK;
+    if (zlib->total_out - index->points[index->count - 1].total_out < zlib->index_span)
+        return Z_OK;
+
+    point = mz_stream_zlib_index_push(index);
+    if (point == NULL)
+        return Z_MEM_ERROR;
+    point->total_in = zlib->total_in;
+    point->total_out = zlib->total_out;
+    point->bits = zlib->zstream.data_type & 7;
+
+    point->window = (uint8_t *)MZ_ALLOC(MZ_STREAM_ZLIB_WINDOW_SIZE);
+    if (point->window == NULL)
+        return Z_MEM_ERROR;
+    if (ZLIB_PREFIX(inflateGetDictionary)(&zlib->zstream, point->window, &window_size) != Z_OK)
+        return Z_STREAM_ERROR;
+    point->window_size = (int32_t)window_size;
+    return Z_OK;
+}
+#endif
+
 int32_t mz_stream_zlib_read(void *stream, void *buf, int32_t size) {
 #ifdef MZ_ZIP_NO_DECOMPRESSION
     MZ_UNUSED(stream);
@@ -142,7 +532,16 @@ int32_t mz_stream_zlib_read(void *stream, void *buf, int32_t size) {
     int32_t bytes_to_read = sizeof(zlib->buffer);
     int32_t read = 0;
     int32_t err = Z_OK;
+    int flush = Z_SYNC_FLUSH;
 
+#ifdef HAVE_LIBDEFLATE
+    if (zlib->whole)
+        return mz_stream_zlib_whole_read(stream, buf, size);
+#endif
+
+    /* Stop at every block boundary so access points can be taken there */
+    if (zlib->index != NULL)
+        flush = Z_BLOCK;
 
     zlib->zstream.next_out = (Bytef*)buf;
     zlib->zstream.avail_out = (uInt)size;
@@ -166,7 +565,7 @@ int32_t mz_stream_zlib_read(void *stream, void *buf, int32_t size) {
         total_in_before = zlib->zstream.avail_in;
         total_out_before = zlib->zstream.total_out;
 
-        err = ZLIB_PREFIX(inflate)(&zlib->zstream, Z_SYNC_FLUSH);
+        err = ZLIB_PREFIX(inflate)(&zlib->zstream, flush);
         if ((err >= Z_OK) && (zlib->zstream.msg != NULL)) {
             zlib->error = Z_DATA_ERROR;
             break;
@@ -184,6 +583,14 @@ int32_t mz_stream_zlib_read(void *stream, void *buf, int32_t size) {
         zlib->total_in += in_bytes;
         zlib->total_out += out_bytes;
 
+        if ((err == Z_OK) && (zlib->index != NULL)) {
+            err = mz_stream_zlib_index_add(stream);
+            if (err != Z_OK) {
+                zlib->error = err;
+                break;
+            }
+        }
+
         if (err == Z_STREAM_END)
             break;
         if (err != Z_OK) {
@@ -192,6 +599,11 @@ int32_t mz_stream_zlib_read(void *stream, void *buf, int32_t size) {
         }
     } while (zlib->zstream.avail_out > 0);
 
+    if (zlib->index != NULL) {
+        zlib->index->total_in = zlib->total_in;
+        zlib->index->total_out = zlib->total_out;
+    }
+
     if (zlib->error != 0) {
         /* Zlib errors are compatible with MZ */
         return zlib->error;
@@ -248,6 +660,77 @@ static int32_t mz_stream_zlib_deflate(void *stream, int flush) {
 
     return MZ_OK;
 }
+
+#ifdef HAVE_LIBDEFLATE
+static int32_t mz_stream_zlib_whole_write(void *stream, const void *buf, int32_t size) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+    int32_t buf_size = zlib->whole_in_len + size;
+    int32_t err = MZ_OK;
+
+    /* Grow geometrically so entries written in small chunks are not copied over and over */
+    if ((buf_size > zlib->whole_in_size) && (buf_size < zlib->whole_in_size * 2))
+        buf_size = zlib->whole_in_size * 2;
+    if (buf_size > MZ_STREAM_ZLIB_WHOLE_MAX)
+        buf_size = MZ_STREAM_ZLIB_WHOLE_MAX;
+
+    err = mz_stream_zlib_whole_reserve(stream, &zlib->whole_in, &zlib->whole_in_size,
+        zlib->whole_in_len, buf_size);
+    if (err != MZ_OK)
+        return err;
+
+    memcpy(zlib->whole_in + zlib->whole_in_len, buf, size);
+    zlib->whole_in_len += size;
+    return MZ_OK;
+}
+
+static int32_t mz_stream_zlib_whole_deflate(void *stream) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+    size_t out_bound = 0;
+    size_t out_len = 0;
+    int16_t level = zlib->level;
+    int32_t err = MZ_OK;
+
+    /* libdeflate levels match zlib levels, with more above 9 */
+    if (level < 0)
+        level = MZ_COMPRESS_LEVEL_NORMAL;
+
+    if ((zlib->compressor != NULL) && (zlib->compressor_level != level)) {
+        libdeflate_free_compressor(zlib->compressor);
+        zlib->compressor = NULL;
+    }
+    if (zlib->compressor == NULL) {
+        zlib->compressor = libdeflate_alloc_compressor(level);
+        zlib->compressor_level = level;
+    }
+    if (zlib->compressor == NULL)
+        err = MZ_MEM_ERROR;
+
+    if (err == MZ_OK) {
+        out_bound = libdeflate_deflate_compress_bound(zlib->compressor, (size_t)zlib->whole_in_len);
+        err = mz_stream_zlib_whole_reserve(stream, &zlib->whole_out, &zlib->whole_out_size, 0,
+            (int32_t)out_bound);
+    }
+    if (err == MZ_OK) {
+        out_len = libdeflate_deflate_compress(zlib->compressor, zlib->whole_in,
+            (size_t)zlib->whole_in_len, zlib->whole_out, out_bound);
+        if (out_len == 0)
+            err = MZ_DATA_ERROR;
+    }
+    if (err == MZ_OK) {
+        if (mz_stream_write(zlib->stream.base, zlib->whole_out, (int32_t)out_len) != (int32_t)out_len)
+            err = MZ_WRITE_ERROR;
+    }
+
+    zlib->whole_in_len = 0;
+    if (err != MZ_OK) {
+        zlib->error = err;
+        return err;
+    }
+
+    zlib->total_out += (int64_t)out_len;
+    return MZ_OK;
+}
+#endif
 #endif
 
 int32_t mz_stream_zlib_write(void *stream, const void *buf, int32_t size) {
@@ -260,6 +743,25 @@ int32_t mz_stream_zlib_write(void *stream, const void *buf, int32_t size) {
     mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
     int32_t err = MZ_OK;
 
+#ifdef HAVE_LIBDEFLATE
+    if (zlib->whole) {
+        /* Entries are gathered for libdeflate until they outgrow the limit */
+        if ((int64_t)zlib->whole_in_len + size <= MZ_STREAM_ZLIB_WHOLE_MAX) {
+            err = mz_stream_zlib_whole_write(stream, buf, size);
+            if (err != MZ_OK)
+                return err;
+            zlib->total_in += size;
+            return size;
+        }
+
+        err = mz_stream_zlib_whole_fallback(stream);
+        if (err == MZ_OK)
+            err = mz_stream_zlib_deflate(stream, Z_NO_FLUSH);
+        if (err != MZ_OK)
+            return err;
+    }
+#endif
+
     zlib->zstream.next_in = (Bytef*)(intptr_t)buf;
     zlib->zstream.avail_in = (uInt)size;
 
@@ -295,19 +797,23 @@ int32_t mz_stream_zlib_close(void *stream) {
 #ifdef MZ_ZIP_NO_COMPRESSION
         return MZ_SUPPORT_ERROR;
 #else
-        mz_stream_zlib_deflate(stream, Z_FINISH);
-        mz_stream_zlib_flush(stream);
-
-        ZLIB_PREFIX(deflateEnd)(&zlib->zstream);
+#ifdef HAVE_LIBDEFLATE
+        if (zlib->whole) {
+            mz_stream_zlib_whole_deflate(stream);
+        } else
+#endif
+        {
+            mz_stream_zlib_deflate(stream, Z_FINISH);
+            mz_stream_zlib_flush(stream);
+        }
 #endif
     } else if (zlib->mode & MZ_OPEN_MODE_READ) {
 #ifdef MZ_ZIP_NO_DECOMPRESSION
         return MZ_SUPPORT_ERROR;
-#else
-        ZLIB_PREFIX(inflateEnd)(&zlib->zstream);
 #endif
     }
 
+    /* Keep zstream allocated so the next open only has to reset it */
     zlib->initialized = 0;
 
     if (zlib->error != Z_OK)
@@ -332,6 +838,9 @@ int32_t mz_stream_zlib_get_prop_int64(void *stream, int32_t prop, int64_t *value
     case MZ_STREAM_PROP_TOTAL_OUT:
         *value = zlib->total_out;
         break;
+    case MZ_STREAM_PROP_TOTAL_OUT_MAX:
+        *value = zlib->max_total_out;
+        break;
     case MZ_STREAM_PROP_HEADER_SIZE:
         *value = 0;
         break;
@@ -353,6 +862,9 @@ int32_t mz_stream_zlib_set_prop_int64(void *stream, int32_t prop, int64_t value)
     case MZ_STREAM_PROP_TOTAL_IN_MAX:
         zlib->max_total_in = value;
         break;
+    case MZ_STREAM_PROP_TOTAL_OUT_MAX:
+        zlib->max_total_out = value;
+        break;
     case MZ_STREAM_PROP_COMPRESS_WINDOW:
         zlib->window_bits = (int32_t)value;
         break;
@@ -362,6 +874,276 @@ int32_t mz_stream_zlib_set_prop_int64(void *stream, int32_t prop, int64_t value)
     return MZ_OK;
 }
 
+void mz_stream_zlib_set_dictionary(void *stream, const void *dictionary, int32_t dictionary_size) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+    zlib->dictionary = (const uint8_t *)dictionary;
+    zlib->dictionary_size = dictionary_size;
+}
+
+int32_t mz_stream_zlib_set_index(void *stream, void *index, int64_t span) {
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+    mz_stream_zlib_index *zlib_index = (mz_stream_zlib_index *)index;
+    int32_t err = MZ_OK;
+
+    if (zlib_index != NULL) {
+        if ((span <= 0) || ((zlib->mode & MZ_OPEN_MODE_READ) == 0))
+            return MZ_PARAM_ERROR;
+
+        /* Inflate restarts from the start of the deflate data the base stream is positioned at */
+#ifdef HAVE_LIBDEFLATE
+        zlib->whole = 0;
+#endif
+        err = mz_stream_zlib_init(stream, MZ_OPEN_MODE_READ);
+        if (err != MZ_OK)
+            return err;
+        zlib->total_in = 0;
+        zlib->total_out = 0;
+
+        /* Start of the deflate data is the first point, other ones follow block ends */
+        mz_stream_zlib_index_clear(zlib_index);
+        if (mz_stream_zlib_index_push(zlib_index) == NULL)
+            return MZ_MEM_ERROR;
+    }
+
+    zlib->index = zlib_index;
+    zlib->index_span = span;
+    return MZ_OK;
+}
+
+int32_t mz_stream_zlib_seek_index(void *stream, void *index, int64_t offset) {
+#ifdef MZ_ZIP_NO_DECOMPRESSION
+    MZ_UNUSED(stream);
+    MZ_UNUSED(index);
+    MZ_UNUSED(offset);
+    return MZ_SUPPORT_ERROR;
+#else
+    mz_stream_zlib *zlib = (mz_stream_zlib *)stream;
+    mz_stream_zlib_point *point = NULL;
+    uint8_t discard[4096];
+    uint8_t prime = 0;
+    int32_t bytes_to_read = 0;
+    int32_t read = 0;
+    int32_t err = MZ_OK;
+
+    err = mz_stream_zlib_index_locate(index, offset, &point);
+    if (err != MZ_OK)
+        return err;
+    if ((zlib->mode & MZ_OPEN_MODE_READ) == 0)
+        return MZ_PARAM_ERROR;
+
+#ifdef HAVE_LIBDEFLATE
+    zlib->whole = 0;
+#endif
+    err = mz_stream_zlib_init(stream, MZ_OPEN_MODE_READ);
+    if (err != MZ_OK)
+        return err;
+
+    zlib->total_in = point->total_in;
+    zlib->total_out = point->total_out;
+
+    /* Base stream is positioned on the byte holding the remaining bits of the point */
+    if (point->bits > 0) {
+        if (mz_stream_read_uint8(zlib->stream.base, &prime) != MZ_OK)
+            return MZ_READ_ERROR;
+        zlib->error = ZLIB_PREFIX(inflatePrime)(&zlib->zstream, point->bits, prime >> (8 - point->bits));
+    }
+    if ((zlib->error == Z_OK) && (point->window_size > 0))
+        zlib->error = ZLIB_PREFIX(inflateSetDictionary)(&zlib->zstream, point->window,
+            (uint32_t)point->window_size);
+    if (zlib->error != Z_OK)
+        return MZ_SEEK_ERROR;
+
+    while (zlib->total_out < offset) {
+        bytes_to_read = sizeof(discard);
+        if ((int64_t)bytes_to_read > (offset - zlib->total_out))
+            bytes_to_read = (int32_t)(offset - zlib->total_out);
+        read = mz_stream_zlib_read(stream, discard, bytes_to_read);
+        if (read < 0)
+            return read;
+        if (read == 0)
+            break;
+    }
+    return MZ_OK;
+#endif
+}
+
+/***************************************************************************/
+
+int32_t mz_stream_zlib_index_get_position(void *handle, int64_t offset, int64_t *position) {
+    mz_stream_zlib_point *point = NULL;
+    int32_t err = MZ_OK;
+
+    if (position == NULL)
+        return MZ_PARAM_ERROR;
+    err = mz_stream_zlib_index_locate(handle, offset, &point);
+    if (err != MZ_OK)
+        return err;
+    *position = point->total_in;
+    if (point->bits > 0)
+        *position -= 1;
+    return MZ_OK;
+}
+
+int32_t mz_stream_zlib_index_get_totals(void *handle, int64_t *total_in, int64_t *total_out) {
+    mz_stream_zlib_index *index = (mz_stream_zlib_index *)handle;
+    if (index == NULL || index->count == 0)
+        return MZ_PARAM_ERROR;
+    if (total_in != NULL)
+        *total_in = index->total_in;
+    if (total_out != NULL)
+        *total_out = index->total_out;
+    return MZ_OK;
+}
+
+int32_t mz_stream_zlib_index_get_count(void *handle, int32_t *count) {
+    mz_stream_zlib_index *index = (mz_stream_zlib_index *)handle;
+    if (index == NULL || count == NULL)
+        return MZ_PARAM_ERROR;
+    *count = index->count;
+    return MZ_OK;
+}
+
+int32_t mz_stream_zlib_index_write(void *handle, void *stream) {
+    mz_stream_zlib_index *index = (mz_stream_zlib_index *)handle;
+    mz_stream_zlib_point *point = NULL;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    if (index == NULL || stream == NULL)
+        return MZ_PARAM_ERROR;
+
+    err = mz_stream_write_uint32(stream, MZ_STREAM_ZLIB_INDEX_MAGIC);
+    if (err == MZ_OK)
+        err = mz_stream_write_uint32(stream, (uint32_t)index->count);
+    if (err == MZ_OK)
+        err = mz_stream_write_int64(stream, index->total_in);
+    if (err == MZ_OK)
+        err = mz_stream_write_int64(stream, index->total_out);
+
+    for (i = 0; (err == MZ_OK) && (i < index->count); i += 1) {
+        point = &index->points[i];
+        err = mz_stream_write_int64(stream, point->total_in);
+        if (err == MZ_OK)
+            err = mz_stream_write_int64(stream, point->total_out);
+        if (err == MZ_OK)
+            err = mz_stream_write_uint8(stream, (uint8_t)point->bits);
+        if (err == MZ_OK)
+            err = mz_stream_write_uint16(stream, (uint16_t)(point->window_size - 1));
+        if ((err == MZ_OK) && (point->window_size > 0)) {
+            if (mz_stream_write(stream, point->window, point->window_size) != point->window_size)
+                err = MZ_WRITE_ERROR;
+        }
+    }
+    return err;
+}
+
+int32_t mz_stream_zlib_index_read(void *handle, void *stream) {
+    mz_stream_zlib_index *index = (mz_stream_zlib_index *)handle;
+    mz_stream_zlib_point *point = NULL;
+    mz_stream_zlib_point *prev = NULL;
+    uint32_t magic = 0;
+    uint32_t count = 0;
+    uint16_t window_size = 0;
+    uint8_t bits = 0;
+    int32_t err = MZ_OK;
+
+    if (index == NULL || stream == NULL)
+        return MZ_PARAM_ERROR;
+
+    mz_stream_zlib_index_clear(index);
+
+    err = mz_stream_read_uint32(stream, &magic);
+    if ((err == MZ_OK) && (magic != MZ_STREAM_ZLIB_INDEX_MAGIC))
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK)
+        err = mz_stream_read_uint32(stream, &count);
+    if ((err == MZ_OK) && ((count == 0) || (count > INT32_MAX / sizeof(mz_stream_zlib_point))))
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK)
+        err = mz_stream_read_int64(stream, &index->total_in);
+    if (err == MZ_OK)
+        err = mz_stream_read_int64(stream, &index->total_out);
+
+    if ((err == MZ_OK) && ((int32_t)count > index->capacity)) {
+        MZ_FREE(index->points);
+        index->capacity = 0;
+        index->points = (mz_stream_zlib_point *)MZ_ALLOC(count * sizeof(mz_stream_zlib_point));
+        if (index->points == NULL)
+            err = MZ_MEM_ERROR;
+        else
+            index->capacity = (int32_t)count;
+    }
+
+    while ((err == MZ_OK) && (index->count < (int32_t)count)) {
+        prev = (index->count > 0) ? &index->points[index->count - 1] : NULL;
+        point = mz_stream_zlib_index_push(index);
+        if (point == NULL) {
+            err = MZ_MEM_ERROR;
+            break;
+        }
+        err = mz_stream_read_int64(stream, &point->total_in);
+        if (err == MZ_OK)
+            err = mz_stream_read_int64(stream, &point->total_out);
+        if (err == MZ_OK)
+            err = mz_stream_read_uint8(stream, &bits);
+        if (err == MZ_OK)
+            err = mz_stream_read_uint16(stream, &window_size);
+        if (err != MZ_OK)
+            break;
+
+        /* Window size is stored less one so a full window fits, an empty one wraps */
+        point->bits = bits;
+        point->window_size = (int32_t)(uint16_t)(window_size + 1);
+
+        /* Points have to be ordered and inside the indexed data */
+        if ((point->bits > 7) || (point->total_in > index->total_in) || (point->total_out > index->total_out) ||
+            ((prev == NULL) && ((point->total_in != 0) || (point->total_out != 0))) ||
+            ((prev != NULL) && ((point->total_in <= prev->total_in) || (point->total_out <= prev->total_out)))) {
+            err = MZ_FORMAT_ERROR;
+            break;
+        }
+
+        if (point->window_size > 0) {
+            point->window = (uint8_t *)MZ_ALLOC(point->window_size);
+            if (point->window == NULL)
+                err = MZ_MEM_ERROR;
+            else if (mz_stream_read(stream, point->window, point->window_size) != point->window_size)
+                err = MZ_READ_ERROR;
+        }
+    }
+
+    if (err != MZ_OK)
+        mz_stream_zlib_index_clear(index);
+    return err;
+}
+
+void *mz_stream_zlib_index_create(void **handle) {
+    mz_stream_zlib_index *index = NULL;
+
+    index = (mz_stream_zlib_index *)MZ_ALLOC(sizeof(mz_stream_zlib_index));
+    if (index != NULL)
+        memset(index, 0, sizeof(mz_stream_zlib_index));
+    if (handle != NULL)
+        *handle = index;
+
+    return index;
+}
+
+void mz_stream_zlib_index_delete(void **handle) {
+    mz_stream_zlib_index *index = NULL;
+    if (handle == NULL)
+        return;
+    index = (mz_stream_zlib_index *)*handle;
+    if (index != NULL) {
+        mz_stream_zlib_index_clear(index);
+        MZ_FREE(index->points);
+        MZ_FREE(index);
+    }
+    *handle = NULL;
+}
+
+/***************************************************************************/
+
 void *mz_stream_zlib_create(void **stream) {
     mz_stream_zlib *zlib = NULL;
 
@@ -383,8 +1165,17 @@ void mz_stream_zlib_delete(void **stream) {
     if (stream == NULL)
         return;
     zlib = (mz_stream_zlib *)*stream;
-    if (zlib != NULL)
+    if (zlib != NULL) {
+        mz_stream_zlib_end(zlib);
+#ifdef HAVE_LIBDEFLATE
+        mz_stream_zlib_whole_free(zlib);
+        if (zlib->compressor != NULL)
+            libdeflate_free_compressor(zlib->compressor);
+        if (zlib->decompressor != NULL)
+            libdeflate_free_decompressor(zlib->decompressor);
+#endif
         MZ_FREE(zlib);
+    }
     *stream = NULL;
 }
 
@@ -29,6 +29,19 @@ int32_t mz_stream_zlib_error(void *stream);
 int32_t mz_stream_zlib_get_prop_int64(void *stream, int32_t prop, int64_t *value);
 int32_t mz_stream_zlib_set_prop_int64(void *stream, int32_t prop, int64_t value);
 
+void    mz_stream_zlib_set_dictionary(void *stream, const void *dictionary, int32_t dictionary_size);
+int32_t mz_stream_zlib_set_index(void *stream, void *index, int64_t span);
+int32_t mz_stream_zlib_seek_index(void *stream, void *index, int64_t offset);
+
+int32_t mz_stream_zlib_index_get_position(void *index, int64_t offset, int64_t *position);
+int32_t mz_stream_zlib_index_get_totals(void *index, int64_t *total_in, int64_t *total_out);
+int32_t mz_stream_zlib_index_get_count(void *index, int32_t *count);
+int32_t mz_stream_zlib_index_read(void *index, void *stream);
+int32_t mz_stream_zlib_index_write(void *index, void *stream);
+
+void*   mz_stream_zlib_index_create(void **index);
+void    mz_stream_zlib_index_delete(void **index);
+
 void*   mz_stream_zlib_create(void **stream);
 void    mz_stream_zlib_delete(void **stream);
 
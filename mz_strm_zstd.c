@@ -11,10 +11,24 @@
 */
 
 #include "mz.h"
+#include "mz_alloc.h"
 #include "mz_strm.h"
 #include "mz_strm_zstd.h"
 
+/* Needed for contexts created with a custom allocator */
+#define ZSTD_STATIC_LINKING_ONLY
 #include <zstd.h>
+#include <zdict.h>
+
+/***************************************************************************/
+
+/* Seek table appended as a skippable frame, layout of the zstd seekable format */
+#define MZ_ZSTD_SEEKABLE_SKIPPABLE_MAGIC    (0x184D2A5E)
+#define MZ_ZSTD_SEEKABLE_MAGIC              (0x8F92EAB1)
+#define MZ_ZSTD_SEEKABLE_FOOTER_SIZE        (9)
+#define MZ_ZSTD_SEEKABLE_HEADER_SIZE        (8)
+#define MZ_ZSTD_SEEKABLE_CHECKSUM_FLAG      (0x80)
+#define MZ_ZSTD_SEEKABLE_MAX_FRAMES         (0x8000000)
 
 /***************************************************************************/
 
@@ -30,7 +44,8 @@ static mz_stream_vtbl mz_stream_zstd_vtbl = {
     mz_stream_zstd_create,
     mz_stream_zstd_delete,
     mz_stream_zstd_get_prop_int64,
-    mz_stream_zstd_set_prop_int64
+    mz_stream_zstd_set_prop_int64,
+    NULL
 };
 
 /***************************************************************************/
@@ -51,20 +66,85 @@ typedef struct mz_stream_zstd_s {
     int64_t         max_total_out;
     int8_t          initialized;
     uint32_t        preset;
+    const void      *dictionary;
+    mz_alloc        *ctx_alloc;     /* allocator the kept contexts were created with */
+    int64_t         frame_size;     /* uncompressed size of each independent frame, 0 for one frame */
+    int64_t         frame_in;
+    int64_t         frame_start;    /* total_out when the current frame started */
+    int64_t         base_in;        /* bytes read from the base stream */
+    int64_t         *frames;        /* compressed and uncompressed start of each frame and the end */
+    int32_t         frame_count;
+    int32_t         frame_capacity;
+    int8_t          frames_loaded;
 } mz_stream_zstd;
 
 /***************************************************************************/
 
+static void *mz_stream_zstd_alloc(void *opaque, size_t size) {
+    return mz_alloc_malloc((mz_alloc *)opaque, size);
+}
+
+static void mz_stream_zstd_free(void *opaque, void *address) {
+    mz_alloc_free((mz_alloc *)opaque, address);
+}
+
+static ZSTD_customMem mz_stream_zstd_custom_mem(void *stream) {
+    mz_stream_zstd *zstd = (mz_stream_zstd *)stream;
+    ZSTD_customMem custom_mem;
+
+    memset(&custom_mem, 0, sizeof(custom_mem));
+    if (zstd->stream.alloc != NULL) {
+        custom_mem.customAlloc = mz_stream_zstd_alloc;
+        custom_mem.customFree = mz_stream_zstd_free;
+        custom_mem.opaque = zstd->stream.alloc;
+    }
+    return custom_mem;
+}
+
+static void mz_stream_zstd_free_contexts(void *stream) {
+    mz_stream_zstd *zstd = (mz_stream_zstd *)stream;
+#ifndef MZ_ZIP_NO_COMPRESSION
+    ZSTD_freeCStream(zstd->zcstream);
+#endif
+    zstd->zcstream = NULL;
+#ifndef MZ_ZIP_NO_DECOMPRESSION
+    ZSTD_freeDStream(zstd->zdstream);
+#endif
+    zstd->zdstream = NULL;
+}
+
 int32_t mz_stream_zstd_open(void *stream, const char *path, int32_t mode) {
     mz_stream_zstd *zstd = (mz_stream_zstd *)stream;
+    size_t result = 0;
 
     MZ_UNUSED(path);
+    MZ_UNUSED(result);
+
+    if (zstd->ctx_alloc != zstd->stream.alloc) {
+        mz_stream_zstd_free_contexts(stream);
+        zstd->ctx_alloc = zstd->stream.alloc;
+    }
 
     if (mode & MZ_OPEN_MODE_WRITE) {
 #ifdef MZ_ZIP_NO_COMPRESSION
         return MZ_SUPPORT_ERROR;
 #else
-        zstd->zcstream = ZSTD_createCStream();
+        /* Contexts are kept from the last open and only need their session reset */
+        if (zstd->zcstream != NULL)
+            ZSTD_CCtx_reset(zstd->zcstream, ZSTD_reset_session_and_parameters);
+        else
+            zstd->zcstream = ZSTD_createCStream_advanced(mz_stream_zstd_custom_mem(stream));
+        if (zstd->zcstream == NULL)
+            return MZ_MEM_ERROR;
+        if (zstd->dictionary != NULL) {
+            result = ZSTD_CCtx_refCDict(zstd->zcstream, (const ZSTD_CDict *)zstd->dictionary);
+            if (ZSTD_isError(result)) {
+                ZSTD_freeCStream(zstd->zcstream);
+                zstd->zcstream = NULL;
+                zstd->error = (int32_t)result;
+                return MZ_DATA_ERROR;
+            }
+        }
         zstd->out.dst = zstd->buffer;
         zstd->out.size = sizeof(zstd->buffer);
         zstd->out.pos = 0;
@@ -73,13 +153,36 @@ int32_t mz_stream_zstd_open(void *stream, const char *path, int32_t mode) {
 #ifdef MZ_ZIP_NO_DECOMPRESSION
         return MZ_SUPPORT_ERROR;
 #else
-        zstd->zdstream = ZSTD_createDStream();
+        if (zstd->zdstream != NULL)
+            ZSTD_DCtx_reset(zstd->zdstream, ZSTD_reset_session_and_parameters);
+        else
+            zstd->zdstream = ZSTD_createDStream_advanced(mz_stream_zstd_custom_mem(stream));
+        if (zstd->zdstream == NULL)
+            return MZ_MEM_ERROR;
+        if (zstd->dictionary != NULL) {
+            result = ZSTD_DCtx_refDDict(zstd->zdstream, (const ZSTD_DDict *)zstd->dictionary);
+            if (ZSTD_isError(result)) {
+                ZSTD_freeDStream(zstd->zdstream);
+                zstd->zdstream = NULL;
+                zstd->error = (int32_t)result;
+                return MZ_DATA_ERROR;
+            }
+        }
         memset(&zstd->out, 0, sizeof(ZSTD_outBuffer));
 #endif
     }
 
     memset(&zstd->in, 0, sizeof(ZSTD_inBuffer));
 
+    zstd->total_in = 0;
+    zstd->total_out = 0;
+    zstd->buffer_len = 0;
+    zstd->frame_in = 0;
+    zstd->frame_start = 0;
+    zstd->base_in = 0;
+    zstd->frame_count = 0;
+    zstd->frames_loaded = 0;
+
     zstd->initialized = 1;
     zstd->mode = mode;
     zstd->error = MZ_OK;
@@ -129,6 +232,7 @@ int32_t mz_stream_zstd_read(void *stream, void *buf, int32_t size) {
 
             if (read < 0)
                 return read;
+            zstd->base_in += read;
 
             zstd->in.src = (const void*)zstd->buffer;
             zstd->in.pos = 0;
@@ -165,6 +269,36 @@ int32_t mz_stream_zstd_read(void *stream, void *buf, int32_t size) {
 #endif
 }
 
+static int32_t mz_stream_zstd_frames_add(void *stream, int64_t compressed, int64_t uncompressed) {
+    mz_stream_zstd *zstd = (mz_stream_zstd *)stream;
+    int64_t *frames = NULL;
+    int32_t capacity = 0;
+
+    /* Frames are stored as start offsets, the first pair being zero */
+    if (zstd->frame_count + 2 > zstd->frame_capacity) {
+        capacity = (zstd->frame_capacity == 0) ? 64 : zstd->frame_capacity * 2;
+        if (capacity > MZ_ZSTD_SEEKABLE_MAX_FRAMES)
+            return MZ_MEM_ERROR;
+        frames = (int64_t *)MZ_ALLOC((size_t)capacity * 2 * sizeof(int64_t));
+        if (frames == NULL)
+            return MZ_MEM_ERROR;
+        if (zstd->frames != NULL)
+            memcpy(frames, zstd->frames, (size_t)(zstd->frame_count + 1) * 2 * sizeof(int64_t));
+        MZ_FREE(zstd->frames);
+        zstd->frames = frames;
+        zstd->frame_capacity = capacity;
+    }
+    if (zstd->frame_count == 0) {
+        zstd->frames[0] = 0;
+        zstd->frames[1] = 0;
+    }
+
+    zstd->frames[(zstd->frame_count + 1) * 2] = zstd->frames[zstd->frame_count * 2] + compressed;
+    zstd->frames[(zstd->frame_count + 1) * 2 + 1] = zstd->frames[zstd->frame_count * 2 + 1] + uncompressed;
+    zstd->frame_count += 1;
+    return MZ_OK;
+}
+
 #ifndef MZ_ZIP_NO_COMPRESSION
 static int32_t mz_stream_zstd_flush(void *stream) {
     mz_stream_zstd *zstd = (mz_stream_zstd *)stream;
@@ -213,6 +347,56 @@ static int32_t mz_stream_zstd_compress(void *stream, ZSTD_EndDirective flush) {
 
     return MZ_OK;
 }
+
+static int32_t mz_stream_zstd_end_frame(void *stream) {
+    mz_stream_zstd *zstd = (mz_stream_zstd *)stream;
+    int32_t err = MZ_OK;
+
+    zstd->in.src = NULL;
+    zstd->in.pos = 0;
+    zstd->in.size = 0;
+
+    err = mz_stream_zstd_compress(stream, ZSTD_e_end);
+    if (err == MZ_OK)
+        err = mz_stream_zstd_frames_add(stream, zstd->total_out - zstd->frame_start, zstd->frame_in);
+
+    zstd->frame_start = zstd->total_out;
+    zstd->frame_in = 0;
+    return err;
+}
+
+static int32_t mz_stream_zstd_write_seek_table(void *stream) {
+    mz_stream_zstd *zstd = (mz_stream_zstd *)stream;
+    int64_t *frame = NULL;
+    int32_t table_size = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    err = mz_stream_zstd_flush(stream);
+    zstd->buffer_len = 0;
+
+    /* Decoders not aware of the seekable format skip the table like any skippable frame */
+    table_size = zstd->frame_count * 8 + MZ_ZSTD_SEEKABLE_FOOTER_SIZE;
+    if (err == MZ_OK)
+        err = mz_stream_write_uint32(zstd->stream.base, MZ_ZSTD_SEEKABLE_SKIPPABLE_MAGIC);
+    if (err == MZ_OK)
+        err = mz_stream_write_uint32(zstd->stream.base, (uint32_t)table_size);
+    for (i = 0; (err == MZ_OK) && (i < zstd->frame_count); i += 1) {
+        frame = &zstd->frames[i * 2];
+        err = mz_stream_write_uint32(zstd->stream.base, (uint32_t)(frame[2] - frame[0]));
+        if (err == MZ_OK)
+            err = mz_stream_write_uint32(zstd->stream.base, (uint32_t)(frame[3] - frame[1]));
+    }
+    if (err == MZ_OK)
+        err = mz_stream_write_uint32(zstd->stream.base, (uint32_t)zstd->frame_count);
+    if (err == MZ_OK)
+        err = mz_stream_write_uint8(zstd->stream.base, 0);
+    if (err == MZ_OK)
+        err = mz_stream_write_uint32(zstd->stream.base, MZ_ZSTD_SEEKABLE_MAGIC);
+
+    zstd->total_out += MZ_ZSTD_SEEKABLE_HEADER_SIZE + table_size;
+    return err;
+}
 #endif
 
 int32_t mz_stream_zstd_write(void *stream, const void *buf, int32_t size) {
@@ -223,18 +407,34 @@ int32_t mz_stream_zstd_write(void *stream, const void *buf, int32_t size) {
     return MZ_SUPPORT_ERROR;
 #else
     mz_stream_zstd *zstd = (mz_stream_zstd *)stream;
+    int32_t chunk = 0;
+    int32_t written = 0;
     int32_t err = MZ_OK;
 
-    zstd->in.src = buf;
-    zstd->in.pos = 0;
-    zstd->in.size = size;
+    do {
+        chunk = size - written;
+        if ((zstd->frame_size > 0) && ((int64_t)chunk > zstd->frame_size - zstd->frame_in))
+            chunk = (int32_t)(zstd->frame_size - zstd->frame_in);
 
-    err = mz_stream_zstd_compress(stream, ZSTD_e_continue);
-    if (err != MZ_OK) {
-        return err;
-    }
+        zstd->in.src = (const uint8_t *)buf + written;
+        zstd->in.pos = 0;
+        zstd->in.size = chunk;
+
+        err = mz_stream_zstd_compress(stream, ZSTD_e_continue);
+        if (err != MZ_OK)
+            return err;
+
+        written += chunk;
+        zstd->frame_in += chunk;
+        zstd->total_in += chunk;
+
+        if ((zstd->frame_size > 0) && (zstd->frame_in == zstd->frame_size)) {
+            err = mz_stream_zstd_end_frame(stream);
+            if (err != MZ_OK)
+                return err;
+        }
+    } while (written < size);
 
-    zstd->total_in += size;
     return size;
 #endif
 }
@@ -245,12 +445,150 @@ int64_t mz_stream_zstd_tell(void *stream) {
     return MZ_TELL_ERROR;
 }
 
+#ifndef MZ_ZIP_NO_DECOMPRESSION
+static int32_t mz_stream_zstd_seek_base(void *stream, int64_t position) {
+    mz_stream_zstd *zstd = (mz_stream_zstd *)stream;
+    int32_t err = MZ_OK;
+
+    /* Base is only moved relative to the data already read so split disks are followed */
+    err = mz_stream_seek(zstd->stream.base, position - zstd->base_in, MZ_SEEK_CUR);
+    if (err == MZ_OK)
+        zstd->base_in = position;
+    memset(&zstd->in, 0, sizeof(ZSTD_inBuffer));
+    return err;
+}
+
+static int32_t mz_stream_zstd_load_seek_table(void *stream) {
+    mz_stream_zstd *zstd = (mz_stream_zstd *)stream;
+    int64_t table_start = 0;
+    uint32_t magic = 0;
+    uint32_t frame_count = 0;
+    uint32_t table_size = 0;
+    uint32_t compressed = 0;
+    uint32_t uncompressed = 0;
+    uint32_t checksum = 0;
+    uint8_t descriptor = 0;
+    int32_t entry_size = 8;
+    int32_t err = MZ_OK;
+    uint32_t i = 0;
+
+    /* Size of the compressed data is needed to find the table at its end */
+    if (zstd->max_total_in < MZ_ZSTD_SEEKABLE_HEADER_SIZE + MZ_ZSTD_SEEKABLE_FOOTER_SIZE)
+        return MZ_SUPPORT_ERROR;
+
+    err = mz_stream_zstd_seek_base(stream, zstd->max_total_in - MZ_ZSTD_SEEKABLE_FOOTER_SIZE);
+    if (err == MZ_OK)
+        err = mz_stream_read_uint32(zstd->stream.base, &frame_count);
+    if (err == MZ_OK)
+        err = mz_stream_read_uint8(zstd->stream.base, &descriptor);
+    if (err == MZ_OK)
+        err = mz_stream_read_uint32(zstd->stream.base, &magic);
+    if (err != MZ_OK)
+        return err;
+    zstd->base_in += MZ_ZSTD_SEEKABLE_FOOTER_SIZE;
+    if (magic != MZ_ZSTD_SEEKABLE_MAGIC)
+        return MZ_SUPPORT_ERROR;
+
+    if (descriptor & MZ_ZSTD_SEEKABLE_CHECKSUM_FLAG)
+        entry_size += 4;
+    if ((frame_count == 0) || (frame_count > MZ_ZSTD_SEEKABLE_MAX_FRAMES))
+        return MZ_FORMAT_ERROR;
+    table_start = zstd->max_total_in - MZ_ZSTD_SEEKABLE_FOOTER_SIZE - MZ_ZSTD_SEEKABLE_HEADER_SIZE -
+        (int64_t)frame_count * entry_size;
+    if (table_start < 0)
+        return MZ_FORMAT_ERROR;
+
+    err = mz_stream_zstd_seek_base(stream, table_start);
+    if (err == MZ_OK)
+        err = mz_stream_read_uint32(zstd->stream.base, &magic);
+    if (err == MZ_OK)
+        err = mz_stream_read_uint32(zstd->stream.base, &table_size);
+    if ((err == MZ_OK) && ((magic != MZ_ZSTD_SEEKABLE_SKIPPABLE_MAGIC) ||
+        (table_size != frame_count * entry_size + MZ_ZSTD_SEEKABLE_FOOTER_SIZE)))
+        err = MZ_FORMAT_ERROR;
+
+    zstd->frame_count = 0;
+    for (i = 0; (err == MZ_OK) && (i < frame_count); i += 1) {
+        err = mz_stream_read_uint32(zstd->stream.base, &compressed);
+        if (err == MZ_OK)
+            err = mz_stream_read_uint32(zstd->stream.base, &uncompressed);
+        if ((err == MZ_OK) && (entry_size > 8))
+            err = mz_stream_read_uint32(zstd->stream.base, &checksum);
+        if (err == MZ_OK)
+            err = mz_stream_zstd_frames_add(stream, compressed, uncompressed);
+    }
+    zstd->base_in = table_start + MZ_ZSTD_SEEKABLE_HEADER_SIZE + (int64_t)frame_count * entry_size;
+
+    /* Frames have to end where the table starts */
+    if ((err == MZ_OK) && (zstd->frames[zstd->frame_count * 2] != table_start))
+        err = MZ_FORMAT_ERROR;
+    if (err != MZ_OK) {
+        zstd->frame_count = 0;
+        return err;
+    }
+
+    zstd->frames_loaded = 1;
+    return MZ_OK;
+}
+#endif
+
 int32_t mz_stream_zstd_seek(void *stream, int64_t offset, int32_t origin) {
+#ifdef MZ_ZIP_NO_DECOMPRESSION
     MZ_UNUSED(stream);
     MZ_UNUSED(offset);
     MZ_UNUSED(origin);
+    return MZ_SUPPORT_ERROR;
+#else
+    mz_stream_zstd *zstd = (mz_stream_zstd *)stream;
+    uint8_t discard[4096];
+    int32_t bytes_to_read = 0;
+    int32_t left = 0;
+    int32_t right = 0;
+    int32_t middle = 0;
+    int32_t read = 0;
+    int32_t err = MZ_OK;
 
-    return MZ_SEEK_ERROR;
+    /* Only entries written as independent frames with a seek table can be seeked */
+    if ((origin != MZ_SEEK_SET) || (offset < 0) || ((zstd->mode & MZ_OPEN_MODE_READ) == 0))
+        return MZ_SEEK_ERROR;
+    if (!zstd->frames_loaded) {
+        err = mz_stream_zstd_load_seek_table(stream);
+        if (err != MZ_OK)
+            return err;
+    }
+    if (offset > zstd->frames[zstd->frame_count * 2 + 1])
+        return MZ_SEEK_ERROR;
+
+    /* Last frame starting at or before the offset */
+    right = zstd->frame_count - 1;
+    while (left < right) {
+        middle = left + (right - left + 1) / 2;
+        if (zstd->frames[middle * 2 + 1] <= offset)
+            left = middle;
+        else
+            right = middle - 1;
+    }
+
+    err = mz_stream_zstd_seek_base(stream, zstd->frames[left * 2]);
+    if (err != MZ_OK)
+        return err;
+
+    ZSTD_DCtx_reset(zstd->zdstream, ZSTD_reset_session_only);
+    zstd->total_in = zstd->frames[left * 2];
+    zstd->total_out = zstd->frames[left * 2 + 1];
+
+    while (zstd->total_out < offset) {
+        bytes_to_read = sizeof(discard);
+        if ((int64_t)bytes_to_read > (offset - zstd->total_out))
+            bytes_to_read = (int32_t)(offset - zstd->total_out);
+        read = mz_stream_zstd_read(stream, discard, bytes_to_read);
+        if (read < 0)
+            return read;
+        if (read == 0)
+            return MZ_SEEK_ERROR;
+    }
+    return MZ_OK;
+#endif
 }
 
 int32_t mz_stream_zstd_close(void *stream) {
@@ -260,20 +598,21 @@ int32_t mz_stream_zstd_close(void *stream) {
 #ifdef MZ_ZIP_NO_COMPRESSION
         return MZ_SUPPORT_ERROR;
 #else
-        mz_stream_zstd_compress(stream, ZSTD_e_end);
-        mz_stream_zstd_flush(stream);
-
-        ZSTD_freeCStream(zstd->zcstream);
-        zstd->zcstream = NULL;
+        if (zstd->frame_size > 0) {
+            if ((zstd->frame_in > 0) || (zstd->frame_count == 0))
+                mz_stream_zstd_end_frame(stream);
+            mz_stream_zstd_write_seek_table(stream);
+        } else {
+            mz_stream_zstd_compress(stream, ZSTD_e_end);
+            mz_stream_zstd_flush(stream);
+        }
 #endif
     } else if (zstd->mode & MZ_OPEN_MODE_READ) {
 #ifdef MZ_ZIP_NO_DECOMPRESSION
         return MZ_SUPPORT_ERROR;
-#else
-        ZSTD_freeDStream(zstd->zdstream);
-        zstd->zdstream = NULL;
 #endif
     }
+    /* Contexts are freed on delete so they can be reused by the next open */
     zstd->initialized = 0;
     return MZ_OK;
 }
@@ -301,6 +640,9 @@ int32_t mz_stream_zstd_get_prop_int64(void *stream, int32_t prop, int64_t *value
     case MZ_STREAM_PROP_HEADER_SIZE:
         *value = 0;
         break;
+    case MZ_STREAM_PROP_COMPRESS_FRAME_SIZE:
+        *value = zstd->frame_size;
+        break;
     default:
         return MZ_EXIST_ERROR;
     }
@@ -319,10 +661,66 @@ int32_t mz_stream_zstd_set_prop_int64(void *stream, int32_t prop, int64_t value)
     case MZ_STREAM_PROP_TOTAL_IN_MAX:
         zstd->max_total_in = value;
         return MZ_OK;
+    case MZ_STREAM_PROP_COMPRESS_FRAME_SIZE:
+        if ((value < 0) || (value > UINT32_MAX / 2))
+            return MZ_PARAM_ERROR;
+        zstd->frame_size = value;
+        return MZ_OK;
     }
     return MZ_EXIST_ERROR;
 }
 
+void mz_stream_zstd_set_dictionary(void *stream, const void *prepared) {
+    mz_stream_zstd *zstd = (mz_stream_zstd *)stream;
+    zstd->dictionary = prepared;
+}
+
+void *mz_stream_zstd_dictionary_create(const void *dictionary, int32_t dictionary_size, int32_t mode,
+    int16_t level) {
+    if (mode & MZ_OPEN_MODE_WRITE) {
+#ifdef MZ_ZIP_NO_COMPRESSION
+        return NULL;
+#else
+        if (level < 0)
+            level = ZSTD_CLEVEL_DEFAULT;
+        return ZSTD_createCDict(dictionary, (size_t)dictionary_size, level);
+#endif
+    }
+#ifdef MZ_ZIP_NO_DECOMPRESSION
+    return NULL;
+#else
+    return ZSTD_createDDict(dictionary, (size_t)dictionary_size);
+#endif
+}
+
+void mz_stream_zstd_dictionary_delete(void **prepared, int32_t mode) {
+    if (prepared == NULL || *prepared == NULL)
+        return;
+#ifndef MZ_ZIP_NO_COMPRESSION
+    if (mode & MZ_OPEN_MODE_WRITE)
+        ZSTD_freeCDict((ZSTD_CDict *)*prepared);
+#endif
+#ifndef MZ_ZIP_NO_DECOMPRESSION
+    if ((mode & MZ_OPEN_MODE_WRITE) == 0)
+        ZSTD_freeDDict((ZSTD_DDict *)*prepared);
+#endif
+    *prepared = NULL;
+}
+
+int32_t mz_stream_zstd_dictionary_train(void *dictionary, int32_t dictionary_size, const void *samples,
+    const size_t *sample_sizes, int32_t sample_count) {
+    size_t result = 0;
+
+    if (dictionary == NULL || samples == NULL || sample_sizes == NULL || sample_count <= 0)
+        return MZ_PARAM_ERROR;
+
+    result = ZDICT_trainFromBuffer(dictionary, (size_t)dictionary_size, samples, sample_sizes,
+        (unsigned)sample_count);
+    if (ZDICT_isError(result))
+        return MZ_DATA_ERROR;
+    return (int32_t)result;
+}
+
 void *mz_stream_zstd_create(void **stream) {
     mz_stream_zstd *zstd = NULL;
     zstd = (mz_stream_zstd *)MZ_ALLOC(sizeof(mz_stream_zstd));
@@ -341,8 +739,11 @@ void mz_stream_zstd_delete(void **stream) {
     if (stream == NULL)
         return;
     zstd = (mz_stream_zstd *)*stream;
-    if (zstd != NULL)
+    if (zstd != NULL) {
+        mz_stream_zstd_free_contexts(zstd);
+        MZ_FREE(zstd->frames);
         MZ_FREE(zstd);
+    }
     *stream = NULL;
 }
 
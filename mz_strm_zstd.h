@@ -30,6 +30,14 @@ int32_t mz_stream_zstd_error(void *stream);
 int32_t mz_stream_zstd_get_prop_int64(void *stream, int32_t prop, int64_t *value);
 int32_t mz_stream_zstd_set_prop_int64(void *stream, int32_t prop, int64_t value);
 
+void    mz_stream_zstd_set_dictionary(void *stream, const void *prepared);
+
+void*   mz_stream_zstd_dictionary_create(const void *dictionary, int32_t dictionary_size, int32_t mode,
+    int16_t level);
+void    mz_stream_zstd_dictionary_delete(void **prepared, int32_t mode);
+int32_t mz_stream_zstd_dictionary_train(void *dictionary, int32_t dictionary_size, const void *samples,
+    const size_t *sample_sizes, int32_t sample_count);
+
 void*   mz_stream_zstd_create(void **stream);
 void    mz_stream_zstd_delete(void **stream);
 
@@ -0,0 +1,35 @@
+/* mz_trace.h -- Static tracepoints
+   part of the MiniZip project
+
+   Copyright (C) 2010-2020 Nathan Moinvaziri
+     https://github.com/nmoinvaz/minizip
+
+   This program is distributed under the terms of the same license as zlib.
+   See the accompanying LICENSE file for the full text of the license.
+*/
+
+#ifndef MZ_TRACE_H
+#define MZ_TRACE_H
+
+/***************************************************************************/
+
+/* Probes are nops until a tracer such as bpftrace attaches to them, so they
+   stay enabled in release builds */
+#ifdef HAVE_SDT
+#  include <sys/sdt.h>
+#  define MZ_TRACE0(name)                   DTRACE_PROBE(minizip, name)
+#  define MZ_TRACE1(name, a)                DTRACE_PROBE1(minizip, name, a)
+#  define MZ_TRACE2(name, a, b)             DTRACE_PROBE2(minizip, name, a, b)
+#  define MZ_TRACE3(name, a, b, c)          DTRACE_PROBE3(minizip, name, a, b, c)
+#  define MZ_TRACE4(name, a, b, c, d)       DTRACE_PROBE4(minizip, name, a, b, c, d)
+#else
+#  define MZ_TRACE0(name)
+#  define MZ_TRACE1(name, a)
+#  define MZ_TRACE2(name, a, b)
+#  define MZ_TRACE3(name, a, b, c)
+#  define MZ_TRACE4(name, a, b, c, d)
+#endif
+
+/***************************************************************************/
+
+#endif
@@ -17,7 +17,9 @@
 
 
 #include "mz.h"
+#include "mz_alloc.h"
 #include "mz_crypt.h"
+#include "mz_os.h"
 #include "mz_strm.h"
 #ifdef HAVE_BZIP2
 #  include "mz_strm_bzip.h"
@@ -41,6 +43,7 @@
 #ifdef HAVE_ZSTD
 #  include "mz_strm_zstd.h"
 #endif
+#include "mz_trace.h"
 
 #include "mz_zip.h"
 
@@ -78,8 +81,35 @@
 #define MZ_ZIP_EOCD_MAX_BACK            (1 << 20)
 #endif
 
+#define MZ_ZIP_RECOVER_CHUNK_SIZE       (4 * 1024 * 1024)
+#define MZ_ZIP_RECOVER_REPORT_NS        (250 * 1000 * 1000)
+
+#define MZ_ZIP_DICT_FILENAME            ("__dict__")
+#define MZ_ZIP_DICT_FIELD_LENGTH        (4 + 4 + 4 + 8 + 2)
+#define MZ_ZIP_DICT_MAX_SIZE            (1 << 24)
+#define MZ_ZIP_DICT_RECORD_COUNT        (8)
+
+/* Entry streams kept between entries, indexed by kind */
+#define MZ_ZIP_POOL_NONE                (-1)
+#define MZ_ZIP_POOL_RAW_CRYPT           (0)
+#define MZ_ZIP_POOL_PKCRYPT             (1)
+#define MZ_ZIP_POOL_WZAES               (2)
+#define MZ_ZIP_POOL_STORE               (3)
+#define MZ_ZIP_POOL_DEFLATE             (4)
+#define MZ_ZIP_POOL_ZSTD                (5)
+#define MZ_ZIP_POOL_COUNT               (6)
+
+#define MZ_ZIP_CODEC_MAX                (16)
+
 /***************************************************************************/
 
+typedef struct mz_zip_dict_record_s {
+    uint32_t id;
+    int32_t  size;
+    uint32_t disk_number;
+    int64_t  disk_offset;
+} mz_zip_dict_record;
+
 typedef struct mz_zip_s {
     mz_zip_file file_info;
     mz_zip_file local_file_info;
@@ -89,16 +119,31 @@ typedef struct mz_zip_s {
     void *cd_mem_stream;            /* memory stream for central directory */
     void *compress_stream;          /* compression stream */
     void *crypt_stream;             /* encryption stream */
+    void *stream_pool[MZ_ZIP_POOL_COUNT];   /* closed entry streams ready for reuse */
+    int8_t compress_pool;           /* pool slot of the compression stream */
+    int8_t crypt_pool;              /* pool slot of the encryption stream */
     void *file_info_stream;         /* memory stream for storing file info */
     void *local_file_info_stream;   /* memory stream for storing local file info */
+    mz_zip_stats *stats;            /* counters for entry streams */
+    mz_alloc *alloc;                /* allocator for codec state and archive comment */
+    const char *codec_name;         /* codec preferred for entries it can handle */
+    int32_t frame_size;             /* uncompressed size of independently compressed frames */
+    mz_stream_create_cb compress_create;    /* codec that created the compression stream */
+    uint8_t  low_memory;            /* delete entry streams on close instead of pooling */
 
     int32_t  open_mode;
     uint8_t  recover;
+    mz_zip_recover_cb recover_cb;   /* reports progress while recovering the central dir */
+    void     *recover_userdata;
+    int32_t  recover_threads;       /* threads scanning for signatures while recovering */
     uint8_t  data_descriptor;
 
     uint32_t disk_number_with_cd;   /* number of the disk with the central dir */
     int64_t  disk_offset_shift;     /* correction for zips that have wrong offset start of cd */
 
+    int64_t  eocd_pos;              /* pos of the end of central dir record */
+    int64_t  eocd_pos_hint;         /* pos to check for the record before searching */
+
     int64_t  cd_start_pos;          /* pos of the first file in the central dir stream */
     int64_t  cd_current_pos;        /* pos of the current file in the central dir */
     int64_t  cd_offset;             /* offset of start of central directory */
@@ -108,8 +153,23 @@ typedef struct mz_zip_s {
     uint8_t  entry_scanned;         /* entry header information read ok */
     uint8_t  entry_opened;          /* entry is open for read/write */
     uint8_t  entry_raw;             /* entry opened with raw mode */
+    uint8_t  entry_dict;            /* entry compressed with the shared dictionary */
+    uint8_t  entry_seeked;          /* entry read from an access point, crc can not be verified */
+    int64_t  entry_data_pos;        /* pos of the entry data following the local header */
     uint32_t entry_crc32;           /* entry crc32  */
 
+    uint8_t  *dict;                 /* shared compression dictionary */
+    int32_t  dict_size;
+    uint32_t dict_id;               /* crc32 of the dictionary */
+    uint32_t dict_disk_number;      /* disk of the dictionary record */
+    int64_t  dict_disk_offset;      /* offset of the dictionary record */
+    void     *dict_prepared;        /* dictionary digested by the codec, reused across entries */
+    int32_t  dict_prepared_mode;
+    int16_t  dict_prepared_level;
+    mz_zip_dict_record
+             dict_records[MZ_ZIP_DICT_RECORD_COUNT];  /* dictionaries already written */
+    int32_t  dict_record_count;
+
     uint64_t number_entry;
 
     uint16_t version_madeby;
@@ -207,6 +267,7 @@ static int32_t mz_zip_entry_read_header(void *stream, uint8_t local, mz_zip_file
     int64_t linkname_pos = 0;
     int64_t saved_pos = 0;
     int32_t err = MZ_OK;
+    int32_t dict_method = -1;
     char *linkname = NULL;
 
 
@@ -423,6 +484,16 @@ static int32_t mz_zip_entry_read_header(void *stream, uint8_t local, mz_zip_file
                 }
             }
 #endif
+            /* Read actual compression method of entries using a shared dictionary */
+            else if ((field_type == MZ_ZIP_EXTENSION_DICT) && (field_length >= MZ_ZIP_DICT_FIELD_LENGTH)) {
+                err = mz_stream_seek(file_extra_stream, MZ_ZIP_DICT_FIELD_LENGTH - 2, MZ_SEEK_CUR);
+                if (err == MZ_OK)
+                    err = mz_stream_read_uint16(file_extra_stream, &value16);
+                if (err == MZ_OK)
+                    dict_method = value16;
+                if ((err == MZ_OK) && (field_length > MZ_ZIP_DICT_FIELD_LENGTH))
+                    err = mz_stream_seek(file_extra_stream, field_length - MZ_ZIP_DICT_FIELD_LENGTH, MZ_SEEK_CUR);
+            }
             else if (field_length > 0) {
                 err = mz_stream_seek(file_extra_stream, field_length, MZ_SEEK_CUR);
             }
@@ -431,6 +502,10 @@ static int32_t mz_zip_entry_read_header(void *stream, uint8_t local, mz_zip_file
         }
     }
 
+    /* Dictionary field may come before the aes field which also names the method */
+    if ((file_info->compression_method == MZ_COMPRESS_METHOD_DICT) && (dict_method >= 0))
+        file_info->compression_method = (uint16_t)dict_method;
+
     /* Get pointers to variable length data */
     mz_stream_mem_get_buffer(file_extra_stream, (const void **)&file_info->filename);
     mz_stream_mem_get_buffer_at(file_extra_stream, extrafield_pos, (const void **)&file_info->extrafield);
@@ -460,6 +535,7 @@ static int32_t mz_zip_entry_read_header(void *stream, uint8_t local, mz_zip_file
             file_info->filename_size, file_info->extrafield_size, file_info->comment_size);
     }
 
+    MZ_TRACE3(header__read, local, file_info->filename, err);
     return err;
 }
 
@@ -545,6 +621,7 @@ static int32_t mz_zip_entry_write_header(void *stream, uint8_t local, mz_zip_fil
     uint16_t filename_length = 0;
     uint16_t linkname_size = 0;
     uint16_t version_needed = 0;
+    uint16_t compression_method = 0;
     int32_t comment_size = 0;
     int32_t err = MZ_OK;
     int32_t err_mem = MZ_OK;
@@ -562,6 +639,13 @@ static int32_t mz_zip_entry_write_header(void *stream, uint8_t local, mz_zip_fil
     if ((local) && (file_info->flag & MZ_ZIP_FLAG_MASK_LOCAL_INFO))
         mask = 1;
 
+    /* Entries using a shared dictionary keep their actual method in the dictionary field,
+       so readers without dictionary support refuse them */
+    compression_method = file_info->compression_method;
+    if (mz_zip_extrafield_contains(file_info->extrafield, file_info->extrafield_size,
+        MZ_ZIP_EXTENSION_DICT, NULL) == MZ_OK)
+        compression_method = MZ_COMPRESS_METHOD_DICT;
+
     /* Calculate extra field sizes */
     if (file_info->uncompressed_size >= UINT32_MAX)
         field_length_zip64 += 8;
@@ -674,7 +758,7 @@ static int32_t mz_zip_entry_write_header(void *stream, uint8_t local, mz_zip_fil
             err = mz_stream_write_uint16(stream, MZ_COMPRESS_METHOD_AES);
         else
 #endif
-            err = mz_stream_write_uint16(stream, file_info->compression_method);
+            err = mz_stream_write_uint16(stream, compression_method);
     }
     if (err == MZ_OK) {
         if (file_info->modified_date != 0 && !mask)
@@ -829,7 +913,7 @@ static int32_t mz_zip_entry_write_header(void *stream, uint8_t local, mz_zip_fil
         if (err == MZ_OK)
             err = mz_stream_write_uint8(stream, file_info->aes_encryption_mode);
         if (err == MZ_OK)
-            err = mz_stream_write_uint16(stream, file_info->compression_method);
+            err = mz_stream_write_uint16(stream, compression_method);
     }
 #endif
     if ((err == MZ_OK) && (!local) && (file_info->comment != NULL)) {
@@ -883,9 +967,24 @@ static int32_t mz_zip_read_cd(void *handle) {
     if (zip == NULL)
         return MZ_PARAM_ERROR;
 
-    /* Read and cache central directory records */
-    err = mz_zip_search_eocd(zip->stream, &eocd_pos);
+    MZ_TRACE0(cd__read__start);
+
+    /* Read and cache central directory records, trying where the record was last time first */
+    err = MZ_EXIST_ERROR;
+    if (zip->eocd_pos_hint > 0) {
+        eocd_pos = zip->eocd_pos_hint;
+        err = mz_stream_seek(zip->stream, eocd_pos, MZ_SEEK_SET);
+        if (err == MZ_OK)
+            err = mz_stream_read_uint32(zip->stream, &value32);
+        if ((err == MZ_OK) && (value32 != MZ_ZIP_MAGIC_ENDHEADER))
+            err = MZ_EXIST_ERROR;
+        if (err == MZ_OK)
+            err = mz_stream_seek(zip->stream, eocd_pos, MZ_SEEK_SET);
+    }
+    if (err != MZ_OK)
+        err = mz_zip_search_eocd(zip->stream, &eocd_pos);
     if (err == MZ_OK) {
+        zip->eocd_pos = eocd_pos;
         /* The signature, already checked */
         err = mz_stream_read_uint32(zip->stream, &value32);
         /* Number of this disk */
@@ -919,7 +1018,7 @@ static int32_t mz_zip_read_cd(void *handle) {
         if (err == MZ_OK)
             err = mz_stream_read_uint16(zip->stream, &comment_size);
         if ((err == MZ_OK) && (comment_size > 0)) {
-            zip->comment = (char *)MZ_ALLOC(comment_size + 1);
+            zip->comment = (char *)mz_alloc_malloc(zip->alloc, comment_size + 1);
             if (zip->comment != NULL) {
                 comment_read = mz_stream_read(zip->stream, zip->comment, comment_size);
                 /* Don't fail if incorrect comment length read, not critical */
@@ -1018,6 +1117,7 @@ static int32_t mz_zip_read_cd(void *handle) {
         }
     }
 
+    MZ_TRACE4(cd__read__done, zip->number_entry, zip->cd_offset, zip->cd_size, err);
     return err;
 }
 
@@ -1156,12 +1256,202 @@ static int32_t mz_zip_write_cd(void *handle) {
     return err;
 }
 
-static int32_t mz_zip_recover_cd(void *handle) {
-    mz_zip *zip = (mz_zip *)handle;
+static int32_t mz_zip_dict_read_extrafield(const mz_zip_file *file_info, uint32_t *dict_id, int32_t *dict_size,
+    uint32_t *disk_number, int64_t *disk_offset) {
+    void *file_extra_stream = NULL;
+    uint32_t value32 = 0;
+    uint16_t field_length = 0;
+    int32_t err = MZ_OK;
+
+    if (file_info->extrafield == NULL || file_info->extrafield_size == 0)
+        return MZ_EXIST_ERROR;
+
+    mz_stream_mem_create(&file_extra_stream);
+    mz_stream_mem_set_buffer(file_extra_stream, (void *)file_info->extrafield, file_info->extrafield_size);
+
+    err = mz_zip_extrafield_find(file_extra_stream, MZ_ZIP_EXTENSION_DICT, &field_length);
+    if ((err == MZ_OK) && (field_length < MZ_ZIP_DICT_FIELD_LENGTH))
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK)
+        err = mz_stream_read_uint32(file_extra_stream, dict_id);
+    if (err == MZ_OK) {
+        err = mz_stream_read_uint32(file_extra_stream, &value32);
+        if ((err == MZ_OK) && ((value32 == 0) || (value32 > MZ_ZIP_DICT_MAX_SIZE)))
+            err = MZ_FORMAT_ERROR;
+        *dict_size = (int32_t)value32;
+    }
+    if (err == MZ_OK)
+        err = mz_stream_read_uint32(file_extra_stream, disk_number);
+    if (err == MZ_OK)
+        err = mz_stream_read_int64(file_extra_stream, disk_offset);
+
+    mz_stream_mem_delete(&file_extra_stream);
+    return err;
+}
+
+static int32_t mz_zip_recover_is_dict_record(const mz_zip_file *file_info) {
+    int64_t disk_offset = 0;
+    uint32_t disk_number = 0;
+    uint32_t dict_id = 0;
+    int32_t dict_size = 0;
+
+    /* Dictionary record describes itself so it can be told apart from an entry of the same name */
+    if (file_info->filename == NULL || strcmp(file_info->filename, MZ_ZIP_DICT_FILENAME) != 0)
+        return MZ_EXIST_ERROR;
+    if (mz_zip_dict_read_extrafield(file_info, &dict_id, &dict_size, &disk_number, &disk_offset) != MZ_OK)
+        return MZ_EXIST_ERROR;
+    if ((dict_id != file_info->crc) || (dict_size != file_info->uncompressed_size) ||
+        (disk_number != file_info->disk_number) || (disk_offset != file_info->disk_offset))
+        return MZ_EXIST_ERROR;
+    return MZ_OK;
+}
+
+typedef struct mz_zip_recover_list_s {
+    int64_t *pos;
+    int32_t count;
+    int32_t capacity;
+} mz_zip_recover_list;
+
+static int32_t mz_zip_recover_list_add(mz_zip_recover_list *list, int64_t pos) {
+    int64_t *positions = NULL;
+    int32_t capacity = 0;
+
+    if (list->count == list->capacity) {
+        if (list->capacity > INT32_MAX / 2)
+            return MZ_MEM_ERROR;
+        capacity = (list->capacity == 0) ? 64 : list->capacity * 2;
+        positions = (int64_t *)MZ_ALLOC(capacity * sizeof(int64_t));
+        if (positions == NULL)
+            return MZ_MEM_ERROR;
+        if (list->pos != NULL)
+            memcpy(positions, list->pos, list->count * sizeof(int64_t));
+        MZ_FREE(list->pos);
+        list->pos = positions;
+        list->capacity = capacity;
+    }
+    list->pos[list->count] = pos;
+    list->count += 1;
+    return MZ_OK;
+}
+
+static int32_t mz_zip_recover_list_find(mz_zip_recover_list *list, int64_t pos) {
+    /* Index of the first position at or after pos, positions are added in ascending order */
+    int32_t low = 0;
+    int32_t high = list->count;
+    int32_t mid = 0;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (list->pos[mid] < pos)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+static void mz_zip_recover_report(mz_zip *zip, mz_zip_recover_progress *progress, uint64_t start_time, uint8_t finished) {
+    uint64_t elapsed_ns = 0;
+
+    if (zip->recover_cb == NULL)
+        return;
+
+    elapsed_ns = mz_os_ns_time() - start_time;
+    if (!finished && elapsed_ns - progress->elapsed_ns < MZ_ZIP_RECOVER_REPORT_NS)
+        return;
+
+    progress->elapsed_ns = elapsed_ns;
+    progress->finished = finished;
+    if (elapsed_ns > 0)
+        progress->bytes_per_sec = (uint64_t)((double)progress->position * 1000000000.0 / elapsed_ns);
+
+    zip->recover_cb(zip, zip->recover_userdata, progress);
+}
+
+static int32_t mz_zip_recover_disk_straddle(mz_zip *zip, const uint8_t *magic, int64_t disk_number,
+    int64_t next_disk, int64_t start_pos, int64_t *position) {
+    uint8_t buf[6];
+    int64_t end_pos = 0;
+    int32_t tail_size = 3;
+    int32_t head_size = 0;
+    int32_t i = 0;
+
+    /* Magic can be cut in two by the end of a disk, the last bytes are joined with the start of the next disk */
+    mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, disk_number);
+    if (mz_stream_seek(zip->stream, 0, MZ_SEEK_END) != MZ_OK)
+        return MZ_EXIST_ERROR;
+    end_pos = mz_stream_tell(zip->stream);
+    if (end_pos - start_pos < tail_size)
+        tail_size = (int32_t)(end_pos - start_pos);
+    if (tail_size <= 0)
+        return MZ_EXIST_ERROR;
+    if (mz_stream_seek(zip->stream, end_pos - tail_size, MZ_SEEK_SET) != MZ_OK)
+        return MZ_EXIST_ERROR;
+    if (mz_stream_read(zip->stream, buf, tail_size) != tail_size)
+        return MZ_EXIST_ERROR;
+
+    mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, next_disk);
+    if (mz_stream_seek(zip->stream, 0, MZ_SEEK_SET) != MZ_OK)
+        return MZ_EXIST_ERROR;
+    head_size = mz_stream_read(zip->stream, buf + tail_size, 3);
+    if (head_size < 0)
+        return MZ_EXIST_ERROR;
+
+    for (i = 0; i < tail_size && tail_size + head_size - i >= 4; i += 1) {
+        if (memcmp(buf + i, magic, 4) != 0)
+            continue;
+        *position = end_pos - tail_size + i;
+        mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, disk_number);
+        return mz_stream_seek(zip->stream, *position, MZ_SEEK_SET);
+    }
+
+    return MZ_EXIST_ERROR;
+}
+
+static int32_t mz_zip_recover_disk_find(mz_zip *zip, const uint8_t *magic, int64_t *position,
+    uint32_t *disk_number_with_cd) {
+    int64_t disk_number = 0;
+    int64_t next_disk = 0;
+    int64_t start_pos = 0;
+    int64_t end_pos = 0;
+    int32_t err = MZ_OK;
+
+    /* Each disk is searched on its own so the position found is relative to the disk it is on */
+    for (;;) {
+        start_pos = mz_stream_tell(zip->stream);
+        if (start_pos < 0)
+            return MZ_EXIST_ERROR;
+        err = mz_stream_seek(zip->stream, 0, MZ_SEEK_END);
+        if (err == MZ_OK)
+            end_pos = mz_stream_tell(zip->stream);
+        if (err == MZ_OK)
+            err = mz_stream_seek(zip->stream, start_pos, MZ_SEEK_SET);
+        if (err == MZ_OK)
+            err = mz_stream_find(zip->stream, (const void *)magic, 4, end_pos - start_pos, position);
+        if (err != MZ_EXIST_ERROR)
+            return err;
+
+        /* Continue on the next disk, the disk with the central directory comes last */
+        if (mz_stream_get_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, &disk_number) != MZ_OK ||
+            disk_number < 0)
+            return MZ_EXIST_ERROR;
+        next_disk = disk_number + 1;
+        mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, next_disk);
+        if (mz_stream_seek(zip->stream, 0, MZ_SEEK_SET) != MZ_OK) {
+            *disk_number_with_cd = (uint32_t)next_disk;
+            next_disk = -1;
+        }
+        if (mz_zip_recover_disk_straddle(zip, magic, disk_number, next_disk, start_pos, position) == MZ_OK)
+            return MZ_OK;
+        mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, next_disk);
+        if (mz_stream_seek(zip->stream, 0, MZ_SEEK_SET) != MZ_OK)
+            return MZ_EXIST_ERROR;
+    }
+}
+
+static int32_t mz_zip_recover_cd_disks(mz_zip *zip, void *cd_mem_stream, void *local_file_info_stream,
+    mz_zip_recover_progress *progress, uint64_t start_time, uint32_t *disk_number_with_cd) {
     mz_zip_file local_file_info;
-    void *local_file_info_stream = NULL;
-    void *cd_mem_stream = NULL;
-    uint64_t number_entry = 0;
     int64_t descriptor_pos = 0;
     int64_t next_header_pos = 0;
     int64_t disk_offset = 0;
@@ -1173,35 +1463,16 @@ static int32_t mz_zip_recover_cd(void *handle) {
     uint8_t descriptor_magic[4] = MZ_ZIP_MAGIC_DATADESCRIPTORU8;
     uint8_t local_header_magic[4] = MZ_ZIP_MAGIC_LOCALHEADERU8;
     uint8_t central_header_magic[4] = MZ_ZIP_MAGIC_CENTRALHEADERU8;
+    int64_t compressed_disk = 0;
+    int64_t next_disk = 0;
+    int64_t descriptor_disk = 0;
     uint32_t crc32 = 0;
-    int32_t disk_number_with_cd = 0;
     int32_t err = MZ_OK;
     uint8_t zip64 = 0;
     uint8_t eof = 0;
 
 
-    mz_zip_print("Zip - Recover - Start\n");
-
-    mz_zip_get_cd_mem_stream(handle, &cd_mem_stream);
-
-    /* Determine if we are on a split disk or not */
-    mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, 0);
-    if (mz_stream_tell(zip->stream) < 0) {
-        mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, -1);
-        mz_stream_seek(zip->stream, 0, MZ_SEEK_SET);
-    } else
-        disk_number_with_cd = 1;
-
-    if (mz_stream_is_open(cd_mem_stream) != MZ_OK)
-        err = mz_stream_mem_open(cd_mem_stream, NULL, MZ_OPEN_MODE_CREATE);
-
-    mz_stream_mem_create(&local_file_info_stream);
-    mz_stream_mem_open(local_file_info_stream, NULL, MZ_OPEN_MODE_CREATE);
-
-    if (err == MZ_OK) {
-        err = mz_stream_find(zip->stream, (const void *)local_header_magic, sizeof(local_header_magic),
-                INT64_MAX, &next_header_pos);
-    }
+    err = mz_zip_recover_disk_find(zip, local_header_magic, &next_header_pos, disk_number_with_cd);
 
     while (err == MZ_OK && !eof) {
         /* Get current offset and disk number for central dir record */
@@ -1214,12 +1485,15 @@ static int32_t mz_zip_recover_cd(void *handle) {
         if (err != MZ_OK)
             break;
 
+        /* Disk with the central directory is numbered after the last disk part */
         local_file_info.disk_offset = disk_offset;
-        if (disk_number < 0)
-            disk_number = 0;
-        local_file_info.disk_number = (uint32_t)disk_number;
+        if (disk_number >= 0)
+            *disk_number_with_cd = (uint32_t)disk_number + 1;
+        local_file_info.disk_number = (disk_number < 0) ? *disk_number_with_cd : (uint32_t)disk_number;
 
+        /* Header may have continued onto the next disk */
         compressed_pos = mz_stream_tell(zip->stream);
+        mz_stream_get_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, &compressed_disk);
 
         if ((err == MZ_OK) && (local_file_info.compressed_size > 0)) {
             mz_stream_seek(zip->stream, local_file_info.compressed_size, MZ_SEEK_CUR);
@@ -1227,15 +1501,14 @@ static int32_t mz_zip_recover_cd(void *handle) {
 
         for (;;) {
             /* Search for the next local header */
-            err = mz_stream_find(zip->stream, (const void *)local_header_magic, sizeof(local_header_magic),
-                    INT64_MAX, &next_header_pos);
+            err = mz_zip_recover_disk_find(zip, local_header_magic, &next_header_pos, disk_number_with_cd);
 
             if (err == MZ_EXIST_ERROR) {
+                mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, compressed_disk);
                 mz_stream_seek(zip->stream, compressed_pos, MZ_SEEK_SET);
 
                 /* Search for central dir if no local header found */
-                err = mz_stream_find(zip->stream, (const void *)central_header_magic, sizeof(central_header_magic),
-                    INT64_MAX, &next_header_pos);
+                err = mz_zip_recover_disk_find(zip, central_header_magic, &next_header_pos, disk_number_with_cd);
 
                 if (err == MZ_EXIST_ERROR) {
                     /* Get end of stream if no central header found */
@@ -1246,10 +1519,23 @@ static int32_t mz_zip_recover_cd(void *handle) {
                 eof = 1;
             }
 
+            mz_stream_get_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, &next_disk);
+
             if (local_file_info.flag & MZ_ZIP_FLAG_DATA_DESCRIPTOR || local_file_info.compressed_size == 0) {
                 /* Search backwards for the descriptor, seeking too far back will be incorrect if compressed size is small */
                 err = mz_stream_find_reverse(zip->stream, (const void *)descriptor_magic, sizeof(descriptor_magic),
                             MZ_ZIP_SIZE_MAX_DATA_DESCRIPTOR, &descriptor_pos);
+                if ((err != MZ_OK) && (next_disk != compressed_disk) && (next_header_pos < MZ_ZIP_SIZE_MAX_DATA_DESCRIPTOR)) {
+                    /* Descriptor is at the end of the disk before the one the next header starts */
+                    descriptor_disk = (next_disk < 0) ? (int64_t)*disk_number_with_cd - 1 : next_disk - 1;
+                    mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, descriptor_disk);
+                    if (mz_stream_seek(zip->stream, 0, MZ_SEEK_END) == MZ_OK)
+                        err = mz_stream_find_reverse(zip->stream, (const void *)descriptor_magic,
+                            sizeof(descriptor_magic), MZ_ZIP_SIZE_MAX_DATA_DESCRIPTOR, &descriptor_pos);
+                    if (err != MZ_OK)
+                        err = mz_zip_recover_disk_straddle(zip, descriptor_magic, descriptor_disk, next_disk, 0,
+                            &descriptor_pos);
+                }
                 if (err == MZ_OK) {
                     if (mz_zip_extrafield_contains(local_file_info.extrafield,
                         local_file_info.extrafield_size, MZ_ZIP_EXTENSION_ZIP64, NULL) == MZ_OK)
@@ -1273,6 +1559,7 @@ static int32_t mz_zip_recover_cd(void *handle) {
                 } else if (local_file_info.flag & MZ_ZIP_FLAG_DATA_DESCRIPTOR) {
                     /* Wrong local file entry found, keep searching */
                     next_header_pos += 1;
+                    mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, next_disk);
                     mz_stream_seek(zip->stream, next_header_pos, MZ_SEEK_SET);
                     continue;
                 }
@@ -1293,179 +1580,956 @@ static int32_t mz_zip_recover_cd(void *handle) {
             }
         }
 
-        mz_zip_print("Zip - Recover - Entry %s (csize %" PRId64 " usize %" PRId64 " flags 0x%" PRIx16 ")\n",
-            local_file_info.filename, local_file_info.compressed_size, local_file_info.uncompressed_size,
-            local_file_info.flag);
+        if (mz_zip_recover_is_dict_record(&local_file_info) == MZ_OK) {
+            /* Dictionary record is deliberately left out of the central directory */
+            mz_zip_print("Zip - Recover - Dictionary (offset %" PRId64 ")\n", local_file_info.disk_offset);
+        } else {
+            mz_zip_print("Zip - Recover - Entry %s (csize %" PRId64 " usize %" PRId64 " flags 0x%" PRIx16 ")\n",
+                local_file_info.filename, local_file_info.compressed_size, local_file_info.uncompressed_size,
+                local_file_info.flag);
 
-        /* Rewrite central dir with local headers and offsets */
-        err = mz_zip_entry_write_header(cd_mem_stream, 0, &local_file_info);
-        if (err == MZ_OK)
-            number_entry += 1;
+            /* Rewrite central dir with local headers and offsets */
+            err = mz_zip_entry_write_header(cd_mem_stream, 0, &local_file_info);
+            if (err == MZ_OK)
+                progress->entries += 1;
+        }
 
+        mz_zip_recover_report(zip, progress, start_time, 0);
+
+        mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, next_disk);
         err = mz_stream_seek(zip->stream, next_header_pos, MZ_SEEK_SET);
     }
 
-    mz_stream_mem_delete(&local_file_info_stream);
-
-    mz_zip_print("Zip - Recover - Complete (cddisk %" PRId32 " entries %" PRId64 ")\n",
-        disk_number_with_cd, number_entry);
-
-    if (number_entry == 0)
-        return err;
-
-    /* Set new upper seek boundary for central dir mem stream */
-    disk_offset = mz_stream_tell(cd_mem_stream);
-    mz_stream_mem_set_buffer_limit(cd_mem_stream, (int32_t)disk_offset);
-
-    /* Set new central directory info */
-    mz_zip_set_cd_stream(handle, 0, cd_mem_stream);
-    mz_zip_set_number_entry(handle, number_entry);
-    mz_zip_set_disk_number_with_cd(handle, disk_number_with_cd);
-
-    return MZ_OK;
+    return err;
 }
 
-void *mz_zip_create(void **handle) {
-    mz_zip *zip = NULL;
-
-    zip = (mz_zip *)MZ_ALLOC(sizeof(mz_zip));
-    if (zip != NULL) {
-        memset(zip, 0, sizeof(mz_zip));
-        zip->data_descriptor = 1;
-    }
-    if (handle != NULL)
-        *handle = zip;
-
-    return zip;
-}
+static int32_t mz_zip_recover_scan_buf(const uint8_t *buf, int32_t buf_size, int32_t scan_size, int64_t buf_pos,
+    mz_zip_recover_list *local, mz_zip_recover_list *descriptor, mz_zip_recover_list *central) {
+    const uint8_t *ptr = buf;
+    uint32_t magic = 0;
+    int32_t i = 0;
+    int32_t err = MZ_OK;
 
-void mz_zip_delete(void **handle) {
-    mz_zip *zip = NULL;
-    if (handle == NULL)
-        return;
-    zip = (mz_zip *)*handle;
-    if (zip != NULL) {
-        MZ_FREE(zip);
+    /* Signatures starting in the first scan size bytes are collected, the rest of the buffer
+       is only there to complete a signature that starts near the end */
+    while ((ptr = (const uint8_t *)memchr(ptr, 'P', scan_size - (int32_t)(ptr - buf))) != NULL) {
+        i = (int32_t)(ptr - buf);
+        if (i + 4 > buf_size)
+            break;
+        ptr += 1;
+        if (buf[i + 1] != 'K')
+            continue;
+
+        magic = (uint32_t)buf[i] | ((uint32_t)buf[i + 1] << 8) |
+            ((uint32_t)buf[i + 2] << 16) | ((uint32_t)buf[i + 3] << 24);
+
+        if (magic == MZ_ZIP_MAGIC_LOCALHEADER)
+            err = mz_zip_recover_list_add(local, buf_pos + i);
+        else if (magic == MZ_ZIP_MAGIC_DATADESCRIPTOR)
+            err = mz_zip_recover_list_add(descriptor, buf_pos + i);
+        else if (magic == MZ_ZIP_MAGIC_CENTRALHEADER)
+            err = mz_zip_recover_list_add(central, buf_pos + i);
+        if (err != MZ_OK)
+            break;
     }
-    *handle = NULL;
+    return err;
 }
 
-int32_t mz_zip_open(void *handle, void *stream, int32_t mode) {
-    mz_zip *zip = (mz_zip *)handle;
+static int32_t mz_zip_recover_cd_scan(mz_zip *zip, mz_zip_recover_list *local, mz_zip_recover_list *descriptor,
+    mz_zip_recover_list *central, mz_zip_recover_progress *progress, uint64_t start_time) {
+    uint8_t *buf = NULL;
+    int64_t buf_pos = 0;
+    int32_t buf_size = 0;
+    int32_t carry = 0;
+    int32_t read = 0;
     int32_t err = MZ_OK;
 
+    /* Signatures found in each chunk are collected in file order, the last bytes of a chunk
+       are carried over so a signature split between two chunks is not missed */
+    buf = (uint8_t *)MZ_ALLOC(MZ_ZIP_RECOVER_CHUNK_SIZE + 3);
+    if (buf == NULL)
+        return MZ_MEM_ERROR;
 
-    if (zip == NULL)
-        return MZ_PARAM_ERROR;
-
-    mz_zip_print("Zip - Open\n");
+    while (err == MZ_OK) {
+        read = mz_stream_read(zip->stream, buf + carry, MZ_ZIP_RECOVER_CHUNK_SIZE);
+        if (read < 0)
+            err = MZ_READ_ERROR;
+        if (read <= 0)
+            break;
 
-    zip->stream = stream;
+        buf_size = carry + read;
+        err = mz_zip_recover_scan_buf(buf, buf_size, buf_size, buf_pos, local, descriptor, central);
 
-    mz_stream_mem_create(&zip->cd_mem_stream);
+        carry = (buf_size < 3) ? buf_size : 3;
+        memmove(buf, buf + buf_size - carry, carry);
+        buf_pos += buf_size - carry;
 
-    if (mode & MZ_OPEN_MODE_WRITE) {
-        mz_stream_mem_open(zip->cd_mem_stream, NULL, MZ_OPEN_MODE_CREATE);
-        zip->cd_stream = zip->cd_mem_stream;
-    } else {
-        zip->cd_stream = stream;
+        progress->position = buf_pos + carry;
+        mz_zip_recover_report(zip, progress, start_time, 0);
     }
 
-    if ((mode & MZ_OPEN_MODE_READ) || (mode & MZ_OPEN_MODE_APPEND)) {
-        if ((mode & MZ_OPEN_MODE_CREATE) == 0) {
-            err = mz_zip_read_cd(zip);
-            if (err != MZ_OK) {
-                mz_zip_print("Zip - Error detected reading cd (%" PRId32 ")\n", err);
-                if (zip->recover && mz_zip_recover_cd(zip) == MZ_OK)
-                    err = MZ_OK;
-            }
-        }
+    MZ_FREE(buf);
+    return err;
+}
 
-        if ((err == MZ_OK) && (mode & MZ_OPEN_MODE_APPEND)) {
-            if (zip->cd_size > 0) {
-                /* Store central directory in memory */
-                err = mz_stream_seek(zip->stream, zip->cd_offset, MZ_SEEK_SET);
-                if (err == MZ_OK)
-                    err = mz_stream_copy(zip->cd_mem_stream, zip->stream, (int32_t)zip->cd_size);
-                if (err == MZ_OK)
-                    err = mz_stream_seek(zip->stream, zip->cd_offset, MZ_SEEK_SET);
-            } else {
-                if (zip->cd_signature == MZ_ZIP_MAGIC_ENDHEADER) {
-                    /* If tiny zip then overwrite end header */
-                    err = mz_stream_seek(zip->stream, zip->cd_offset, MZ_SEEK_SET);
-                } else {
-                    /* If no central directory, append new zip to end of file */
-                    err = mz_stream_seek(zip->stream, 0, MZ_SEEK_END);
-                }
-            }
+typedef struct mz_zip_recover_scan_s {
+    mz_zip                  *zip;
+    mz_zip_recover_progress *progress;
+    uint64_t                start_time;
+    int64_t                 part_size;      /* bytes scanned by each thread, a multiple of the chunk size */
+    int32_t                 thread_count;
+    mz_zip_recover_list     *lists;         /* local, descriptor and central lists of each thread */
+    int32_t                 *errors;
+} mz_zip_recover_scan;
+
+static void mz_zip_recover_scan_thread(void *userdata, int32_t index) {
+    mz_zip_recover_scan *scan = (mz_zip_recover_scan *)userdata;
+    mz_zip_recover_list *lists = &scan->lists[index * 3];
+    uint8_t *buf = NULL;
+    int64_t total = scan->progress->total;
+    int64_t pos = index * scan->part_size;
+    int64_t end = pos + scan->part_size;
+    int64_t size = 0;
+    int32_t scan_size = 0;
+    int32_t read = 0;
+    int32_t err = MZ_OK;
 
-            if (zip->disk_number_with_cd > 0) {
-                /* Move to last disk to begin appending */
-                mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, zip->disk_number_with_cd - 1);
-            }
-        } else {
-            zip->cd_start_pos = zip->cd_offset;
-        }
-    }
+    if (end > total)
+        end = total;
+
+    buf = (uint8_t *)MZ_ALLOC(MZ_ZIP_RECOVER_CHUNK_SIZE + 3);
+    if (buf == NULL)
+        err = MZ_MEM_ERROR;
+
+    /* Reads at an offset leave the stream position alone so every thread can read the same stream,
+       each chunk reads 3 bytes past its end to find a signature that continues into the next one */
+    while (err == MZ_OK && pos < end) {
+        size = total - pos;
+        if (size > MZ_ZIP_RECOVER_CHUNK_SIZE + 3)
+            size = MZ_ZIP_RECOVER_CHUNK_SIZE + 3;
+        read = mz_stream_read_at(scan->zip->stream, pos, buf, (int32_t)size);
+        if (read < 0)
+            err = MZ_READ_ERROR;
+        if (read <= 0)
+            break;
 
-    if (err != MZ_OK) {
-        mz_zip_close(zip);
-        return err;
+        scan_size = (end - pos < MZ_ZIP_RECOVER_CHUNK_SIZE) ? (int32_t)(end - pos) : MZ_ZIP_RECOVER_CHUNK_SIZE;
+        if (scan_size > read)
+            scan_size = read;
+        err = mz_zip_recover_scan_buf(buf, read, scan_size, pos, &lists[0], &lists[1], &lists[2]);
+        pos += scan_size;
+
+        /* Only the calling thread reports, parts are the same size so its share stands for the others */
+        if (index == 0) {
+            scan->progress->position = pos * scan->thread_count;
+            if (scan->progress->position > total)
+                scan->progress->position = total;
+            mz_zip_recover_report(scan->zip, scan->progress, scan->start_time, 0);
+        }
     }
 
-    /* Memory streams used to store variable length file info data */
-    mz_stream_mem_create(&zip->file_info_stream);
-    mz_stream_mem_open(zip->file_info_stream, NULL, MZ_OPEN_MODE_CREATE);
-
-    mz_stream_mem_create(&zip->local_file_info_stream);
-    mz_stream_mem_open(zip->local_file_info_stream, NULL, MZ_OPEN_MODE_CREATE);
-
-    zip->open_mode = mode;
-
-    return err;
+    MZ_FREE(buf);
+    scan->errors[index] = err;
 }
 
-int32_t mz_zip_close(void *handle) {
-    mz_zip *zip = (mz_zip *)handle;
+static int32_t mz_zip_recover_cd_scan_threaded(mz_zip *zip, mz_zip_recover_list *local,
+    mz_zip_recover_list *descriptor, mz_zip_recover_list *central, mz_zip_recover_progress *progress,
+    uint64_t start_time) {
+    mz_zip_recover_scan scan;
+    mz_zip_recover_list *merged[3];
+    int64_t chunk_count = 0;
     int32_t err = MZ_OK;
+    int32_t i = 0;
+    int32_t k = 0;
+    int32_t p = 0;
+    uint8_t byte = 0;
 
-    if (zip == NULL)
-        return MZ_PARAM_ERROR;
-
-    mz_zip_print("Zip - Close\n");
-
-    if (mz_zip_entry_is_open(handle) == MZ_OK)
-        err = mz_zip_entry_close(handle);
+    /* Threads read the stream at offsets so the stream must support it */
+    if (mz_stream_read_at(zip->stream, 0, &byte, 1) != 1)
+        return MZ_SUPPORT_ERROR;
 
-    if ((err == MZ_OK) && (zip->open_mode & MZ_OPEN_MODE_WRITE))
-        err = mz_zip_write_cd(handle);
+    chunk_count = (progress->total + MZ_ZIP_RECOVER_CHUNK_SIZE - 1) / MZ_ZIP_RECOVER_CHUNK_SIZE;
+    memset(&scan, 0, sizeof(scan));
+    scan.zip = zip;
+    scan.progress = progress;
+    scan.start_time = start_time;
+    scan.thread_count = zip->recover_threads;
+    if (scan.thread_count > chunk_count)
+        scan.thread_count = (int32_t)chunk_count;
+    if (scan.thread_count <= 1)
+        return MZ_SUPPORT_ERROR;
+    scan.part_size = ((chunk_count + scan.thread_count - 1) / scan.thread_count) * MZ_ZIP_RECOVER_CHUNK_SIZE;
 
-    if (zip->cd_mem_stream != NULL) {
-        mz_stream_close(zip->cd_mem_stream);
-        mz_stream_delete(&zip->cd_mem_stream);
-    }
+    scan.lists = (mz_zip_recover_list *)MZ_ALLOC(scan.thread_count * 3 * sizeof(mz_zip_recover_list));
+    scan.errors = (int32_t *)MZ_ALLOC(scan.thread_count * sizeof(int32_t));
+    if (scan.lists == NULL || scan.errors == NULL)
+        err = MZ_MEM_ERROR;
 
-    if (zip->file_info_stream != NULL) {
-        mz_stream_mem_close(zip->file_info_stream);
-        mz_stream_mem_delete(&zip->file_info_stream);
+    if (err == MZ_OK) {
+        memset(scan.lists, 0, scan.thread_count * 3 * sizeof(mz_zip_recover_list));
+        memset(scan.errors, 0, scan.thread_count * sizeof(int32_t));
+        err = mz_os_run_threads(scan.thread_count, mz_zip_recover_scan_thread, &scan);
     }
-    if (zip->local_file_info_stream != NULL) {
-        mz_stream_mem_close(zip->local_file_info_stream);
-        mz_stream_mem_delete(&zip->local_file_info_stream);
+    for (i = 0; err == MZ_OK && i < scan.thread_count; i += 1)
+        err = scan.errors[i];
+
+    /* Parts are in file order so joining the lists of each thread keeps the positions sorted */
+    merged[0] = local;
+    merged[1] = descriptor;
+    merged[2] = central;
+    for (k = 0; err == MZ_OK && k < 3; k += 1) {
+        for (i = 0; err == MZ_OK && i < scan.thread_count; i += 1) {
+            for (p = 0; err == MZ_OK && p < scan.lists[i * 3 + k].count; p += 1)
+                err = mz_zip_recover_list_add(merged[k], scan.lists[i * 3 + k].pos[p]);
+        }
     }
 
-    if (zip->comment) {
-        MZ_FREE(zip->comment);
-        zip->comment = NULL;
+    if (scan.lists != NULL) {
+        for (i = 0; i < scan.thread_count * 3; i += 1)
+            MZ_FREE(scan.lists[i].pos);
     }
+    MZ_FREE(scan.lists);
+    MZ_FREE(scan.errors);
 
-    zip->stream = NULL;
-    zip->cd_stream = NULL;
-
+    if (err == MZ_OK) {
+        progress->position = progress->total;
+        mz_zip_recover_report(zip, progress, start_time, 0);
+    }
     return err;
 }
 
-int32_t mz_zip_get_comment(void *handle, const char **comment) {
+static int32_t mz_zip_recover_cd_chunks(mz_zip *zip, void *cd_mem_stream, void *local_file_info_stream,
+    mz_zip_recover_progress *progress, uint64_t start_time) {
+    mz_zip_recover_list local;
+    mz_zip_recover_list descriptor;
+    mz_zip_recover_list central;
+    mz_zip_file local_file_info;
+    int64_t descriptor_pos = 0;
+    int64_t descriptor_min_pos = 0;
+    int64_t next_header_pos = 0;
+    int64_t compressed_pos = 0;
+    int64_t compressed_end_pos = 0;
+    int64_t compressed_size = 0;
+    int64_t uncompressed_size = 0;
+    int64_t found_compressed_size = 0;
+    int64_t found_uncompressed_size = 0;
+    int64_t found_pos = 0;
+    uint32_t crc32 = 0;
+    uint32_t found_crc32 = 0;
+    int32_t current = 0;
+    int32_t next = 0;
+    int32_t d = 0;
+    int32_t err = MZ_OK;
+    uint8_t zip64 = 0;
+    uint8_t eof = 0;
+
+
+    memset(&local, 0, sizeof(local));
+    memset(&descriptor, 0, sizeof(descriptor));
+    memset(&central, 0, sizeof(central));
+
+    if (mz_stream_seek(zip->stream, 0, MZ_SEEK_END) == MZ_OK)
+        progress->total = mz_stream_tell(zip->stream);
+    err = mz_stream_seek(zip->stream, 0, MZ_SEEK_SET);
+
+    /* Scan on threads when asked to, otherwise or when it is not supported scan on this thread */
+    if (err == MZ_OK) {
+        err = MZ_SUPPORT_ERROR;
+        if (zip->recover_threads > 1)
+            err = mz_zip_recover_cd_scan_threaded(zip, &local, &descriptor, &central, progress, start_time);
+        if (err == MZ_SUPPORT_ERROR)
+            err = mz_zip_recover_cd_scan(zip, &local, &descriptor, &central, progress, start_time);
+    }
+    if (err == MZ_OK && local.count == 0)
+        err = MZ_EXIST_ERROR;
+
+    /* Validate each local header candidate and skip candidates that fall inside its data */
+    while (err == MZ_OK && current < local.count) {
+        err = mz_stream_seek(zip->stream, local.pos[current], MZ_SEEK_SET);
+        if (err != MZ_OK)
+            break;
+
+        memset(&local_file_info, 0, sizeof(local_file_info));
+        if (mz_zip_entry_read_header(zip->stream, 1, &local_file_info, local_file_info_stream) != MZ_OK) {
+            current += 1;
+            continue;
+        }
+
+        local_file_info.disk_offset = local.pos[current];
+        local_file_info.disk_number = 0;
+
+        compressed_pos = mz_stream_tell(zip->stream);
+        compressed_end_pos = 0;
+
+        zip64 = 0;
+        if (mz_zip_extrafield_contains(local_file_info.extrafield,
+            local_file_info.extrafield_size, MZ_ZIP_EXTENSION_ZIP64, NULL) == MZ_OK)
+            zip64 = 1;
+
+        next = mz_zip_recover_list_find(&local, compressed_pos + local_file_info.compressed_size);
+        eof = 0;
+
+        for (;;) {
+            if (next < local.count) {
+                next_header_pos = local.pos[next];
+            } else {
+                /* Use central dir or end of stream if no local header follows */
+                d = mz_zip_recover_list_find(&central, compressed_pos);
+                if (d < central.count)
+                    next_header_pos = central.pos[d];
+                else
+                    next_header_pos = progress->total;
+                eof = 1;
+            }
+
+            if (local_file_info.flag & MZ_ZIP_FLAG_DATA_DESCRIPTOR || local_file_info.compressed_size == 0) {
+                /* Look at the descriptors just before the next header, preferring the one
+                   whose compressed size agrees with its distance from the start of the data */
+                descriptor_min_pos = next_header_pos - MZ_ZIP_SIZE_MAX_DATA_DESCRIPTOR;
+                if (descriptor_min_pos < compressed_pos)
+                    descriptor_min_pos = compressed_pos;
+
+                found_pos = -1;
+                d = mz_zip_recover_list_find(&descriptor, next_header_pos) - 1;
+                for (; d >= 0 && descriptor.pos[d] >= descriptor_min_pos; d -= 1) {
+                    descriptor_pos = descriptor.pos[d];
+                    if (mz_stream_seek(zip->stream, descriptor_pos, MZ_SEEK_SET) != MZ_OK)
+                        continue;
+                    if (mz_zip_entry_read_descriptor(zip->stream, zip64, &crc32,
+                        &compressed_size, &uncompressed_size) != MZ_OK)
+                        continue;
+                    if (found_pos < 0 || compressed_size == descriptor_pos - compressed_pos) {
+                        found_pos = descriptor_pos;
+                        found_crc32 = crc32;
+                        found_compressed_size = compressed_size;
+                        found_uncompressed_size = uncompressed_size;
+                    }
+                    if (compressed_size == descriptor_pos - compressed_pos)
+                        break;
+                }
+
+                if (found_pos >= 0) {
+                    if (local_file_info.crc == 0)
+                        local_file_info.crc = found_crc32;
+                    if (local_file_info.compressed_size == 0)
+                        local_file_info.compressed_size = found_compressed_size;
+                    if (local_file_info.uncompressed_size == 0)
+                        local_file_info.uncompressed_size = found_uncompressed_size;
+
+                    compressed_end_pos = found_pos;
+                } else if (!eof && local_file_info.flag & MZ_ZIP_FLAG_DATA_DESCRIPTOR) {
+                    /* Wrong local file entry found, keep searching */
+                    next += 1;
+                    continue;
+                } else {
+                    compressed_end_pos = next_header_pos;
+                }
+            } else {
+                compressed_end_pos = next_header_pos;
+            }
+
+            break;
+        }
+
+        compressed_size = compressed_end_pos - compressed_pos;
+
+        if (compressed_size > UINT32_MAX) {
+            /* Update sizes if 4GB file is written with no ZIP64 support */
+            if (local_file_info.uncompressed_size < UINT32_MAX) {
+                local_file_info.compressed_size = compressed_size;
+                local_file_info.uncompressed_size = 0;
+            }
+        }
+
+        if (mz_zip_recover_is_dict_record(&local_file_info) == MZ_OK) {
+            /* Dictionary record is deliberately left out of the central directory */
+            mz_zip_print("Zip - Recover - Dictionary (offset %" PRId64 ")\n", local_file_info.disk_offset);
+        } else {
+            mz_zip_print("Zip - Recover - Entry %s (csize %" PRId64 " usize %" PRId64 " flags 0x%" PRIx16 ")\n",
+                local_file_info.filename, local_file_info.compressed_size, local_file_info.uncompressed_size,
+                local_file_info.flag);
+
+            /* Rewrite central dir with local headers and offsets */
+            err = mz_zip_entry_write_header(cd_mem_stream, 0, &local_file_info);
+            if (err == MZ_OK)
+                progress->entries += 1;
+        }
+
+        mz_zip_recover_report(zip, progress, start_time, 0);
+
+        current = next;
+    }
+
+    MZ_FREE(local.pos);
+    MZ_FREE(descriptor.pos);
+    MZ_FREE(central.pos);
+    return err;
+}
+
+static int32_t mz_zip_recover_cd(void *handle) {
+    mz_zip *zip = (mz_zip *)handle;
+    mz_zip_recover_progress progress;
+    void *local_file_info_stream = NULL;
+    void *cd_mem_stream = NULL;
+    uint64_t start_time = 0;
+    int64_t cd_size = 0;
+    int64_t disk_number = 0;
+    uint32_t disk_number_with_cd = 0;
+    int32_t err = MZ_OK;
+    uint8_t split = 0;
+
+
+    mz_zip_print("Zip - Recover - Start\n");
+
+    memset(&progress, 0, sizeof(progress));
+    start_time = mz_os_ns_time();
+
+    mz_zip_get_cd_mem_stream(handle, &cd_mem_stream);
+
+    /* Determine if we are on a split disk or not */
+    mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, 0);
+    if (mz_stream_tell(zip->stream) < 0) {
+        mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, -1);
+        mz_stream_seek(zip->stream, 0, MZ_SEEK_SET);
+    } else {
+        disk_number_with_cd = 1;
+        if (mz_stream_get_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, &disk_number) == MZ_OK)
+            split = 1;
+    }
+
+    if (mz_stream_is_open(cd_mem_stream) != MZ_OK)
+        err = mz_stream_mem_open(cd_mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    mz_stream_mem_create(&local_file_info_stream);
+    mz_stream_mem_open(local_file_info_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    /* Offsets on split disks are relative to each disk so they are searched one header at a time */
+    if (err == MZ_OK) {
+        if (split)
+            err = mz_zip_recover_cd_disks(zip, cd_mem_stream, local_file_info_stream, &progress, start_time,
+                &disk_number_with_cd);
+        else
+            err = mz_zip_recover_cd_chunks(zip, cd_mem_stream, local_file_info_stream, &progress, start_time);
+    }
+
+    mz_stream_mem_delete(&local_file_info_stream);
+
+    mz_zip_recover_report(zip, &progress, start_time, 1);
+
+    mz_zip_print("Zip - Recover - Complete (cddisk %" PRIu32 " entries %" PRId64 ")\n",
+        disk_number_with_cd, progress.entries);
+
+    if (progress.entries == 0)
+        return err;
+
+    /* Set new upper seek boundary for central dir mem stream */
+    cd_size = mz_stream_tell(cd_mem_stream);
+    mz_stream_mem_set_buffer_limit(cd_mem_stream, (int32_t)cd_size);
+
+    /* Set new central directory info */
+    mz_zip_set_cd_stream(handle, 0, cd_mem_stream);
+    mz_zip_set_number_entry(handle, progress.entries);
+    mz_zip_set_disk_number_with_cd(handle, disk_number_with_cd);
+
+    return MZ_OK;
+}
+
+static void mz_zip_dict_reset(void *handle) {
+    mz_zip *zip = (mz_zip *)handle;
+
+#ifdef HAVE_ZSTD
+    mz_stream_zstd_dictionary_delete(&zip->dict_prepared, zip->dict_prepared_mode);
+#endif
+    if (zip->dict != NULL)
+        MZ_FREE(zip->dict);
+
+    zip->dict = NULL;
+    zip->dict_size = 0;
+    zip->dict_id = 0;
+    zip->dict_disk_number = 0;
+    zip->dict_disk_offset = 0;
+}
+
+static void mz_zip_dict_assign(void *handle, uint8_t *dict, int32_t dict_size) {
+    mz_zip *zip = (mz_zip *)handle;
+
+    /* Takes ownership of the dictionary buffer */
+    mz_zip_dict_reset(handle);
+
+    zip->dict = dict;
+    zip->dict_size = dict_size;
+    zip->dict_id = mz_crypt_crc32_update(0, dict, dict_size);
+}
+
+static int32_t mz_zip_dict_write_record(void *handle) {
+    mz_zip *zip = (mz_zip *)handle;
+    mz_zip_dict_record *record = NULL;
+    mz_zip_file dict_info;
+    void *file_extra_stream = NULL;
+    uint8_t extrafield[4 + MZ_ZIP_DICT_FIELD_LENGTH];
+    int64_t disk_number = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    /* Switching back to a dictionary written before references its existing record */
+    for (i = 0; i < zip->dict_record_count; i += 1) {
+        record = &zip->dict_records[i];
+        if ((record->id == zip->dict_id) && (record->size == zip->dict_size)) {
+            zip->dict_disk_number = record->disk_number;
+            zip->dict_disk_offset = record->disk_offset;
+            return MZ_OK;
+        }
+    }
+
+    /* Dictionary is stored as a local record that is not listed in the central directory */
+    memset(&dict_info, 0, sizeof(dict_info));
+    dict_info.filename = MZ_ZIP_DICT_FILENAME;
+    dict_info.compression_method = MZ_COMPRESS_METHOD_STORE;
+    dict_info.crc = zip->dict_id;
+    dict_info.compressed_size = zip->dict_size;
+    dict_info.uncompressed_size = zip->dict_size;
+
+    mz_stream_get_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, &disk_number);
+    zip->dict_disk_number = (uint32_t)disk_number;
+    zip->dict_disk_offset = mz_stream_tell(zip->stream);
+
+    mz_zip_print("Zip - Dictionary - Write (id %08" PRIx32 " size %" PRId32 " offset %" PRId64 ")\n",
+        zip->dict_id, zip->dict_size, zip->dict_disk_offset);
+
+    /* Record carries a dictionary field pointing at itself so recovery can leave it out */
+    mz_stream_mem_create(&file_extra_stream);
+    mz_stream_mem_set_buffer(file_extra_stream, extrafield, sizeof(extrafield));
+    err = mz_zip_extrafield_write(file_extra_stream, MZ_ZIP_EXTENSION_DICT, MZ_ZIP_DICT_FIELD_LENGTH);
+    if (err == MZ_OK)
+        err = mz_stream_write_uint32(file_extra_stream, zip->dict_id);
+    if (err == MZ_OK)
+        err = mz_stream_write_uint32(file_extra_stream, (uint32_t)zip->dict_size);
+    if (err == MZ_OK)
+        err = mz_stream_write_uint32(file_extra_stream, zip->dict_disk_number);
+    if (err == MZ_OK)
+        err = mz_stream_write_int64(file_extra_stream, zip->dict_disk_offset);
+    if (err == MZ_OK)
+        err = mz_stream_write_uint16(file_extra_stream, MZ_COMPRESS_METHOD_STORE);
+    mz_stream_mem_delete(&file_extra_stream);
+
+    dict_info.extrafield = extrafield;
+    dict_info.extrafield_size = sizeof(extrafield);
+
+    if (err == MZ_OK)
+        err = mz_zip_entry_write_header(zip->stream, 1, &dict_info);
+    if ((err == MZ_OK) && (mz_stream_write(zip->stream, zip->dict, zip->dict_size) != zip->dict_size))
+        err = MZ_WRITE_ERROR;
+
+    if ((err == MZ_OK) && (zip->dict_record_count < MZ_ZIP_DICT_RECORD_COUNT)) {
+        record = &zip->dict_records[zip->dict_record_count++];
+        record->id = zip->dict_id;
+        record->size = zip->dict_size;
+        record->disk_number = zip->dict_disk_number;
+        record->disk_offset = zip->dict_disk_offset;
+    }
+
+    return err;
+}
+
+/***************************************************************************/
+
+#ifdef MZ_ZIP_NO_COMPRESSION
+#  define MZ_ZIP_CODEC_BUILTIN  (MZ_CODEC_DECOMPRESS | MZ_CODEC_STREAMING)
+#elif defined(MZ_ZIP_NO_DECOMPRESSION)
+#  define MZ_ZIP_CODEC_BUILTIN  (MZ_CODEC_COMPRESS | MZ_CODEC_STREAMING)
+#else
+#  define MZ_ZIP_CODEC_BUILTIN  (MZ_CODEC_COMPRESS | MZ_CODEC_DECOMPRESS | MZ_CODEC_STREAMING)
+#endif
+#ifdef HAVE_LIBDEFLATE
+#  define MZ_ZIP_CODEC_ZLIB     (MZ_ZIP_CODEC_BUILTIN | MZ_CODEC_DICTIONARY | MZ_CODEC_ONE_SHOT)
+#else
+#  define MZ_ZIP_CODEC_ZLIB     (MZ_ZIP_CODEC_BUILTIN | MZ_CODEC_DICTIONARY)
+#endif
+
+/* Codecs compiled in, registered codecs are preferred over them on equal priority */
+static const mz_zip_codec mz_zip_codec_builtin[] = {
+#if defined(HAVE_ZLIB) && !defined(HAVE_LIBCOMP)
+    { MZ_COMPRESS_METHOD_DEFLATE, "zlib", mz_stream_zlib_create, MZ_ZIP_CODEC_ZLIB, 0, 0 },
+#endif
+#ifdef HAVE_LIBCOMP
+    { MZ_COMPRESS_METHOD_DEFLATE, "libcomp", mz_stream_zlib_create, MZ_ZIP_CODEC_BUILTIN, 0, 0 },
+    { MZ_COMPRESS_METHOD_XZ, "libcomp", mz_stream_libcomp_create, MZ_ZIP_CODEC_BUILTIN, 0, 0 },
+#endif
+#ifdef HAVE_BZIP2
+    { MZ_COMPRESS_METHOD_BZIP2, "bzip2", mz_stream_bzip_create, MZ_ZIP_CODEC_BUILTIN, 0, 0 },
+#endif
+#ifdef HAVE_LZMA
+    { MZ_COMPRESS_METHOD_LZMA, "lzma", mz_stream_lzma_create, MZ_ZIP_CODEC_BUILTIN, 0, 0 },
+    { MZ_COMPRESS_METHOD_XZ, "lzma", mz_stream_lzma_create, MZ_ZIP_CODEC_BUILTIN, 0, 0 },
+#endif
+#ifdef HAVE_ZSTD
+    { MZ_COMPRESS_METHOD_ZSTD, "zstd", mz_stream_zstd_create, MZ_ZIP_CODEC_BUILTIN | MZ_CODEC_DICTIONARY, 0, 0 },
+#endif
+    { 0, NULL, NULL, 0, 0, 0 }
+};
+
+static mz_zip_codec mz_zip_codec_registry[MZ_ZIP_CODEC_MAX];
+static int32_t mz_zip_codec_count = 0;
+
+static int32_t mz_zip_codec_takes_dict(mz_stream_create_cb create) {
+    /* Dictionaries are handed to the stream through functions of the codec itself */
+#if defined(HAVE_ZLIB) && !defined(HAVE_LIBCOMP)
+    if (create == mz_stream_zlib_create)
+        return 1;
+#endif
+#ifdef HAVE_ZSTD
+    if (create == mz_stream_zstd_create)
+        return 1;
+#endif
+    MZ_UNUSED(create);
+    return 0;
+}
+
+static int32_t mz_zip_codec_fits(const mz_zip_codec *codec, uint16_t method, uint32_t flags, int64_t entry_size) {
+    if (codec->method != method)
+        return 0;
+    if ((codec->flags & flags) != flags)
+        return 0;
+    if ((codec->max_entry_size > 0) && ((entry_size < 0) || (entry_size > codec->max_entry_size)))
+        return 0;
+    return 1;
+}
+
+int32_t mz_zip_codec_register(const mz_zip_codec *codec) {
+    int32_t i = 0;
+
+    if (codec == NULL || codec->name == NULL || codec->create == NULL)
+        return MZ_PARAM_ERROR;
+    if (codec->method == MZ_COMPRESS_METHOD_STORE)
+        return MZ_PARAM_ERROR;
+    if ((codec->flags & MZ_CODEC_DICTIONARY) && (!mz_zip_codec_takes_dict(codec->create)))
+        return MZ_PARAM_ERROR;
+
+    for (i = 0; i < mz_zip_codec_count; i += 1) {
+        if ((mz_zip_codec_registry[i].method == codec->method) &&
+            (strcmp(mz_zip_codec_registry[i].name, codec->name) == 0)) {
+            mz_zip_codec_registry[i] = *codec;
+            return MZ_OK;
+        }
+    }
+
+    if (mz_zip_codec_count >= MZ_ZIP_CODEC_MAX)
+        return MZ_MEM_ERROR;
+
+    mz_zip_codec_registry[mz_zip_codec_count] = *codec;
+    mz_zip_codec_count += 1;
+    return MZ_OK;
+}
+
+int32_t mz_zip_codec_unregister(uint16_t method, const char *name) {
+    int32_t i = 0;
+
+    if (name == NULL)
+        return MZ_PARAM_ERROR;
+
+    for (i = 0; i < mz_zip_codec_count; i += 1) {
+        if ((mz_zip_codec_registry[i].method == method) &&
+            (strcmp(mz_zip_codec_registry[i].name, name) == 0)) {
+            memmove(&mz_zip_codec_registry[i], &mz_zip_codec_registry[i + 1],
+                (mz_zip_codec_count - i - 1) * sizeof(mz_zip_codec));
+            mz_zip_codec_count -= 1;
+            return MZ_OK;
+        }
+    }
+    return MZ_EXIST_ERROR;
+}
+
+int32_t mz_zip_codec_find(uint16_t method, uint32_t flags, int64_t entry_size, const char *name,
+    const mz_zip_codec **codec) {
+    const mz_zip_codec *candidate = NULL;
+    const mz_zip_codec *best = NULL;
+    int32_t builtin_count = (int32_t)(sizeof(mz_zip_codec_builtin) / sizeof(mz_zip_codec_builtin[0])) - 1;
+    int32_t i = 0;
+
+    if (codec == NULL)
+        return MZ_PARAM_ERROR;
+
+    for (i = 0; i < mz_zip_codec_count + builtin_count; i += 1) {
+        if (i < mz_zip_codec_count)
+            candidate = &mz_zip_codec_registry[i];
+        else
+            candidate = &mz_zip_codec_builtin[i - mz_zip_codec_count];
+
+        if (!mz_zip_codec_fits(candidate, method, flags, entry_size))
+            continue;
+        if ((name != NULL) && (strcmp(candidate->name, name) == 0)) {
+            best = candidate;
+            break;
+        }
+        if ((best == NULL) || (candidate->priority > best->priority))
+            best = candidate;
+    }
+
+    *codec = best;
+    if (best == NULL)
+        return MZ_SUPPORT_ERROR;
+    return MZ_OK;
+}
+
+static int8_t mz_zip_codec_pool(mz_stream_create_cb create) {
+#if defined(HAVE_ZLIB) && !defined(HAVE_LIBCOMP)
+    if (create == mz_stream_zlib_create)
+        return MZ_ZIP_POOL_DEFLATE;
+#endif
+#ifdef HAVE_ZSTD
+    if (create == mz_stream_zstd_create)
+        return MZ_ZIP_POOL_ZSTD;
+#endif
+    MZ_UNUSED(create);
+    return MZ_ZIP_POOL_NONE;
+}
+
+static int32_t mz_zip_dict_is_supported(uint16_t compression_method, int64_t entry_size) {
+    const mz_zip_codec *codec = NULL;
+    return mz_zip_codec_find(compression_method, MZ_CODEC_COMPRESS | MZ_CODEC_DICTIONARY, entry_size,
+        NULL, &codec);
+}
+
+/***************************************************************************/
+
+static void *mz_zip_pool_get(void *handle, int8_t slot, mz_stream_create_cb create) {
+    mz_zip *zip = (mz_zip *)handle;
+    void *stream = NULL;
+
+    if (slot != MZ_ZIP_POOL_NONE) {
+        stream = zip->stream_pool[slot];
+        zip->stream_pool[slot] = NULL;
+    }
+    if (stream == NULL)
+        create(&stream);
+    return stream;
+}
+
+static void mz_zip_pool_put(void *handle, int8_t slot, void **stream) {
+    mz_zip *zip = (mz_zip *)handle;
+
+    if (*stream == NULL)
+        return;
+    if ((slot == MZ_ZIP_POOL_NONE) || (zip->stream_pool[slot] != NULL) || (zip->low_memory)) {
+        mz_stream_delete(stream);
+        return;
+    }
+
+    /* Forget settings made for this entry, the codec state is reset when reopened */
+    mz_stream_set_prop_int64(*stream, MZ_STREAM_PROP_TOTAL_IN_MAX, 0);
+    mz_stream_set_prop_int64(*stream, MZ_STREAM_PROP_TOTAL_OUT_MAX, 0);
+#if defined(HAVE_ZLIB) && !defined(HAVE_LIBCOMP)
+    if (slot == MZ_ZIP_POOL_DEFLATE)
+        mz_stream_zlib_set_dictionary(*stream, NULL, 0);
+#endif
+#ifdef HAVE_ZSTD
+    if (slot == MZ_ZIP_POOL_ZSTD)
+        mz_stream_zstd_set_dictionary(*stream, NULL);
+#endif
+
+    zip->stream_pool[slot] = *stream;
+    *stream = NULL;
+}
+
+static void mz_zip_pool_reset(void *handle) {
+    mz_zip *zip = (mz_zip *)handle;
+    int32_t i = 0;
+
+    for (i = 0; i < MZ_ZIP_POOL_COUNT; i += 1) {
+        if (zip->stream_pool[i] != NULL)
+            mz_stream_delete(&zip->stream_pool[i]);
+    }
+}
+
+/***************************************************************************/
+
+void *mz_zip_create(void **handle) {
+    mz_zip *zip = NULL;
+
+    zip = (mz_zip *)MZ_ALLOC(sizeof(mz_zip));
+    if (zip != NULL) {
+        memset(zip, 0, sizeof(mz_zip));
+        zip->data_descriptor = 1;
+        zip->compress_pool = MZ_ZIP_POOL_NONE;
+        zip->crypt_pool = MZ_ZIP_POOL_NONE;
+    }
+    if (handle != NULL)
+        *handle = zip;
+
+    return zip;
+}
+
+void mz_zip_delete(void **handle) {
+    mz_zip *zip = NULL;
+    if (handle == NULL)
+        return;
+    zip = (mz_zip *)*handle;
+    if (zip != NULL) {
+        mz_zip_pool_reset(zip);
+        if (zip->cd_mem_stream != NULL)
+            mz_stream_mem_delete(&zip->cd_mem_stream);
+        if (zip->file_info_stream != NULL)
+            mz_stream_mem_delete(&zip->file_info_stream);
+        if (zip->local_file_info_stream != NULL)
+            mz_stream_mem_delete(&zip->local_file_info_stream);
+        MZ_FREE(zip);
+    }
+    *handle = NULL;
+}
+
+int32_t mz_zip_open(void *handle, void *stream, int32_t mode) {
+    mz_zip *zip = (mz_zip *)handle;
+    int32_t err = MZ_OK;
+
+
+    if (zip == NULL)
+        return MZ_PARAM_ERROR;
+
+    mz_zip_print("Zip - Open\n");
+
+    zip->stream = stream;
+
+    /* Memory streams are kept from the last time the handle was opened */
+    if (zip->cd_mem_stream == NULL)
+        mz_stream_mem_create(&zip->cd_mem_stream);
+
+    if (mode & MZ_OPEN_MODE_WRITE) {
+        mz_stream_mem_open(zip->cd_mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+        zip->cd_stream = zip->cd_mem_stream;
+    } else {
+        /* Empty the buffer of a previous open so it is not taken for an unzipped cd */
+        if (mz_stream_mem_is_open(zip->cd_mem_stream) == MZ_OK)
+            mz_stream_mem_open(zip->cd_mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+        zip->cd_stream = stream;
+    }
+
+    if ((mode & MZ_OPEN_MODE_READ) || (mode & MZ_OPEN_MODE_APPEND)) {
+        if ((mode & MZ_OPEN_MODE_CREATE) == 0) {
+            err = mz_zip_read_cd(zip);
+            if (err != MZ_OK) {
+                mz_zip_print("Zip - Error detected reading cd (%" PRId32 ")\n", err);
+                if (zip->recover && mz_zip_recover_cd(zip) == MZ_OK)
+                    err = MZ_OK;
+            }
+        }
+
+        if ((err == MZ_OK) && (mode & MZ_OPEN_MODE_APPEND)) {
+            if (zip->cd_size > 0) {
+                /* Store central directory in memory */
+                err = mz_stream_seek(zip->stream, zip->cd_offset, MZ_SEEK_SET);
+                if (err == MZ_OK)
+                    err = mz_stream_copy(zip->cd_mem_stream, zip->stream, (int32_t)zip->cd_size);
+                if (err == MZ_OK)
+                    err = mz_stream_seek(zip->stream, zip->cd_offset, MZ_SEEK_SET);
+            } else {
+                if (zip->cd_signature == MZ_ZIP_MAGIC_ENDHEADER) {
+                    /* If tiny zip then overwrite end header */
+                    err = mz_stream_seek(zip->stream, zip->cd_offset, MZ_SEEK_SET);
+                } else {
+                    /* If no central directory, append new zip to end of file */
+                    err = mz_stream_seek(zip->stream, 0, MZ_SEEK_END);
+                }
+            }
+
+            if (zip->disk_number_with_cd > 0) {
+                /* Move to last disk to begin appending */
+                mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, zip->disk_number_with_cd - 1);
+            }
+        } else {
+            zip->cd_start_pos = zip->cd_offset;
+        }
+    }
+
+    if (err != MZ_OK) {
+        mz_zip_close(zip);
+        return err;
+    }
+
+    /* Memory streams used to store variable length file info data */
+    if (zip->file_info_stream == NULL)
+        mz_stream_mem_create(&zip->file_info_stream);
+    mz_stream_mem_open(zip->file_info_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    if (zip->local_file_info_stream == NULL)
+        mz_stream_mem_create(&zip->local_file_info_stream);
+    mz_stream_mem_open(zip->local_file_info_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    zip->open_mode = mode;
+
+    return err;
+}
+
+int32_t mz_zip_close(void *handle) {
+    mz_zip *zip = (mz_zip *)handle;
+    int32_t err = MZ_OK;
+
+    if (zip == NULL)
+        return MZ_PARAM_ERROR;
+
+    mz_zip_print("Zip - Close\n");
+
+    if (mz_zip_entry_is_open(handle) == MZ_OK)
+        err = mz_zip_entry_close(handle);
+
+    if ((err == MZ_OK) && (zip->open_mode & MZ_OPEN_MODE_WRITE))
+        err = mz_zip_write_cd(handle);
+
+    /* Memory streams and pooled entry streams are kept for the next open unless memory
+       is to be given back, or came from an allocator the caller may reset after closing */
+    if (zip->low_memory) {
+        if (zip->cd_mem_stream != NULL)
+            mz_stream_mem_delete(&zip->cd_mem_stream);
+        if (zip->file_info_stream != NULL)
+            mz_stream_mem_delete(&zip->file_info_stream);
+        if (zip->local_file_info_stream != NULL)
+            mz_stream_mem_delete(&zip->local_file_info_stream);
+    } else {
+        if (zip->cd_mem_stream != NULL)
+            mz_stream_mem_close(zip->cd_mem_stream);
+        if (zip->file_info_stream != NULL)
+            mz_stream_mem_close(zip->file_info_stream);
+        if (zip->local_file_info_stream != NULL)
+            mz_stream_mem_close(zip->local_file_info_stream);
+    }
+
+    if (zip->comment) {
+        mz_alloc_free(zip->alloc, zip->comment);
+        zip->comment = NULL;
+    }
+
+    mz_zip_dict_reset(handle);
+    zip->dict_record_count = 0;
+
+    if (zip->low_memory || zip->alloc != NULL)
+        mz_zip_pool_reset(handle);
+
+    /* Forget everything read from the archive so the handle can be opened again */
+    memset(&zip->file_info, 0, sizeof(zip->file_info));
+    memset(&zip->local_file_info, 0, sizeof(zip->local_file_info));
+    zip->stream = NULL;
+    zip->cd_stream = NULL;
+    zip->open_mode = 0;
+    zip->disk_number_with_cd = 0;
+    zip->disk_offset_shift = 0;
+    zip->eocd_pos = 0;
+    zip->eocd_pos_hint = 0;
+    zip->cd_start_pos = 0;
+    zip->cd_current_pos = 0;
+    zip->cd_offset = 0;
+    zip->cd_size = 0;
+    zip->cd_signature = 0;
+    zip->entry_scanned = 0;
+    zip->entry_opened = 0;
+    zip->entry_raw = 0;
+    zip->entry_dict = 0;
+    zip->entry_crc32 = 0;
+    zip->number_entry = 0;
+    zip->version_madeby = 0;
+
+    return err;
+}
+
+int32_t mz_zip_get_comment(void *handle, const char **comment) {
     mz_zip *zip = (mz_zip *)handle;
     if (zip == NULL || comment == NULL)
         return MZ_PARAM_ERROR;
@@ -1481,11 +2545,11 @@ int32_t mz_zip_set_comment(void *handle, const char *comment) {
     if (zip == NULL || comment == NULL)
         return MZ_PARAM_ERROR;
     if (zip->comment != NULL)
-        MZ_FREE(zip->comment);
+        mz_alloc_free(zip->alloc, zip->comment);
     comment_size = (int32_t)strlen(comment);
     if (comment_size > UINT16_MAX)
         return MZ_PARAM_ERROR;
-    zip->comment = (char *)MZ_ALLOC(comment_size+1);
+    zip->comment = (char *)mz_alloc_malloc(zip->alloc, comment_size+1);
     if (zip->comment == NULL)
         return MZ_MEM_ERROR;
     memset(zip->comment, 0, comment_size+1);
@@ -1517,6 +2581,23 @@ int32_t mz_zip_set_recover(void *handle, uint8_t recover) {
     return MZ_OK;
 }
 
+int32_t mz_zip_set_recover_cb(void *handle, void *userdata, mz_zip_recover_cb cb) {
+    mz_zip *zip = (mz_zip *)handle;
+    if (zip == NULL)
+        return MZ_PARAM_ERROR;
+    zip->recover_cb = cb;
+    zip->recover_userdata = userdata;
+    return MZ_OK;
+}
+
+int32_t mz_zip_set_recover_threads(void *handle, int32_t thread_count) {
+    mz_zip *zip = (mz_zip *)handle;
+    if (zip == NULL)
+        return MZ_PARAM_ERROR;
+    zip->recover_threads = thread_count;
+    return MZ_OK;
+}
+
 int32_t mz_zip_set_data_descriptor(void *handle, uint8_t data_descriptor) {
     mz_zip *zip = (mz_zip *)handle;
     if (zip == NULL)
@@ -1525,6 +2606,32 @@ int32_t mz_zip_set_data_descriptor(void *handle, uint8_t data_descriptor) {
     return MZ_OK;
 }
 
+int32_t mz_zip_set_stats(void *handle, mz_zip_stats *stats) {
+    mz_zip *zip = (mz_zip *)handle;
+    if (zip == NULL)
+        return MZ_PARAM_ERROR;
+    zip->stats = stats;
+    return MZ_OK;
+}
+
+int32_t mz_zip_set_alloc(void *handle, mz_alloc *alloc) {
+    mz_zip *zip = (mz_zip *)handle;
+    if (zip == NULL)
+        return MZ_PARAM_ERROR;
+    zip->alloc = alloc;
+    return MZ_OK;
+}
+
+int32_t mz_zip_set_low_memory(void *handle, uint8_t low_memory) {
+    mz_zip *zip = (mz_zip *)handle;
+    if (zip == NULL)
+        return MZ_PARAM_ERROR;
+    zip->low_memory = low_memory;
+    if (low_memory)
+        mz_zip_pool_reset(handle);
+    return MZ_OK;
+}
+
 int32_t mz_zip_get_stream(void *handle, void **stream) {
     mz_zip *zip = (mz_zip *)handle;
     if (zip == NULL || stream == NULL)
@@ -1545,57 +2652,171 @@ int32_t mz_zip_set_cd_stream(void *handle, int64_t cd_start_pos, void *cd_stream
     return MZ_OK;
 }
 
-int32_t mz_zip_get_cd_mem_stream(void *handle, void **cd_mem_stream) {
+int32_t mz_zip_get_cd_mem_stream(void *handle, void **cd_mem_stream) {
+    mz_zip *zip = (mz_zip *)handle;
+    if (zip == NULL || cd_mem_stream == NULL)
+        return MZ_PARAM_ERROR;
+    *cd_mem_stream = zip->cd_mem_stream;
+    if (*cd_mem_stream == NULL)
+        return MZ_EXIST_ERROR;
+    return MZ_OK;
+}
+
+int32_t mz_zip_set_number_entry(void *handle, uint64_t number_entry) {
+    mz_zip *zip = (mz_zip *)handle;
+    if (zip == NULL)
+        return MZ_PARAM_ERROR;
+    zip->number_entry = number_entry;
+    return MZ_OK;
+}
+
+int32_t mz_zip_get_number_entry(void *handle, uint64_t *number_entry) {
+    mz_zip *zip = (mz_zip *)handle;
+    if (zip == NULL || number_entry == NULL)
+        return MZ_PARAM_ERROR;
+    *number_entry = zip->number_entry;
+    return MZ_OK;
+}
+
+int32_t mz_zip_set_disk_number_with_cd(void *handle, uint32_t disk_number_with_cd) {
+    mz_zip *zip = (mz_zip *)handle;
+    if (zip == NULL)
+        return MZ_PARAM_ERROR;
+    zip->disk_number_with_cd = disk_number_with_cd;
+    return MZ_OK;
+}
+
+int32_t mz_zip_get_disk_number_with_cd(void *handle, uint32_t *disk_number_with_cd) {
+    mz_zip *zip = (mz_zip *)handle;
+    if (zip == NULL || disk_number_with_cd == NULL)
+        return MZ_PARAM_ERROR;
+    *disk_number_with_cd = zip->disk_number_with_cd;
+    return MZ_OK;
+}
+
+int32_t mz_zip_get_eocd_pos(void *handle, int64_t *eocd_pos) {
+    mz_zip *zip = (mz_zip *)handle;
+    if (zip == NULL || eocd_pos == NULL)
+        return MZ_PARAM_ERROR;
+    *eocd_pos = zip->eocd_pos;
+    if (*eocd_pos == 0)
+        return MZ_EXIST_ERROR;
+    return MZ_OK;
+}
+
+int32_t mz_zip_set_eocd_pos_hint(void *handle, int64_t eocd_pos) {
+    mz_zip *zip = (mz_zip *)handle;
+    if (zip == NULL)
+        return MZ_PARAM_ERROR;
+    zip->eocd_pos_hint = eocd_pos;
+    return MZ_OK;
+}
+
+int32_t mz_zip_set_dictionary(void *handle, const void *dict, int32_t dict_size) {
+    mz_zip *zip = (mz_zip *)handle;
+    uint8_t *dict_copy = NULL;
+    int32_t err = MZ_OK;
+
+    if (zip == NULL || dict_size < 0 || dict_size > MZ_ZIP_DICT_MAX_SIZE)
+        return MZ_PARAM_ERROR;
+    if (mz_zip_entry_is_open(handle) == MZ_OK)
+        return MZ_PARAM_ERROR;
+
+    if (dict == NULL || dict_size == 0) {
+        mz_zip_dict_reset(handle);
+        return MZ_OK;
+    }
+
+    dict_copy = (uint8_t *)MZ_ALLOC(dict_size);
+    if (dict_copy == NULL)
+        return MZ_MEM_ERROR;
+    memcpy(dict_copy, dict, dict_size);
+
+    mz_zip_dict_assign(handle, dict_copy, dict_size);
+
+    if (zip->open_mode & MZ_OPEN_MODE_WRITE) {
+        err = mz_zip_dict_write_record(handle);
+        if (err != MZ_OK)
+            mz_zip_dict_reset(handle);
+    }
+
+    return err;
+}
+
+int32_t mz_zip_set_frame_size(void *handle, int32_t frame_size) {
     mz_zip *zip = (mz_zip *)handle;
-    if (zip == NULL || cd_mem_stream == NULL)
+    if (zip == NULL || frame_size < 0)
         return MZ_PARAM_ERROR;
-    *cd_mem_stream = zip->cd_mem_stream;
-    if (*cd_mem_stream == NULL)
-        return MZ_EXIST_ERROR;
+    zip->frame_size = frame_size;
     return MZ_OK;
 }
 
-int32_t mz_zip_set_number_entry(void *handle, uint64_t number_entry) {
+int32_t mz_zip_set_codec(void *handle, const char *name) {
     mz_zip *zip = (mz_zip *)handle;
     if (zip == NULL)
         return MZ_PARAM_ERROR;
-    zip->number_entry = number_entry;
+    zip->codec_name = name;
     return MZ_OK;
 }
 
-int32_t mz_zip_get_number_entry(void *handle, uint64_t *number_entry) {
+int32_t mz_zip_get_dictionary(void *handle, const void **dict, int32_t *dict_size) {
     mz_zip *zip = (mz_zip *)handle;
-    if (zip == NULL || number_entry == NULL)
+    if (zip == NULL || dict == NULL || dict_size == NULL)
         return MZ_PARAM_ERROR;
-    *number_entry = zip->number_entry;
+    if (zip->dict == NULL)
+        return MZ_EXIST_ERROR;
+    *dict = zip->dict;
+    *dict_size = zip->dict_size;
     return MZ_OK;
 }
 
-int32_t mz_zip_set_disk_number_with_cd(void *handle, uint32_t disk_number_with_cd) {
+static int32_t mz_zip_dict_apply(void *handle, int16_t compress_level) {
     mz_zip *zip = (mz_zip *)handle;
-    if (zip == NULL)
-        return MZ_PARAM_ERROR;
-    zip->disk_number_with_cd = disk_number_with_cd;
-    return MZ_OK;
-}
+    int32_t mode = MZ_OPEN_MODE_READ;
 
-int32_t mz_zip_get_disk_number_with_cd(void *handle, uint32_t *disk_number_with_cd) {
-    mz_zip *zip = (mz_zip *)handle;
-    if (zip == NULL || disk_number_with_cd == NULL)
-        return MZ_PARAM_ERROR;
-    *disk_number_with_cd = zip->disk_number_with_cd;
-    return MZ_OK;
+    if (zip->dict == NULL)
+        return MZ_EXIST_ERROR;
+    if (zip->open_mode & MZ_OPEN_MODE_WRITE)
+        mode = MZ_OPEN_MODE_WRITE;
+
+#if defined(HAVE_ZLIB) && !defined(HAVE_LIBCOMP)
+    if (zip->compress_create == mz_stream_zlib_create) {
+        mz_stream_zlib_set_dictionary(zip->compress_stream, zip->dict, zip->dict_size);
+        return MZ_OK;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    if (zip->compress_create == mz_stream_zstd_create) {
+        /* Digest the dictionary once and share it with every entry using the same level */
+        if ((zip->dict_prepared != NULL) &&
+            ((zip->dict_prepared_mode != mode) || (zip->dict_prepared_level != compress_level)))
+            mz_stream_zstd_dictionary_delete(&zip->dict_prepared, zip->dict_prepared_mode);
+        if (zip->dict_prepared == NULL) {
+            zip->dict_prepared = mz_stream_zstd_dictionary_create(zip->dict, zip->dict_size, mode,
+                compress_level);
+            zip->dict_prepared_mode = mode;
+            zip->dict_prepared_level = compress_level;
+        }
+        if (zip->dict_prepared == NULL)
+            return MZ_MEM_ERROR;
+        mz_stream_zstd_set_dictionary(zip->compress_stream, zip->dict_prepared);
+        return MZ_OK;
+    }
+#endif
+
+    MZ_UNUSED(compress_level);
+    MZ_UNUSED(mode);
+    return MZ_SUPPORT_ERROR;
 }
 
 static int32_t mz_zip_entry_close_int(void *handle) {
     mz_zip *zip = (mz_zip *)handle;
 
-    if (zip->crypt_stream != NULL)
-        mz_stream_delete(&zip->crypt_stream);
-    zip->crypt_stream = NULL;
-    if (zip->compress_stream != NULL)
-        mz_stream_delete(&zip->compress_stream);
-    zip->compress_stream = NULL;
+    mz_zip_pool_put(handle, zip->crypt_pool, &zip->crypt_stream);
+    zip->crypt_pool = MZ_ZIP_POOL_NONE;
+    mz_zip_pool_put(handle, zip->compress_pool, &zip->compress_stream);
+    zip->compress_pool = MZ_ZIP_POOL_NONE;
+    zip->compress_create = NULL;
 
     zip->entry_opened = 0;
 
@@ -1604,6 +2825,9 @@ static int32_t mz_zip_entry_close_int(void *handle) {
 
 static int32_t mz_zip_entry_open_int(void *handle, uint8_t raw, int16_t compress_level, const char *password) {
     mz_zip *zip = (mz_zip *)handle;
+    const mz_zip_codec *codec = NULL;
+    uint32_t codec_flags = 0;
+    int64_t entry_size = 0;
     int64_t max_total_in = 0;
     int64_t header_size = 0;
     int64_t footer_size = 0;
@@ -1613,25 +2837,24 @@ static int32_t mz_zip_entry_open_int(void *handle, uint8_t raw, int16_t compress
     if (zip == NULL)
         return MZ_PARAM_ERROR;
 
-    switch (zip->file_info.compression_method) {
-    case MZ_COMPRESS_METHOD_STORE:
-    case MZ_COMPRESS_METHOD_DEFLATE:
-#ifdef HAVE_BZIP2
-    case MZ_COMPRESS_METHOD_BZIP2:
-#endif
-#ifdef HAVE_LZMA
-    case MZ_COMPRESS_METHOD_LZMA:
-#endif
-#if defined(HAVE_LZMA) || defined(HAVE_LIBCOMP)
-    case MZ_COMPRESS_METHOD_XZ:
-#endif
-#ifdef HAVE_ZSTD
-    case MZ_COMPRESS_METHOD_ZSTD:
-#endif
-        err = MZ_OK;
-        break;
-    default:
-        return MZ_SUPPORT_ERROR;
+    if (zip->file_info.compression_method != MZ_COMPRESS_METHOD_STORE) {
+        /* Raw entries are copied as they are, but only for methods a codec exists for */
+        if (!raw) {
+            if (zip->open_mode & MZ_OPEN_MODE_WRITE)
+                codec_flags |= MZ_CODEC_COMPRESS;
+            else
+                codec_flags |= MZ_CODEC_DECOMPRESS;
+            if (zip->entry_dict)
+                codec_flags |= MZ_CODEC_DICTIONARY;
+        }
+        /* Size of an entry written without one is only known once it is closed */
+        entry_size = zip->file_info.uncompressed_size;
+        if ((zip->open_mode & MZ_OPEN_MODE_WRITE) && (entry_size == 0))
+            entry_size = -1;
+        err = mz_zip_codec_find(zip->file_info.compression_method, codec_flags,
+            entry_size, zip->codec_name, &codec);
+        if (err != MZ_OK)
+            return MZ_SUPPORT_ERROR;
     }
 
 #ifndef HAVE_WZAES
@@ -1656,7 +2879,8 @@ static int32_t mz_zip_entry_open_int(void *handle, uint8_t raw, int16_t compress
     if ((err == MZ_OK) && (use_crypt)) {
 #ifdef HAVE_WZAES
         if (zip->file_info.aes_version) {
-            mz_stream_wzaes_create(&zip->crypt_stream);
+            zip->crypt_pool = MZ_ZIP_POOL_WZAES;
+            zip->crypt_stream = mz_zip_pool_get(handle, zip->crypt_pool, mz_stream_wzaes_create);
             mz_stream_wzaes_set_password(zip->crypt_stream, password);
             mz_stream_wzaes_set_encryption_mode(zip->crypt_stream, zip->file_info.aes_encryption_mode);
         } else
@@ -1681,7 +2905,8 @@ static int32_t mz_zip_entry_open_int(void *handle, uint8_t raw, int16_t compress
                 verify2 = (uint8_t)((zip->file_info.crc >> 24) & 0xff);
             }
 
-            mz_stream_pkcrypt_create(&zip->crypt_stream);
+            zip->crypt_pool = MZ_ZIP_POOL_PKCRYPT;
+            zip->crypt_stream = mz_zip_pool_get(handle, zip->crypt_pool, mz_stream_pkcrypt_create);
             mz_stream_pkcrypt_set_password(zip->crypt_stream, password);
             mz_stream_pkcrypt_set_verify(zip->crypt_stream, verify1, verify2);
 #endif
@@ -1689,51 +2914,47 @@ static int32_t mz_zip_entry_open_int(void *handle, uint8_t raw, int16_t compress
     }
 
     if (err == MZ_OK) {
-        if (zip->crypt_stream == NULL)
-            mz_stream_raw_create(&zip->crypt_stream);
+        if (zip->crypt_stream == NULL) {
+            zip->crypt_pool = MZ_ZIP_POOL_RAW_CRYPT;
+            zip->crypt_stream = mz_zip_pool_get(handle, zip->crypt_pool, mz_stream_raw_create);
+        }
 
         mz_stream_set_base(zip->crypt_stream, zip->stream);
+        if (zip->stats != NULL)
+            mz_stream_set_stats(zip->crypt_stream, &zip->stats->crypt);
+        mz_stream_set_alloc(zip->crypt_stream, zip->alloc);
 
         err = mz_stream_open(zip->crypt_stream, NULL, zip->open_mode);
     }
 
     if (err == MZ_OK) {
-        if (zip->entry_raw || zip->file_info.compression_method == MZ_COMPRESS_METHOD_STORE)
-            mz_stream_raw_create(&zip->compress_stream);
-#if defined(HAVE_ZLIB) || defined(HAVE_LIBCOMP)
-        else if (zip->file_info.compression_method == MZ_COMPRESS_METHOD_DEFLATE)
-            mz_stream_zlib_create(&zip->compress_stream);
-#endif
-#ifdef HAVE_BZIP2
-        else if (zip->file_info.compression_method == MZ_COMPRESS_METHOD_BZIP2)
-            mz_stream_bzip_create(&zip->compress_stream);
-#endif
-#ifdef HAVE_LIBCOMP
-        else if (zip->file_info.compression_method == MZ_COMPRESS_METHOD_XZ) {
-            mz_stream_libcomp_create(&zip->compress_stream);
-            mz_stream_set_prop_int64(zip->compress_stream, MZ_STREAM_PROP_COMPRESS_METHOD,
-                zip->file_info.compression_method);
+        if (zip->entry_raw || zip->file_info.compression_method == MZ_COMPRESS_METHOD_STORE) {
+            zip->compress_pool = MZ_ZIP_POOL_STORE;
+            zip->compress_stream = mz_zip_pool_get(handle, zip->compress_pool, mz_stream_raw_create);
         }
-#endif
-#ifdef HAVE_LZMA
-        else if (zip->file_info.compression_method == MZ_COMPRESS_METHOD_LZMA ||
-                 zip->file_info.compression_method == MZ_COMPRESS_METHOD_XZ) {
-            mz_stream_lzma_create(&zip->compress_stream);
+        else {
+            zip->compress_create = codec->create;
+            zip->compress_pool = mz_zip_codec_pool(codec->create);
+            zip->compress_stream = mz_zip_pool_get(handle, zip->compress_pool, codec->create);
+            /* Codecs handling more than one method are told which one the entry uses */
             mz_stream_set_prop_int64(zip->compress_stream, MZ_STREAM_PROP_COMPRESS_METHOD,
                 zip->file_info.compression_method);
         }
-#endif
-#ifdef HAVE_ZSTD
-        else if (zip->file_info.compression_method == MZ_COMPRESS_METHOD_ZSTD)
-            mz_stream_zstd_create(&zip->compress_stream);
-#endif
-        else
-            err = MZ_PARAM_ERROR;
+        if (zip->compress_stream == NULL)
+            err = MZ_MEM_ERROR;
     }
 
+    if ((err == MZ_OK) && (zip->entry_dict) && (!zip->entry_raw) &&
+        (zip->file_info.compression_method != MZ_COMPRESS_METHOD_STORE))
+        err = mz_zip_dict_apply(handle, compress_level);
+
     if (err == MZ_OK) {
         if (zip->open_mode & MZ_OPEN_MODE_WRITE) {
             mz_stream_set_prop_int64(zip->compress_stream, MZ_STREAM_PROP_COMPRESS_LEVEL, compress_level);
+            /* Codecs without independent frames ignore the property */
+            if (!zip->entry_raw)
+                mz_stream_set_prop_int64(zip->compress_stream, MZ_STREAM_PROP_COMPRESS_FRAME_SIZE,
+                    zip->frame_size);
         } else {
             int32_t set_end_of_stream = 0;
 
@@ -1768,9 +2989,21 @@ static int32_t mz_zip_entry_open_int(void *handle, uint8_t raw, int16_t compress
                 mz_stream_set_prop_int64(zip->compress_stream, MZ_STREAM_PROP_TOTAL_IN_MAX, zip->file_info.compressed_size);
                 mz_stream_set_prop_int64(zip->compress_stream, MZ_STREAM_PROP_TOTAL_OUT_MAX, zip->file_info.uncompressed_size);
             }
+#ifdef HAVE_LIBDEFLATE
+            /* Known sizes let small deflate entries be inflated in one call */
+            if ((!zip->entry_raw) && (zip->file_info.compression_method == MZ_COMPRESS_METHOD_DEFLATE)) {
+                if (max_total_in == 0)
+                    max_total_in = zip->file_info.compressed_size;
+                mz_stream_set_prop_int64(zip->compress_stream, MZ_STREAM_PROP_TOTAL_IN_MAX, max_total_in);
+                mz_stream_set_prop_int64(zip->compress_stream, MZ_STREAM_PROP_TOTAL_OUT_MAX, zip->file_info.uncompressed_size);
+            }
+#endif
         }
 
         mz_stream_set_base(zip->compress_stream, zip->crypt_stream);
+        if (zip->stats != NULL)
+            mz_stream_set_stats(zip->compress_stream, &zip->stats->compress);
+        mz_stream_set_alloc(zip->compress_stream, zip->alloc);
 
         err = mz_stream_open(zip->compress_stream, NULL, zip->open_mode);
     }
@@ -1778,6 +3011,7 @@ static int32_t mz_zip_entry_open_int(void *handle, uint8_t raw, int16_t compress
     if (err == MZ_OK) {
         zip->entry_opened = 1;
         zip->entry_crc32 = 0;
+        zip->entry_seeked = 0;
     } else {
         mz_zip_entry_close_int(handle);
     }
@@ -1794,10 +3028,9 @@ int32_t mz_zip_entry_is_open(void *handle) {
     return MZ_OK;
 }
 
-static int32_t mz_zip_seek_to_local_header(void *handle) {
+static int32_t mz_zip_seek_to_disk_offset(void *handle, uint32_t disk_number, int64_t disk_offset) {
     mz_zip *zip = (mz_zip *)handle;
     int64_t disk_size = 0;
-    uint32_t disk_number = zip->file_info.disk_number;
 
     if (disk_number == zip->disk_number_with_cd) {
         mz_stream_get_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_SIZE, &disk_size);
@@ -1808,18 +3041,67 @@ static int32_t mz_zip_seek_to_local_header(void *handle) {
     mz_stream_set_prop_int64(zip->stream, MZ_STREAM_PROP_DISK_NUMBER, disk_number);
 
     mz_zip_print("Zip - Entry - Seek local (disk %" PRId32 " offset %" PRId64 ")\n",
-        disk_number, zip->file_info.disk_offset);
+        disk_number, disk_offset);
 
     /* Guard against seek overflows */
     if ((zip->disk_offset_shift > 0) &&
-        (zip->file_info.disk_offset > (INT64_MAX - zip->disk_offset_shift)))
+        (disk_offset > (INT64_MAX - zip->disk_offset_shift)))
         return MZ_FORMAT_ERROR;
 
-    return mz_stream_seek(zip->stream, zip->file_info.disk_offset + zip->disk_offset_shift, MZ_SEEK_SET);
+    return mz_stream_seek(zip->stream, disk_offset + zip->disk_offset_shift, MZ_SEEK_SET);
+}
+
+static int32_t mz_zip_seek_to_local_header(void *handle) {
+    mz_zip *zip = (mz_zip *)handle;
+    return mz_zip_seek_to_disk_offset(handle, zip->file_info.disk_number, zip->file_info.disk_offset);
+}
+
+static int32_t mz_zip_dict_load(void *handle, uint32_t dict_id, int32_t dict_size, uint32_t disk_number,
+    int64_t disk_offset) {
+    mz_zip *zip = (mz_zip *)handle;
+    mz_zip_file dict_info;
+    uint8_t *dict = NULL;
+    int32_t err = MZ_OK;
+
+    /* Entries compressed with the same dictionary share the loaded copy */
+    if ((zip->dict != NULL) && (zip->dict_id == dict_id))
+        return MZ_OK;
+
+    mz_zip_print("Zip - Dictionary - Load (id %08" PRIx32 " size %" PRId32 " offset %" PRId64 ")\n",
+        dict_id, dict_size, disk_offset);
+
+    memset(&dict_info, 0, sizeof(dict_info));
+
+    err = mz_zip_seek_to_disk_offset(handle, disk_number, disk_offset);
+    if (err == MZ_OK)
+        err = mz_zip_entry_read_header(zip->stream, 1, &dict_info, zip->local_file_info_stream);
+    if ((err == MZ_OK) && ((dict_info.compression_method != MZ_COMPRESS_METHOD_STORE) ||
+        (dict_info.uncompressed_size != dict_size) || (dict_info.crc != dict_id)))
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK) {
+        dict = (uint8_t *)MZ_ALLOC(dict_size);
+        if (dict == NULL)
+            err = MZ_MEM_ERROR;
+    }
+    if ((err == MZ_OK) && (mz_stream_read(zip->stream, dict, dict_size) != dict_size))
+        err = MZ_READ_ERROR;
+    if ((err == MZ_OK) && (mz_crypt_crc32_update(0, dict, dict_size) != dict_id))
+        err = MZ_CRC_ERROR;
+
+    if (err == MZ_OK)
+        mz_zip_dict_assign(handle, dict, dict_size);
+    else if (dict != NULL)
+        MZ_FREE(dict);
+
+    return err;
 }
 
 int32_t mz_zip_entry_read_open(void *handle, uint8_t raw, const char *password) {
     mz_zip *zip = (mz_zip *)handle;
+    int64_t dict_disk_offset = 0;
+    uint32_t dict_disk_number = 0;
+    uint32_t dict_id = 0;
+    int32_t dict_size = 0;
     int32_t err = MZ_OK;
     int32_t err_shift = MZ_OK;
 
@@ -1836,7 +3118,18 @@ int32_t mz_zip_entry_read_open(void *handle, uint8_t raw, const char *password)
 
     mz_zip_print("Zip - Entry - Read open (raw %" PRId32 ")\n", raw);
 
-    err = mz_zip_seek_to_local_header(handle);
+    zip->entry_dict = 0;
+    if (mz_zip_dict_read_extrafield(&zip->file_info, &dict_id, &dict_size, &dict_disk_number,
+        &dict_disk_offset) == MZ_OK) {
+        zip->entry_dict = 1;
+        err = mz_zip_dict_load(handle, dict_id, dict_size, dict_disk_number, dict_disk_offset);
+        /* Raw data can still be read without the dictionary */
+        if (raw)
+            err = MZ_OK;
+    }
+
+    if (err == MZ_OK)
+        err = mz_zip_seek_to_local_header(handle);
     if (err == MZ_OK)
         err = mz_zip_entry_read_header(zip->stream, 1, &zip->local_file_info, zip->local_file_info_stream);
 
@@ -1851,6 +3144,10 @@ int32_t mz_zip_entry_read_open(void *handle, uint8_t raw, const char *password)
         }
     }
 
+    /* Data start is kept for positional reads of stored entries */
+    if (err == MZ_OK)
+        zip->entry_data_pos = mz_stream_tell(zip->stream);
+
 #ifdef MZ_ZIP_NO_DECOMPRESSION
     if (!raw && zip->file_info.compression_method != MZ_COMPRESS_METHOD_STORE)
         err = MZ_SUPPORT_ERROR;
@@ -1858,6 +3155,86 @@ int32_t mz_zip_entry_read_open(void *handle, uint8_t raw, const char *password)
     if (err == MZ_OK)
         err = mz_zip_entry_open_int(handle, raw, 0, password);
 
+    MZ_TRACE4(entry__read__open, zip->file_info.filename, zip->file_info.compression_method, raw, err);
+    return err;
+}
+
+static int32_t mz_zip_dict_write_extrafield(void *handle, const mz_zip_file *file_info, int16_t compress_level,
+    uint8_t raw) {
+    mz_zip *zip = (mz_zip *)handle;
+    void *file_extra_stream = NULL;
+    int64_t extrafield_start = 0;
+    int64_t disk_offset = 0;
+    uint32_t disk_number = 0;
+    uint32_t dict_id = 0;
+    int32_t dict_size = 0;
+    int32_t err = MZ_OK;
+    int32_t err_mem = MZ_OK;
+    uint16_t field_type = 0;
+    uint16_t field_length = 0;
+
+    zip->entry_dict = 0;
+
+    if (raw) {
+        /* Raw data must be stored with the same dictionary it was compressed with */
+        if (mz_zip_dict_read_extrafield(file_info, &dict_id, &dict_size, &disk_number, &disk_offset) == MZ_OK) {
+            if ((zip->dict == NULL) || (zip->dict_id != dict_id))
+                return MZ_SUPPORT_ERROR;
+            zip->entry_dict = 1;
+        }
+    } else if ((zip->dict != NULL) && (compress_level != 0) &&
+        (mz_zip_dict_is_supported(file_info->compression_method,
+            (file_info->uncompressed_size > 0) ? file_info->uncompressed_size : -1) == MZ_OK) &&
+        (mz_zip_attrib_is_dir(file_info->external_fa, file_info->version_madeby) != MZ_OK)) {
+        zip->entry_dict = 1;
+    }
+
+    extrafield_start = mz_stream_tell(zip->file_info_stream);
+
+    if (zip->entry_dict) {
+        err = mz_zip_extrafield_write(zip->file_info_stream, MZ_ZIP_EXTENSION_DICT, MZ_ZIP_DICT_FIELD_LENGTH);
+        if (err == MZ_OK)
+            err = mz_stream_write_uint32(zip->file_info_stream, zip->dict_id);
+        if (err == MZ_OK)
+            err = mz_stream_write_uint32(zip->file_info_stream, (uint32_t)zip->dict_size);
+        if (err == MZ_OK)
+            err = mz_stream_write_uint32(zip->file_info_stream, zip->dict_disk_number);
+        if (err == MZ_OK)
+            err = mz_stream_write_int64(zip->file_info_stream, zip->dict_disk_offset);
+        if (err == MZ_OK)
+            err = mz_stream_write_uint16(zip->file_info_stream, file_info->compression_method);
+    }
+
+    if ((err == MZ_OK) && (file_info->extrafield != NULL) && (file_info->extrafield_size > 0)) {
+        if (mz_zip_extrafield_contains(file_info->extrafield, file_info->extrafield_size,
+            MZ_ZIP_EXTENSION_DICT, NULL) != MZ_OK) {
+            mz_stream_write(zip->file_info_stream, file_info->extrafield, file_info->extrafield_size);
+        } else {
+            /* Drop the incoming dictionary field, it points into another archive */
+            mz_stream_mem_create(&file_extra_stream);
+            mz_stream_mem_set_buffer(file_extra_stream, (void *)file_info->extrafield,
+                file_info->extrafield_size);
+
+            while (err == MZ_OK) {
+                err_mem = mz_zip_extrafield_read(file_extra_stream, &field_type, &field_length);
+                if (err_mem != MZ_OK)
+                    break;
+                if (field_type == MZ_ZIP_EXTENSION_DICT) {
+                    err_mem = mz_stream_seek(file_extra_stream, field_length, MZ_SEEK_CUR);
+                    if (err_mem != MZ_OK)
+                        break;
+                    continue;
+                }
+                err = mz_zip_extrafield_write(zip->file_info_stream, field_type, field_length);
+                if (err == MZ_OK)
+                    err = mz_stream_copy(zip->file_info_stream, file_extra_stream, field_length);
+            }
+
+            mz_stream_mem_delete(&file_extra_stream);
+        }
+    }
+
+    zip->file_info.extrafield_size = (uint16_t)(mz_stream_tell(zip->file_info_stream) - extrafield_start);
     return err;
 }
 
@@ -1899,8 +3276,7 @@ int32_t mz_zip_entry_write_open(void *handle, const mz_zip_file *file_info, int1
     mz_stream_write_uint8(zip->file_info_stream, 0);
 
     extrafield_pos = mz_stream_tell(zip->file_info_stream);
-    if (file_info->extrafield != NULL)
-        mz_stream_write(zip->file_info_stream, file_info->extrafield, file_info->extrafield_size);
+    err = mz_zip_dict_write_extrafield(handle, file_info, compress_level, raw);
     mz_stream_write_uint8(zip->file_info_stream, 0);
 
     comment_pos = mz_stream_tell(zip->file_info_stream);
@@ -1966,6 +3342,8 @@ int32_t mz_zip_entry_write_open(void *handle, const mz_zip_file *file_info, int1
     if (err == MZ_OK)
         err = mz_zip_entry_open_int(handle, raw, compress_level, password);
 
+    MZ_TRACE4(entry__write__open, zip->file_info.filename, zip->file_info.compression_method,
+        compress_level, err);
     return err;
 }
 
@@ -1985,7 +3363,9 @@ int32_t mz_zip_entry_read(void *handle, void *buf, int32_t len) {
 
     /* Read entire entry even if uncompressed_size = 0, otherwise */
     /* aes encryption validation will fail if compressed_size > 0 */
+    MZ_TRACE1(codec__read__start, len);
     read = mz_stream_read(zip->compress_stream, buf, len);
+    MZ_TRACE1(codec__read__done, read);
     if (read > 0)
         zip->entry_crc32 = mz_crypt_crc32_update(zip->entry_crc32, buf, read);
 
@@ -1994,13 +3374,183 @@ int32_t mz_zip_entry_read(void *handle, void *buf, int32_t len) {
     return read;
 }
 
+int32_t mz_zip_entry_read_at(void *handle, int64_t offset, void *buf, int32_t len) {
+    mz_zip *zip = (mz_zip *)handle;
+    int64_t remaining = 0;
+
+    if (zip == NULL || mz_zip_entry_is_open(handle) != MZ_OK)
+        return MZ_PARAM_ERROR;
+    if ((zip->open_mode & MZ_OPEN_MODE_READ) == 0)
+        return MZ_PARAM_ERROR;
+    if (buf == NULL || offset < 0 || len < 0)
+        return MZ_PARAM_ERROR;
+    /* Only stored data maps one to one onto the bytes in the archive */
+    if (zip->file_info.compression_method != MZ_COMPRESS_METHOD_STORE)
+        return MZ_SUPPORT_ERROR;
+    if (zip->file_info.flag & MZ_ZIP_FLAG_ENCRYPTED)
+        return MZ_SUPPORT_ERROR;
+    /* Data is not followed across disks */
+    if (zip->disk_number_with_cd > 0)
+        return MZ_SUPPORT_ERROR;
+
+    /* Sizes that differ would read past the entry into the rest of the archive */
+    if (zip->file_info.uncompressed_size != zip->file_info.compressed_size)
+        return MZ_FORMAT_ERROR;
+
+    if (offset >= zip->file_info.uncompressed_size)
+        return 0;
+    remaining = zip->file_info.uncompressed_size - offset;
+    if (len > remaining)
+        len = (int32_t)remaining;
+
+    return mz_stream_read_at(zip->stream, zip->entry_data_pos + offset, buf, len);
+}
+
+#if defined(HAVE_ZLIB) && !defined(HAVE_LIBCOMP) && !defined(MZ_ZIP_NO_DECOMPRESSION)
+static int32_t mz_zip_entry_seek_data(void *handle, int64_t position) {
+    mz_zip *zip = (mz_zip *)handle;
+    int32_t err = MZ_OK;
+
+    /* Relative seek from the local header so data spanning disks is followed */
+    err = mz_zip_seek_to_local_header(handle);
+    if (err == MZ_OK)
+        err = mz_stream_seek(zip->stream, MZ_ZIP_SIZE_LD_ITEM +
+            (int64_t)zip->local_file_info.filename_size +
+            (int64_t)zip->local_file_info.extrafield_size +
+            position, MZ_SEEK_CUR);
+    return err;
+}
+
+static int32_t mz_zip_entry_is_indexable(void *handle) {
+    mz_zip *zip = (mz_zip *)handle;
+
+    if (zip == NULL || mz_zip_entry_is_open(handle) != MZ_OK)
+        return MZ_PARAM_ERROR;
+    if ((zip->open_mode & MZ_OPEN_MODE_READ) == 0)
+        return MZ_PARAM_ERROR;
+    /* Only plain deflate data inflated by zlib can be resumed from an access point */
+    if ((zip->entry_raw) || (zip->compress_create != mz_stream_zlib_create))
+        return MZ_SUPPORT_ERROR;
+    if (zip->file_info.flag & MZ_ZIP_FLAG_ENCRYPTED)
+        return MZ_SUPPORT_ERROR;
+    return MZ_OK;
+}
+#endif
+
+int32_t mz_zip_entry_build_index(void *handle, void *index, int64_t span) {
+#if defined(HAVE_ZLIB) && !defined(HAVE_LIBCOMP) && !defined(MZ_ZIP_NO_DECOMPRESSION)
+    mz_zip *zip = (mz_zip *)handle;
+    uint8_t *buf = NULL;
+    uint32_t crc32 = 0;
+    int32_t read = 0;
+    int32_t err = MZ_OK;
+
+    if (index == NULL || span <= 0)
+        return MZ_PARAM_ERROR;
+    err = mz_zip_entry_is_indexable(handle);
+    if (err != MZ_OK)
+        return err;
+
+    buf = (uint8_t *)MZ_ALLOC(INT16_MAX);
+    if (buf == NULL)
+        return MZ_MEM_ERROR;
+
+    err = mz_zip_entry_seek_data(handle, 0);
+    if (err == MZ_OK)
+        err = mz_stream_zlib_set_index(zip->compress_stream, index, span);
+
+    /* Whole entry is inflated once, which also verifies it */
+    while (err == MZ_OK) {
+        read = mz_stream_read(zip->compress_stream, buf, INT16_MAX);
+        if (read < 0)
+            err = read;
+        if (read <= 0)
+            break;
+        crc32 = mz_crypt_crc32_update(crc32, buf, read);
+    }
+
+    mz_stream_zlib_set_index(zip->compress_stream, NULL, 0);
+    MZ_FREE(buf);
+
+    if ((err == MZ_OK) && (crc32 != zip->file_info.crc))
+        err = MZ_CRC_ERROR;
+
+    zip->entry_crc32 = crc32;
+    zip->entry_seeked = 0;
+    return err;
+#else
+    MZ_UNUSED(handle);
+    MZ_UNUSED(index);
+    MZ_UNUSED(span);
+    return MZ_SUPPORT_ERROR;
+#endif
+}
+
+int32_t mz_zip_entry_seek(void *handle, void *index, int64_t offset) {
+    mz_zip *zip = (mz_zip *)handle;
+#if defined(HAVE_ZLIB) && !defined(HAVE_LIBCOMP) && !defined(MZ_ZIP_NO_DECOMPRESSION)
+    int64_t position = 0;
+    int64_t total_in = 0;
+    int64_t total_out = 0;
+#endif
+    int32_t err = MZ_OK;
+
+    if (zip == NULL || mz_zip_entry_is_open(handle) != MZ_OK || offset < 0)
+        return MZ_PARAM_ERROR;
+
+#if defined(HAVE_ZSTD) && !defined(MZ_ZIP_NO_DECOMPRESSION)
+    /* Zstd entries written as independent frames carry their own seek table */
+    if ((zip->compress_create == mz_stream_zstd_create) && (!zip->entry_raw) &&
+        ((zip->open_mode & MZ_OPEN_MODE_READ) != 0) &&
+        ((zip->file_info.flag & MZ_ZIP_FLAG_ENCRYPTED) == 0)) {
+        if (offset > zip->file_info.uncompressed_size)
+            return MZ_PARAM_ERROR;
+        err = mz_stream_seek(zip->compress_stream, offset, MZ_SEEK_SET);
+        zip->entry_seeked = 1;
+        return err;
+    }
+#endif
+
+#if defined(HAVE_ZLIB) && !defined(HAVE_LIBCOMP) && !defined(MZ_ZIP_NO_DECOMPRESSION)
+    if (index == NULL)
+        return MZ_PARAM_ERROR;
+    err = mz_zip_entry_is_indexable(handle);
+    if (err != MZ_OK)
+        return err;
+    if (offset > zip->file_info.uncompressed_size)
+        return MZ_PARAM_ERROR;
+
+    /* Index built for another entry would resume inflate at garbage */
+    err = mz_stream_zlib_index_get_totals(index, &total_in, &total_out);
+    if ((err == MZ_OK) && ((total_in != zip->file_info.compressed_size) ||
+        (total_out != zip->file_info.uncompressed_size)))
+        err = MZ_FORMAT_ERROR;
+
+    if (err == MZ_OK)
+        err = mz_stream_zlib_index_get_position(index, offset, &position);
+    if (err == MZ_OK)
+        err = mz_zip_entry_seek_data(handle, position);
+    if (err == MZ_OK)
+        err = mz_stream_zlib_seek_index(zip->compress_stream, index, offset);
+
+    zip->entry_seeked = 1;
+    return err;
+#else
+    MZ_UNUSED(index);
+    MZ_UNUSED(err);
+    return MZ_SUPPORT_ERROR;
+#endif
+}
+
 int32_t mz_zip_entry_write(void *handle, const void *buf, int32_t len) {
     mz_zip *zip = (mz_zip *)handle;
     int32_t written = 0;
 
     if (zip == NULL || mz_zip_entry_is_open(handle) != MZ_OK)
         return MZ_PARAM_ERROR;
+    MZ_TRACE1(codec__write__start, len);
     written = mz_stream_write(zip->compress_stream, buf, len);
+    MZ_TRACE1(codec__write__done, written);
     if (written > 0)
         zip->entry_crc32 = mz_crypt_crc32_update(zip->entry_crc32, buf, written);
 
@@ -2056,7 +3606,7 @@ int32_t mz_zip_entry_read_close(void *handle, uint32_t *crc32, int64_t *compress
     }
 
     /* If entire entry was not read verification will fail */
-    if ((err == MZ_OK) && (total_in > 0) && (!zip->entry_raw)) {
+    if ((err == MZ_OK) && (total_in > 0) && (!zip->entry_raw) && (!zip->entry_seeked)) {
 #ifdef HAVE_WZAES
         /* AES zip version AE-1 will expect a valid crc as well */
         if (zip->file_info.aes_version <= 0x0001)
@@ -2071,6 +3621,7 @@ int32_t mz_zip_entry_read_close(void *handle, uint32_t *crc32, int64_t *compress
         }
     }
 
+    MZ_TRACE3(entry__read__close, zip->file_info.filename, total_in, err);
     mz_zip_entry_close_int(handle);
 
     return err;
@@ -2166,11 +3717,52 @@ int32_t mz_zip_entry_write_close(void *handle, uint32_t crc32, int64_t compresse
 
     zip->number_entry += 1;
 
+    MZ_TRACE4(entry__write__close, zip->file_info.filename, zip->file_info.compressed_size,
+        zip->file_info.uncompressed_size, err);
     mz_zip_entry_close_int(handle);
 
     return err;
 }
 
+int32_t mz_zip_entry_write_rewind(void *handle) {
+    mz_zip *zip = (mz_zip *)handle;
+
+    if (zip == NULL || mz_zip_entry_is_open(handle) != MZ_OK)
+        return MZ_PARAM_ERROR;
+    if ((zip->open_mode & MZ_OPEN_MODE_WRITE) == 0 || zip->entry_raw)
+        return MZ_PARAM_ERROR;
+
+    mz_zip_print("Zip - Entry - Write rewind (disk %" PRId32 " offset %" PRId64 ")\n",
+        zip->file_info.disk_number, zip->file_info.disk_offset);
+
+    /* Close streams to release codec state, the data they flush is overwritten later */
+    mz_stream_close(zip->compress_stream);
+    if (zip->file_info.flag & MZ_ZIP_FLAG_ENCRYPTED) {
+        mz_stream_set_base(zip->crypt_stream, zip->stream);
+        mz_stream_close(zip->crypt_stream);
+    }
+
+    mz_zip_entry_close_int(handle);
+
+    return mz_zip_seek_to_local_header(handle);
+}
+
+int32_t mz_zip_entry_write_get_totals(void *handle, int64_t *total_in, int64_t *total_out) {
+    mz_zip *zip = (mz_zip *)handle;
+
+    if (zip == NULL || total_in == NULL || total_out == NULL)
+        return MZ_PARAM_ERROR;
+    if (mz_zip_entry_is_open(handle) != MZ_OK || (zip->open_mode & MZ_OPEN_MODE_WRITE) == 0)
+        return MZ_PARAM_ERROR;
+
+    *total_in = 0;
+    *total_out = 0;
+
+    /* Output counted by the codec includes data it has not passed down the stream yet */
+    mz_stream_get_prop_int64(zip->compress_stream, MZ_STREAM_PROP_TOTAL_IN, total_in);
+    return mz_stream_get_prop_int64(zip->compress_stream, MZ_STREAM_PROP_TOTAL_OUT, total_out);
+}
+
 int32_t mz_zip_entry_close(void *handle) {
     return mz_zip_entry_close_raw(handle, UINT64_MAX, 0);
 }
@@ -2697,6 +4289,9 @@ const char* mz_zip_get_compression_method_string(int32_t compression_method)
     case MZ_COMPRESS_METHOD_ZSTD:
         method = "zstd";
         break;
+    case MZ_COMPRESS_METHOD_DICT:
+        method = "dict";
+        break;
     }
     return method;
 }
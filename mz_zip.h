@@ -52,9 +52,36 @@ typedef struct mz_zip_file_s {
 
 } mz_zip_file, mz_zip_entry;
 
+typedef struct mz_zip_stats_s {
+    mz_stream_stats file;               /* file or memory stream */
+    mz_stream_stats buffered;           /* buffered stream */
+    mz_stream_stats split;              /* split disk stream */
+    mz_stream_stats crypt;              /* encryption stream of each entry */
+    mz_stream_stats compress;           /* compression stream of each entry */
+} mz_zip_stats;
+
+typedef struct mz_zip_codec_s {
+    uint16_t            method;         /* compression method handled */
+    const char          *name;          /* backend name, must stay valid while registered */
+    mz_stream_create_cb create;         /* creates the compression stream for an entry */
+    uint32_t            flags;          /* MZ_CODEC capabilities */
+    int32_t             priority;       /* highest priority codec that fits is chosen */
+    int64_t             max_entry_size; /* largest entry to use the codec for, 0 for any size */
+} mz_zip_codec;
+
+typedef struct mz_zip_recover_progress_s {
+    int64_t  position;                  /* bytes scanned for headers */
+    int64_t  total;                     /* size of the stream, 0 for split disks */
+    uint64_t entries;                   /* entries recovered so far */
+    uint64_t elapsed_ns;                /* time since recovery started */
+    uint64_t bytes_per_sec;             /* scan throughput */
+    uint8_t  finished;                  /* last report, recovery is complete */
+} mz_zip_recover_progress;
+
 /***************************************************************************/
 
 typedef int32_t (*mz_zip_locate_entry_cb)(void *handle, void *userdata, mz_zip_file *file_info);
+typedef void    (*mz_zip_recover_cb)(void *handle, void *userdata, const mz_zip_recover_progress *progress);
 
 /***************************************************************************/
 
@@ -85,9 +112,24 @@ int32_t mz_zip_set_version_madeby(void *handle, uint16_t version_madeby);
 int32_t mz_zip_set_recover(void *handle, uint8_t recover);
 /* Sets the ability to recover the central dir by reading local file headers */
 
+int32_t mz_zip_set_recover_cb(void *handle, void *userdata, mz_zip_recover_cb cb);
+/* Sets the callback for progress of central dir recovery, called at most every 250ms and once when done */
+
+int32_t mz_zip_set_recover_threads(void *handle, int32_t thread_count);
+/* Sets the number of threads that scan for signatures when recovering the central dir */
+
 int32_t mz_zip_set_data_descriptor(void *handle, uint8_t data_descriptor);
 /* Sets the use of data descriptor flag when writing zip entries */
 
+int32_t mz_zip_set_stats(void *handle, mz_zip_stats *stats);
+/* Sets the counters updated by the crypt and compress streams of each entry */
+
+int32_t mz_zip_set_alloc(void *handle, mz_alloc *alloc);
+/* Sets the allocator used for codec state and the global comment, must be set before opening */
+
+int32_t mz_zip_set_low_memory(void *handle, uint8_t low_memory);
+/* Sets whether entry streams are freed when the entry is closed instead of kept for the next */
+
 int32_t mz_zip_get_stream(void *handle, void **stream);
 /* Get a pointer to the stream used to open */
 
@@ -109,6 +151,36 @@ int32_t mz_zip_set_disk_number_with_cd(void *handle, uint32_t disk_number_with_c
 int32_t mz_zip_get_disk_number_with_cd(void *handle, uint32_t *disk_number_with_cd);
 /* Get the disk number containing the central directory record */
 
+int32_t mz_zip_get_eocd_pos(void *handle, int64_t *eocd_pos);
+/* Get the position of the end of central directory record found when opening */
+
+int32_t mz_zip_set_eocd_pos_hint(void *handle, int64_t eocd_pos);
+/* Sets where to check for the end of central directory record before searching for it */
+
+int32_t mz_zip_set_dictionary(void *handle, const void *dict, int32_t dict_size);
+/* Sets the dictionary used to compress deflate and zstd entries, in write mode it is stored in the zip */
+
+int32_t mz_zip_get_dictionary(void *handle, const void **dict, int32_t *dict_size);
+/* Get the dictionary set or last loaded for reading an entry */
+
+int32_t mz_zip_set_codec(void *handle, const char *name);
+/* Sets the name of the codec preferred for entries it is able to handle */
+
+int32_t mz_zip_set_frame_size(void *handle, int32_t frame_size);
+/* Sets the size zstd entries are split into independent frames at, 0 for a single frame */
+
+/***************************************************************************/
+
+int32_t mz_zip_codec_register(const mz_zip_codec *codec);
+/* Adds a codec or replaces the one with the same method and name, not thread safe */
+
+int32_t mz_zip_codec_unregister(uint16_t method, const char *name);
+/* Removes a registered codec, not thread safe */
+
+int32_t mz_zip_codec_find(uint16_t method, uint32_t flags, int64_t entry_size, const char *name,
+    const mz_zip_codec **codec);
+/* Finds the codec used for an entry, preferring the named one and then the highest priority */
+
 /***************************************************************************/
 
 int32_t mz_zip_entry_is_open(void *handle);
@@ -120,10 +192,19 @@ int32_t mz_zip_entry_read_open(void *handle, uint8_t raw, const char *password);
 int32_t mz_zip_entry_read(void *handle, void *buf, int32_t len);
 /* Read bytes from the current file in the zip file */
 
+int32_t mz_zip_entry_read_at(void *handle, int64_t offset, void *buf, int32_t len);
+/* Read bytes at an offset in the current stored file without moving the stream, safe to call concurrently */
+
 int32_t mz_zip_entry_read_close(void *handle, uint32_t *crc32, int64_t *compressed_size,
     int64_t *uncompressed_size);
 /* Close the current file for reading and get data descriptor values */
 
+int32_t mz_zip_entry_build_index(void *handle, void *index, int64_t span);
+/* Inflate the current file recording access points at least span bytes apart into a zlib index */
+
+int32_t mz_zip_entry_seek(void *handle, void *index, int64_t offset);
+/* Move to an uncompressed offset in the current file, from the nearest access point or zstd frame */
+
 int32_t mz_zip_entry_write_open(void *handle, const mz_zip_file *file_info,
     int16_t compress_level, uint8_t raw, const char *password);
 /* Open for writing the current file in the zip file */
@@ -135,6 +216,12 @@ int32_t mz_zip_entry_write_close(void *handle, uint32_t crc32, int64_t compresse
     int64_t uncompressed_size);
 /* Close the current file for writing and set data descriptor values */
 
+int32_t mz_zip_entry_write_rewind(void *handle);
+/* Discard the data written for the current file and seek back to its local header */
+
+int32_t mz_zip_entry_write_get_totals(void *handle, int64_t *total_in, int64_t *total_out);
+/* Get the bytes consumed and produced so far by the compression of the current file */
+
 int32_t mz_zip_entry_close_raw(void *handle, int64_t uncompressed_size, uint32_t crc32);
 /* Close the current file in the zip file where raw is compressed data */
 
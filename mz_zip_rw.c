@@ -17,6 +17,9 @@
 #include "mz_strm_os.h"
 #include "mz_strm_split.h"
 #include "mz_strm_wzaes.h"
+#ifdef HAVE_ZSTD
+#  include "mz_strm_zstd.h"
+#endif
 #include "mz_zip.h"
 
 #include "mz_zip_rw.h"
@@ -27,20 +30,80 @@
 
 #define MZ_ZIP_CD_FILENAME              ("__cdcd__")
 
+#define MZ_ZIP_READER_MAP_SIZE          (1024 * 1024)
+#define MZ_ZIP_READER_DIRECT_CHUNK      (1024 * 1024)
+
+#define MZ_ZIP_SIDECAR_SUFFIX           (".mzi")
+#define MZ_ZIP_SIDECAR_MAGIC            (0x49585a4d) /* MZXI */
+#define MZ_ZIP_SIDECAR_VERSION          (1)
+#define MZ_ZIP_SIDECAR_BUCKETS_MIN      (16)
+#define MZ_ZIP_SIDECAR_CRC_CHUNK        (64 * 1024)
+
+#define MZ_ZIP_AUTO_SAMPLE_MIN          (1024)
+#define MZ_ZIP_AUTO_STORE_SYMBOLS       (224)
+#define MZ_ZIP_AUTO_FAST_SYMBOLS        (128)
+#define MZ_ZIP_AUTO_PROBE_SIZE          (1024 * 1024)
+#define MZ_ZIP_AUTO_PROBE_RATIO         (90)
+#define MZ_ZIP_AUTO_MATCH_BITS          (12)
+
+#define MZ_ZIP_DEDUP_TABLE_SIZE         (256)
+
+#define MZ_ZIP_DICT_SAMPLE_MAX          (64 * 1024)
+#define MZ_ZIP_DICT_SAMPLE_COUNT        (256)
+#define MZ_ZIP_DICT_SAMPLE_MIN          (8)
+#define MZ_ZIP_DICT_SAMPLE_FACTOR       (8)
+#define MZ_ZIP_DICT_DEFLATE_MAX         (32 * 1024)
+#define MZ_ZIP_DICT_METHOD_COUNT        (2)
+
+/***************************************************************************/
+
+/* Sidecar index file: header, entry table, hash buckets and string pool. Sections are
+   addressed by offsets from the start of the file so it can be used where it is mapped. */
+typedef struct mz_zip_sidecar_header_s {
+    uint32_t    magic;              /* also rejects files written with the other byte order */
+    uint32_t    version;
+    int64_t     archive_size;
+    int64_t     archive_modified;
+    int64_t     eocd_pos;
+    int64_t     cd_start;
+    int64_t     cd_end;
+    uint64_t    entry_count;
+    uint32_t    cd_crc32;           /* crc32 of the central directory records */
+    uint32_t    bucket_count;       /* power of two */
+    int64_t     entries_offset;
+    int64_t     buckets_offset;
+    int64_t     strings_offset;
+    int64_t     strings_size;
+} mz_zip_sidecar_header;
+
+typedef struct mz_zip_sidecar_entry_s {
+    int64_t     cd_pos;             /* position of the entry in the central directory */
+    int64_t     filename_offset;    /* offset of the zero terminated filename in the string pool */
+    uint32_t    filename_size;
+    uint32_t    hash;
+    uint32_t    next;               /* one based index of the next entry in the bucket, 0 for none */
+    uint32_t    reserved;
+} mz_zip_sidecar_entry;
+
 /***************************************************************************/
 
 typedef struct mz_zip_reader_s {
     void        *zip_handle;
+    void        *zip_spare;     /* closed zip handle kept for the next open */
     void        *file_stream;
     void        *buffered_stream;
     void        *split_stream;
     void        *mem_stream;
+    mz_zip_stats
+                *stats;
+    mz_alloc    *alloc;
     void        *hash;
     uint16_t    hash_algorithm;
     uint16_t    hash_digest_size;
     mz_zip_file *file_info;
     const char  *pattern;
     uint8_t     pattern_ignore_case;
+    void        *patterns;      /* pattern set, takes the place of pattern */
     const char  *password;
     void        *overwrite_userdata;
     mz_zip_reader_overwrite_cb
@@ -55,18 +118,88 @@ typedef struct mz_zip_reader_s {
     void        *entry_userdata;
     mz_zip_reader_entry_cb
                 entry_cb;
+    void        *timing_userdata;
+    mz_zip_reader_timing_cb
+                timing_cb;
+    mz_zip_stats
+                timing_stats;
+    mz_zip_stats
+                timing_start;
+    mz_zip_entry_timing
+                timing;
+    void        *test_userdata;
+    mz_zip_reader_test_cb
+                test_cb;
+    int32_t     test_threads;
     uint8_t     raw;
-    uint8_t     buffer[UINT16_MAX];
+    uint8_t     *buffer;        /* allocated on first save */
+    uint8_t     low_memory;
     int32_t     encoding;
     uint8_t     sign_required;
     uint8_t     cd_verified;
     uint8_t     cd_zipped;
     uint8_t     entry_verified;
     uint8_t     recover;
+    void        *recover_userdata;
+    mz_zip_recover_cb
+                recover_cb;
+    int32_t     recover_threads;
+    uint8_t     ordered;
+    uint8_t     drop_cache;
+    int64_t     eocd_pos_hint;
+    char        *cache_path;    /* last archive opened by path and where its end of central dir was */
+    int64_t     cache_size;
+    time_t      cache_modified;
+    int64_t     cache_eocd_pos;
+    uint8_t     sidecar;
+    const uint8_t
+                *sidecar_map;   /* sidecar index of the archive opened by path */
+    int64_t     sidecar_size;
 } mz_zip_reader;
 
 /***************************************************************************/
 
+static int64_t mz_zip_timing_layer(const mz_stream_stats *stats, const mz_stream_stats *start, uint8_t write) {
+    if (write)
+        return (stats->write_time - start->write_time) + (stats->seek_time - start->seek_time);
+    return (stats->read_time - start->read_time) + (stats->seek_time - start->seek_time);
+}
+
+static int64_t mz_zip_timing_calls(const mz_stream_stats *stats, const mz_stream_stats *start) {
+    return (stats->read_calls - start->read_calls) + (stats->write_calls - start->write_calls) +
+        (stats->seek_calls - start->seek_calls);
+}
+
+static void mz_zip_timing_end(mz_zip_entry_timing *timing, const mz_zip_stats *stats,
+    const mz_zip_stats *start, uint8_t write) {
+    int64_t io_time = 0;
+    int64_t crypt_time = 0;
+    int64_t compress_time = 0;
+
+    if (stats == NULL)
+        return;
+
+    /* Each layer's time includes the layers below it, so peel them off from the
+       outermost archive stream that saw any calls during the entry */
+    if (mz_zip_timing_calls(&stats->split, &start->split) > 0)
+        io_time = mz_zip_timing_layer(&stats->split, &start->split, write);
+    else if (mz_zip_timing_calls(&stats->buffered, &start->buffered) > 0)
+        io_time = mz_zip_timing_layer(&stats->buffered, &start->buffered, write);
+    else
+        io_time = mz_zip_timing_layer(&stats->file, &start->file, write);
+
+    crypt_time = mz_zip_timing_layer(&stats->crypt, &start->crypt, write);
+    compress_time = mz_zip_timing_layer(&stats->compress, &start->compress, write);
+
+    timing->io_time = (uint64_t)io_time;
+    if (crypt_time > io_time)
+        timing->crypt_time = (uint64_t)(crypt_time - io_time);
+    if (compress_time > crypt_time)
+        timing->compress_time = (uint64_t)(compress_time - crypt_time);
+}
+
+/***************************************************************************/
+
 int32_t mz_zip_reader_is_open(void *handle) {
     mz_zip_reader *reader = (mz_zip_reader *)handle;
     if (reader == NULL)
@@ -76,6 +209,20 @@ int32_t mz_zip_reader_is_open(void *handle) {
     return MZ_OK;
 }
 
+static void mz_zip_reader_idle(void *handle) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+
+    /* Give back buffers that are only needed while reading, they are allocated again on demand */
+    if (!reader->low_memory)
+        return;
+    if (reader->buffered_stream != NULL)
+        mz_stream_buffered_release(reader->buffered_stream);
+    if (reader->buffer != NULL) {
+        MZ_FREE(reader->buffer);
+        reader->buffer = NULL;
+    }
+}
+
 int32_t mz_zip_reader_open(void *handle, void *stream) {
     mz_zip_reader *reader = (mz_zip_reader *)handle;
     int32_t err = MZ_OK;
@@ -83,8 +230,20 @@ int32_t mz_zip_reader_open(void *handle, void *stream) {
     reader->cd_verified = 0;
     reader->cd_zipped = 0;
 
-    mz_zip_create(&reader->zip_handle);
+    if (reader->zip_spare != NULL) {
+        reader->zip_handle = reader->zip_spare;
+        reader->zip_spare = NULL;
+    } else {
+        mz_zip_create(&reader->zip_handle);
+    }
     mz_zip_set_recover(reader->zip_handle, reader->recover);
+    mz_zip_set_recover_cb(reader->zip_handle, reader->recover_userdata, reader->recover_cb);
+    mz_zip_set_recover_threads(reader->zip_handle, reader->recover_threads);
+    mz_zip_set_stats(reader->zip_handle, reader->stats);
+    mz_zip_set_alloc(reader->zip_handle, reader->alloc);
+    mz_zip_set_low_memory(reader->zip_handle, reader->low_memory);
+    mz_zip_set_eocd_pos_hint(reader->zip_handle, reader->eocd_pos_hint);
+    reader->eocd_pos_hint = 0;
 
     err = mz_zip_open(reader->zip_handle, stream, MZ_OPEN_MODE_READ);
 
@@ -94,26 +253,239 @@ int32_t mz_zip_reader_open(void *handle, void *stream) {
     }
 
     mz_zip_reader_unzip_cd(reader);
+    mz_zip_reader_idle(handle);
+    return MZ_OK;
+}
+
+static uint32_t mz_zip_sidecar_hash(const char *filename) {
+    uint32_t hash = 2166136261u;
+    uint8_t c = 0;
+
+    /* Folded the same way as path comparisons so it serves case insensitive lookups too */
+    while (*filename != 0) {
+        c = (uint8_t)*filename++;
+        if (c == '\\')
+            c = '/';
+        else if (c >= 'A' && c <= 'Z')
+            c = (uint8_t)(c - 'A' + 'a');
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+static char *mz_zip_sidecar_path_create(const char *path, const char *suffix) {
+    char *sidecar_path = NULL;
+    size_t path_size = strlen(path);
+    size_t suffix_size = strlen(suffix);
+
+    sidecar_path = (char *)MZ_ALLOC(path_size + suffix_size + 1);
+    if (sidecar_path != NULL) {
+        memcpy(sidecar_path, path, path_size);
+        memcpy(sidecar_path + path_size, suffix, suffix_size + 1);
+    }
+    return sidecar_path;
+}
+
+static void mz_zip_reader_sidecar_close(void *handle) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    if (reader->sidecar_map != NULL)
+        mz_os_unmap_file(reader->sidecar_map, reader->sidecar_size);
+    reader->sidecar_map = NULL;
+    reader->sidecar_size = 0;
+}
+
+static int32_t mz_zip_reader_sidecar_open(void *handle, const char *path, int64_t file_size, time_t modified_date) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    const mz_zip_sidecar_header *header = NULL;
+    const void *map = NULL;
+    char *sidecar_path = NULL;
+    int64_t map_size = 0;
+    int32_t err = MZ_OK;
+
+    sidecar_path = mz_zip_sidecar_path_create(path, MZ_ZIP_SIDECAR_SUFFIX);
+    if (sidecar_path == NULL)
+        return MZ_MEM_ERROR;
+    err = mz_os_map_file(sidecar_path, &map, &map_size);
+    MZ_FREE(sidecar_path);
+    if (err != MZ_OK)
+        return err;
+
+    /* Only used when it was written for this version of the archive and its sections fit */
+    header = (const mz_zip_sidecar_header *)map;
+    if ((map_size < (int64_t)sizeof(mz_zip_sidecar_header)) ||
+        (header->magic != MZ_ZIP_SIDECAR_MAGIC) || (header->version != MZ_ZIP_SIDECAR_VERSION) ||
+        (header->archive_size != file_size) || (header->archive_modified != (int64_t)modified_date))
+        err = MZ_EXIST_ERROR;
+    else if ((header->entry_count > UINT32_MAX - 1) || (header->bucket_count == 0) ||
+        ((header->bucket_count & (header->bucket_count - 1)) != 0) ||
+        (header->entries_offset < (int64_t)sizeof(mz_zip_sidecar_header)) ||
+        (header->entries_offset % 8 != 0) || (header->buckets_offset % 4 != 0) ||
+        (header->entries_offset + (int64_t)(header->entry_count * sizeof(mz_zip_sidecar_entry)) > header->buckets_offset) ||
+        (header->buckets_offset + (int64_t)header->bucket_count * 4 > header->strings_offset) ||
+        (header->strings_size <= 0) || (header->strings_offset + header->strings_size != map_size) ||
+        (((const uint8_t *)map)[map_size - 1] != 0))
+        err = MZ_FORMAT_ERROR;
+
+    if (err != MZ_OK) {
+        mz_os_unmap_file(map, map_size);
+        return err;
+    }
+
+    reader->sidecar_map = (const uint8_t *)map;
+    reader->sidecar_size = map_size;
     return MZ_OK;
 }
 
+static int32_t mz_zip_reader_sidecar_locate(void *handle, const char *filename, uint8_t ignore_case) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    const mz_zip_sidecar_header *header = (const mz_zip_sidecar_header *)reader->sidecar_map;
+    const mz_zip_sidecar_entry *entries = NULL;
+    const mz_zip_sidecar_entry *entry = NULL;
+    const uint32_t *buckets = NULL;
+    const char *strings = NULL;
+    mz_zip_file *file_info = NULL;
+    uint32_t hash = 0;
+    uint32_t index = 0;
+    uint64_t visited = 0;
+    int32_t err = MZ_OK;
+
+    entries = (const mz_zip_sidecar_entry *)(reader->sidecar_map + header->entries_offset);
+    buckets = (const uint32_t *)(reader->sidecar_map + header->buckets_offset);
+    strings = (const char *)(reader->sidecar_map + header->strings_offset);
+
+    hash = mz_zip_sidecar_hash(filename);
+    index = buckets[hash & (header->bucket_count - 1)];
+    while ((index != 0) && (index <= header->entry_count) && (visited++ < header->entry_count)) {
+        entry = &entries[index - 1];
+        index = entry->next;
+        if (entry->hash != hash || entry->filename_offset < 0 || entry->filename_offset >= header->strings_size)
+            continue;
+        if (mz_zip_path_compare(strings + entry->filename_offset, filename, ignore_case) != 0)
+            continue;
+
+        /* The central directory has the final say in case the archive changed in place */
+        err = mz_zip_goto_entry(reader->zip_handle, entry->cd_pos);
+        if (err == MZ_OK)
+            err = mz_zip_entry_get_info(reader->zip_handle, &file_info);
+        if ((err == MZ_OK) && (mz_zip_path_compare(file_info->filename, filename, ignore_case) == 0))
+            return MZ_OK;
+        return MZ_EXIST_ERROR;
+    }
+    return MZ_END_OF_LIST;
+}
+
+static int32_t mz_zip_reader_sidecar_crc(void *handle, int64_t start, int64_t end, uint32_t *crc32) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    void *cd_stream = NULL;
+    uint8_t *buf = NULL;
+    int32_t read = 0;
+    int32_t err = MZ_OK;
+
+    /* Central directory is read from memory when it was stored zipped */
+    if (reader->cd_zipped)
+        err = mz_zip_get_cd_mem_stream(reader->zip_handle, &cd_stream);
+    else
+        err = mz_zip_get_stream(reader->zip_handle, &cd_stream);
+    if (err != MZ_OK)
+        return err;
+
+    buf = (uint8_t *)MZ_ALLOC(MZ_ZIP_SIDECAR_CRC_CHUNK);
+    if (buf == NULL)
+        return MZ_MEM_ERROR;
+
+    *crc32 = 0;
+    err = mz_stream_seek(cd_stream, start, MZ_SEEK_SET);
+    while ((err == MZ_OK) && (start < end)) {
+        read = MZ_ZIP_SIDECAR_CRC_CHUNK;
+        if (end - start < read)
+            read = (int32_t)(end - start);
+        read = mz_stream_read(cd_stream, buf, read);
+        if (read <= 0)
+            err = MZ_READ_ERROR;
+        else
+            *crc32 = mz_crypt_crc32_update(*crc32, buf, read);
+        start += read;
+    }
+
+    MZ_FREE(buf);
+    return err;
+}
+
 int32_t mz_zip_reader_open_file(void *handle, const char *path) {
     mz_zip_reader *reader = (mz_zip_reader *)handle;
+    const mz_zip_sidecar_header *header = NULL;
+    uint64_t number_entry = 0;
+    int64_t file_size = 0;
+    int64_t eocd_pos = 0;
+    time_t modified_date = 0;
+    uint32_t cd_crc32 = 0;
+    int32_t path_size = 0;
     int32_t err = MZ_OK;
 
 
     mz_zip_reader_close(handle);
 
-    mz_stream_os_create(&reader->file_stream);
-    mz_stream_buffered_create(&reader->buffered_stream);
-    mz_stream_split_create(&reader->split_stream);
+    /* Streams kept from the last open are reused */
+    if (reader->file_stream == NULL)
+        mz_stream_os_create(&reader->file_stream);
+    if (reader->buffered_stream == NULL)
+        mz_stream_buffered_create(&reader->buffered_stream);
+    if (reader->split_stream == NULL)
+        mz_stream_split_create(&reader->split_stream);
 
     mz_stream_set_base(reader->buffered_stream, reader->file_stream);
     mz_stream_set_base(reader->split_stream, reader->buffered_stream);
 
+    if (reader->stats != NULL) {
+        mz_stream_set_stats(reader->file_stream, &reader->stats->file);
+        mz_stream_set_stats(reader->buffered_stream, &reader->stats->buffered);
+        mz_stream_set_stats(reader->split_stream, &reader->stats->split);
+    }
+
+    /* Skip searching for the end of central dir if the archive has not changed since it was last opened */
+    file_size = mz_os_get_file_size(path);
+    if (mz_os_get_file_date(path, &modified_date, NULL, NULL) != MZ_OK)
+        modified_date = 0;
+    if ((reader->cache_path != NULL) && (strcmp(reader->cache_path, path) == 0) &&
+        (reader->cache_size == file_size) && (reader->cache_modified == modified_date))
+        reader->eocd_pos_hint = reader->cache_eocd_pos;
+    if (reader->sidecar && (mz_zip_reader_sidecar_open(handle, path, file_size, modified_date) == MZ_OK))
+        reader->eocd_pos_hint = ((const mz_zip_sidecar_header *)reader->sidecar_map)->eocd_pos;
+
     err = mz_stream_open(reader->split_stream, path, MZ_OPEN_MODE_READ);
     if (err == MZ_OK)
         err = mz_zip_reader_open(handle, reader->split_stream);
+    reader->eocd_pos_hint = 0;
+
+    if ((err == MZ_OK) && (reader->sidecar_map != NULL)) {
+        /* Drop the sidecar if the central directory is not the one it was written for, size and
+           date alone do not catch an entry renamed to a name of the same length */
+        header = (const mz_zip_sidecar_header *)reader->sidecar_map;
+        if ((mz_zip_get_eocd_pos(reader->zip_handle, &eocd_pos) != MZ_OK) || (eocd_pos != header->eocd_pos) ||
+            (mz_zip_get_number_entry(reader->zip_handle, &number_entry) != MZ_OK) ||
+            (number_entry != header->entry_count) ||
+            (mz_zip_goto_first_entry(reader->zip_handle) != MZ_OK) ||
+            (mz_zip_get_entry(reader->zip_handle) != header->cd_start) ||
+            (mz_zip_reader_sidecar_crc(handle, header->cd_start, header->cd_end, &cd_crc32) != MZ_OK) ||
+            (cd_crc32 != header->cd_crc32))
+            mz_zip_reader_sidecar_close(handle);
+    }
+    if (err != MZ_OK)
+        mz_zip_reader_sidecar_close(handle);
+
+    if ((err == MZ_OK) && (mz_zip_get_eocd_pos(reader->zip_handle, &eocd_pos) == MZ_OK)) {
+        path_size = (int32_t)strlen(path) + 1;
+        if ((reader->cache_path == NULL) || (strcmp(reader->cache_path, path) != 0)) {
+            if (reader->cache_path != NULL)
+                MZ_FREE(reader->cache_path);
+            reader->cache_path = (char *)MZ_ALLOC(path_size);
+            if (reader->cache_path != NULL)
+                memcpy(reader->cache_path, path, path_size);
+        }
+        reader->cache_size = file_size;
+        reader->cache_modified = modified_date;
+        reader->cache_eocd_pos = eocd_pos;
+    }
     return err;
 }
 
@@ -158,6 +530,8 @@ int32_t mz_zip_reader_open_file_in_memory(void *handle, const char *path) {
     mz_stream_os_close(file_stream);
     mz_stream_os_delete(&file_stream);
 
+    if (err == MZ_OK && reader->stats != NULL)
+        mz_stream_set_stats(reader->mem_stream, &reader->stats->file);
     if (err == MZ_OK)
         err = mz_zip_reader_open(handle, reader->mem_stream);
     if (err != MZ_OK)
@@ -184,37 +558,59 @@ int32_t mz_zip_reader_open_buffer(void *handle, uint8_t *buf, int32_t len, uint8
         mz_stream_mem_set_buffer(reader->mem_stream, buf, len);
     }
 
+    if (err == MZ_OK && reader->stats != NULL)
+        mz_stream_set_stats(reader->mem_stream, &reader->stats->file);
     if (err == MZ_OK)
         err = mz_zip_reader_open(handle, reader->mem_stream);
 
     return err;
 }
 
+static void mz_zip_reader_free(void *handle) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+
+    if (reader->zip_spare != NULL)
+        mz_zip_delete(&reader->zip_spare);
+    if (reader->split_stream != NULL)
+        mz_stream_split_delete(&reader->split_stream);
+    if (reader->buffered_stream != NULL)
+        mz_stream_buffered_delete(&reader->buffered_stream);
+    if (reader->file_stream != NULL)
+        mz_stream_os_delete(&reader->file_stream);
+    if (reader->buffer != NULL) {
+        MZ_FREE(reader->buffer);
+        reader->buffer = NULL;
+    }
+}
+
 int32_t mz_zip_reader_close(void *handle) {
     mz_zip_reader *reader = (mz_zip_reader *)handle;
     int32_t err = MZ_OK;
 
+    /* Unless in low memory mode, the zip handle, file streams and buffer are kept
+       so the next open does not allocate them again */
     if (reader->zip_handle != NULL) {
         err = mz_zip_close(reader->zip_handle);
-        mz_zip_delete(&reader->zip_handle);
+        if (reader->low_memory || reader->zip_spare != NULL)
+            mz_zip_delete(&reader->zip_handle);
+        else
+            reader->zip_spare = reader->zip_handle;
+        reader->zip_handle = NULL;
     }
 
-    if (reader->split_stream != NULL) {
+    if (reader->split_stream != NULL)
         mz_stream_split_close(reader->split_stream);
-        mz_stream_split_delete(&reader->split_stream);
-    }
 
-    if (reader->buffered_stream != NULL)
-        mz_stream_buffered_delete(&reader->buffered_stream);
-
-    if (reader->file_stream != NULL)
-        mz_stream_os_delete(&reader->file_stream);
+    mz_zip_reader_sidecar_close(handle);
 
     if (reader->mem_stream != NULL) {
         mz_stream_mem_close(reader->mem_stream);
         mz_stream_mem_delete(&reader->mem_stream);
     }
 
+    if (reader->low_memory)
+        mz_zip_reader_free(handle);
+
     return err;
 }
 
@@ -286,7 +682,10 @@ static int32_t mz_zip_reader_locate_entry_cb(void *handle, void *userdata, mz_zi
     mz_zip_reader *reader = (mz_zip_reader *)userdata;
     int32_t result = 0;
     MZ_UNUSED(handle);
-    result = mz_path_compare_wc(file_info->filename, reader->pattern, reader->pattern_ignore_case);
+    if (reader->patterns != NULL)
+        result = mz_pattern_match(reader->patterns, file_info->filename);
+    else
+        result = mz_path_compare_wc(file_info->filename, reader->pattern, reader->pattern_ignore_case);
     return result;
 }
 
@@ -300,7 +699,7 @@ int32_t mz_zip_reader_goto_first_entry(void *handle) {
     if (mz_zip_entry_is_open(reader->zip_handle) == MZ_OK)
         mz_zip_reader_entry_close(handle);
 
-    if (reader->pattern == NULL)
+    if (reader->pattern == NULL && reader->patterns == NULL)
         err = mz_zip_goto_first_entry(reader->zip_handle);
     else
         err = mz_zip_locate_first_entry(reader->zip_handle, reader, mz_zip_reader_locate_entry_cb);
@@ -309,6 +708,7 @@ int32_t mz_zip_reader_goto_first_entry(void *handle) {
     if (err == MZ_OK)
         err = mz_zip_entry_get_info(reader->zip_handle, &reader->file_info);
 
+    mz_zip_reader_idle(handle);
     return err;
 }
 
@@ -322,7 +722,7 @@ int32_t mz_zip_reader_goto_next_entry(void *handle) {
     if (mz_zip_entry_is_open(reader->zip_handle) == MZ_OK)
         mz_zip_reader_entry_close(handle);
 
-    if (reader->pattern == NULL)
+    if (reader->pattern == NULL && reader->patterns == NULL)
         err = mz_zip_goto_next_entry(reader->zip_handle);
     else
         err = mz_zip_locate_next_entry(reader->zip_handle, reader, mz_zip_reader_locate_entry_cb);
@@ -331,6 +731,7 @@ int32_t mz_zip_reader_goto_next_entry(void *handle) {
     if (err == MZ_OK)
         err = mz_zip_entry_get_info(reader->zip_handle, &reader->file_info);
 
+    mz_zip_reader_idle(handle);
     return err;
 }
 
@@ -341,12 +742,169 @@ int32_t mz_zip_reader_locate_entry(void *handle, const char *filename, uint8_t i
     if (mz_zip_entry_is_open(reader->zip_handle) == MZ_OK)
         mz_zip_reader_entry_close(handle);
 
-    err = mz_zip_locate_entry(reader->zip_handle, filename, ignore_case);
+    err = MZ_EXIST_ERROR;
+    if (reader->sidecar_map != NULL)
+        err = mz_zip_reader_sidecar_locate(handle, filename, ignore_case);
+    if (err == MZ_EXIST_ERROR)
+        err = mz_zip_locate_entry(reader->zip_handle, filename, ignore_case);
 
     reader->file_info = NULL;
     if (err == MZ_OK)
         err = mz_zip_entry_get_info(reader->zip_handle, &reader->file_info);
 
+    mz_zip_reader_idle(handle);
+    return err;
+}
+
+int32_t mz_zip_reader_sidecar_save(void *handle) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    mz_zip_sidecar_header *header = NULL;
+    mz_zip_sidecar_entry *entries = NULL;
+    mz_zip_file *file_info = NULL;
+    uint32_t *buckets = NULL;
+    uint8_t *buf = NULL;
+    char *strings = NULL;
+    char *sidecar_path = NULL;
+    char *temp_path = NULL;
+    void *stream = NULL;
+    uint64_t count = 0;
+    uint64_t i = 0;
+    int64_t strings_size = 0;
+    int64_t buf_size = 0;
+    int64_t string_pos = 0;
+    uint32_t bucket_count = MZ_ZIP_SIDECAR_BUCKETS_MIN;
+    uint32_t bucket = 0;
+    int32_t written = 0;
+    int32_t err = MZ_OK;
+
+
+    /* Sidecar is keyed to the file, so the archive must have been opened by path */
+    if (mz_zip_reader_is_open(handle) != MZ_OK || reader->cache_path == NULL || reader->mem_stream != NULL)
+        return MZ_PARAM_ERROR;
+    if (mz_stream_is_open(reader->split_stream) != MZ_OK)
+        return MZ_PARAM_ERROR;
+    if (mz_zip_entry_is_open(reader->zip_handle) == MZ_OK)
+        mz_zip_reader_entry_close(handle);
+
+    /* Size the sections in a first pass over the central directory */
+    err = mz_zip_goto_first_entry(reader->zip_handle);
+    while (err == MZ_OK) {
+        err = mz_zip_entry_get_info(reader->zip_handle, &file_info);
+        if (err == MZ_OK) {
+            count += 1;
+            strings_size += (int64_t)file_info->filename_size + 1;
+            err = mz_zip_goto_next_entry(reader->zip_handle);
+        }
+    }
+    if (err == MZ_END_OF_LIST)
+        err = MZ_OK;
+    if ((err == MZ_OK) && (count > UINT32_MAX / 2))
+        err = MZ_SUPPORT_ERROR;
+    if (err != MZ_OK)
+        return err;
+    if (strings_size == 0)
+        strings_size = 1;
+    while (bucket_count < count)
+        bucket_count <<= 1;
+
+    buf_size = (int64_t)sizeof(mz_zip_sidecar_header) + (int64_t)(count * sizeof(mz_zip_sidecar_entry)) +
+        (int64_t)bucket_count * 4 + strings_size;
+    if ((int64_t)(size_t)buf_size != buf_size)
+        return MZ_MEM_ERROR;
+    buf = (uint8_t *)MZ_ALLOC((size_t)buf_size);
+    if (buf == NULL)
+        return MZ_MEM_ERROR;
+    memset(buf, 0, (size_t)buf_size);
+
+    header = (mz_zip_sidecar_header *)buf;
+    header->magic = MZ_ZIP_SIDECAR_MAGIC;
+    header->version = MZ_ZIP_SIDECAR_VERSION;
+    header->archive_size = reader->cache_size;
+    header->archive_modified = (int64_t)reader->cache_modified;
+    header->entry_count = count;
+    header->bucket_count = bucket_count;
+    header->entries_offset = sizeof(mz_zip_sidecar_header);
+    header->buckets_offset = header->entries_offset + (int64_t)(count * sizeof(mz_zip_sidecar_entry));
+    header->strings_offset = header->buckets_offset + (int64_t)bucket_count * 4;
+    header->strings_size = strings_size;
+    entries = (mz_zip_sidecar_entry *)(buf + header->entries_offset);
+    buckets = (uint32_t *)(buf + header->buckets_offset);
+    strings = (char *)(buf + header->strings_offset);
+
+    err = mz_zip_get_eocd_pos(reader->zip_handle, &header->eocd_pos);
+
+    /* Fill the entry table and string pool in a second pass */
+    if (err == MZ_OK)
+        err = mz_zip_goto_first_entry(reader->zip_handle);
+    header->cd_start = mz_zip_get_entry(reader->zip_handle);
+    for (i = 0; (err == MZ_OK) && (i < count); i += 1) {
+        err = mz_zip_entry_get_info(reader->zip_handle, &file_info);
+        if ((err == MZ_OK) && (string_pos + file_info->filename_size + 1 > strings_size))
+            err = MZ_FORMAT_ERROR;
+        if (err != MZ_OK)
+            break;
+        entries[i].cd_pos = mz_zip_get_entry(reader->zip_handle);
+        entries[i].filename_offset = string_pos;
+        entries[i].filename_size = file_info->filename_size;
+        entries[i].hash = mz_zip_sidecar_hash(file_info->filename);
+        memcpy(strings + string_pos, file_info->filename, file_info->filename_size);
+        string_pos += (int64_t)file_info->filename_size + 1;
+        err = mz_zip_goto_next_entry(reader->zip_handle);
+    }
+    if (err == MZ_END_OF_LIST && i == count)
+        err = MZ_OK;
+    header->cd_end = mz_zip_get_entry(reader->zip_handle);
+
+    /* Chain buckets back to front so duplicate names resolve to the first one like a scan */
+    for (i = count; (err == MZ_OK) && (i > 0); i -= 1) {
+        bucket = entries[i - 1].hash & (bucket_count - 1);
+        entries[i - 1].next = buckets[bucket];
+        buckets[bucket] = (uint32_t)i;
+    }
+
+    if (err == MZ_OK)
+        err = mz_zip_reader_sidecar_crc(handle, header->cd_start, header->cd_end, &header->cd_crc32);
+
+    /* Written next to the archive then renamed so readers never map a partial file */
+    if (err == MZ_OK) {
+        sidecar_path = mz_zip_sidecar_path_create(reader->cache_path, MZ_ZIP_SIDECAR_SUFFIX);
+        if (sidecar_path != NULL)
+            temp_path = mz_zip_sidecar_path_create(sidecar_path, ".tmp");
+        if (temp_path == NULL)
+            err = MZ_MEM_ERROR;
+    }
+    if (err == MZ_OK) {
+        mz_stream_os_create(&stream);
+        err = mz_stream_os_open(stream, temp_path, MZ_OPEN_MODE_CREATE | MZ_OPEN_MODE_WRITE);
+        for (i = 0; (err == MZ_OK) && ((int64_t)i < buf_size); i += written) {
+            written = INT32_MAX;
+            if (buf_size - (int64_t)i < written)
+                written = (int32_t)(buf_size - (int64_t)i);
+            written = mz_stream_os_write(stream, buf + i, written);
+            if (written <= 0)
+                err = MZ_WRITE_ERROR;
+        }
+        if ((mz_stream_os_close(stream) != MZ_OK) && (err == MZ_OK))
+            err = MZ_CLOSE_ERROR;
+        mz_stream_os_delete(&stream);
+
+        if ((err == MZ_OK) && (mz_os_rename(temp_path, sidecar_path) != MZ_OK)) {
+            /* Renaming over an existing file fails on some systems */
+            mz_os_unlink(sidecar_path);
+            err = mz_os_rename(temp_path, sidecar_path);
+        }
+        if (err != MZ_OK)
+            mz_os_unlink(temp_path);
+    }
+
+    if (sidecar_path != NULL)
+        MZ_FREE(sidecar_path);
+    if (temp_path != NULL)
+        MZ_FREE(temp_path);
+    MZ_FREE(buf);
+
+    reader->file_info = NULL;
+    mz_zip_reader_idle(handle);
     return err;
 }
 
@@ -357,6 +915,7 @@ int32_t mz_zip_reader_entry_open(void *handle) {
     int32_t err = MZ_OK;
     const char *password = NULL;
     char password_buf[120];
+    uint64_t open_time = 0;
 
 
     reader->entry_verified = 0;
@@ -370,6 +929,11 @@ int32_t mz_zip_reader_entry_open(void *handle) {
     if (mz_zip_entry_is_open(reader->zip_handle) == MZ_OK)
         return MZ_OK;
 
+    if (reader->timing_cb != NULL) {
+        memset(&reader->timing, 0, sizeof(reader->timing));
+        open_time = mz_os_ns_time();
+    }
+
     password = reader->password;
 
     /* Check if we need a password and ask for it if we need to */
@@ -411,6 +975,12 @@ int32_t mz_zip_reader_entry_open(void *handle) {
         err = MZ_SIGN_ERROR;
 #endif
 
+    if (reader->timing_cb != NULL) {
+        reader->timing.header_time = mz_os_ns_time() - open_time;
+        if (reader->stats != NULL)
+            memcpy(&reader->timing_start, reader->stats, sizeof(mz_zip_stats));
+    }
+
     return err;
 }
 
@@ -441,6 +1011,13 @@ int32_t mz_zip_reader_entry_close(void *handle) {
     err_close = mz_zip_entry_close(reader->zip_handle);
     if (err == MZ_OK)
         err = err_close;
+
+    if (reader->timing_cb != NULL) {
+        mz_zip_timing_end(&reader->timing, reader->stats, &reader->timing_start, 0);
+        reader->timing_cb(handle, reader->timing_userdata, reader->file_info, &reader->timing);
+    }
+
+    mz_zip_reader_idle(handle);
     return err;
 }
 
@@ -455,6 +1032,11 @@ int32_t mz_zip_reader_entry_read(void *handle, void *buf, int32_t len) {
     return read;
 }
 
+int32_t mz_zip_reader_entry_read_at(void *handle, int64_t offset, void *buf, int32_t len) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    return mz_zip_entry_read_at(reader->zip_handle, offset, buf, len);
+}
+
 int32_t mz_zip_reader_entry_has_sign(void *handle) {
     mz_zip_reader *reader = (mz_zip_reader *)handle;
 
@@ -596,6 +1178,7 @@ int32_t mz_zip_reader_entry_save_process(void *handle, void *stream, mz_stream_w
     int32_t err = MZ_OK;
     int32_t read = 0;
     int32_t written = 0;
+    uint64_t write_time = 0;
 
 
     if (mz_zip_reader_is_open(reader) != MZ_OK)
@@ -612,8 +1195,13 @@ int32_t mz_zip_reader_entry_save_process(void *handle, void *stream, mz_stream_w
     if (err != MZ_OK)
         return err;
 
+    if (reader->buffer == NULL)
+        reader->buffer = (uint8_t *)MZ_ALLOC(UINT16_MAX);
+    if (reader->buffer == NULL)
+        return MZ_MEM_ERROR;
+
     /* Unzip entry in zip file */
-    read = mz_zip_reader_entry_read(handle, reader->buffer, sizeof(reader->buffer));
+    read = mz_zip_reader_entry_read(handle, reader->buffer, UINT16_MAX);
 
     if (read == 0) {
         /* If we are done close the entry */
@@ -626,7 +1214,11 @@ int32_t mz_zip_reader_entry_save_process(void *handle, void *stream, mz_stream_w
 
     if (read > 0) {
         /* Write the data to the specified stream */
+        if (reader->timing_cb != NULL)
+            write_time = mz_os_ns_time();
         written = write_cb(stream, reader->buffer, read);
+        if (reader->timing_cb != NULL)
+            reader->timing.data_time += mz_os_ns_time() - write_time;
         if (written != read)
             return MZ_WRITE_ERROR;
     }
@@ -680,9 +1272,62 @@ int32_t mz_zip_reader_entry_save(void *handle, void *stream, mz_stream_write_cb
     return err;
 }
 
+static int32_t mz_zip_reader_entry_save_direct(void *handle, void *buf, int64_t len, int64_t *read) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    uint64_t current_time = 0;
+    uint64_t update_time = 0;
+    int64_t update_pos = 0;
+    int32_t chunk = 0;
+    int32_t err = MZ_OK;
+
+    *read = 0;
+
+    if (reader->progress_cb != NULL)
+        reader->progress_cb(handle, reader->progress_userdata, reader->file_info, *read);
+
+    /* Decompress straight into the destination, without going through our buffer */
+    if (mz_zip_entry_is_open(reader->zip_handle) != MZ_OK)
+        err = mz_zip_reader_entry_open(handle);
+    while ((err == MZ_OK) && (*read < len)) {
+        chunk = (len - *read > MZ_ZIP_READER_DIRECT_CHUNK) ? MZ_ZIP_READER_DIRECT_CHUNK : (int32_t)(len - *read);
+        chunk = mz_zip_reader_entry_read(handle, (uint8_t *)buf + *read, chunk);
+        if (chunk == 0)
+            break;
+        if (chunk < 0)
+            err = chunk;
+        else
+            *read += chunk;
+
+        /* Update progress if enough time have passed */
+        current_time = mz_os_ms_time();
+        if ((current_time - update_time) > reader->progress_cb_interval_ms) {
+            if (reader->progress_cb != NULL)
+                reader->progress_cb(handle, reader->progress_userdata, reader->file_info, *read);
+
+            update_pos = *read;
+            update_time = current_time;
+        }
+    }
+
+    /* Closing the entry checks the size and crc of what was read */
+    if (mz_zip_entry_is_open(reader->zip_handle) == MZ_OK) {
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_close(handle);
+        else
+            mz_zip_reader_entry_close(handle);
+    }
+
+    if (reader->progress_cb != NULL && update_pos != *read)
+        reader->progress_cb(handle, reader->progress_userdata, reader->file_info, *read);
+
+    return err;
+}
+
 int32_t mz_zip_reader_entry_save_file(void *handle, const char *path) {
     mz_zip_reader *reader = (mz_zip_reader *)handle;
     void *stream = NULL;
+    void *map = NULL;
+    int64_t read = 0;
     uint32_t target_attrib = 0;
     int32_t err_attrib = 0;
     int32_t err = MZ_OK;
@@ -745,10 +1390,22 @@ int32_t mz_zip_reader_entry_save_file(void *handle, const char *path) {
 
     /* Create the file on disk so we can save to it */
     mz_stream_os_create(&stream);
-    err = mz_stream_os_open(stream, pathwfs, MZ_OPEN_MODE_CREATE);
 
-    if (err == MZ_OK)
-        err = mz_zip_reader_entry_save(handle, stream, mz_stream_write);
+    if (!reader->raw && (reader->file_info->uncompressed_size >= MZ_ZIP_READER_MAP_SIZE)) {
+        /* Large files are decompressed straight into the mapped file where supported */
+        err = mz_stream_os_open(stream, pathwfs, MZ_OPEN_MODE_CREATE | MZ_OPEN_MODE_READWRITE);
+        if ((err == MZ_OK) && (mz_stream_os_map(stream, reader->file_info->uncompressed_size, &map) == MZ_OK)) {
+            err = mz_zip_reader_entry_save_direct(handle, map, reader->file_info->uncompressed_size, &read);
+            if (mz_stream_os_unmap(stream) != MZ_OK && err == MZ_OK)
+                err = MZ_WRITE_ERROR;
+        } else if (err == MZ_OK) {
+            err = mz_zip_reader_entry_save(handle, stream, mz_stream_write);
+        }
+    } else {
+        err = mz_stream_os_open(stream, pathwfs, MZ_OPEN_MODE_CREATE);
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_save(handle, stream, mz_stream_write);
+    }
 
     mz_stream_close(stream);
     mz_stream_delete(&stream);
@@ -773,8 +1430,7 @@ int32_t mz_zip_reader_entry_save_file(void *handle, const char *path) {
 
 int32_t mz_zip_reader_entry_save_buffer(void *handle, void *buf, int32_t len) {
     mz_zip_reader *reader = (mz_zip_reader *)handle;
-    void *mem_stream = NULL;
-    int32_t err = MZ_OK;
+    int64_t read = 0;
 
     if (mz_zip_reader_is_open(reader) != MZ_OK)
         return MZ_PARAM_ERROR;
@@ -785,16 +1441,7 @@ int32_t mz_zip_reader_entry_save_buffer(void *handle, void *buf, int32_t len) {
     if (len != (int32_t)reader->file_info->uncompressed_size)
         return MZ_BUF_ERROR;
 
-    /* Create a memory stream backed by our buffer and save to it */
-    mz_stream_mem_create(&mem_stream);
-    mz_stream_mem_set_buffer(mem_stream, buf, len);
-
-    err = mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_READ);
-    if (err == MZ_OK)
-        err = mz_zip_reader_entry_save(handle, mem_stream, mz_stream_mem_write);
-
-    mz_stream_mem_delete(&mem_stream);
-    return err;
+    return mz_zip_reader_entry_save_direct(handle, buf, len, &read);
 }
 
 int32_t mz_zip_reader_entry_save_buffer_length(void *handle) {
@@ -811,50 +1458,377 @@ int32_t mz_zip_reader_entry_save_buffer_length(void *handle) {
     return (int32_t)reader->file_info->uncompressed_size;
 }
 
-/***************************************************************************/
+typedef struct mz_zip_reader_batch_item_s {
+    mz_zip_reader_batch
+                *entry;
+    int64_t     cd_pos;
+    int64_t     disk_offset;
+    uint32_t    disk_number;
+} mz_zip_reader_batch_item;
 
-int32_t mz_zip_reader_save_all(void *handle, const char *destination_dir) {
+static int mz_zip_reader_batch_compare_name(const void *a, const void *b) {
+    const char *name1 = (*(const mz_zip_reader_batch_item **)a)->entry->filename;
+    const char *name2 = (*(const mz_zip_reader_batch_item **)b)->entry->filename;
+    char c1 = 0;
+    char c2 = 0;
+
+    /* Same order as mz_zip_path_compare, where both slashes are the same */
+    do {
+        c1 = (*name1 == '\\') ? '/' : *name1;
+        c2 = (*name2 == '\\') ? '/' : *name2;
+        name1 += 1;
+        name2 += 1;
+    } while (c1 != 0 && c1 == c2);
+
+    return (unsigned char)c1 - (unsigned char)c2;
+}
+
+static int mz_zip_reader_batch_compare_index(const void *a, const void *b) {
+    int64_t index1 = (*(const mz_zip_reader_batch_item **)a)->entry->index;
+    int64_t index2 = (*(const mz_zip_reader_batch_item **)b)->entry->index;
+    return (index1 > index2) - (index1 < index2);
+}
+
+static int mz_zip_reader_batch_compare_offset(const void *a, const void *b) {
+    const mz_zip_reader_batch_item *item1 = *(const mz_zip_reader_batch_item **)a;
+    const mz_zip_reader_batch_item *item2 = *(const mz_zip_reader_batch_item **)b;
+    if (item1->disk_number != item2->disk_number)
+        return (item1->disk_number > item2->disk_number) ? 1 : -1;
+    return (item1->disk_offset > item2->disk_offset) - (item1->disk_offset < item2->disk_offset);
+}
+
+static int32_t mz_zip_reader_batch_find(void *handle, mz_zip_reader_batch_item *items, int32_t count,
+    mz_zip_reader_batch_item **order) {
     mz_zip_reader *reader = (mz_zip_reader *)handle;
+    mz_zip_reader_batch_item key_item;
+    mz_zip_reader_batch_item *key = &key_item;
+    mz_zip_reader_batch_item **by_name = order;
+    mz_zip_reader_batch_item **by_index = NULL;
+    mz_zip_reader_batch_item **match = NULL;
+    mz_zip_reader_batch key_entry;
+    mz_zip_file *file_info = NULL;
+    int64_t index = 0;
+    int32_t name_count = 0;
+    int32_t index_count = 0;
+    int32_t next_index = 0;
     int32_t err = MZ_OK;
-    uint8_t *utf8_string = NULL;
-    char path[512];
-    char utf8_name[256];
-    char resolved_name[256];
+    int32_t i = 0;
 
-    err = mz_zip_reader_goto_first_entry(handle);
+    /* Entries asked for by name come first sorted by name, then those asked for by index */
+    for (i = 0; i < count; i += 1) {
+        if (items[i].entry->filename != NULL)
+            order[name_count++] = &items[i];
+    }
+    by_index = order + name_count;
+    for (i = 0; i < count; i += 1) {
+        if (items[i].entry->filename == NULL)
+            by_index[index_count++] = &items[i];
+    }
+    qsort(by_name, name_count, sizeof(mz_zip_reader_batch_item *), mz_zip_reader_batch_compare_name);
+    qsort(by_index, index_count, sizeof(mz_zip_reader_batch_item *), mz_zip_reader_batch_compare_index);
 
-    if (err == MZ_END_OF_LIST)
-        return err;
+    memset(&key_entry, 0, sizeof(key_entry));
+    key_item.entry = &key_entry;
 
+    /* Find all of the entries in one pass over the central directory */
+    err = mz_zip_goto_first_entry(reader->zip_handle);
     while (err == MZ_OK) {
-        /* Construct output path */
-        path[0] = 0;
-
-        strncpy(utf8_name, reader->file_info->filename, sizeof(utf8_name) - 1);
-        utf8_name[sizeof(utf8_name) - 1] = 0;
-
-        if ((reader->encoding > 0) && (reader->file_info->flag & MZ_ZIP_FLAG_UTF8) == 0) {
-            utf8_string = mz_os_utf8_string_create(reader->file_info->filename, reader->encoding);
-            if (utf8_string) {
-                strncpy(utf8_name, (char *)utf8_string, sizeof(utf8_name) - 1);
-                utf8_name[sizeof(utf8_name) - 1] = 0;
-                mz_os_utf8_string_delete(&utf8_string);
-            }
-        }
-
-        err = mz_path_resolve(utf8_name, resolved_name, sizeof(resolved_name));
+        err = mz_zip_entry_get_info(reader->zip_handle, &file_info);
         if (err != MZ_OK)
             break;
 
-        if (destination_dir != NULL)
-            mz_path_combine(path, destination_dir, sizeof(path));
+        while ((next_index < index_count) && (by_index[next_index]->entry->index < index))
+            next_index += 1;
+        for (i = next_index; (i < index_count) && (by_index[i]->entry->index == index); i += 1) {
+            by_index[i]->cd_pos = mz_zip_get_entry(reader->zip_handle);
+            by_index[i]->disk_offset = file_info->disk_offset;
+            by_index[i]->disk_number = file_info->disk_number;
+        }
 
-        mz_path_combine(path, resolved_name, sizeof(path));
+        if (name_count > 0) {
+            key_entry.filename = file_info->filename;
+            match = (mz_zip_reader_batch_item **)bsearch(&key, by_name, name_count,
+                sizeof(mz_zip_reader_batch_item *), mz_zip_reader_batch_compare_name);
+        }
+        if (match != NULL) {
+            /* The same name may be asked for more than once, the first entry with it is used */
+            while ((match > by_name) && (mz_zip_reader_batch_compare_name(match - 1, &key) == 0))
+                match -= 1;
+            for (; (match < by_name + name_count) && (mz_zip_reader_batch_compare_name(match, &key) == 0); match += 1) {
+                if ((*match)->cd_pos >= 0)
+                    break;
+                (*match)->cd_pos = mz_zip_get_entry(reader->zip_handle);
+                (*match)->disk_offset = file_info->disk_offset;
+                (*match)->disk_number = file_info->disk_number;
+            }
+            match = NULL;
+        }
 
-        /* Save file to disk */
-        err = mz_zip_reader_entry_save_file(handle, path);
+        index += 1;
+        err = mz_zip_goto_next_entry(reader->zip_handle);
+    }
 
-        if (err == MZ_OK)
+    if (err == MZ_END_OF_LIST)
+        err = MZ_OK;
+    return err;
+}
+
+static int32_t mz_zip_reader_batch_read(void *handle, mz_zip_reader_batch *entry) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    int32_t err = MZ_OK;
+
+    if (entry->buf == NULL) {
+        if (entry->write_cb == NULL)
+            return MZ_PARAM_ERROR;
+        err = mz_zip_reader_entry_save(handle, entry->stream, entry->write_cb);
+        if (err == MZ_OK)
+            entry->read = reader->file_info->uncompressed_size;
+        return err;
+    }
+
+    if (reader->file_info->uncompressed_size > entry->buf_size)
+        return MZ_BUF_ERROR;
+
+    return mz_zip_reader_entry_save_direct(handle, entry->buf, reader->file_info->uncompressed_size, &entry->read);
+}
+
+int32_t mz_zip_reader_read_batch(void *handle, mz_zip_reader_batch *entries, int32_t count) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    mz_zip_reader_batch_item *items = NULL;
+    mz_zip_reader_batch_item **order = NULL;
+    int32_t found = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    if (mz_zip_reader_is_open(handle) != MZ_OK)
+        return MZ_PARAM_ERROR;
+    if (entries == NULL || count < 0)
+        return MZ_PARAM_ERROR;
+    if (count == 0)
+        return MZ_OK;
+
+    if (mz_zip_entry_is_open(reader->zip_handle) == MZ_OK)
+        mz_zip_reader_entry_close(handle);
+
+    items = (mz_zip_reader_batch_item *)MZ_ALLOC(count * sizeof(mz_zip_reader_batch_item));
+    order = (mz_zip_reader_batch_item **)MZ_ALLOC(count * sizeof(mz_zip_reader_batch_item *));
+    if (items == NULL || order == NULL) {
+        MZ_FREE(items);
+        MZ_FREE(order);
+        return MZ_MEM_ERROR;
+    }
+
+    for (i = 0; i < count; i += 1) {
+        memset(&items[i], 0, sizeof(items[i]));
+        items[i].entry = &entries[i];
+        items[i].cd_pos = -1;
+        entries[i].read = 0;
+        entries[i].err = MZ_EXIST_ERROR;
+    }
+
+    err = mz_zip_reader_batch_find(handle, items, count, order);
+
+    /* Read the entries in the order they are stored, so the archive is read front to back
+       and local headers are mostly already in the buffered stream when they are sought */
+    if (err == MZ_OK) {
+        for (i = 0; i < count; i += 1) {
+            if (items[i].cd_pos >= 0)
+                order[found++] = &items[i];
+        }
+        qsort(order, found, sizeof(mz_zip_reader_batch_item *), mz_zip_reader_batch_compare_offset);
+    }
+
+    for (i = 0; i < found && err == MZ_OK; i += 1) {
+        err = mz_zip_goto_entry(reader->zip_handle, order[i]->cd_pos);
+        reader->file_info = NULL;
+        if (err == MZ_OK)
+            err = mz_zip_entry_get_info(reader->zip_handle, &reader->file_info);
+        if (err == MZ_OK)
+            order[i]->entry->err = mz_zip_reader_batch_read(handle, order[i]->entry);
+    }
+
+    /* Report the first entry that could not be read */
+    for (i = 0; i < count && err == MZ_OK; i += 1) {
+        if (entries[i].err != MZ_OK)
+            err = entries[i].err;
+    }
+
+    MZ_FREE(items);
+    MZ_FREE(order);
+
+    mz_zip_reader_idle(handle);
+    return err;
+}
+
+/***************************************************************************/
+
+static int32_t mz_zip_reader_save_all_entry(void *handle, const char *destination_dir) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    int32_t err = MZ_OK;
+    uint8_t *utf8_string = NULL;
+    char path[512];
+    char utf8_name[256];
+    char resolved_name[256];
+
+    /* Construct output path */
+    path[0] = 0;
+
+    strncpy(utf8_name, reader->file_info->filename, sizeof(utf8_name) - 1);
+    utf8_name[sizeof(utf8_name) - 1] = 0;
+
+    if ((reader->encoding > 0) && (reader->file_info->flag & MZ_ZIP_FLAG_UTF8) == 0) {
+        utf8_string = mz_os_utf8_string_create(reader->file_info->filename, reader->encoding);
+        if (utf8_string) {
+            strncpy(utf8_name, (char *)utf8_string, sizeof(utf8_name) - 1);
+            utf8_name[sizeof(utf8_name) - 1] = 0;
+            mz_os_utf8_string_delete(&utf8_string);
+        }
+    }
+
+    err = mz_path_resolve(utf8_name, resolved_name, sizeof(resolved_name));
+    if (err != MZ_OK)
+        return err;
+
+    if (destination_dir != NULL)
+        mz_path_combine(path, destination_dir, sizeof(path));
+
+    mz_path_combine(path, resolved_name, sizeof(path));
+
+    /* Save file to disk */
+    return mz_zip_reader_entry_save_file(handle, path);
+}
+
+typedef struct mz_zip_reader_plan_item_s {
+    int64_t     cd_pos;
+    int64_t     disk_offset;
+    int64_t     disk_end;
+    uint32_t    disk_number;
+} mz_zip_reader_plan_item;
+
+#define MZ_ZIP_READER_READ_AHEAD        (4 * 1024 * 1024)
+
+static int mz_zip_reader_plan_compare(const void *a, const void *b) {
+    const mz_zip_reader_plan_item *item1 = (const mz_zip_reader_plan_item *)a;
+    const mz_zip_reader_plan_item *item2 = (const mz_zip_reader_plan_item *)b;
+    if (item1->disk_number != item2->disk_number)
+        return (item1->disk_number > item2->disk_number) ? 1 : -1;
+    return (item1->disk_offset > item2->disk_offset) - (item1->disk_offset < item2->disk_offset);
+}
+
+static void mz_zip_reader_plan_advise(void *handle, mz_zip_reader_plan_item *items, int32_t count, int32_t index,
+    int64_t *advise_end) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    mz_zip_reader_plan_item *item = &items[index];
+    int64_t end = item->disk_end;
+    int32_t i = 0;
+
+    if (item->disk_offset < *advise_end)
+        return;
+
+    /* Ask for the entries in the next window on the same disk to be read in the background */
+    for (i = index + 1; i < count; i += 1) {
+        if (items[i].disk_number != item->disk_number)
+            break;
+        if (items[i].disk_end > item->disk_offset + MZ_ZIP_READER_READ_AHEAD)
+            break;
+        end = items[i].disk_end;
+    }
+
+    mz_stream_os_advise(reader->file_stream, item->disk_offset, end - item->disk_offset, MZ_STREAM_ADVISE_WILLNEED);
+    *advise_end = end;
+}
+
+static int32_t mz_zip_reader_save_all_ordered(void *handle, const char *destination_dir) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    mz_zip_reader_plan_item *items = NULL;
+    int64_t advise_end = 0;
+    int64_t drop_start = 0;
+    int32_t count = 0;
+    int32_t index = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    /* Count the entries to extract, then plan to read them in the order they are stored */
+    err = mz_zip_reader_goto_first_entry(handle);
+    if (err == MZ_END_OF_LIST)
+        return err;
+    while (err == MZ_OK) {
+        count += 1;
+        err = mz_zip_reader_goto_next_entry(handle);
+    }
+    if (err != MZ_END_OF_LIST)
+        return err;
+
+    items = (mz_zip_reader_plan_item *)MZ_ALLOC(count * sizeof(mz_zip_reader_plan_item));
+    if (items == NULL)
+        return MZ_MEM_ERROR;
+
+    err = mz_zip_reader_goto_first_entry(handle);
+    while (err == MZ_OK && index < count) {
+        items[index].cd_pos = mz_zip_get_entry(reader->zip_handle);
+        items[index].disk_number = reader->file_info->disk_number;
+        items[index].disk_offset = reader->file_info->disk_offset;
+        /* Local header has 30 fixed bytes and usually the same name and extra field as the central dir */
+        items[index].disk_end = reader->file_info->disk_offset + 30 +
+            reader->file_info->filename_size + reader->file_info->extrafield_size +
+            reader->file_info->compressed_size;
+        index += 1;
+        err = mz_zip_reader_goto_next_entry(handle);
+    }
+    if (err == MZ_END_OF_LIST)
+        err = MZ_OK;
+    count = index;
+
+    qsort(items, count, sizeof(mz_zip_reader_plan_item), mz_zip_reader_plan_compare);
+
+    if (err == MZ_OK && reader->file_stream != NULL)
+        mz_stream_os_advise(reader->file_stream, 0, 0, MZ_STREAM_ADVISE_SEQUENTIAL);
+
+    for (i = 0; i < count && err == MZ_OK; i += 1) {
+        if ((i > 0) && (items[i].disk_number != items[i - 1].disk_number)) {
+            advise_end = 0;
+            drop_start = 0;
+        }
+
+        err = mz_zip_goto_entry(reader->zip_handle, items[i].cd_pos);
+        reader->file_info = NULL;
+        if (err == MZ_OK)
+            err = mz_zip_entry_get_info(reader->zip_handle, &reader->file_info);
+
+        if (err == MZ_OK && reader->file_stream != NULL)
+            mz_zip_reader_plan_advise(handle, items, count, i, &advise_end);
+        if (err == MZ_OK)
+            err = mz_zip_reader_save_all_entry(handle, destination_dir);
+
+        /* Data that has been extracted is not read again so drop it from the cache */
+        if (err == MZ_OK && reader->drop_cache && reader->file_stream != NULL &&
+            items[i].disk_end > drop_start) {
+            mz_stream_os_advise(reader->file_stream, drop_start, items[i].disk_end - drop_start,
+                MZ_STREAM_ADVISE_DONTNEED);
+            drop_start = items[i].disk_end;
+        }
+    }
+
+    MZ_FREE(items);
+    return err;
+}
+
+int32_t mz_zip_reader_save_all(void *handle, const char *destination_dir) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    int32_t err = MZ_OK;
+
+    if (reader->ordered)
+        return mz_zip_reader_save_all_ordered(handle, destination_dir);
+
+    err = mz_zip_reader_goto_first_entry(handle);
+
+    if (err == MZ_END_OF_LIST)
+        return err;
+
+    while (err == MZ_OK) {
+        err = mz_zip_reader_save_all_entry(handle, destination_dir);
+
+        if (err == MZ_OK)
             err = mz_zip_reader_goto_next_entry(handle);
     }
 
@@ -864,6 +1838,223 @@ int32_t mz_zip_reader_save_all(void *handle, const char *destination_dir) {
     return err;
 }
 
+static int32_t mz_zip_reader_test_write_cb(void *stream, const void *buf, int32_t size) {
+    MZ_UNUSED(stream);
+    MZ_UNUSED(buf);
+    /* Data being tested is only hashed and thrown away */
+    return size;
+}
+
+static int32_t mz_zip_reader_test_entry(void *handle, mz_zip_reader_test_result *result) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    int32_t err = MZ_OK;
+
+    err = mz_zip_reader_entry_open(handle);
+    if ((err == MZ_OK) && (reader->hash != NULL))
+        result->hashed += 1;
+    /* The hash and crc are checked when the entry is closed at the end of the data */
+    if (err == MZ_OK)
+        err = mz_zip_reader_entry_save(handle, NULL, mz_zip_reader_test_write_cb);
+    if (mz_zip_entry_is_open(reader->zip_handle) == MZ_OK)
+        mz_zip_reader_entry_close(handle);
+    if (err == MZ_OK)
+        result->bytes += reader->file_info->uncompressed_size;
+    return err;
+}
+
+typedef struct mz_zip_reader_test_item_s {
+    int64_t     cd_pos;
+    int32_t     err;
+} mz_zip_reader_test_item;
+
+typedef struct mz_zip_reader_test_work_s {
+    mz_zip_reader
+                *reader;
+    mz_zip_reader_test_item
+                *items;
+    int32_t     count;
+    mz_zip_reader_test_result
+                *results;       /* one for each thread */
+    int32_t     thread_count;
+} mz_zip_reader_test_work;
+
+static void mz_zip_reader_test_thread(void *userdata, int32_t index) {
+    mz_zip_reader_test_work *work = (mz_zip_reader_test_work *)userdata;
+    mz_zip_reader *clone = NULL;
+    void *clone_handle = NULL;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    /* Each thread reads through its own reader opened on the same file */
+    mz_zip_reader_create(&clone_handle);
+    clone = (mz_zip_reader *)clone_handle;
+    if (clone == NULL)
+        err = MZ_MEM_ERROR;
+    if (err == MZ_OK) {
+        mz_zip_reader_set_password(clone_handle, work->reader->password);
+        mz_zip_reader_set_encoding(clone_handle, work->reader->encoding);
+        mz_zip_reader_set_recover(clone_handle, work->reader->recover);
+        err = mz_zip_reader_open_file(clone_handle, work->reader->cache_path);
+    }
+
+    for (i = index; i < work->count; i += work->thread_count) {
+        work->items[i].err = err;
+        if (err != MZ_OK)
+            continue;
+        work->items[i].err = mz_zip_goto_entry(clone->zip_handle, work->items[i].cd_pos);
+        if (work->items[i].err == MZ_OK)
+            work->items[i].err = mz_zip_entry_get_info(clone->zip_handle, &clone->file_info);
+        if (work->items[i].err == MZ_OK)
+            work->items[i].err = mz_zip_reader_test_entry(clone_handle, &work->results[index]);
+    }
+
+    if (clone != NULL) {
+        mz_zip_reader_close(clone_handle);
+        mz_zip_reader_delete(&clone_handle);
+    }
+}
+
+static int32_t mz_zip_reader_test_threaded(void *handle, mz_zip_reader_test_result *result, int32_t *first_err) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    mz_zip_reader_test_work work;
+    int32_t index = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    memset(&work, 0, sizeof(work));
+    work.reader = reader;
+
+    /* Entries are picked on this thread so the pattern and skip rules are the same as when run serially */
+    while (err == MZ_OK) {
+        if ((mz_zip_entry_is_dir(reader->zip_handle) != MZ_OK) &&
+            (mz_zip_entry_is_symlink(reader->zip_handle) != MZ_OK) &&
+            (reader->file_info->uncompressed_size != 0))
+            work.count += 1;
+        err = mz_zip_reader_goto_next_entry(handle);
+    }
+    if (err != MZ_END_OF_LIST)
+        return err;
+
+    if (work.count > 0) {
+        work.items = (mz_zip_reader_test_item *)MZ_ALLOC(work.count * sizeof(mz_zip_reader_test_item));
+        if (work.items == NULL)
+            return MZ_MEM_ERROR;
+    }
+
+    err = mz_zip_reader_goto_first_entry(handle);
+    while (err == MZ_OK) {
+        if ((mz_zip_entry_is_dir(reader->zip_handle) == MZ_OK) ||
+            (mz_zip_entry_is_symlink(reader->zip_handle) == MZ_OK) ||
+            (reader->file_info->uncompressed_size == 0)) {
+            result->skipped += 1;
+        } else if (index < work.count) {
+            work.items[index].cd_pos = mz_zip_get_entry(reader->zip_handle);
+            work.items[index].err = MZ_OK;
+            index += 1;
+        }
+        err = mz_zip_reader_goto_next_entry(handle);
+    }
+    work.count = index;
+
+    work.thread_count = (reader->test_threads < work.count) ? reader->test_threads : work.count;
+    if ((err == MZ_END_OF_LIST) && (work.thread_count > 0)) {
+        work.results = (mz_zip_reader_test_result *)MZ_ALLOC(work.thread_count * sizeof(mz_zip_reader_test_result));
+        if (work.results == NULL)
+            err = MZ_MEM_ERROR;
+    }
+    if ((err == MZ_END_OF_LIST) && (work.thread_count > 0)) {
+        memset(work.results, 0, work.thread_count * sizeof(mz_zip_reader_test_result));
+        /* Without thread support each share of the entries is checked in turn */
+        if (mz_os_run_threads(work.thread_count, mz_zip_reader_test_thread, &work) != MZ_OK) {
+            for (i = 0; i < work.thread_count; i += 1)
+                mz_zip_reader_test_thread(&work, i);
+        }
+        for (i = 0; i < work.thread_count; i += 1) {
+            result->hashed += work.results[i].hashed;
+            result->bytes += work.results[i].bytes;
+        }
+    }
+
+    /* Results are reported in central directory order once every thread is done */
+    for (i = 0; (err == MZ_END_OF_LIST) && (i < work.count); i += 1) {
+        result->entries += 1;
+        if (work.items[i].err != MZ_OK) {
+            result->failed += 1;
+            if (*first_err == MZ_OK)
+                *first_err = work.items[i].err;
+        }
+        if ((reader->test_cb != NULL) && (mz_zip_goto_entry(reader->zip_handle, work.items[i].cd_pos) == MZ_OK) &&
+            (mz_zip_entry_get_info(reader->zip_handle, &reader->file_info) == MZ_OK))
+            reader->test_cb(handle, reader->test_userdata, reader->file_info, work.items[i].err);
+    }
+
+    MZ_FREE(work.results);
+    MZ_FREE(work.items);
+    return err;
+}
+
+int32_t mz_zip_reader_test_all(void *handle, mz_zip_reader_test_result *result) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    mz_zip_reader_test_result local_result;
+    uint64_t start_time = 0;
+    int32_t first_err = MZ_OK;
+    int32_t entry_err = MZ_OK;
+    int32_t err = MZ_OK;
+
+
+    if (mz_zip_reader_is_open(handle) != MZ_OK)
+        return MZ_PARAM_ERROR;
+    if (result == NULL)
+        result = &local_result;
+
+    memset(result, 0, sizeof(mz_zip_reader_test_result));
+    start_time = mz_os_ns_time();
+
+    if (mz_zip_entry_is_open(reader->zip_handle) == MZ_OK)
+        mz_zip_reader_entry_close(handle);
+
+    err = mz_zip_reader_goto_first_entry(handle);
+
+    if (err == MZ_END_OF_LIST)
+        return err;
+
+    /* Threads open the archive again by its path, and a password callback may not be safe to call from them */
+    if ((err == MZ_OK) && (reader->test_threads > 1) && (reader->cache_path != NULL) &&
+        (reader->mem_stream == NULL) && (mz_stream_is_open(reader->split_stream) == MZ_OK) &&
+        (reader->password_cb == NULL))
+        err = mz_zip_reader_test_threaded(handle, result, &first_err);
+
+    while (err == MZ_OK) {
+        /* Entries without data are skipped without reading their local header */
+        if ((mz_zip_entry_is_dir(reader->zip_handle) == MZ_OK) ||
+            (mz_zip_entry_is_symlink(reader->zip_handle) == MZ_OK) ||
+            (reader->file_info->uncompressed_size == 0)) {
+            result->skipped += 1;
+        } else {
+            entry_err = mz_zip_reader_test_entry(handle, result);
+            result->entries += 1;
+            if (entry_err != MZ_OK) {
+                result->failed += 1;
+                if (first_err == MZ_OK)
+                    first_err = entry_err;
+            }
+            if (reader->test_cb != NULL)
+                reader->test_cb(handle, reader->test_userdata, reader->file_info, entry_err);
+        }
+
+        err = mz_zip_reader_goto_next_entry(handle);
+    }
+
+    result->elapsed_ns = mz_os_ns_time() - start_time;
+    if (result->elapsed_ns > 0)
+        result->bytes_per_sec = (uint64_t)((double)result->bytes * 1000000000.0 / (double)result->elapsed_ns);
+
+    /* An entry that fails does not stop the others from being checked */
+    if (err == MZ_END_OF_LIST)
+        err = first_err;
+    return err;
+}
+
 /***************************************************************************/
 
 void mz_zip_reader_set_pattern(void *handle, const char *pattern, uint8_t ignore_case) {
@@ -872,6 +2063,11 @@ void mz_zip_reader_set_pattern(void *handle, const char *pattern, uint8_t ignore
     reader->pattern_ignore_case = ignore_case;
 }
 
+void mz_zip_reader_set_patterns(void *handle, void *patterns) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    reader->patterns = patterns;
+}
+
 void mz_zip_reader_set_password(void *handle, const char *password) {
     mz_zip_reader *reader = (mz_zip_reader *)handle;
     reader->password = password;
@@ -920,6 +2116,36 @@ void mz_zip_reader_set_encoding(void *handle, int32_t encoding) {
     reader->encoding = encoding;
 }
 
+void mz_zip_reader_set_stats(void *handle, mz_zip_stats *stats) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    reader->stats = stats;
+}
+
+void mz_zip_reader_set_alloc(void *handle, mz_alloc *alloc) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    reader->alloc = alloc;
+}
+
+void mz_zip_reader_set_ordered(void *handle, uint8_t ordered) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    reader->ordered = ordered;
+}
+
+void mz_zip_reader_set_drop_cache(void *handle, uint8_t drop_cache) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    reader->drop_cache = drop_cache;
+}
+
+void mz_zip_reader_set_low_memory(void *handle, uint8_t low_memory) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    reader->low_memory = low_memory;
+}
+
+void mz_zip_reader_set_sidecar(void *handle, uint8_t sidecar) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    reader->sidecar = sidecar;
+}
+
 void mz_zip_reader_set_sign_required(void *handle, uint8_t sign_required) {
     mz_zip_reader *reader = (mz_zip_reader *)handle;
     reader->sign_required = sign_required;
@@ -948,12 +2174,45 @@ void mz_zip_reader_set_progress_interval(void *handle, uint32_t milliseconds) {
     reader->progress_cb_interval_ms = milliseconds;
 }
 
+void mz_zip_reader_set_recover_cb(void *handle, void *userdata, mz_zip_recover_cb cb) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    reader->recover_cb = cb;
+    reader->recover_userdata = userdata;
+}
+
+void mz_zip_reader_set_recover_threads(void *handle, int32_t thread_count) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    reader->recover_threads = thread_count;
+}
+
 void mz_zip_reader_set_entry_cb(void *handle, void *userdata, mz_zip_reader_entry_cb cb) {
     mz_zip_reader *reader = (mz_zip_reader *)handle;
     reader->entry_cb = cb;
     reader->entry_userdata = userdata;
 }
 
+void mz_zip_reader_set_timing_cb(void *handle, void *userdata, mz_zip_reader_timing_cb cb) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    reader->timing_cb = cb;
+    reader->timing_userdata = userdata;
+    /* Timings are taken from the stream counters so keep our own if none are set */
+    if ((cb != NULL) && (reader->stats == NULL)) {
+        memset(&reader->timing_stats, 0, sizeof(reader->timing_stats));
+        reader->stats = &reader->timing_stats;
+    }
+}
+
+void mz_zip_reader_set_test_threads(void *handle, int32_t thread_count) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    reader->test_threads = thread_count;
+}
+
+void mz_zip_reader_set_test_cb(void *handle, void *userdata, mz_zip_reader_test_cb cb) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    reader->test_cb = cb;
+    reader->test_userdata = userdata;
+}
+
 int32_t mz_zip_reader_get_zip_handle(void *handle, void **zip_handle) {
     mz_zip_reader *reader = (mz_zip_reader *)handle;
     if (zip_handle == NULL)
@@ -964,6 +2223,13 @@ int32_t mz_zip_reader_get_zip_handle(void *handle, void **zip_handle) {
     return MZ_OK;
 }
 
+int32_t mz_zip_reader_has_sidecar(void *handle) {
+    mz_zip_reader *reader = (mz_zip_reader *)handle;
+    if (reader->sidecar_map == NULL)
+        return MZ_EXIST_ERROR;
+    return MZ_OK;
+}
+
 /***************************************************************************/
 
 void *mz_zip_reader_create(void **handle) {
@@ -987,6 +2253,9 @@ void mz_zip_reader_delete(void **handle) {
     reader = (mz_zip_reader *)*handle;
     if (reader != NULL) {
         mz_zip_reader_close(reader);
+        mz_zip_reader_free(reader);
+        if (reader->cache_path != NULL)
+            MZ_FREE(reader->cache_path);
         MZ_FREE(reader);
     }
     *handle = NULL;
@@ -994,12 +2263,33 @@ void mz_zip_reader_delete(void **handle) {
 
 /***************************************************************************/
 
+typedef struct mz_zip_writer_dedup_s {
+    uint8_t     digest[MZ_HASH_SHA256_SIZE];
+    int64_t     data_offset;
+    int64_t     compressed_size;
+    int64_t     uncompressed_size;
+    uint32_t    crc;
+    uint16_t    compression_method;
+    int16_t     compress_level;
+    uint8_t     used;
+} mz_zip_writer_dedup;
+
+typedef struct mz_zip_writer_dict_s {
+    void        *samples;
+    size_t      sample_sizes[MZ_ZIP_DICT_SAMPLE_COUNT];
+    int32_t     sample_count;
+    uint16_t    compression_method;
+    uint8_t     *dict;
+    int32_t     dict_size;
+    uint8_t     trained;
+} mz_zip_writer_dict;
+
 typedef struct mz_zip_writer_s {
     void        *zip_handle;
     void        *file_stream;
     void        *buffered_stream;
     void        *split_stream;
-    void        *sha256;
+    void        *hash;
     void        *mem_stream;
     void        *file_extra_stream;
     mz_zip_file file_info;
@@ -1016,6 +2306,15 @@ typedef struct mz_zip_writer_s {
     void        *entry_userdata;
     mz_zip_writer_entry_cb
                 entry_cb;
+    void        *timing_userdata;
+    mz_zip_writer_timing_cb
+                timing_cb;
+    mz_zip_stats
+                timing_stats;
+    mz_zip_stats
+                timing_start;
+    mz_zip_entry_timing
+                timing;
     const char  *password;
     const char  *comment;
     uint8_t     *cert_data;
@@ -1023,6 +2322,27 @@ typedef struct mz_zip_writer_s {
     const char  *cert_pwd;
     uint16_t    compress_method;
     int16_t     compress_level;
+    uint8_t     compress_auto;
+    uint8_t     dedup;
+    mz_zip_writer_dedup
+                *dedup_table;
+    int64_t     *dedup_sizes;
+    int32_t     dedup_table_size;
+    int32_t     dedup_count;
+    uint16_t    hash_algorithm;     /* hash stored with each entry, 0 for none */
+    uint16_t    hash_entry_algorithm;
+    uint8_t     hash_known;
+    uint8_t     hash_digest[MZ_HASH_SHA256_SIZE];
+    int32_t     dict_size;
+    mz_zip_writer_dict
+                dicts[MZ_ZIP_DICT_METHOD_COUNT];
+    mz_zip_writer_dict
+                *dict_sampler;
+    int32_t     dict_sample_size;
+    int32_t     frame_size;
+    mz_zip_stats
+                *stats;
+    mz_alloc    *alloc;
     uint8_t     follow_links;
     uint8_t     store_links;
     uint8_t     zip_cd;
@@ -1105,6 +2425,9 @@ static int32_t mz_zip_writer_open_int(void *handle, void *stream, int32_t mode)
     int32_t err = MZ_OK;
 
     mz_zip_create(&writer->zip_handle);
+    mz_zip_set_stats(writer->zip_handle, writer->stats);
+    mz_zip_set_alloc(writer->zip_handle, writer->alloc);
+    mz_zip_set_frame_size(writer->zip_handle, writer->frame_size);
     err = mz_zip_open(writer->zip_handle, stream, mode);
 
     if (err != MZ_OK) {
@@ -1161,6 +2484,12 @@ int32_t mz_zip_writer_open_file(void *handle, const char *path, int64_t disk_siz
     mz_stream_set_base(writer->buffered_stream, writer->file_stream);
     mz_stream_set_base(writer->split_stream, writer->buffered_stream);
 
+    if (writer->stats != NULL) {
+        mz_stream_set_stats(writer->file_stream, &writer->stats->file);
+        mz_stream_set_stats(writer->buffered_stream, &writer->stats->buffered);
+        mz_stream_set_stats(writer->split_stream, &writer->stats->split);
+    }
+
     mz_stream_split_set_prop_int64(writer->split_stream, MZ_STREAM_PROP_DISK_SIZE, disk_size);
 
     err = mz_stream_open(writer->split_stream, path, mode);
@@ -1211,56 +2540,208 @@ int32_t mz_zip_writer_open_file_in_memory(void *handle, const char *path) {
     mz_stream_os_close(file_stream);
     mz_stream_os_delete(&file_stream);
 
+    if (err == MZ_OK && writer->stats != NULL)
+        mz_stream_set_stats(writer->mem_stream, &writer->stats->file);
     if (err == MZ_OK)
         err = mz_zip_writer_open(handle, writer->mem_stream);
     if (err != MZ_OK)
         mz_zip_writer_close(handle);
 
-    return err;
+    return err;
+}
+
+int32_t mz_zip_writer_close(void *handle) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    if (writer->zip_handle != NULL) {
+        mz_zip_set_version_madeby(writer->zip_handle, MZ_VERSION_MADEBY);
+        if (writer->comment)
+            mz_zip_set_comment(writer->zip_handle, writer->comment);
+        if (writer->zip_cd)
+            mz_zip_writer_zip_cd(writer);
+
+        err = mz_zip_close(writer->zip_handle);
+        mz_zip_delete(&writer->zip_handle);
+    }
+
+    if (writer->split_stream != NULL) {
+        mz_stream_split_close(writer->split_stream);
+        mz_stream_split_delete(&writer->split_stream);
+    }
+
+    if (writer->buffered_stream != NULL)
+        mz_stream_buffered_delete(&writer->buffered_stream);
+
+    if (writer->file_stream != NULL)
+        mz_stream_os_delete(&writer->file_stream);
+
+    if (writer->mem_stream != NULL) {
+        mz_stream_mem_close(writer->mem_stream);
+        mz_stream_mem_delete(&writer->mem_stream);
+    }
+
+    /* Stored locations are only valid for this archive */
+    if (writer->dedup_table != NULL)
+        MZ_FREE(writer->dedup_table);
+    writer->dedup_table = NULL;
+    if (writer->dedup_sizes != NULL)
+        MZ_FREE(writer->dedup_sizes);
+    writer->dedup_sizes = NULL;
+    writer->dedup_table_size = 0;
+    writer->dedup_count = 0;
+
+    for (i = 0; i < MZ_ZIP_DICT_METHOD_COUNT; i += 1) {
+        if (writer->dicts[i].samples != NULL) {
+            mz_stream_mem_close(writer->dicts[i].samples);
+            mz_stream_mem_delete(&writer->dicts[i].samples);
+        }
+        if (writer->dicts[i].dict != NULL)
+            MZ_FREE(writer->dicts[i].dict);
+        memset(&writer->dicts[i], 0, sizeof(mz_zip_writer_dict));
+    }
+    writer->dict_sampler = NULL;
+
+    return err;
+}
+
+/***************************************************************************/
+
+static mz_zip_writer_dict *mz_zip_writer_dict_get(void *handle, uint16_t compression_method) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    switch (compression_method) {
+    case MZ_COMPRESS_METHOD_DEFLATE:
+        return &writer->dicts[0];
+    case MZ_COMPRESS_METHOD_ZSTD:
+        return &writer->dicts[1];
+    }
+    return NULL;
+}
+
+static int32_t mz_zip_writer_dict_select(void *handle, mz_zip_writer_dict *writer_dict) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    const void *dict = NULL;
+    int32_t dict_size = 0;
+    int32_t err = MZ_OK;
+
+    /* Each method is compressed only with the dictionary trained from its own samples */
+    err = mz_zip_get_dictionary(writer->zip_handle, &dict, &dict_size);
+    if (!writer_dict->trained) {
+        if (err == MZ_OK)
+            return mz_zip_set_dictionary(writer->zip_handle, NULL, 0);
+        return MZ_OK;
+    }
+    if ((err == MZ_OK) && (dict_size == writer_dict->dict_size) &&
+        (memcmp(dict, writer_dict->dict, dict_size) == 0))
+        return MZ_OK;
+    return mz_zip_set_dictionary(writer->zip_handle, writer_dict->dict, writer_dict->dict_size);
+}
+
+static int32_t mz_zip_writer_dict_sample_begin(void *handle, mz_zip_writer_dict *writer_dict,
+    const char *password) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    mz_zip_file *zip_file_info = NULL;
+    const void *dict = NULL;
+    int32_t dict_size = 0;
+
+    /* Only sample data that the dictionary will later be used for, never encrypted data
+       because the dictionary is stored in the clear */
+    if (writer->raw || (password != NULL))
+        return MZ_OK;
+    if (writer_dict->sample_count >= MZ_ZIP_DICT_SAMPLE_COUNT)
+        return MZ_OK;
+    if (mz_zip_get_dictionary(writer->zip_handle, &dict, &dict_size) == MZ_OK)
+        return MZ_OK;
+    if (mz_zip_entry_get_info(writer->zip_handle, &zip_file_info) != MZ_OK)
+        return MZ_OK;
+    if (mz_zip_attrib_is_dir(zip_file_info->external_fa, zip_file_info->version_madeby) == MZ_OK)
+        return MZ_OK;
+
+    if (writer_dict->samples == NULL) {
+        mz_stream_mem_create(&writer_dict->samples);
+        if (mz_stream_mem_open(writer_dict->samples, NULL, MZ_OPEN_MODE_CREATE) != MZ_OK)
+            return MZ_MEM_ERROR;
+    }
+
+    writer_dict->compression_method = zip_file_info->compression_method;
+    writer->dict_sampler = writer_dict;
+    writer->dict_sample_size = 0;
+    return MZ_OK;
 }
 
-int32_t mz_zip_writer_close(void *handle) {
+static int32_t mz_zip_writer_dict_train(void *handle, mz_zip_writer_dict *writer_dict) {
     mz_zip_writer *writer = (mz_zip_writer *)handle;
-    int32_t err = MZ_OK;
+    const uint8_t *samples = NULL;
+    int32_t samples_size = 0;
+    int32_t dict_size = 0;
 
+    mz_stream_mem_get_buffer(writer_dict->samples, (const void **)&samples);
+    mz_stream_mem_get_buffer_length(writer_dict->samples, &samples_size);
 
-    if (writer->zip_handle != NULL) {
-        mz_zip_set_version_madeby(writer->zip_handle, MZ_VERSION_MADEBY);
-        if (writer->comment)
-            mz_zip_set_comment(writer->zip_handle, writer->comment);
-        if (writer->zip_cd)
-            mz_zip_writer_zip_cd(writer);
+    if ((writer_dict->sample_count < MZ_ZIP_DICT_SAMPLE_MIN) || (samples_size <= 0))
+        return MZ_OK;
+    if ((writer_dict->sample_count < MZ_ZIP_DICT_SAMPLE_COUNT) &&
+        ((int64_t)samples_size < (int64_t)writer->dict_size * MZ_ZIP_DICT_SAMPLE_FACTOR))
+        return MZ_OK;
 
-        err = mz_zip_close(writer->zip_handle);
-        mz_zip_delete(&writer->zip_handle);
-    }
+    writer_dict->dict = (uint8_t *)MZ_ALLOC(writer->dict_size);
+    if (writer_dict->dict == NULL)
+        return MZ_MEM_ERROR;
 
-    if (writer->split_stream != NULL) {
-        mz_stream_split_close(writer->split_stream);
-        mz_stream_split_delete(&writer->split_stream);
-    }
+#ifdef HAVE_ZSTD
+    if (writer_dict->compression_method == MZ_COMPRESS_METHOD_ZSTD)
+        dict_size = mz_stream_zstd_dictionary_train(writer_dict->dict, writer->dict_size, samples,
+            writer_dict->sample_sizes, writer_dict->sample_count);
+#endif
 
-    if (writer->buffered_stream != NULL)
-        mz_stream_buffered_delete(&writer->buffered_stream);
+    if (dict_size <= 0) {
+        /* Use the most recent sample data as the dictionary content, deflate can only
+           reference the last 32KB of it */
+        dict_size = writer->dict_size;
+        if ((writer_dict->compression_method == MZ_COMPRESS_METHOD_DEFLATE) &&
+            (dict_size > MZ_ZIP_DICT_DEFLATE_MAX))
+            dict_size = MZ_ZIP_DICT_DEFLATE_MAX;
+        if (dict_size > samples_size)
+            dict_size = samples_size;
+        memcpy(writer_dict->dict, samples + samples_size - dict_size, dict_size);
+    }
 
-    if (writer->file_stream != NULL)
-        mz_stream_os_delete(&writer->file_stream);
+    writer_dict->dict_size = dict_size;
+    writer_dict->trained = 1;
 
-    if (writer->mem_stream != NULL) {
-        mz_stream_mem_close(writer->mem_stream);
-        mz_stream_mem_delete(&writer->mem_stream);
-    }
+    mz_stream_mem_close(writer_dict->samples);
+    mz_stream_mem_delete(&writer_dict->samples);
 
-    return err;
+    /* Entry is closed so the dictionary can be written before the next one */
+    return mz_zip_writer_dict_select(handle, writer_dict);
 }
 
-/***************************************************************************/
+#ifndef MZ_ZIP_NO_ENCRYPTION
+static uint16_t mz_zip_writer_hash_get_algorithm(void *handle) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    if (writer->hash_algorithm != 0)
+        return writer->hash_algorithm;
+    /* Dedup and signing need a digest even when none is stored */
+    if (writer->dedup || ((writer->cert_data != NULL) && (writer->cert_data_size > 0)))
+        return MZ_HASH_SHA256;
+    return 0;
+}
+#endif
 
 int32_t mz_zip_writer_entry_open(void *handle, mz_zip_file *file_info) {
     mz_zip_writer *writer = (mz_zip_writer *)handle;
+    mz_zip_writer_dict *writer_dict = NULL;
     int32_t err = MZ_OK;
     const char *password = NULL;
     char password_buf[120];
+    uint64_t open_time = 0;
+
+    if (writer->timing_cb != NULL) {
+        memset(&writer->timing, 0, sizeof(writer->timing));
+        open_time = mz_os_ns_time();
+    }
 
     /* Copy file info to access data upon close */
     memcpy(&writer->file_info, file_info, sizeof(mz_zip_file));
@@ -1279,17 +2760,35 @@ int32_t mz_zip_writer_entry_open(void *handle, mz_zip_file *file_info) {
     }
 
 #ifndef MZ_ZIP_NO_ENCRYPTION
-    if (mz_zip_attrib_is_dir(writer->file_info.external_fa, writer->file_info.version_madeby) != MZ_OK) {
-        /* Start calculating sha256 */
-        mz_crypt_sha_create(&writer->sha256);
-        mz_crypt_sha_set_algorithm(writer->sha256, MZ_HASH_SHA256);
-        mz_crypt_sha_begin(writer->sha256);
+    writer->hash_entry_algorithm = mz_zip_writer_hash_get_algorithm(handle);
+    if ((writer->hash_entry_algorithm != 0) &&
+        (mz_zip_attrib_is_dir(writer->file_info.external_fa, writer->file_info.version_madeby) != MZ_OK)) {
+        /* Start calculating hash while the data is written */
+        mz_crypt_sha_create(&writer->hash);
+        mz_crypt_sha_set_algorithm(writer->hash, writer->hash_entry_algorithm);
+        mz_crypt_sha_begin(writer->hash);
     }
 #endif
 
+    if ((writer->dict_size > 0) && (!writer->raw)) {
+        writer_dict = mz_zip_writer_dict_get(handle, writer->file_info.compression_method);
+        if (writer_dict != NULL)
+            err = mz_zip_writer_dict_select(handle, writer_dict);
+    }
+
     /* Open entry in zip */
-    err = mz_zip_entry_write_open(writer->zip_handle, &writer->file_info, writer->compress_level,
-        writer->raw, password);
+    if (err == MZ_OK)
+        err = mz_zip_entry_write_open(writer->zip_handle, &writer->file_info, writer->compress_level,
+            writer->raw, password);
+
+    if ((err == MZ_OK) && (writer_dict != NULL) && (!writer_dict->trained))
+        err = mz_zip_writer_dict_sample_begin(handle, writer_dict, password);
+
+    if (writer->timing_cb != NULL) {
+        writer->timing.header_time = mz_os_ns_time() - open_time;
+        if (writer->stats != NULL)
+            memcpy(&writer->timing_start, writer->stats, sizeof(mz_zip_stats));
+    }
 
     return err;
 }
@@ -1331,47 +2830,63 @@ int32_t mz_zip_writer_entry_sign(void *handle, uint8_t *message, int32_t message
 
 int32_t mz_zip_writer_entry_close(void *handle) {
     mz_zip_writer *writer = (mz_zip_writer *)handle;
+    mz_zip_writer_dict *writer_dict = NULL;
+    mz_zip_file *timing_file_info = NULL;
     int32_t err = MZ_OK;
 #ifndef MZ_ZIP_NO_ENCRYPTION
+    mz_zip_file *zip_file_info = NULL;
     const uint8_t *extrafield = NULL;
     int32_t extrafield_size = 0;
     int16_t field_length_hash = 0;
-    uint8_t sha256[MZ_HASH_SHA256_SIZE];
+    uint16_t digest_size = 0;
+    uint8_t digest[MZ_HASH_SHA256_SIZE];
 
 
-    if (writer->sha256 != NULL) {
-        mz_crypt_sha_end(writer->sha256, sha256, sizeof(sha256));
-        mz_crypt_sha_delete(&writer->sha256);
+    if (writer->hash != NULL) {
+        digest_size = (writer->hash_entry_algorithm == MZ_HASH_SHA1) ? MZ_HASH_SHA1_SIZE : MZ_HASH_SHA256_SIZE;
+        memset(digest, 0, sizeof(digest));
+        mz_crypt_sha_end(writer->hash, digest, sizeof(digest));
+        mz_crypt_sha_delete(&writer->hash);
+
+        /* Use hash calculated before the data was written, otherwise keep it for dedup */
+        if (writer->hash_known)
+            memcpy(digest, writer->hash_digest, sizeof(digest));
+        else
+            memcpy(writer->hash_digest, digest, sizeof(writer->hash_digest));
 
         /* Copy extrafield so we can append our own fields before close */
         mz_stream_mem_create(&writer->file_extra_stream);
         mz_stream_mem_open(writer->file_extra_stream, NULL, MZ_OPEN_MODE_CREATE);
 
-        /* Write sha256 hash to extrafield */
-        field_length_hash = 4 + MZ_HASH_SHA256_SIZE;
-        err = mz_zip_extrafield_write(writer->file_extra_stream, MZ_ZIP_EXTENSION_HASH, field_length_hash);
-        if (err == MZ_OK)
-            err = mz_stream_write_uint16(writer->file_extra_stream, MZ_HASH_SHA256);
-        if (err == MZ_OK)
-            err = mz_stream_write_uint16(writer->file_extra_stream, MZ_HASH_SHA256_SIZE);
-        if (err == MZ_OK) {
-            if (mz_stream_write(writer->file_extra_stream, sha256, sizeof(sha256)) != MZ_HASH_SHA256_SIZE)
-                err = MZ_WRITE_ERROR;
+        /* Write hash to extrafield unless it was only calculated for dedup */
+        if ((writer->hash_algorithm != 0) || ((writer->cert_data != NULL) && (writer->cert_data_size > 0))) {
+            field_length_hash = 4 + digest_size;
+            err = mz_zip_extrafield_write(writer->file_extra_stream, MZ_ZIP_EXTENSION_HASH, field_length_hash);
+            if (err == MZ_OK)
+                err = mz_stream_write_uint16(writer->file_extra_stream, writer->hash_entry_algorithm);
+            if (err == MZ_OK)
+                err = mz_stream_write_uint16(writer->file_extra_stream, digest_size);
+            if (err == MZ_OK) {
+                if (mz_stream_write(writer->file_extra_stream, digest, digest_size) != digest_size)
+                    err = MZ_WRITE_ERROR;
+            }
         }
 
 #ifdef MZ_ZIP_SIGNING
         if ((err == MZ_OK) && (writer->cert_data != NULL) && (writer->cert_data_size > 0)) {
             /* Sign entry if not zipping cd or if it is cd being zipped */
             if (!writer->zip_cd || strcmp(writer->file_info.filename, MZ_ZIP_CD_FILENAME) == 0) {
-                err = mz_zip_writer_entry_sign(handle, sha256, sizeof(sha256),
+                err = mz_zip_writer_entry_sign(handle, digest, digest_size,
                     writer->cert_data, writer->cert_data_size, writer->cert_pwd);
             }
         }
 #endif
 
-        if ((writer->file_info.extrafield != NULL) && (writer->file_info.extrafield_size > 0))
-            mz_stream_mem_write(writer->file_extra_stream, writer->file_info.extrafield,
-                writer->file_info.extrafield_size);
+        /* Keep fields added when the entry was opened, such as the dictionary reference */
+        if ((mz_zip_entry_get_info(writer->zip_handle, &zip_file_info) == MZ_OK) &&
+            (zip_file_info->extrafield != NULL) && (zip_file_info->extrafield_size > 0))
+            mz_stream_mem_write(writer->file_extra_stream, zip_file_info->extrafield,
+                zip_file_info->extrafield_size);
 
         /* Update extra field for central directory after adding extra fields */
         mz_stream_mem_get_buffer(writer->file_extra_stream, (const void **)&extrafield);
@@ -1392,17 +2907,41 @@ int32_t mz_zip_writer_entry_close(void *handle) {
     if (writer->file_extra_stream != NULL)
         mz_stream_mem_delete(&writer->file_extra_stream);
 
+    if (writer->timing_cb != NULL) {
+        mz_zip_timing_end(&writer->timing, writer->stats, &writer->timing_start, 1);
+        if (mz_zip_entry_get_info(writer->zip_handle, &timing_file_info) != MZ_OK)
+            timing_file_info = &writer->file_info;
+        writer->timing_cb(handle, writer->timing_userdata, timing_file_info, &writer->timing);
+    }
+
+    if (writer->dict_sampler != NULL) {
+        writer_dict = writer->dict_sampler;
+        writer->dict_sampler = NULL;
+        if (writer->dict_sample_size > 0)
+            writer_dict->sample_sizes[writer_dict->sample_count++] = (size_t)writer->dict_sample_size;
+        if (err == MZ_OK)
+            err = mz_zip_writer_dict_train(handle, writer_dict);
+    }
+
     return err;
 }
 
 int32_t mz_zip_writer_entry_write(void *handle, const void *buf, int32_t len) {
     mz_zip_writer *writer = (mz_zip_writer *)handle;
     int32_t written = 0;
+    int32_t sample = 0;
     written = mz_zip_entry_write(writer->zip_handle, buf, len);
 #ifndef MZ_ZIP_NO_ENCRYPTION
-    if ((written > 0) && (writer->sha256 != NULL))
-        mz_crypt_sha_update(writer->sha256, buf, written);
+    if ((written > 0) && (writer->hash != NULL) && (!writer->hash_known))
+        mz_crypt_sha_update(writer->hash, buf, written);
 #endif
+    if ((written > 0) && (writer->dict_sampler != NULL) && (writer->dict_sample_size < MZ_ZIP_DICT_SAMPLE_MAX)) {
+        sample = MZ_ZIP_DICT_SAMPLE_MAX - writer->dict_sample_size;
+        if (sample > written)
+            sample = written;
+        if (mz_stream_mem_write(writer->dict_sampler->samples, buf, sample) == sample)
+            writer->dict_sample_size += sample;
+    }
     return written;
 }
 /***************************************************************************/
@@ -1412,6 +2951,7 @@ int32_t mz_zip_writer_add_process(void *handle, void *stream, mz_stream_read_cb
     int32_t read = 0;
     int32_t written = 0;
     int32_t err = MZ_OK;
+    uint64_t read_time = 0;
 
     if (mz_zip_writer_is_open(writer) != MZ_OK)
         return MZ_PARAM_ERROR;
@@ -1421,7 +2961,11 @@ int32_t mz_zip_writer_add_process(void *handle, void *stream, mz_stream_read_cb
     if (read_cb == NULL)
         return MZ_PARAM_ERROR;
 
+    if (writer->timing_cb != NULL)
+        read_time = mz_os_ns_time();
     read = read_cb(stream, writer->buffer, sizeof(writer->buffer));
+    if (writer->timing_cb != NULL)
+        writer->timing.data_time += mz_os_ns_time() - read_time;
     if (read == 0)
         return MZ_END_OF_STREAM;
     if (read < 0) {
@@ -1436,14 +2980,177 @@ int32_t mz_zip_writer_add_process(void *handle, void *stream, mz_stream_read_cb
     return written;
 }
 
+static int32_t mz_zip_writer_auto_select(void *handle, void *stream, uint16_t *compress_method,
+    int16_t *compress_level) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    uint64_t histogram[256];
+    uint64_t collisions = 0;
+    uint64_t symbols = 0;
+    int64_t start_pos = 0;
+    int32_t read = 0;
+    int32_t i = 0;
+
+    /* Sample the start of the stream and estimate how many distinct byte
+       values it effectively uses, a cheap stand-in for its order-0 entropy */
+    start_pos = mz_stream_tell(stream);
+    if (start_pos < 0)
+        return MZ_OK;
+
+    read = mz_stream_read(stream, writer->buffer, sizeof(writer->buffer));
+    if (mz_stream_seek(stream, start_pos, MZ_SEEK_SET) != MZ_OK)
+        return MZ_SEEK_ERROR;
+    if (read < MZ_ZIP_AUTO_SAMPLE_MIN)
+        return MZ_OK;
+
+    memset(histogram, 0, sizeof(histogram));
+    for (i = 0; i < read; i += 1)
+        histogram[writer->buffer[i]] += 1;
+    for (i = 0; i < 256; i += 1) {
+        if (histogram[i] > 1)
+            collisions += histogram[i] * (histogram[i] - 1);
+    }
+
+    symbols = 256;
+    if (collisions > 0)
+        symbols = ((uint64_t)read * (read - 1)) / collisions;
+
+    if (symbols >= MZ_ZIP_AUTO_STORE_SYMBOLS) {
+        *compress_method = MZ_COMPRESS_METHOD_STORE;
+    } else if (symbols >= MZ_ZIP_AUTO_FAST_SYMBOLS) {
+        if ((*compress_level < 0) || (*compress_level > MZ_COMPRESS_LEVEL_FAST))
+            *compress_level = MZ_COMPRESS_LEVEL_FAST;
+    }
+
+    return MZ_OK;
+}
+
+static int64_t mz_zip_writer_auto_estimate(const uint8_t *buf, int32_t size) {
+    uint16_t matches[1 << MZ_ZIP_AUTO_MATCH_BITS];
+    uint32_t histogram[256];
+    uint64_t collisions = 0;
+    uint64_t symbols = 0;
+    uint64_t step = 0;
+    uint32_t value = 0;
+    uint32_t hash = 0;
+    int64_t literal_bits = 0;
+    int32_t literals = 0;
+    int32_t matched = 0;
+    int32_t candidate = 0;
+    int32_t i = 0;
+
+
+    /* Estimate the compressed size of a buffer without the codec, whose output may lag behind
+       its input, by counting 4 byte repeats as one byte and coding the other bytes by entropy */
+    memset(matches, 0, sizeof(matches));
+    memset(histogram, 0, sizeof(histogram));
+
+    while (i < size) {
+        candidate = 0;
+        if (i + 4 <= size) {
+            value = (uint32_t)buf[i] | ((uint32_t)buf[i + 1] << 8) | ((uint32_t)buf[i + 2] << 16) |
+                ((uint32_t)buf[i + 3] << 24);
+            hash = (value * 2654435761U) >> (32 - MZ_ZIP_AUTO_MATCH_BITS);
+            candidate = matches[hash];
+            matches[hash] = (uint16_t)(i + 1);
+        }
+        if ((candidate > 0) && (memcmp(buf + candidate - 1, buf + i, 4) == 0)) {
+            matched += 1;
+            i += 4;
+        } else {
+            histogram[buf[i]] += 1;
+            literals += 1;
+            i += 1;
+        }
+    }
+
+    for (i = 0; i < 256; i += 1) {
+        if (histogram[i] > 1)
+            collisions += (uint64_t)histogram[i] * (histogram[i] - 1);
+    }
+    symbols = 256;
+    if (collisions > 0)
+        symbols = ((uint64_t)literals * (literals - 1)) / collisions;
+    if (symbols > 256)
+        symbols = 256;
+
+    /* Bits per literal in sixteenths, log2 of the symbol count interpolated between powers of 2 */
+    for (step = 1; (step * 2) <= symbols; step *= 2)
+        literal_bits += 16;
+    if (symbols > 0)
+        literal_bits += ((symbols - step) * 16) / step;
+
+    return ((int64_t)literals * literal_bits) / (16 * 8) + matched;
+}
+
+static int32_t mz_zip_writer_auto_probe(void *handle, void *stream, int64_t stream_start,
+    int64_t disk_number, int64_t current_pos, int64_t probe_in, int64_t probe_out, uint8_t *restarted) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    void *zip_stream = NULL;
+    int64_t stream_end = 0;
+    int64_t end_disk_number = 0;
+    int32_t err = MZ_OK;
+
+    *restarted = 0;
+
+    /* Entries that already spanned to another disk can not be rewound */
+    mz_zip_get_stream(writer->zip_handle, &zip_stream);
+    mz_stream_get_prop_int64(zip_stream, MZ_STREAM_PROP_DISK_NUMBER, &end_disk_number);
+    if (end_disk_number != disk_number)
+        return MZ_EXIST_ERROR;
+
+    /* Judge only the most recent window so an easily compressed head does not hide the rest */
+    if (probe_out * 100 < probe_in * MZ_ZIP_AUTO_PROBE_RATIO)
+        return MZ_OK;
+
+    /* Storing must overwrite everything compressed so far, so leave the end of streams alone */
+    if (mz_stream_seek(stream, 0, MZ_SEEK_END) != MZ_OK)
+        return MZ_SEEK_ERROR;
+    stream_end = mz_stream_tell(stream);
+    if (mz_stream_seek(stream, stream_start + current_pos, MZ_SEEK_SET) != MZ_OK)
+        return MZ_SEEK_ERROR;
+    if (stream_end - stream_start < current_pos * 2)
+        return MZ_EXIST_ERROR;
+
+    err = mz_zip_entry_write_rewind(writer->zip_handle);
+    if (err == MZ_OK)
+        err = mz_stream_seek(stream, stream_start, MZ_SEEK_SET);
+#ifndef MZ_ZIP_NO_ENCRYPTION
+    if ((err == MZ_OK) && (writer->hash != NULL))
+        err = mz_crypt_sha_begin(writer->hash);
+#endif
+    if (err == MZ_OK) {
+        writer->file_info.compression_method = MZ_COMPRESS_METHOD_STORE;
+        err = mz_zip_entry_write_open(writer->zip_handle, &writer->file_info, 0, 0, writer->password);
+    }
+    if (err == MZ_OK)
+        *restarted = 1;
+    return err;
+}
+
 int32_t mz_zip_writer_add(void *handle, void *stream, mz_stream_read_cb read_cb) {
     mz_zip_writer *writer = (mz_zip_writer *)handle;
+    void *zip_stream = NULL;
     uint64_t current_time = 0;
     uint64_t update_time = 0;
     int64_t current_pos = 0;
     int64_t update_pos = 0;
+    int64_t stream_start = -1;
+    int64_t probe_pos = 0;
+    int64_t probe_in = 0;
+    int64_t probe_out = 0;
+    int64_t disk_number = 0;
     int32_t err = MZ_OK;
     int32_t written = 0;
+    uint8_t restarted = 0;
+
+    /* Compression is probed only when the input can be rewound and restarted as stored */
+    if (writer->compress_auto && !writer->raw && (read_cb == mz_stream_read) &&
+        (writer->file_info.compression_method != MZ_COMPRESS_METHOD_STORE) &&
+        (((writer->file_info.flag & MZ_ZIP_FLAG_ENCRYPTED) == 0) || (writer->password != NULL))) {
+        stream_start = mz_stream_tell(stream);
+        mz_zip_get_stream(writer->zip_handle, &zip_stream);
+        mz_stream_get_prop_int64(zip_stream, MZ_STREAM_PROP_DISK_NUMBER, &disk_number);
+    }
 
     /* Update the progress at the beginning */
     if (writer->progress_cb != NULL)
@@ -1459,6 +3166,27 @@ int32_t mz_zip_writer_add(void *handle, void *stream, mz_stream_read_cb read_cb)
         if (written < 0)
             err = written;
 
+        /* Estimate from the data just written, the buffer still holds it */
+        if ((err == MZ_OK) && (stream_start >= 0)) {
+            probe_in += written;
+            probe_out += mz_zip_writer_auto_estimate(writer->buffer, written);
+        }
+
+        /* Fall back to storing if a window of data does not compress well */
+        if ((err == MZ_OK) && (stream_start >= 0) && (current_pos - probe_pos >= MZ_ZIP_AUTO_PROBE_SIZE)) {
+            err = mz_zip_writer_auto_probe(handle, stream, stream_start, disk_number, current_pos,
+                probe_in, probe_out, &restarted);
+            probe_pos = current_pos;
+            probe_in = 0;
+            probe_out = 0;
+            if (restarted)
+                current_pos = 0;
+            if (restarted || err == MZ_EXIST_ERROR)
+                stream_start = -1;
+            if (err == MZ_EXIST_ERROR)
+                err = MZ_OK;
+        }
+
         /* Update progress if enough time have passed */
         current_time = mz_os_ms_time();
         if ((current_time - update_time) > writer->progress_cb_interval_ms) {
@@ -1477,8 +3205,257 @@ int32_t mz_zip_writer_add(void *handle, void *stream, mz_stream_read_cb read_cb)
     return err;
 }
 
+#ifndef MZ_ZIP_NO_ENCRYPTION
+static int32_t mz_zip_writer_dedup_size(void *stream, int64_t *size) {
+    int64_t start_pos = 0;
+    int32_t err = MZ_OK;
+
+    *size = 0;
+
+    start_pos = mz_stream_tell(stream);
+    if (start_pos < 0)
+        return MZ_TELL_ERROR;
+    err = mz_stream_seek(stream, 0, MZ_SEEK_END);
+    if (err == MZ_OK)
+        *size = mz_stream_tell(stream) - start_pos;
+    if (err == MZ_OK)
+        err = mz_stream_seek(stream, start_pos, MZ_SEEK_SET);
+    return err;
+}
+
+static int32_t mz_zip_writer_dedup_hash(void *handle, void *stream) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    void *hash = NULL;
+    int64_t start_pos = 0;
+    int32_t read = 0;
+    int32_t err = MZ_OK;
+
+    start_pos = mz_stream_tell(stream);
+    if (start_pos < 0)
+        return MZ_TELL_ERROR;
+
+    /* Same hash as the one calculated while the data is written */
+    mz_crypt_sha_create(&hash);
+    mz_crypt_sha_set_algorithm(hash, mz_zip_writer_hash_get_algorithm(handle));
+    err = mz_crypt_sha_begin(hash);
+
+    while (err == MZ_OK) {
+        read = mz_stream_read(stream, writer->buffer, sizeof(writer->buffer));
+        if (read < 0)
+            err = read;
+        if (read <= 0)
+            break;
+        if (mz_crypt_sha_update(hash, writer->buffer, read) != read)
+            err = MZ_HASH_ERROR;
+    }
+
+    memset(writer->hash_digest, 0, sizeof(writer->hash_digest));
+    if (err == MZ_OK)
+        err = mz_crypt_sha_end(hash, writer->hash_digest, sizeof(writer->hash_digest));
+    if (err == MZ_OK)
+        err = mz_stream_seek(stream, start_pos, MZ_SEEK_SET);
+    if (err == MZ_OK)
+        writer->hash_known = 1;
+
+    mz_crypt_sha_delete(&hash);
+    return err;
+}
+
+static mz_zip_writer_dedup *mz_zip_writer_dedup_find(void *handle, int64_t uncompressed_size) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    mz_zip_writer_dedup *dedup = NULL;
+    uint32_t mask = (uint32_t)writer->dedup_table_size - 1;
+    uint32_t i = 0;
+
+    if (writer->dedup_table == NULL)
+        return NULL;
+
+    /* Open addressing using the start of the hash as the slot */
+    memcpy(&i, writer->hash_digest, sizeof(i));
+    for (i &= mask; writer->dedup_table[i].used; i = (i + 1) & mask) {
+        dedup = &writer->dedup_table[i];
+        if ((dedup->uncompressed_size == uncompressed_size) &&
+            (memcmp(dedup->digest, writer->hash_digest, sizeof(dedup->digest)) == 0))
+            return dedup;
+    }
+    return NULL;
+}
+
+static uint32_t mz_zip_writer_dedup_size_slot(int64_t size, uint32_t mask) {
+    return ((uint32_t)size * 2654435761u) & mask;
+}
+
+static int32_t mz_zip_writer_dedup_size_exists(void *handle, int64_t uncompressed_size) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    uint32_t mask = (uint32_t)writer->dedup_table_size - 1;
+    uint32_t i = 0;
+
+    if (writer->dedup_sizes == NULL)
+        return MZ_EXIST_ERROR;
+
+    /* Sizes are kept in their own set so only same sized data needs hashing up front */
+    i = mz_zip_writer_dedup_size_slot(uncompressed_size, mask);
+    for (; writer->dedup_sizes[i] != 0; i = (i + 1) & mask) {
+        if (writer->dedup_sizes[i] == uncompressed_size)
+            return MZ_OK;
+    }
+    return MZ_EXIST_ERROR;
+}
+
+static void mz_zip_writer_dedup_insert(void *handle, const mz_zip_writer_dedup *dedup) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    uint32_t mask = (uint32_t)writer->dedup_table_size - 1;
+    uint32_t i = 0;
+
+    memcpy(&i, dedup->digest, sizeof(i));
+    for (i &= mask; writer->dedup_table[i].used; i = (i + 1) & mask)
+        ;
+
+    memcpy(&writer->dedup_table[i], dedup, sizeof(mz_zip_writer_dedup));
+    writer->dedup_table[i].used = 1;
+    writer->dedup_count += 1;
+
+    i = mz_zip_writer_dedup_size_slot(dedup->uncompressed_size, mask);
+    for (; writer->dedup_sizes[i] != 0; i = (i + 1) & mask) {
+        if (writer->dedup_sizes[i] == dedup->uncompressed_size)
+            return;
+    }
+    writer->dedup_sizes[i] = dedup->uncompressed_size;
+}
+
+static int32_t mz_zip_writer_dedup_add(void *handle, const mz_zip_writer_dedup *dedup) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    mz_zip_writer_dedup *old_table = writer->dedup_table;
+    int64_t *old_sizes = writer->dedup_sizes;
+    int32_t old_table_size = writer->dedup_table_size;
+    int32_t table_size = 0;
+    int32_t n = 0;
+
+    /* Keep the tables at most half full */
+    if ((writer->dedup_count + 1) * 2 > writer->dedup_table_size) {
+        table_size = MZ_ZIP_DEDUP_TABLE_SIZE;
+        if (old_table_size > 0)
+            table_size = old_table_size * 2;
+
+        writer->dedup_table = (mz_zip_writer_dedup *)MZ_ALLOC(table_size * sizeof(mz_zip_writer_dedup));
+        writer->dedup_sizes = (int64_t *)MZ_ALLOC(table_size * sizeof(int64_t));
+        if (writer->dedup_table == NULL || writer->dedup_sizes == NULL) {
+            if (writer->dedup_table != NULL)
+                MZ_FREE(writer->dedup_table);
+            if (writer->dedup_sizes != NULL)
+                MZ_FREE(writer->dedup_sizes);
+            writer->dedup_table = old_table;
+            writer->dedup_sizes = old_sizes;
+            return MZ_MEM_ERROR;
+        }
+        memset(writer->dedup_table, 0, table_size * sizeof(mz_zip_writer_dedup));
+        memset(writer->dedup_sizes, 0, table_size * sizeof(int64_t));
+        writer->dedup_table_size = table_size;
+        writer->dedup_count = 0;
+
+        for (n = 0; n < old_table_size; n += 1) {
+            if (old_table[n].used)
+                mz_zip_writer_dedup_insert(handle, &old_table[n]);
+        }
+        if (old_table != NULL)
+            MZ_FREE(old_table);
+        if (old_sizes != NULL)
+            MZ_FREE(old_sizes);
+    }
+
+    mz_zip_writer_dedup_insert(handle, dedup);
+    return MZ_OK;
+}
+
+static int32_t mz_zip_writer_dedup_readable(void *handle, const mz_zip_writer_dedup *dedup) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    void *zip_stream = NULL;
+    int64_t current_pos = 0;
+    int32_t err = MZ_OK;
+    uint8_t value = 0;
+
+    /* Copying reads the earlier data back, which write only streams can not do */
+    mz_zip_get_stream(writer->zip_handle, &zip_stream);
+    current_pos = mz_stream_tell(zip_stream);
+    if (current_pos < 0)
+        return MZ_TELL_ERROR;
+
+    err = mz_stream_seek(zip_stream, dedup->data_offset, MZ_SEEK_SET);
+    if ((err == MZ_OK) && (dedup->compressed_size > 0) && (mz_stream_read(zip_stream, &value, 1) != 1))
+        err = MZ_READ_ERROR;
+    if (mz_stream_seek(zip_stream, current_pos, MZ_SEEK_SET) != MZ_OK)
+        return MZ_SEEK_ERROR;
+    return err;
+}
+
+static int32_t mz_zip_writer_dedup_copy(void *handle, mz_zip_file *file_info, const mz_zip_writer_dedup *dedup) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    mz_zip_file dedup_file_info;
+    void *zip_stream = NULL;
+    int64_t src_pos = dedup->data_offset;
+    int64_t dst_pos = 0;
+    int64_t left = dedup->compressed_size;
+    int32_t chunk = 0;
+    int32_t err = MZ_OK;
+    int16_t original_level = writer->compress_level;
+    uint8_t original_raw = writer->raw;
+
+
+    memcpy(&dedup_file_info, file_info, sizeof(mz_zip_file));
+    dedup_file_info.compression_method = dedup->compression_method;
+    dedup_file_info.crc = dedup->crc;
+    dedup_file_info.compressed_size = dedup->compressed_size;
+    dedup_file_info.uncompressed_size = dedup->uncompressed_size;
+
+    /* Write the previously compressed data again in raw mode */
+    writer->raw = 1;
+    writer->compress_level = dedup->compress_level;
+
+    err = mz_zip_writer_entry_open(handle, &dedup_file_info);
+
+    writer->compress_level = original_level;
+
+    mz_zip_get_stream(writer->zip_handle, &zip_stream);
+    dst_pos = mz_stream_tell(zip_stream);
+
+    while ((err == MZ_OK) && (left > 0)) {
+        chunk = sizeof(writer->buffer);
+        if (chunk > left)
+            chunk = (int32_t)left;
+
+        err = mz_stream_seek(zip_stream, src_pos, MZ_SEEK_SET);
+        if ((err == MZ_OK) && (mz_stream_read(zip_stream, writer->buffer, chunk) != chunk))
+            err = MZ_READ_ERROR;
+        if (err == MZ_OK)
+            err = mz_stream_seek(zip_stream, dst_pos, MZ_SEEK_SET);
+        if ((err == MZ_OK) && (mz_zip_writer_entry_write(handle, writer->buffer, chunk) != chunk))
+            err = MZ_WRITE_ERROR;
+
+        src_pos += chunk;
+        dst_pos += chunk;
+        left -= chunk;
+    }
+
+    if (err == MZ_OK)
+        err = mz_zip_writer_entry_close(handle);
+
+    writer->raw = original_raw;
+    return err;
+}
+#endif
+
 int32_t mz_zip_writer_add_info(void *handle, void *stream, mz_stream_read_cb read_cb, mz_zip_file *file_info) {
     mz_zip_writer *writer = (mz_zip_writer *)handle;
+    mz_zip_file auto_file_info;
+#ifndef MZ_ZIP_NO_ENCRYPTION
+    mz_zip_writer_dedup dedup;
+    mz_zip_writer_dedup *dedup_found = NULL;
+    mz_zip_file *zip_file_info = NULL;
+    void *zip_stream = NULL;
+    int64_t disk_size = 0;
+    uint8_t dedup_entry = 0;
+#endif
+    int16_t original_level = 0;
     int32_t err = MZ_OK;
 
 
@@ -1487,20 +3464,92 @@ int32_t mz_zip_writer_add_info(void *handle, void *stream, mz_stream_read_cb rea
     if (file_info == NULL)
         return MZ_PARAM_ERROR;
 
+    original_level = writer->compress_level;
+
+#ifndef MZ_ZIP_NO_ENCRYPTION
+    memset(&dedup, 0, sizeof(dedup));
+    mz_zip_get_stream(writer->zip_handle, &zip_stream);
+    mz_stream_get_prop_int64(zip_stream, MZ_STREAM_PROP_DISK_SIZE, &disk_size);
+
+    /* Look for identical data already compressed in this archive, it must be
+       unencrypted and on the same disk so it can be read back and copied */
+    if (writer->dedup && !writer->raw && (stream != NULL) && (read_cb == mz_stream_read) &&
+        (disk_size == 0) && (writer->password == NULL) &&
+        ((file_info->flag & MZ_ZIP_FLAG_ENCRYPTED) == 0) &&
+        (mz_zip_attrib_is_dir(file_info->external_fa, file_info->version_madeby) != MZ_OK)) {
+        dedup_entry = 1;
+        /* Most data is hashed while it is compressed, read it ahead only if its size was seen before */
+        if (mz_zip_writer_dedup_size(stream, &dedup.uncompressed_size) != MZ_OK)
+            dedup_entry = 0;
+        if (dedup_entry && (mz_zip_writer_dedup_size_exists(handle, dedup.uncompressed_size) == MZ_OK)) {
+            err = mz_zip_writer_dedup_hash(handle, stream);
+            if (err == MZ_OK)
+                dedup_found = mz_zip_writer_dedup_find(handle, dedup.uncompressed_size);
+        }
+        if ((dedup_found != NULL) && (mz_zip_writer_dedup_readable(handle, dedup_found) == MZ_OK)) {
+            err = mz_zip_writer_dedup_copy(handle, file_info, dedup_found);
+            writer->hash_known = 0;
+            return err;
+        }
+    }
+#endif
+
+    /* Pick compression method and level from a sample of the data */
+    if (writer->compress_auto && !writer->raw && (stream != NULL) && (read_cb == mz_stream_read) &&
+        (file_info->compression_method != MZ_COMPRESS_METHOD_STORE) &&
+        (mz_zip_attrib_is_dir(file_info->external_fa, file_info->version_madeby) != MZ_OK)) {
+        memcpy(&auto_file_info, file_info, sizeof(mz_zip_file));
+        err = mz_zip_writer_auto_select(handle, stream, &auto_file_info.compression_method,
+            &writer->compress_level);
+        file_info = &auto_file_info;
+    }
+
     /* Add to zip */
-    err = mz_zip_writer_entry_open(handle, file_info);
-    if (err != MZ_OK)
-        return err;
+    if (err == MZ_OK)
+        err = mz_zip_writer_entry_open(handle, file_info);
 
-    if (stream != NULL) {
-        if (mz_zip_attrib_is_dir(writer->file_info.external_fa, writer->file_info.version_madeby) != MZ_OK) {
+#ifndef MZ_ZIP_NO_ENCRYPTION
+    if ((err == MZ_OK) && dedup_entry) {
+        dedup.data_offset = mz_stream_tell(zip_stream);
+        dedup.compress_level = writer->compress_level;
+    }
+#endif
+
+    if ((err == MZ_OK) && (stream != NULL)) {
+        if (mz_zip_attrib_is_dir(writer->file_info.external_fa, writer->file_info.version_madeby) != MZ_OK)
             err = mz_zip_writer_add(handle, stream, read_cb);
-            if (err != MZ_OK)
-                return err;
-        }
     }
 
-    err = mz_zip_writer_entry_close(handle);
+    writer->compress_level = original_level;
+
+#ifndef MZ_ZIP_NO_ENCRYPTION
+    /* Data compressed against a dictionary can't be copied, check while the entry's own
+       extra field is still around since closing replaces it */
+    if ((err == MZ_OK) && dedup_entry &&
+        (mz_zip_entry_get_info(writer->zip_handle, &zip_file_info) == MZ_OK) &&
+        (mz_zip_extrafield_contains(zip_file_info->extrafield, zip_file_info->extrafield_size,
+            MZ_ZIP_EXTENSION_DICT, NULL) == MZ_OK))
+        dedup_entry = 0;
+#endif
+
+    if (err == MZ_OK)
+        err = mz_zip_writer_entry_close(handle);
+
+#ifndef MZ_ZIP_NO_ENCRYPTION
+    /* Remember where the compressed data was written for later duplicates */
+    if ((err == MZ_OK) && dedup_entry &&
+        (mz_zip_entry_get_info(writer->zip_handle, &zip_file_info) == MZ_OK) &&
+        (zip_file_info->uncompressed_size > 0)) {
+        memcpy(dedup.digest, writer->hash_digest, sizeof(dedup.digest));
+        dedup.uncompressed_size = zip_file_info->uncompressed_size;
+        dedup.compressed_size = zip_file_info->compressed_size;
+        dedup.crc = zip_file_info->crc;
+        dedup.compression_method = zip_file_info->compression_method;
+        err = mz_zip_writer_dedup_add(handle, &dedup);
+    }
+
+    writer->hash_known = 0;
+#endif
 
     return err;
 }
@@ -1520,7 +3569,7 @@ int32_t mz_zip_writer_add_buffer(void *handle, void *buf, int32_t len, mz_zip_fi
 
     err = mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_READ);
     if (err == MZ_OK)
-        err = mz_zip_writer_add_info(handle, mem_stream, mz_stream_mem_read, file_info);
+        err = mz_zip_writer_add_info(handle, mem_stream, mz_stream_read, file_info);
 
     mz_stream_mem_delete(&mem_stream);
     return err;
@@ -1698,6 +3747,8 @@ int32_t mz_zip_writer_copy_from_reader(void *handle, void *reader) {
     uint8_t original_raw = 0;
     void *reader_zip_handle = NULL;
     void *writer_zip_handle = NULL;
+    const void *dict = NULL;
+    int32_t dict_size = 0;
 
 
     if (mz_zip_reader_is_open(reader) != MZ_OK)
@@ -1716,6 +3767,17 @@ int32_t mz_zip_writer_copy_from_reader(void *handle, void *reader) {
     /* Open entry for raw reading */
     err = mz_zip_entry_read_open(reader_zip_handle, 1, NULL);
 
+    /* Raw data compressed with a dictionary needs the same dictionary in the new zip */
+    if ((err == MZ_OK) && (mz_zip_extrafield_contains(file_info->extrafield, file_info->extrafield_size,
+            MZ_ZIP_EXTENSION_DICT, NULL) == MZ_OK) &&
+        (mz_zip_get_dictionary(writer_zip_handle, &dict, &dict_size) != MZ_OK)) {
+        err = mz_zip_get_dictionary(reader_zip_handle, &dict, &dict_size);
+        if (err == MZ_OK)
+            err = mz_zip_set_dictionary(writer_zip_handle, dict, dict_size);
+        if (err != MZ_OK)
+            mz_zip_entry_close(reader_zip_handle);
+    }
+
     if (err == MZ_OK) {
         /* Write entry raw, save original raw value */
         original_raw = writer->raw;
@@ -1786,6 +3848,44 @@ void mz_zip_writer_set_compress_level(void *handle, int16_t compress_level) {
     writer->compress_level = compress_level;
 }
 
+void mz_zip_writer_set_compress_auto(void *handle, uint8_t compress_auto) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    writer->compress_auto = compress_auto;
+}
+
+void mz_zip_writer_set_dedup(void *handle, uint8_t dedup) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    writer->dedup = dedup;
+}
+
+int32_t mz_zip_writer_set_hash_algorithm(void *handle, uint16_t algorithm) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    if ((algorithm != 0) && (algorithm != MZ_HASH_SHA1) && (algorithm != MZ_HASH_SHA256))
+        return MZ_PARAM_ERROR;
+    writer->hash_algorithm = algorithm;
+    return MZ_OK;
+}
+
+void mz_zip_writer_set_dictionary_size(void *handle, int32_t dict_size) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    writer->dict_size = dict_size;
+}
+
+void mz_zip_writer_set_frame_size(void *handle, int32_t frame_size) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    writer->frame_size = frame_size;
+}
+
+void mz_zip_writer_set_stats(void *handle, mz_zip_stats *stats) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    writer->stats = stats;
+}
+
+void mz_zip_writer_set_alloc(void *handle, mz_alloc *alloc) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    writer->alloc = alloc;
+}
+
 void mz_zip_writer_set_follow_links(void *handle, uint8_t follow_links) {
     mz_zip_writer *writer = (mz_zip_writer *)handle;
     writer->follow_links = follow_links;
@@ -1873,6 +3973,17 @@ void mz_zip_writer_set_entry_cb(void *handle, void *userdata, mz_zip_writer_entr
     writer->entry_userdata = userdata;
 }
 
+void mz_zip_writer_set_timing_cb(void *handle, void *userdata, mz_zip_writer_timing_cb cb) {
+    mz_zip_writer *writer = (mz_zip_writer *)handle;
+    writer->timing_cb = cb;
+    writer->timing_userdata = userdata;
+    /* Timings are taken from the stream counters so keep our own if none are set */
+    if ((cb != NULL) && (writer->stats == NULL)) {
+        memset(&writer->timing_stats, 0, sizeof(writer->timing_stats));
+        writer->stats = &writer->timing_stats;
+    }
+}
+
 int32_t mz_zip_writer_get_zip_handle(void *handle, void **zip_handle) {
     mz_zip_writer *writer = (mz_zip_writer *)handle;
     if (zip_handle == NULL)
@@ -1905,6 +4016,7 @@ void *mz_zip_writer_create(void **handle) {
 #endif
         writer->compress_level = MZ_COMPRESS_LEVEL_BEST;
         writer->progress_cb_interval_ms = MZ_DEFAULT_PROGRESS_INTERVAL;
+        writer->hash_algorithm = MZ_HASH_SHA256;
 
         *handle = writer;
     }
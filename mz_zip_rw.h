@@ -17,10 +17,44 @@ extern "C" {
 
 /***************************************************************************/
 
+typedef struct mz_zip_entry_timing_s {
+    uint64_t    header_time;        /* nanoseconds opening the entry and its local header */
+    uint64_t    io_time;            /* nanoseconds reading or writing the archive stream */
+    uint64_t    crypt_time;         /* nanoseconds decrypting or encrypting */
+    uint64_t    compress_time;      /* nanoseconds decompressing or compressing */
+    uint64_t    data_time;          /* nanoseconds writing extracted or reading added data */
+} mz_zip_entry_timing;
+
+typedef struct mz_zip_reader_batch_s {
+    const char  *filename;          /* entry to read, or NULL to read the entry at index */
+    int64_t     index;              /* position of the entry in the central directory */
+    void        *buf;               /* receives the uncompressed data, or NULL to pass it to write_cb */
+    int32_t     buf_size;           /* size of buf */
+    void        *stream;            /* first argument of write_cb */
+    mz_stream_write_cb
+                write_cb;           /* called with the uncompressed data when there is no buf */
+    int64_t     read;               /* number of uncompressed bytes delivered */
+    int32_t     err;                /* result of reading the entry */
+} mz_zip_reader_batch;
+
+typedef struct mz_zip_reader_test_result_s {
+    int64_t     entries;            /* entries read and checked */
+    int64_t     hashed;             /* entries also checked against a stored hash */
+    int64_t     skipped;            /* directories, symbolic links and empty entries */
+    int64_t     failed;             /* entries with a crc, hash or read error */
+    int64_t     bytes;              /* uncompressed bytes checked */
+    uint64_t    elapsed_ns;         /* time taken to check all entries */
+    uint64_t    bytes_per_sec;      /* uncompressed throughput */
+} mz_zip_reader_test_result;
+
+/***************************************************************************/
+
 typedef int32_t (*mz_zip_reader_overwrite_cb)(void *handle, void *userdata, mz_zip_file *file_info, const char *path);
 typedef int32_t (*mz_zip_reader_password_cb)(void *handle, void *userdata, mz_zip_file *file_info, char *password, int32_t max_password);
 typedef int32_t (*mz_zip_reader_progress_cb)(void *handle, void *userdata, mz_zip_file *file_info, int64_t position);
 typedef int32_t (*mz_zip_reader_entry_cb)(void *handle, void *userdata, mz_zip_file *file_info, const char *path);
+typedef void    (*mz_zip_reader_timing_cb)(void *handle, void *userdata, mz_zip_file *file_info, const mz_zip_entry_timing *timing);
+typedef void    (*mz_zip_reader_test_cb)(void *handle, void *userdata, mz_zip_file *file_info, int32_t result);
 
 /***************************************************************************/
 
@@ -58,6 +92,9 @@ int32_t mz_zip_reader_goto_next_entry(void *handle);
 int32_t mz_zip_reader_locate_entry(void *handle, const char *filename, uint8_t ignore_case);
 /* Locates an entry by filename */
 
+int32_t mz_zip_reader_sidecar_save(void *handle);
+/* Writes a sidecar index next to the archive opened by path for locating entries without a scan */
+
 int32_t mz_zip_reader_entry_open(void *handle);
 /* Opens an entry for reading */
 
@@ -67,6 +104,9 @@ int32_t mz_zip_reader_entry_close(void *handle);
 int32_t mz_zip_reader_entry_read(void *handle, void *buf, int32_t len);
 /* Reads and entry after being opened */
 
+int32_t mz_zip_reader_entry_read_at(void *handle, int64_t offset, void *buf, int32_t len);
+/* Reads a stored entry at an offset without moving the stream, safe to call concurrently */
+
 int32_t mz_zip_reader_entry_has_sign(void *handle);
 /* Checks to see if the entry has a signature  */
 
@@ -100,16 +140,25 @@ int32_t mz_zip_reader_entry_save_buffer(void *handle, void *buf, int32_t len);
 int32_t mz_zip_reader_entry_save_buffer_length(void *handle);
 /* Gets the length of the buffer required to save */
 
+int32_t mz_zip_reader_read_batch(void *handle, mz_zip_reader_batch *entries, int32_t count);
+/* Reads many entries in the order they are stored in the zip file */
+
 /***************************************************************************/
 
 int32_t mz_zip_reader_save_all(void *handle, const char *destination_dir);
 /* Save all files into a directory */
 
+int32_t mz_zip_reader_test_all(void *handle, mz_zip_reader_test_result *result);
+/* Checks the crc and stored hash of all entries without saving them */
+
 /***************************************************************************/
 
 void    mz_zip_reader_set_pattern(void *handle, const char *pattern, uint8_t ignore_case);
 /* Sets the match pattern for entries in the zip file, if null all entries are matched */
 
+void    mz_zip_reader_set_patterns(void *handle, void *patterns);
+/* Sets a set of patterns created with mz_pattern_create that entries must match one of, used instead of the pattern */
+
 void    mz_zip_reader_set_password(void *handle, const char *password);
 /* Sets the password required for extraction */
 
@@ -134,6 +183,24 @@ void    mz_zip_reader_set_encoding(void *handle, int32_t encoding);
 void    mz_zip_reader_set_sign_required(void *handle, uint8_t sign_required);
 /* Sets whether or not it a signature is required  */
 
+void    mz_zip_reader_set_stats(void *handle, mz_zip_stats *stats);
+/* Sets the counters updated by each stream layer, must be set before opening */
+
+void    mz_zip_reader_set_alloc(void *handle, mz_alloc *alloc);
+/* Sets the allocator used for codec state, must be set before opening */
+
+void    mz_zip_reader_set_ordered(void *handle, uint8_t ordered);
+/* Sets whether save all extracts entries in the order they are stored instead of central dir order */
+
+void    mz_zip_reader_set_drop_cache(void *handle, uint8_t drop_cache);
+/* Sets whether ordered save all drops archive data from the system cache once it is extracted */
+
+void    mz_zip_reader_set_low_memory(void *handle, uint8_t low_memory);
+/* Sets whether buffers and entry streams are freed while no entry is open, must be set before opening */
+
+void    mz_zip_reader_set_sidecar(void *handle, uint8_t sidecar);
+/* Sets whether a matching sidecar index is mapped when opening by path, must be set before opening */
+
 void    mz_zip_reader_set_overwrite_cb(void *handle, void *userdata, mz_zip_reader_overwrite_cb cb);
 /* Callback for what to do when a file is being overwritten */
 
@@ -146,12 +213,30 @@ void    mz_zip_reader_set_progress_cb(void *handle, void *userdata, mz_zip_reade
 void    mz_zip_reader_set_progress_interval(void *handle, uint32_t milliseconds);
 /* Let at least milliseconds pass between calls to progress callback */
 
+void    mz_zip_reader_set_recover_cb(void *handle, void *userdata, mz_zip_recover_cb cb);
+/* Callback for central dir recovery progress, the handle passed is the zip handle */
+
+void    mz_zip_reader_set_recover_threads(void *handle, int32_t thread_count);
+/* Sets the number of threads that scan the archive when recovering the central dir */
+
 void    mz_zip_reader_set_entry_cb(void *handle, void *userdata, mz_zip_reader_entry_cb cb);
 /* Callback for zip file entries */
 
+void    mz_zip_reader_set_timing_cb(void *handle, void *userdata, mz_zip_reader_timing_cb cb);
+/* Callback with where the time went when each entry is closed, must be set before opening */
+
+void    mz_zip_reader_set_test_cb(void *handle, void *userdata, mz_zip_reader_test_cb cb);
+/* Callback with the result of each entry checked by test all */
+
+void    mz_zip_reader_set_test_threads(void *handle, int32_t thread_count);
+/* Sets the number of threads test all checks entries on, archive must be opened by path */
+
 int32_t mz_zip_reader_get_zip_handle(void *handle, void **zip_handle);
 /* Gets the underlying zip instance handle */
 
+int32_t mz_zip_reader_has_sidecar(void *handle);
+/* Checks whether entries are located through a sidecar index */
+
 void*   mz_zip_reader_create(void **handle);
 /* Create new instance of zip reader */
 
@@ -164,6 +249,7 @@ typedef int32_t (*mz_zip_writer_overwrite_cb)(void *handle, void *userdata, cons
 typedef int32_t (*mz_zip_writer_password_cb)(void *handle, void *userdata, mz_zip_file *file_info, char *password, int32_t max_password);
 typedef int32_t (*mz_zip_writer_progress_cb)(void *handle, void *userdata, mz_zip_file *file_info, int64_t position);
 typedef int32_t (*mz_zip_writer_entry_cb)(void *handle, void *userdata, mz_zip_file *file_info);
+typedef void    (*mz_zip_writer_timing_cb)(void *handle, void *userdata, mz_zip_file *file_info, const mz_zip_entry_timing *timing);
 
 /***************************************************************************/
 
@@ -240,6 +326,27 @@ void    mz_zip_writer_set_compress_method(void *handle, uint16_t compress_method
 void    mz_zip_writer_set_compress_level(void *handle, int16_t compress_level);
 /* Sets the compression level when adding files in zip */
 
+void    mz_zip_writer_set_compress_auto(void *handle, uint8_t compress_auto);
+/* Sets whether or not to pick the compression method per file from a sample of its data */
+
+void    mz_zip_writer_set_dedup(void *handle, uint8_t dedup);
+/* Sets whether or not files with identical contents are only compressed once */
+
+int32_t mz_zip_writer_set_hash_algorithm(void *handle, uint16_t algorithm);
+/* Sets the hash stored with each entry, MZ_HASH_SHA256 by default, MZ_HASH_SHA1 or 0 for none */
+
+void    mz_zip_writer_set_dictionary_size(void *handle, int32_t dict_size);
+/* Sets the size of the dictionary trained from the first files and shared by the rest, 0 disables */
+
+void    mz_zip_writer_set_frame_size(void *handle, int32_t frame_size);
+/* Sets the size zstd entries are split into independent frames at for random access, 0 disables */
+
+void    mz_zip_writer_set_stats(void *handle, mz_zip_stats *stats);
+/* Sets the counters updated by each stream layer, must be set before opening */
+
+void    mz_zip_writer_set_alloc(void *handle, mz_alloc *alloc);
+/* Sets the allocator used for codec state, must be set before opening */
+
 void    mz_zip_writer_set_follow_links(void *handle, uint8_t follow_links);
 /* Follow symbolic links when traversing directories and files to add */
 
@@ -267,6 +374,9 @@ void    mz_zip_writer_set_progress_interval(void *handle, uint32_t milliseconds)
 void    mz_zip_writer_set_entry_cb(void *handle, void *userdata, mz_zip_writer_entry_cb cb);
 /* Callback for zip file entries */
 
+void    mz_zip_writer_set_timing_cb(void *handle, void *userdata, mz_zip_writer_timing_cb cb);
+/* Callback with where the time went when each entry is closed, must be set before opening */
+
 int32_t mz_zip_writer_get_zip_handle(void *handle, void **zip_handle);
 /* Gets the underlying zip handle */
 
@@ -0,0 +1,1182 @@
+/* bench.c - Benchmark suite
+   part of the MiniZip project
+
+   Copyright (C) 2018-2020 Nathan Moinvaziri
+     https://github.com/nmoinvaz/minizip
+
+   This program is distributed under the terms of the same license as zlib.
+   See the accompanying LICENSE file for the full text of the license.
+*/
+
+#include "mz.h"
+#include "mz_os.h"
+#include "mz_strm.h"
+#include "mz_strm_mem.h"
+#include "mz_strm_os.h"
+#include "mz_zip.h"
+#include "mz_zip_rw.h"
+
+#include <stdio.h> /* printf, snprintf, fprintf */
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <time.h> /* clock_gettime */
+#endif
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC_MINOR__ >= 33))
+#  include <malloc.h> /* mallinfo2 */
+#  define BENCH_HEAP_USED
+#endif
+
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+#  define snprintf _snprintf
+#endif
+
+/***************************************************************************/
+
+#define BENCH_PASSWORD                  ("benchmark")
+#define BENCH_MIN_SECONDS               (0.25)
+#define BENCH_BLOCK_SIZE                (64 * 1024)
+
+/***************************************************************************/
+
+typedef struct bench_entry_s {
+    char        filename[32];
+    int32_t     offset;
+    int32_t     size;
+} bench_entry;
+
+typedef struct bench_corpus_s {
+    const char  *name;
+    uint8_t     *data;
+    int32_t     data_size;
+    bench_entry *entries;
+    int32_t     entry_count;
+} bench_corpus;
+
+typedef struct bench_method_s {
+    const char  *name;
+    uint16_t    compress_method;
+} bench_method;
+
+typedef struct bench_crypt_s {
+    const char  *name;
+    const char  *password;
+    uint8_t     aes;
+} bench_crypt;
+
+typedef struct bench_result_s {
+    const char  *name;
+    const char  *corpus;
+    const char  *method;
+    const char  *encryption;
+    int64_t     entries;
+    int64_t     bytes;
+    int64_t     compressed_bytes;
+    int64_t     operations;
+    int64_t     heap_bytes;
+    double      seconds;
+} bench_result;
+
+typedef struct bench_options_s {
+    const char  *output_path;
+    const char  *work_dir;
+    int32_t     iterations;
+    uint8_t     quick;
+} bench_options;
+
+/***************************************************************************/
+
+static const bench_method bench_methods[] = {
+    { "store", MZ_COMPRESS_METHOD_STORE },
+#if defined(HAVE_ZLIB) || defined(HAVE_LIBCOMP)
+    { "deflate", MZ_COMPRESS_METHOD_DEFLATE },
+#endif
+#ifdef HAVE_BZIP2
+    { "bzip2", MZ_COMPRESS_METHOD_BZIP2 },
+#endif
+#ifdef HAVE_LZMA
+    { "lzma", MZ_COMPRESS_METHOD_LZMA },
+#endif
+#if defined(HAVE_LZMA) || defined(HAVE_LIBCOMP)
+    { "xz", MZ_COMPRESS_METHOD_XZ },
+#endif
+#ifdef HAVE_ZSTD
+    { "zstd", MZ_COMPRESS_METHOD_ZSTD },
+#endif
+};
+
+static const bench_crypt bench_crypts[] = {
+    { "none", NULL, 0 },
+#if !defined(MZ_ZIP_NO_ENCRYPTION) && defined(HAVE_PKCRYPT)
+    { "pkcrypt", BENCH_PASSWORD, 0 },
+#endif
+#if !defined(MZ_ZIP_NO_ENCRYPTION) && defined(HAVE_WZAES)
+    { "aes", BENCH_PASSWORD, 1 },
+#endif
+};
+
+static const char *bench_words[] = {
+    "archive", "buffer", "central", "directory", "entry", "extract", "header", "local",
+    "method", "offset", "password", "record", "signature", "stream", "update", "zip"
+};
+
+static uint32_t bench_seed = 0x5eed1234;
+static int32_t bench_result_count = 0;
+
+/***************************************************************************/
+
+static double bench_time(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+static int64_t bench_heap_used(void)
+{
+#ifdef BENCH_HEAP_USED
+    struct mallinfo2 info = mallinfo2();
+    return (int64_t)info.uordblks;
+#else
+    return -1;
+#endif
+}
+
+static uint32_t bench_rand(void)
+{
+    /* Fixed generator so every run works on the same data */
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return bench_seed >> 8;
+}
+
+static void bench_fill_random(uint8_t *buf, int32_t size)
+{
+    int32_t i = 0;
+    for (i = 0; i < size; i += 1)
+        buf[i] = (uint8_t)bench_rand();
+}
+
+static void bench_fill_text(uint8_t *buf, int32_t size, int32_t vocabulary)
+{
+    const char *word = NULL;
+    int32_t i = 0;
+
+    while (i < size)
+    {
+        word = bench_words[bench_rand() % vocabulary];
+        while (*word != 0 && i < size)
+            buf[i++] = (uint8_t)*word++;
+        if (i < size)
+            buf[i++] = (bench_rand() % 12 == 0) ? '\n' : ' ';
+    }
+}
+
+/***************************************************************************/
+
+static int32_t bench_corpus_create(bench_corpus *corpus, const char *name, int32_t entry_count,
+    int32_t data_size)
+{
+    memset(corpus, 0, sizeof(bench_corpus));
+    corpus->name = name;
+    corpus->data = (uint8_t *)MZ_ALLOC(data_size);
+    corpus->entries = (bench_entry *)MZ_ALLOC(entry_count * sizeof(bench_entry));
+    if (corpus->data == NULL || corpus->entries == NULL)
+        return MZ_MEM_ERROR;
+    memset(corpus->entries, 0, entry_count * sizeof(bench_entry));
+    corpus->data_size = data_size;
+    corpus->entry_count = entry_count;
+    return MZ_OK;
+}
+
+static void bench_corpus_delete(bench_corpus *corpus)
+{
+    if (corpus->data != NULL)
+        MZ_FREE(corpus->data);
+    if (corpus->entries != NULL)
+        MZ_FREE(corpus->entries);
+    memset(corpus, 0, sizeof(bench_corpus));
+}
+
+static int32_t bench_corpus_tiny(bench_corpus *corpus, int32_t entry_count)
+{
+    int32_t offset = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    /* Many small text files of varying size */
+    err = bench_corpus_create(corpus, "tiny", entry_count, entry_count * 1024);
+    for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+    {
+        snprintf(corpus->entries[i].filename, sizeof(corpus->entries[i].filename), "tiny/%05" PRId32 ".txt", i);
+        corpus->entries[i].offset = offset;
+        corpus->entries[i].size = 64 + (int32_t)(bench_rand() % 960);
+        bench_fill_text(corpus->data + offset, corpus->entries[i].size, 16);
+        offset += corpus->entries[i].size;
+    }
+    corpus->data_size = offset;
+    return err;
+}
+
+static int32_t bench_corpus_huge(bench_corpus *corpus, int32_t entry_size)
+{
+    int32_t offset = 0;
+    int32_t block = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    /* Few large files alternating between text and random blocks */
+    err = bench_corpus_create(corpus, "huge", 2, entry_size * 2);
+    for (i = 0; i < 2 && err == MZ_OK; i += 1)
+    {
+        snprintf(corpus->entries[i].filename, sizeof(corpus->entries[i].filename), "huge/%" PRId32 ".bin", i);
+        corpus->entries[i].offset = i * entry_size;
+        corpus->entries[i].size = entry_size;
+    }
+    for (offset = 0; offset < corpus->data_size && err == MZ_OK; offset += block)
+    {
+        block = BENCH_BLOCK_SIZE;
+        if (block > corpus->data_size - offset)
+            block = corpus->data_size - offset;
+        if ((offset / BENCH_BLOCK_SIZE) % 2 == 0)
+            bench_fill_text(corpus->data + offset, block, 16);
+        else
+            bench_fill_random(corpus->data + offset, block);
+    }
+    return err;
+}
+
+static int32_t bench_corpus_single(bench_corpus *corpus, const char *name, int32_t size, uint8_t random)
+{
+    int32_t err = MZ_OK;
+
+    err = bench_corpus_create(corpus, name, 1, size);
+    if (err == MZ_OK)
+    {
+        snprintf(corpus->entries[0].filename, sizeof(corpus->entries[0].filename), "%s.bin", name);
+        corpus->entries[0].size = size;
+        /* Incompressible noise or text from a tiny vocabulary */
+        if (random)
+            bench_fill_random(corpus->data, size);
+        else
+            bench_fill_text(corpus->data, size, 2);
+    }
+    return err;
+}
+
+/***************************************************************************/
+
+static void bench_result_print(FILE *output, const bench_result *result)
+{
+    double mb_per_sec = 0;
+    double entries_per_sec = 0;
+    double ns_per_op = 0;
+
+    if (result->seconds > 0)
+    {
+        mb_per_sec = (double)result->bytes / 1e6 / result->seconds;
+        entries_per_sec = (double)result->entries / result->seconds;
+    }
+    if (result->operations > 0)
+        ns_per_op = result->seconds * 1e9 / (double)result->operations;
+
+    fprintf(output, "%s\n    {\"name\": \"%s\", \"corpus\": \"%s\", \"method\": \"%s\", \"encryption\": \"%s\", "
+        "\"entries\": %" PRId64 ", \"bytes\": %" PRId64 ", \"compressed_bytes\": %" PRId64 ", "
+        "\"operations\": %" PRId64 ", \"heap_bytes\": %" PRId64 ", \"seconds\": %.6f, \"mb_per_sec\": %.3f, "
+        "\"entries_per_sec\": %.1f, \"ns_per_op\": %.1f}",
+        bench_result_count > 0 ? "," : "", result->name, result->corpus,
+        result->method ? result->method : "", result->encryption ? result->encryption : "",
+        result->entries, result->bytes, result->compressed_bytes, result->operations, result->heap_bytes,
+        result->seconds, mb_per_sec, entries_per_sec, ns_per_op);
+    fflush(output);
+
+    bench_result_count += 1;
+
+    if (result->heap_bytes > 0)
+    {
+        fprintf(stderr, "%-12s %-6s %-8s %-8s %12" PRId64 " bytes/handle\n", result->name, result->corpus,
+            result->method, "-", result->heap_bytes);
+    }
+    else if (result->operations > 0)
+    {
+        fprintf(stderr, "%-12s %-6s %-8s %-8s %12.1f ns/op\n", result->name, result->corpus,
+            "-", "-", ns_per_op);
+    }
+    else
+    {
+        fprintf(stderr, "%-12s %-6s %-8s %-8s %10.3f MB/s %12.1f entries/s\n", result->name, result->corpus,
+            result->method, result->encryption, mb_per_sec, entries_per_sec);
+    }
+}
+
+/***************************************************************************/
+
+static int32_t bench_compress(const bench_corpus *corpus, const bench_method *method,
+    const bench_crypt *crypt, uint16_t hash_algorithm, void *mem_stream, double *seconds)
+{
+    mz_zip_file file_info;
+    void *writer = NULL;
+    double start = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = method->compress_method;
+    file_info.flag = MZ_ZIP_FLAG_UTF8;
+    file_info.modified_date = 1577836800;
+    if (crypt->password != NULL)
+    {
+        file_info.flag |= MZ_ZIP_FLAG_ENCRYPTED;
+        file_info.aes_version = crypt->aes ? MZ_AES_VERSION : 0;
+    }
+
+    mz_stream_mem_set_buffer_limit(mem_stream, 0);
+    mz_stream_mem_seek(mem_stream, 0, MZ_SEEK_SET);
+
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_compress_method(writer, method->compress_method);
+    mz_zip_writer_set_compress_level(writer, MZ_COMPRESS_LEVEL_DEFAULT);
+    mz_zip_writer_set_password(writer, crypt->password);
+    mz_zip_writer_set_aes(writer, crypt->aes);
+    mz_zip_writer_set_hash_algorithm(writer, hash_algorithm);
+
+    start = bench_time();
+
+    err = mz_zip_writer_open(writer, mem_stream);
+    for (i = 0; i < corpus->entry_count && err == MZ_OK; i += 1)
+    {
+        file_info.filename = corpus->entries[i].filename;
+        file_info.uncompressed_size = corpus->entries[i].size;
+        err = mz_zip_writer_add_buffer(writer, corpus->data + corpus->entries[i].offset,
+            corpus->entries[i].size, &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+
+    *seconds = bench_time() - start;
+
+    mz_zip_writer_delete(&writer);
+    return err;
+}
+
+static int32_t bench_decompress(const bench_corpus *corpus, const bench_crypt *crypt, void *mem_stream,
+    uint8_t *temp, double *seconds)
+{
+    mz_zip_file *file_info = NULL;
+    void *reader = NULL;
+    const uint8_t *buf = NULL;
+    int32_t buf_size = 0;
+    double start = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    mz_stream_mem_get_buffer(mem_stream, (const void **)&buf);
+    mz_stream_mem_get_buffer_length(mem_stream, &buf_size);
+
+    mz_zip_reader_create(&reader);
+    mz_zip_reader_set_password(reader, crypt->password);
+
+    start = bench_time();
+
+    err = mz_zip_reader_open_buffer(reader, (uint8_t *)buf, buf_size, 0);
+    if (err == MZ_OK)
+        err = mz_zip_reader_goto_first_entry(reader);
+    while (err == MZ_OK)
+    {
+        err = mz_zip_reader_entry_get_info(reader, &file_info);
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_save_buffer(reader, temp, (int32_t)file_info->uncompressed_size);
+        if (err == MZ_OK)
+            err = mz_zip_reader_goto_next_entry(reader);
+        i += 1;
+    }
+    if (err == MZ_END_OF_LIST)
+        err = MZ_OK;
+    if (err == MZ_OK && i != corpus->entry_count)
+        err = MZ_FORMAT_ERROR;
+
+    mz_zip_reader_close(reader);
+
+    *seconds = bench_time() - start;
+
+    mz_zip_reader_delete(&reader);
+    return err;
+}
+
+static int32_t bench_codec(FILE *output, const bench_options *options, const bench_corpus *corpus,
+    const bench_method *method, const bench_crypt *crypt, uint8_t *temp)
+{
+    bench_result compress_result;
+    bench_result decompress_result;
+    void *mem_stream = NULL;
+    int32_t compressed_size = 0;
+    double seconds = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    memset(&compress_result, 0, sizeof(compress_result));
+    compress_result.name = "compress";
+    compress_result.corpus = corpus->name;
+    compress_result.method = method->name;
+    compress_result.encryption = crypt->name;
+    compress_result.entries = corpus->entry_count;
+    compress_result.bytes = corpus->data_size;
+    memcpy(&decompress_result, &compress_result, sizeof(decompress_result));
+    decompress_result.name = "decompress";
+
+    mz_stream_mem_create(&mem_stream);
+    mz_stream_mem_set_grow_size(mem_stream, 1024 * 1024);
+    mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    /* Report the best of all iterations */
+    for (i = 0; i < options->iterations && err == MZ_OK; i += 1)
+    {
+        err = bench_compress(corpus, method, crypt, MZ_HASH_SHA256, mem_stream, &seconds);
+        if (err == MZ_OK && (i == 0 || seconds < compress_result.seconds))
+            compress_result.seconds = seconds;
+        if (err == MZ_OK)
+            err = bench_decompress(corpus, crypt, mem_stream, temp, &seconds);
+        if (err == MZ_OK && (i == 0 || seconds < decompress_result.seconds))
+            decompress_result.seconds = seconds;
+    }
+
+    mz_stream_mem_get_buffer_length(mem_stream, &compressed_size);
+    compress_result.compressed_bytes = compressed_size;
+    decompress_result.compressed_bytes = compressed_size;
+
+    mz_stream_mem_close(mem_stream);
+    mz_stream_mem_delete(&mem_stream);
+
+    if (err == MZ_OK)
+    {
+        bench_result_print(output, &compress_result);
+        bench_result_print(output, &decompress_result);
+    }
+    else
+    {
+        fprintf(stderr, "Benchmark %s %s %s failed - %" PRId32 "\n", corpus->name, method->name,
+            crypt->name, err);
+    }
+    return err;
+}
+
+/***************************************************************************/
+
+static int32_t bench_central_dir(FILE *output, const bench_corpus *corpus)
+{
+    bench_result open_result;
+    bench_result locate_result;
+    void *mem_stream = NULL;
+    void *read_stream = NULL;
+    void *zip_handle = NULL;
+    const uint8_t *buf = NULL;
+    int32_t buf_size = 0;
+    double start = 0;
+    int32_t lookups = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    const bench_method store = { "store", MZ_COMPRESS_METHOD_STORE };
+    const bench_crypt plain = { "none", NULL, 0 };
+
+
+    memset(&open_result, 0, sizeof(open_result));
+    open_result.name = "cd_open";
+    open_result.corpus = corpus->name;
+    open_result.entries = corpus->entry_count;
+    memcpy(&locate_result, &open_result, sizeof(locate_result));
+    locate_result.name = "locate_entry";
+
+    mz_stream_mem_create(&mem_stream);
+    mz_stream_mem_set_grow_size(mem_stream, 1024 * 1024);
+    mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    err = bench_compress(corpus, &store, &plain, MZ_HASH_SHA256, mem_stream, &open_result.seconds);
+    if (err == MZ_OK)
+    {
+        mz_stream_mem_get_buffer(mem_stream, (const void **)&buf);
+        mz_stream_mem_get_buffer_length(mem_stream, &buf_size);
+        open_result.bytes = buf_size;
+        open_result.compressed_bytes = buf_size;
+
+        mz_stream_mem_create(&read_stream);
+        mz_stream_mem_set_buffer(read_stream, (void *)buf, buf_size);
+        mz_stream_mem_open(read_stream, NULL, MZ_OPEN_MODE_READ);
+    }
+
+    /* Time to open the archive and walk every central directory record */
+    start = bench_time();
+    while (err == MZ_OK && (open_result.operations < 3 || bench_time() - start < BENCH_MIN_SECONDS))
+    {
+        mz_stream_mem_seek(read_stream, 0, MZ_SEEK_SET);
+        mz_zip_create(&zip_handle);
+        err = mz_zip_open(zip_handle, read_stream, MZ_OPEN_MODE_READ);
+        if (err == MZ_OK)
+            err = mz_zip_goto_first_entry(zip_handle);
+        while (err == MZ_OK)
+            err = mz_zip_goto_next_entry(zip_handle);
+        if (err == MZ_END_OF_LIST)
+            err = MZ_OK;
+        mz_zip_close(zip_handle);
+        mz_zip_delete(&zip_handle);
+        open_result.operations += 1;
+    }
+    open_result.seconds = bench_time() - start;
+
+    /* Time to locate entries in random order */
+    if (err == MZ_OK)
+    {
+        mz_zip_create(&zip_handle);
+        err = mz_zip_open(zip_handle, read_stream, MZ_OPEN_MODE_READ);
+
+        lookups = corpus->entry_count;
+        if (lookups > 1000)
+            lookups = 1000;
+
+        start = bench_time();
+        for (i = 0; i < lookups && err == MZ_OK; i += 1)
+            err = mz_zip_locate_entry(zip_handle, corpus->entries[bench_rand() % corpus->entry_count].filename, 0);
+        locate_result.seconds = bench_time() - start;
+        locate_result.operations = lookups;
+
+        mz_zip_close(zip_handle);
+        mz_zip_delete(&zip_handle);
+    }
+
+    if (read_stream != NULL)
+        mz_stream_mem_delete(&read_stream);
+    mz_stream_mem_close(mem_stream);
+    mz_stream_mem_delete(&mem_stream);
+
+    if (err == MZ_OK)
+    {
+        /* Throughput is not meaningful for these */
+        open_result.entries = 0;
+        open_result.bytes = 0;
+        locate_result.entries = 0;
+        bench_result_print(output, &open_result);
+        bench_result_print(output, &locate_result);
+    }
+    else
+    {
+        fprintf(stderr, "Benchmark central directory failed - %" PRId32 "\n", err);
+    }
+    return err;
+}
+
+static int32_t bench_find(FILE *output, const bench_corpus *corpus, uint8_t reverse)
+{
+    bench_result result;
+    void *mem_stream = NULL;
+    const uint8_t find[4] = { 0x50, 0x4b, 0x05, 0x06 };
+    int64_t position = 0;
+    double start = 0;
+    int32_t err = MZ_OK;
+
+
+    memset(&result, 0, sizeof(result));
+    result.name = reverse ? "find_reverse" : "find";
+    result.corpus = corpus->name;
+    result.method = "-";
+    result.encryption = "-";
+
+    mz_stream_mem_create(&mem_stream);
+    mz_stream_mem_set_buffer(mem_stream, corpus->data, corpus->data_size);
+    mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_READ);
+
+    /* Scan for the end of central directory signature the way the archive open and recovery do */
+    start = bench_time();
+    while (err == MZ_OK && (result.operations < 3 || bench_time() - start < BENCH_MIN_SECONDS))
+    {
+        if (reverse)
+        {
+            mz_stream_mem_seek(mem_stream, 0, MZ_SEEK_END);
+            err = mz_stream_find_reverse(mem_stream, find, sizeof(find), corpus->data_size, &position);
+            result.bytes += (err == MZ_OK) ? corpus->data_size - position : corpus->data_size;
+        }
+        else
+        {
+            mz_stream_mem_seek(mem_stream, 0, MZ_SEEK_SET);
+            err = mz_stream_find(mem_stream, find, sizeof(find), INT64_MAX, &position);
+            result.bytes += (err == MZ_OK) ? position + (int64_t)sizeof(find) : corpus->data_size;
+        }
+        if (err == MZ_EXIST_ERROR)
+            err = MZ_OK;
+        result.operations += 1;
+    }
+    result.seconds = bench_time() - start;
+
+    mz_stream_mem_delete(&mem_stream);
+
+    if (err == MZ_OK)
+    {
+        /* Throughput is the interesting number */
+        result.operations = 0;
+        bench_result_print(output, &result);
+    }
+    else
+    {
+        fprintf(stderr, "Benchmark find failed - %" PRId32 "\n", err);
+    }
+    return err;
+}
+
+static int32_t bench_hash(FILE *output, const bench_options *options, const bench_corpus *corpus)
+{
+    bench_result result;
+    void *mem_stream = NULL;
+    const char *names[3] = { "hash_none", "hash_sha1", "hash_sha256" };
+    uint16_t algorithms[3] = { 0, MZ_HASH_SHA1, MZ_HASH_SHA256 };
+    double seconds = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    int32_t a = 0;
+
+
+    mz_stream_mem_create(&mem_stream);
+    mz_stream_mem_set_grow_size(mem_stream, 1024 * 1024);
+    mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    /* Stored entries so the cost of hashing is not hidden by compression */
+    for (a = 0; a < 3 && err == MZ_OK; a += 1)
+    {
+        memset(&result, 0, sizeof(result));
+        result.name = names[a];
+        result.corpus = corpus->name;
+        result.method = bench_methods[0].name;
+        result.encryption = bench_crypts[0].name;
+        result.entries = corpus->entry_count;
+        result.bytes = corpus->data_size;
+
+        for (i = 0; i < options->iterations && err == MZ_OK; i += 1)
+        {
+            err = bench_compress(corpus, &bench_methods[0], &bench_crypts[0], algorithms[a], mem_stream, &seconds);
+            if (err == MZ_OK && (i == 0 || seconds < result.seconds))
+                result.seconds = seconds;
+        }
+
+        if (err == MZ_OK)
+            bench_result_print(output, &result);
+        else
+            fprintf(stderr, "Benchmark %s failed - %" PRId32 "\n", names[a], err);
+    }
+
+    mz_stream_mem_close(mem_stream);
+    mz_stream_mem_delete(&mem_stream);
+    return err;
+}
+
+/***************************************************************************/
+
+static int32_t bench_archive_write(const char *zip_path, const bench_corpus *corpus, const bench_method *method,
+    int32_t entry_count)
+{
+    mz_zip_file file_info;
+    void *writer = NULL;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_compress_method(writer, method->compress_method);
+    err = mz_zip_writer_open_file(writer, zip_path, 0, 0);
+    for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+    {
+        memset(&file_info, 0, sizeof(file_info));
+        file_info.version_madeby = MZ_VERSION_MADEBY;
+        file_info.compression_method = method->compress_method;
+        file_info.flag = MZ_ZIP_FLAG_UTF8;
+        file_info.filename = corpus->entries[i].filename;
+        file_info.uncompressed_size = corpus->entries[i].size;
+        err = mz_zip_writer_add_buffer(writer, corpus->data + corpus->entries[i].offset,
+            corpus->entries[i].size, &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+    return err;
+}
+
+static int32_t bench_idle_readers(FILE *output, const bench_options *options, const bench_corpus *corpus,
+    const bench_method *method, uint8_t low_memory, uint8_t *temp)
+{
+    bench_result result;
+    void **readers = NULL;
+    char zip_path[256];
+    double start = 0;
+    int64_t heap_start = 0;
+    int32_t reader_count = options->quick ? 32 : 256;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    memset(&result, 0, sizeof(result));
+    result.name = low_memory ? "idle_low_mem" : "idle_reader";
+    result.corpus = corpus->name;
+    result.method = method->name;
+    result.encryption = "none";
+    result.operations = reader_count;
+
+    if (bench_heap_used() < 0)
+        return MZ_OK;
+
+    snprintf(zip_path, sizeof(zip_path), "%s/idle.zip", options->work_dir);
+    err = bench_archive_write(zip_path, corpus, method, corpus->entry_count);
+
+    readers = (void **)MZ_ALLOC(reader_count * sizeof(void *));
+    if (readers == NULL)
+        err = MZ_MEM_ERROR;
+    else
+        memset(readers, 0, reader_count * sizeof(void *));
+
+    /* Heap held by archives kept open after extracting one entry from each */
+    heap_start = bench_heap_used();
+    start = bench_time();
+    for (i = 0; i < reader_count && err == MZ_OK; i += 1)
+    {
+        mz_zip_reader_create(&readers[i]);
+        mz_zip_reader_set_low_memory(readers[i], low_memory);
+        err = mz_zip_reader_open_file(readers[i], zip_path);
+        if (err == MZ_OK)
+            err = mz_zip_reader_locate_entry(readers[i], corpus->entries[i % corpus->entry_count].filename, 0);
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_save_buffer(readers[i], temp, corpus->entries[i % corpus->entry_count].size);
+    }
+    result.seconds = bench_time() - start;
+    result.heap_bytes = (bench_heap_used() - heap_start) / reader_count;
+
+    for (i = 0; readers != NULL && i < reader_count; i += 1)
+    {
+        if (readers[i] != NULL)
+            mz_zip_reader_delete(&readers[i]);
+    }
+    if (readers != NULL)
+        MZ_FREE(readers);
+    mz_os_unlink(zip_path);
+
+    if (err == MZ_OK)
+        bench_result_print(output, &result);
+    else
+        fprintf(stderr, "Benchmark idle readers failed - %" PRId32 "\n", err);
+    return err;
+}
+
+static int32_t bench_reopen(FILE *output, const bench_options *options, const bench_corpus *corpus,
+    const bench_method *method, uint8_t low_memory, uint8_t *temp)
+{
+    bench_result result;
+    void *reader = NULL;
+    char zip_path[256];
+    double start = 0;
+    int32_t cycle_count = options->quick ? 2000 : 50000;
+    int32_t entry_count = corpus->entry_count < 8 ? corpus->entry_count : 8;
+    int32_t entry = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    memset(&result, 0, sizeof(result));
+    /* Low memory mode frees everything on close so it shows the cost without reuse */
+    result.name = low_memory ? "reopen_low_mem" : "reopen";
+    result.corpus = corpus->name;
+    result.method = method->name;
+    result.encryption = "none";
+
+    snprintf(zip_path, sizeof(zip_path), "%s/reopen.zip", options->work_dir);
+    err = bench_archive_write(zip_path, corpus, method, entry_count);
+
+    /* Open, extract one entry and close the same small archive over and over */
+    mz_zip_reader_create(&reader);
+    mz_zip_reader_set_low_memory(reader, low_memory);
+    start = bench_time();
+    for (i = 0; i < cycle_count && err == MZ_OK; i += 1)
+    {
+        entry = i % entry_count;
+        err = mz_zip_reader_open_file(reader, zip_path);
+        if (err == MZ_OK)
+            err = mz_zip_reader_locate_entry(reader, corpus->entries[entry].filename, 0);
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_save_buffer(reader, temp, corpus->entries[entry].size);
+        if (mz_zip_reader_close(reader) != MZ_OK && err == MZ_OK)
+            err = MZ_CLOSE_ERROR;
+        result.entries += 1;
+        result.bytes += corpus->entries[entry].size;
+    }
+    result.seconds = bench_time() - start;
+    result.operations = i;
+    mz_zip_reader_delete(&reader);
+    mz_os_unlink(zip_path);
+
+    if (err == MZ_OK)
+        bench_result_print(output, &result);
+    else
+        fprintf(stderr, "Benchmark reopen failed - %" PRId32 "\n", err);
+    return err;
+}
+
+static int32_t bench_batch_read(FILE *output, const bench_options *options, const bench_corpus *corpus,
+    const bench_method *method, uint8_t batch)
+{
+    bench_result result;
+    mz_zip_reader_batch *entries = NULL;
+    void *reader = NULL;
+    uint8_t *out = NULL;
+    char zip_path[256];
+    double start = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    memset(&result, 0, sizeof(result));
+    result.name = batch ? "batch_read" : "locate_read";
+    result.corpus = corpus->name;
+    result.method = method->name;
+    result.encryption = "none";
+
+    snprintf(zip_path, sizeof(zip_path), "%s/batch.zip", options->work_dir);
+    err = bench_archive_write(zip_path, corpus, method, corpus->entry_count);
+
+    out = (uint8_t *)MZ_ALLOC(corpus->data_size);
+    entries = (mz_zip_reader_batch *)MZ_ALLOC(corpus->entry_count * sizeof(mz_zip_reader_batch));
+    if (out == NULL || entries == NULL)
+        err = MZ_MEM_ERROR;
+
+    /* Every entry of the archive by name, in reverse order of how they are stored */
+    for (i = 0; i < corpus->entry_count && err == MZ_OK; i += 1)
+    {
+        memset(&entries[i], 0, sizeof(entries[i]));
+        entries[i].filename = corpus->entries[corpus->entry_count - 1 - i].filename;
+        entries[i].buf = out + corpus->entries[corpus->entry_count - 1 - i].offset;
+        entries[i].buf_size = corpus->entries[corpus->entry_count - 1 - i].size;
+    }
+
+    mz_zip_reader_create(&reader);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_file(reader, zip_path);
+
+    start = bench_time();
+    if (err == MZ_OK && batch)
+    {
+        err = mz_zip_reader_read_batch(reader, entries, corpus->entry_count);
+    }
+    else
+    {
+        for (i = 0; i < corpus->entry_count && err == MZ_OK; i += 1)
+        {
+            err = mz_zip_reader_locate_entry(reader, entries[i].filename, 0);
+            if (err == MZ_OK)
+                err = mz_zip_reader_entry_save_buffer(reader, entries[i].buf, entries[i].buf_size);
+        }
+    }
+    result.seconds = bench_time() - start;
+
+    if (err == MZ_OK && memcmp(out, corpus->data, corpus->data_size) != 0)
+        err = MZ_FORMAT_ERROR;
+    result.entries = corpus->entry_count;
+    result.bytes = corpus->data_size;
+
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+    mz_os_unlink(zip_path);
+    if (out != NULL)
+        MZ_FREE(out);
+    if (entries != NULL)
+        MZ_FREE(entries);
+
+    if (err == MZ_OK)
+        bench_result_print(output, &result);
+    else
+        fprintf(stderr, "Benchmark batch read failed - %" PRId32 "\n", err);
+    return err;
+}
+
+/***************************************************************************/
+
+static int32_t bench_files_write(const char *root, const bench_corpus *corpus)
+{
+    void *stream = NULL;
+    char path[512];
+    char dir[512];
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    mz_stream_os_create(&stream);
+
+    for (i = 0; i < corpus->entry_count && err == MZ_OK; i += 1)
+    {
+        snprintf(path, sizeof(path), "%s/%s", root, corpus->entries[i].filename);
+        strncpy(dir, path, sizeof(dir) - 1);
+        dir[sizeof(dir) - 1] = 0;
+        mz_path_remove_filename(dir);
+        mz_dir_make(dir);
+
+        err = mz_stream_os_open(stream, path, MZ_OPEN_MODE_CREATE | MZ_OPEN_MODE_WRITE);
+        if (err == MZ_OK)
+        {
+            if (mz_stream_os_write(stream, corpus->data + corpus->entries[i].offset,
+                corpus->entries[i].size) != corpus->entries[i].size)
+                err = MZ_WRITE_ERROR;
+            mz_stream_os_close(stream);
+        }
+    }
+
+    mz_stream_os_delete(&stream);
+    return err;
+}
+
+static void bench_files_unlink(const char *root, const bench_corpus *corpus)
+{
+    char path[512];
+    int32_t i = 0;
+
+    for (i = 0; i < corpus->entry_count; i += 1)
+    {
+        snprintf(path, sizeof(path), "%s/%s", root, corpus->entries[i].filename);
+        mz_os_unlink(path);
+    }
+}
+
+static int32_t bench_end_to_end(FILE *output, const bench_options *options, const bench_corpus **corpora,
+    int32_t corpus_count, const bench_method *method)
+{
+    bench_result create_result;
+    bench_result extract_result;
+    void *writer = NULL;
+    void *reader = NULL;
+    char source_dir[256];
+    char target_dir[256];
+    char zip_path[256];
+    double start = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    memset(&create_result, 0, sizeof(create_result));
+    create_result.name = "create_e2e";
+    create_result.corpus = "files";
+    create_result.method = method->name;
+    create_result.encryption = "none";
+    for (i = 0; i < corpus_count; i += 1)
+    {
+        create_result.entries += corpora[i]->entry_count;
+        create_result.bytes += corpora[i]->data_size;
+    }
+    memcpy(&extract_result, &create_result, sizeof(extract_result));
+    extract_result.name = "extract_e2e";
+
+    snprintf(source_dir, sizeof(source_dir), "%s/source", options->work_dir);
+    snprintf(target_dir, sizeof(target_dir), "%s/target", options->work_dir);
+    snprintf(zip_path, sizeof(zip_path), "%s/bench.zip", options->work_dir);
+
+    for (i = 0; i < corpus_count && err == MZ_OK; i += 1)
+        err = bench_files_write(source_dir, corpora[i]);
+
+    /* Add files from disk into an archive on disk */
+    if (err == MZ_OK)
+    {
+        mz_zip_writer_create(&writer);
+        mz_zip_writer_set_compress_method(writer, method->compress_method);
+        mz_zip_writer_set_compress_level(writer, MZ_COMPRESS_LEVEL_DEFAULT);
+
+        start = bench_time();
+        err = mz_zip_writer_open_file(writer, zip_path, 0, 0);
+        if (err == MZ_OK)
+            err = mz_zip_writer_add_path(writer, source_dir, NULL, 0, 1);
+        if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+            err = MZ_CLOSE_ERROR;
+        create_result.seconds = bench_time() - start;
+
+        mz_zip_writer_delete(&writer);
+        create_result.compressed_bytes = mz_os_get_file_size(zip_path);
+    }
+
+    /* Extract all files from the archive back to disk */
+    if (err == MZ_OK)
+    {
+        mz_zip_reader_create(&reader);
+
+        start = bench_time();
+        err = mz_zip_reader_open_file(reader, zip_path);
+        if (err == MZ_OK)
+            err = mz_zip_reader_save_all(reader, target_dir);
+        mz_zip_reader_close(reader);
+        extract_result.seconds = bench_time() - start;
+
+        mz_zip_reader_delete(&reader);
+        extract_result.compressed_bytes = create_result.compressed_bytes;
+    }
+
+    for (i = 0; i < corpus_count; i += 1)
+    {
+        bench_files_unlink(source_dir, corpora[i]);
+        bench_files_unlink(target_dir, corpora[i]);
+    }
+    mz_os_unlink(zip_path);
+
+    if (err == MZ_OK)
+    {
+        bench_result_print(output, &create_result);
+        bench_result_print(output, &extract_result);
+    }
+    else
+    {
+        fprintf(stderr, "Benchmark end to end failed - %" PRId32 "\n", err);
+    }
+    return err;
+}
+
+/***************************************************************************/
+
+static void bench_help(void)
+{
+    printf("Usage: minizip_bench [-q] [-i iterations] [-d work dir] [-o output.json]\n\n" \
+           "  -q  Quick run with small corpora\n" \
+           "  -i  Number of iterations, best time is reported (default 3)\n" \
+           "  -d  Directory used for end to end file tests (default bench)\n" \
+           "  -o  Write JSON results to file instead of stdout\n\n");
+}
+
+int main(int argc, const char *argv[])
+{
+    bench_options options;
+    bench_corpus tiny;
+    bench_corpus huge;
+    bench_corpus random;
+    bench_corpus text;
+    bench_corpus *corpora[4];
+    const bench_corpus *files[2];
+    FILE *output = stdout;
+    uint8_t *temp = NULL;
+    int32_t method_count = sizeof(bench_methods) / sizeof(bench_methods[0]);
+    int32_t crypt_count = sizeof(bench_crypts) / sizeof(bench_crypts[0]);
+    int32_t scale = 64;
+    int32_t temp_size = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    int32_t m = 0;
+    int32_t c = 0;
+
+
+    memset(&options, 0, sizeof(options));
+    options.iterations = 3;
+    options.work_dir = "bench";
+
+    for (i = 1; i < argc; i += 1)
+    {
+        if (strcmp(argv[i], "-q") == 0)
+            options.quick = 1;
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            options.iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            options.work_dir = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            options.output_path = argv[++i];
+        else
+        {
+            bench_help();
+            return 0;
+        }
+    }
+
+    if (options.iterations <= 0)
+        options.iterations = 1;
+    if (options.quick)
+        scale = 1;
+
+    memset(&tiny, 0, sizeof(tiny));
+    memset(&huge, 0, sizeof(huge));
+    memset(&random, 0, sizeof(random));
+    memset(&text, 0, sizeof(text));
+
+    err = bench_corpus_tiny(&tiny, 250 * scale);
+    if (err == MZ_OK)
+        err = bench_corpus_huge(&huge, 64 * 1024 * scale);
+    if (err == MZ_OK)
+        err = bench_corpus_single(&random, "random", 64 * 1024 * scale, 1);
+    if (err == MZ_OK)
+        err = bench_corpus_single(&text, "text", 64 * 1024 * scale, 0);
+
+    corpora[0] = &tiny;
+    corpora[1] = &huge;
+    corpora[2] = &random;
+    corpora[3] = &text;
+    files[0] = &tiny;
+    files[1] = &huge;
+
+    if (err == MZ_OK)
+    {
+        temp_size = huge.entries[0].size;
+        if (temp_size < random.data_size)
+            temp_size = random.data_size;
+        temp = (uint8_t *)MZ_ALLOC(temp_size);
+        if (temp == NULL)
+            err = MZ_MEM_ERROR;
+    }
+
+    if (err == MZ_OK && options.output_path != NULL)
+    {
+        output = fopen(options.output_path, "w");
+        if (output == NULL)
+        {
+            printf("Error opening output %s\n", options.output_path);
+            err = MZ_OPEN_ERROR;
+        }
+    }
+
+    if (err == MZ_OK)
+    {
+        fprintf(output, "{\n  \"version\": \"%s\",\n  \"quick\": %s,\n  \"iterations\": %" PRId32 ",\n"
+            "  \"results\": [", MZ_VERSION, options.quick ? "true" : "false", options.iterations);
+
+        for (i = 0; i < 4 && err == MZ_OK; i += 1)
+        {
+            for (m = 0; m < method_count && err == MZ_OK; m += 1)
+            {
+                for (c = 0; c < crypt_count && err == MZ_OK; c += 1)
+                    err = bench_codec(output, &options, corpora[i], &bench_methods[m], &bench_crypts[c], temp);
+            }
+        }
+
+        if (err == MZ_OK)
+            err = bench_central_dir(output, &tiny);
+        for (i = 0; i < 2 && err == MZ_OK; i += 1)
+            err = bench_find(output, &random, (uint8_t)i);
+        if (err == MZ_OK)
+            err = bench_hash(output, &options, &huge);
+        if (err == MZ_OK)
+        {
+            mz_dir_make(options.work_dir);
+            /* Use the first real compression method, deflate when available */
+            err = bench_end_to_end(output, &options, files, 2, &bench_methods[method_count > 1 ? 1 : 0]);
+        }
+        for (i = 0; i < 2 && err == MZ_OK; i += 1)
+            err = bench_idle_readers(output, &options, &tiny, &bench_methods[method_count > 1 ? 1 : 0], (uint8_t)i, temp);
+        for (i = 0; i < 2 && err == MZ_OK; i += 1)
+            err = bench_reopen(output, &options, &tiny, &bench_methods[method_count > 1 ? 1 : 0], (uint8_t)i, temp);
+        for (i = 0; i < 2 && err == MZ_OK; i += 1)
+            err = bench_batch_read(output, &options, &tiny, &bench_methods[method_count > 1 ? 1 : 0], (uint8_t)i);
+
+        fprintf(output, "\n  ]\n}\n");
+    }
+
+    if (output != NULL && output != stdout)
+        fclose(output);
+
+    if (temp != NULL)
+        MZ_FREE(temp);
+
+    for (i = 0; i < 4; i += 1)
+        bench_corpus_delete(corpora[i]);
+
+    return err != MZ_OK;
+}
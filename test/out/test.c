@@ -0,0 +1,4386 @@
+/* test.c - Test bed area
+   part of the MiniZip project
+
+   Copyright (C) 2018-2020 Nathan Moinvaziri
+     https://github.com/nmoinvaz/minizip
+
+   This program is distributed under the terms of the same license as zlib.
+   See the accompanying LICENSE file for the full text of the license.
+*/
+
+#include "mz.h"
+#include "mz_alloc.h"
+#ifdef HAVE_COMPAT
+#include "mz_compat.h"
+#endif
+#include "mz_crypt.h"
+#include "mz_os.h"
+#include "mz_strm.h"
+#include "mz_strm_buf.h"
+#ifdef HAVE_BZIP2
+#include "mz_strm_bzip.h"
+#endif
+#ifdef HAVE_PKCRYPT
+#include "mz_strm_pkcrypt.h"
+#endif
+#include "mz_strm_mem.h"
+#include "mz_strm_os.h"
+#ifdef HAVE_WZAES
+#include "mz_strm_wzaes.h"
+#endif
+#ifdef HAVE_ZLIB
+#include "mz_strm_zlib.h"
+#endif
+#include "mz_zip.h"
+#include "mz_zip_rw.h"
+
+#include <stdio.h> /* printf, snprintf */
+
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+#  define snprintf _snprintf
+#endif
+
+/***************************************************************************/
+
+int32_t test_path_resolve_int(char *path, char *expected_path)
+{
+    char output[256];
+    int32_t ok = 0;
+
+    memset(output, 'z', sizeof(output));
+    mz_path_resolve(path, output, sizeof(output));
+    ok = (strcmp(output, expected_path) == 0);
+    printf("path resolve - %s -> %s = %s (%" PRId32 ")\n", path, expected_path, output, ok);
+    return !ok;
+}
+
+int32_t test_path_resolve(void)
+{
+    int32_t err = MZ_OK;
+
+    err |= test_path_resolve_int("c:\\test\\.", "c:\\test\\");
+    err |= test_path_resolve_int("c:\\test\\.\\", "c:\\test\\");
+    err |= test_path_resolve_int("c:\\test\\.\\.", "c:\\test\\");
+    err |= test_path_resolve_int("c:\\test\\..", "c:\\");
+    err |= test_path_resolve_int("c:\\test\\..\\", "c:\\");
+    err |= test_path_resolve_int("c:\\test\\.\\..", "c:\\");
+    err |= test_path_resolve_int("c:\\test\\.\\\\..", "c:\\");
+    err |= test_path_resolve_int(".", ".");
+    err |= test_path_resolve_int(".\\", "");
+    err |= test_path_resolve_int("..", "");
+    err |= test_path_resolve_int("..\\", "");
+    err |= test_path_resolve_int(".\\test\\123", "test\\123");
+    err |= test_path_resolve_int(".\\..\\test\\123", "test\\123");
+    err |= test_path_resolve_int("..\\..\\test\\123", "test\\123");
+    err |= test_path_resolve_int("test\\.abc.txt", "test\\.abc.txt");
+    err |= test_path_resolve_int("c:\\test\\123\\.\\abc.txt", "c:\\test\\123\\abc.txt");
+    err |= test_path_resolve_int("c:\\test\\123\\..\\abc.txt", "c:\\test\\abc.txt");
+    err |= test_path_resolve_int("c:\\test\\123\\..\\..\\abc.txt", "c:\\abc.txt");
+    err |= test_path_resolve_int("c:\\test\\123\\..\\..\\..\\abc.txt", "abc.txt");
+    err |= test_path_resolve_int("c:\\test\\123\\..\\.\\..\\abc.txt", "c:\\abc.txt");
+
+    return err;
+}
+
+int32_t test_path_compare_wc_int(const char *path, const char *wildcard, uint8_t ignore_case, int32_t expected)
+{
+    int32_t ok = ((mz_path_compare_wc(path, wildcard, ignore_case) == MZ_OK) == expected);
+    printf("path compare - %s ~ %s = %" PRId32 " (%" PRId32 ")\n", path, wildcard, expected, ok);
+    return !ok;
+}
+
+int32_t test_path_compare_wc(void)
+{
+    int32_t err = MZ_OK;
+
+    err |= test_path_compare_wc_int("dir/file.txt", "*.txt", 0, 1);
+    err |= test_path_compare_wc_int("dir\\file.txt", "dir/*", 0, 1);
+    err |= test_path_compare_wc_int("DIR/File.TXT", "dir/*.txt", 1, 1);
+    err |= test_path_compare_wc_int("DIR/File.TXT", "dir/*.txt", 0, 0);
+    err |= test_path_compare_wc_int("ab", "a*b", 0, 1);
+    err |= test_path_compare_wc_int("a", "a*b", 0, 0);
+    err |= test_path_compare_wc_int("abcbc", "a*bc", 0, 1);
+    err |= test_path_compare_wc_int("abc", "a**c", 0, 1);
+    err |= test_path_compare_wc_int("abc", "abc*", 0, 1);
+    err |= test_path_compare_wc_int("abc", "ab", 0, 0);
+    err |= test_path_compare_wc_int("", "*", 0, 1);
+    /* Would take exponential time if every star was backtracked to */
+    err |= test_path_compare_wc_int("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+        "*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*b", 0, 0);
+
+    return err;
+}
+
+int32_t test_path_pattern(void)
+{
+    mz_zip_file file_info;
+    mz_zip_file *entry_info = NULL;
+    void *patterns = NULL;
+    void *mem_stream = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    const char *entries[6] = { "assets/logo.png", "keep/readme.txt", "logs/Run.LOG",
+        "src/core/test_zip.c", "src/core/zip.c", "dir12/file12.txt" };
+    uint8_t expected[6] = { 1, 0, 1, 1, 0, 1 };
+    char name[64];
+    int32_t matched = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    mz_pattern_create(&patterns);
+    for (i = 0; i < 3000 && err == MZ_OK; i += 1)
+    {
+        snprintf(name, sizeof(name), "dir%" PRId32 "/file%" PRId32 ".txt", i, i);
+        err = mz_pattern_add(patterns, name, 0);
+    }
+    if (err == MZ_OK)
+        err = mz_pattern_add(patterns, "assets/*", 0);
+    if (err == MZ_OK)
+        err = mz_pattern_add(patterns, "*.log", 1);
+    if (err == MZ_OK)
+        err = mz_pattern_add(patterns, "src/*/test_*.c", 0);
+
+    for (i = 0; i < 6 && err == MZ_OK; i += 1)
+    {
+        if ((mz_pattern_match(patterns, entries[i]) == MZ_OK) != expected[i])
+            err = MZ_FORMAT_ERROR;
+    }
+    /* Slashes match either way, case only where the pattern ignores it */
+    if (err == MZ_OK && mz_pattern_match(patterns, "dir7\\file7.txt") != MZ_OK)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && mz_pattern_match(patterns, "DIR7/file7.txt") == MZ_OK)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && mz_pattern_match(patterns, "ASSETS/logo.png") == MZ_OK)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && mz_pattern_match(patterns, "dir3000/file3000.txt") == MZ_OK)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && mz_pattern_match(patterns, "assets") == MZ_OK)
+        err = MZ_FORMAT_ERROR;
+    /* Patterns added after matching are compiled in too */
+    if (err == MZ_OK)
+        err = mz_pattern_add(patterns, "keep/*.txt", 0);
+    if (err == MZ_OK && mz_pattern_match(patterns, entries[1]) != MZ_OK)
+        err = MZ_FORMAT_ERROR;
+    expected[1] = 1;
+
+    /* Reader only visits entries that match one of the patterns */
+    mz_stream_mem_create(&mem_stream);
+    mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_compress_method(writer, MZ_COMPRESS_METHOD_STORE);
+    if (err == MZ_OK)
+        err = mz_zip_writer_open(writer, mem_stream);
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_STORE;
+    for (i = 0; i < 6 && err == MZ_OK; i += 1)
+    {
+        file_info.filename = entries[i];
+        file_info.uncompressed_size = (int64_t)strlen(entries[i]);
+        err = mz_zip_writer_add_buffer(writer, (void *)entries[i], (int32_t)strlen(entries[i]), &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    mz_zip_reader_create(&reader);
+    mz_zip_reader_set_patterns(reader, patterns);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open(reader, mem_stream);
+    if (err == MZ_OK)
+        err = mz_zip_reader_goto_first_entry(reader);
+    while (err == MZ_OK)
+    {
+        err = mz_zip_reader_entry_get_info(reader, &entry_info);
+        for (i = 0; i < 6 && err == MZ_OK; i += 1)
+        {
+            if (strcmp(entry_info->filename, entries[i]) == 0 && !expected[i])
+                err = MZ_FORMAT_ERROR;
+        }
+        matched += 1;
+        if (err == MZ_OK)
+            err = mz_zip_reader_goto_next_entry(reader);
+    }
+    if (err == MZ_END_OF_LIST)
+        err = (matched == 5) ? MZ_OK : MZ_FORMAT_ERROR;
+
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+    mz_stream_mem_delete(&mem_stream);
+    mz_pattern_delete(&patterns);
+
+    if (err == MZ_OK)
+        printf("Path pattern.. OK\n");
+    else
+        printf("Path pattern failed - %" PRId32 "\n", err);
+    return err;
+}
+
+int32_t test_utf8(void)
+{
+    const char *test_string = "Heiz�lr�cksto�abd�mpfung";
+    uint8_t *utf8_string = mz_os_utf8_string_create(test_string, MZ_ENCODING_CODEPAGE_950);
+    if (utf8_string == NULL)
+        return MZ_BUF_ERROR;
+#if defined(_WINDOWS)
+    wchar_t *unicode_string = mz_os_unicode_string_create((const char *)utf8_string, MZ_ENCODING_UTF8);
+    if (unicode_string == NULL)
+        return MZ_BUF_ERROR;
+    mz_os_unicode_string_delete(&unicode_string);
+#endif
+    mz_os_utf8_string_delete(&utf8_string);
+    return MZ_OK;
+}
+
+int32_t test_encrypt(char *method, mz_stream_create_cb crypt_create, char *password)
+{
+    char buf[UINT16_MAX];
+    int32_t read = 0;
+    int32_t written = 0;
+    int64_t total_written = 0;
+    void *out_stream = NULL;
+    void *in_stream = NULL;
+    void *crypt_out_stream = NULL;
+    char encrypt_path[120];
+    char decrypt_path[120];
+
+    snprintf(encrypt_path, sizeof(encrypt_path), "LICENSE.encrypt.%s", method);
+    snprintf(decrypt_path, sizeof(decrypt_path), "LICENSE.decrypt.%s", method);
+
+    mz_stream_os_create(&in_stream);
+
+    if (mz_stream_os_open(in_stream, "LICENSE", MZ_OPEN_MODE_READ) == MZ_OK)
+    {
+        read = mz_stream_os_read(in_stream, buf, UINT16_MAX);
+        mz_stream_os_close(in_stream);
+    }
+
+    mz_stream_os_delete(&in_stream);
+    mz_stream_os_create(&out_stream);
+
+    if (mz_stream_os_open(out_stream, encrypt_path, MZ_OPEN_MODE_CREATE | MZ_OPEN_MODE_WRITE) == MZ_OK)
+    {
+        crypt_create(&crypt_out_stream);
+
+        mz_stream_set_base(crypt_out_stream, out_stream);
+
+        if (mz_stream_open(crypt_out_stream, password, MZ_OPEN_MODE_WRITE) == MZ_OK)
+        {
+            written = mz_stream_write(crypt_out_stream, buf, read);
+            mz_stream_close(crypt_out_stream);
+            mz_stream_get_prop_int64(crypt_out_stream, MZ_STREAM_PROP_TOTAL_OUT, &total_written);
+        }
+
+        mz_stream_delete(&crypt_out_stream);
+
+        mz_stream_os_close(out_stream);
+
+        printf("%s encrypted %" PRId32 "\n", encrypt_path, written);
+    }
+
+    mz_stream_os_delete(&out_stream);
+    mz_stream_os_create(&in_stream);
+
+    if (mz_stream_os_open(in_stream, encrypt_path, MZ_OPEN_MODE_READ) == MZ_OK)
+    {
+        crypt_create(&crypt_out_stream);
+
+        mz_stream_set_base(crypt_out_stream, in_stream);
+        mz_stream_set_prop_int64(crypt_out_stream, MZ_STREAM_PROP_TOTAL_IN_MAX, total_written);
+
+        if (mz_stream_open(crypt_out_stream, password, MZ_OPEN_MODE_READ) == MZ_OK)
+        {
+            read = mz_stream_read(crypt_out_stream, buf, read);
+            mz_stream_close(crypt_out_stream);
+        }
+
+        mz_stream_delete(&crypt_out_stream);
+
+        mz_stream_os_close(in_stream);
+
+        printf("%s decrypted %" PRId32 "\n", decrypt_path, read);
+    }
+
+    mz_stream_os_delete(&in_stream);
+    mz_stream_os_create(&out_stream);
+
+    if (mz_stream_os_open(out_stream, decrypt_path, MZ_OPEN_MODE_CREATE | MZ_OPEN_MODE_WRITE) == MZ_OK)
+    {
+        mz_stream_os_write(out_stream, buf, read);
+        mz_stream_os_close(out_stream);
+    }
+
+    mz_stream_os_delete(&out_stream);
+    return 0;
+}
+
+int32_t test_compress(char *method, mz_stream_create_cb create_compress)
+{
+    uint8_t buf[UINT16_MAX];
+    int32_t read = 0;
+    int64_t total_in = 0;
+    int64_t total_out = 0;
+    void *in_stream = NULL;
+    void *out_stream = NULL;
+    void *deflate_stream = NULL;
+    void *inflate_stream = NULL;
+    uint32_t crc32 = 0;
+    char filename[120];
+
+    printf("Testing compress %s\n", method);
+
+    mz_stream_os_create(&in_stream);
+
+    if (mz_stream_os_open(in_stream, "LICENSE", MZ_OPEN_MODE_READ) == MZ_OK)
+    {
+        read = mz_stream_os_read(in_stream, buf, UINT16_MAX);
+        if (read > 0)
+            crc32 = mz_crypt_crc32_update(crc32, (const uint8_t *)buf, read);
+
+        mz_stream_os_close(in_stream);
+    }
+
+    mz_stream_os_delete(&in_stream);
+
+    if (read < 0)
+    {
+        printf("Failed to read LICENSE\n");
+        return MZ_OPEN_ERROR;
+    }
+
+    printf("LICENSE crc 0x%08x\n", crc32);
+
+    mz_stream_os_create(&out_stream);
+
+    snprintf(filename, sizeof(filename), "LICENSE.deflate.%s", method);
+    if (mz_stream_os_open(out_stream, filename, MZ_OPEN_MODE_CREATE | MZ_OPEN_MODE_WRITE) == MZ_OK)
+    {
+        create_compress(&deflate_stream);
+        mz_stream_set_base(deflate_stream, out_stream);
+
+        mz_stream_open(deflate_stream, NULL, MZ_OPEN_MODE_WRITE);
+        mz_stream_write(deflate_stream, buf, read);
+        mz_stream_close(deflate_stream);
+
+        mz_stream_get_prop_int64(deflate_stream, MZ_STREAM_PROP_TOTAL_IN, &total_in);
+        mz_stream_get_prop_int64(deflate_stream, MZ_STREAM_PROP_TOTAL_OUT, &total_out);
+
+        mz_stream_delete(&deflate_stream);
+
+        printf("%s compressed from %u to %u\n", filename, (uint32_t)total_in, (uint32_t)total_out);
+
+        mz_stream_os_close(out_stream);
+    }
+
+    mz_stream_os_delete(&out_stream);
+    mz_stream_os_create(&in_stream);
+
+    if (mz_stream_os_open(in_stream, filename, MZ_OPEN_MODE_READ) == MZ_OK)
+    {
+        create_compress(&inflate_stream);
+        mz_stream_set_base(inflate_stream, in_stream);
+
+        mz_stream_open(inflate_stream, NULL, MZ_OPEN_MODE_READ);
+        read = mz_stream_read(inflate_stream, buf, UINT16_MAX);
+        mz_stream_close(inflate_stream);
+
+        mz_stream_get_prop_int64(inflate_stream, MZ_STREAM_PROP_TOTAL_IN, &total_in);
+        mz_stream_get_prop_int64(inflate_stream, MZ_STREAM_PROP_TOTAL_OUT, &total_out);
+
+        mz_stream_delete(&inflate_stream);
+
+        mz_stream_os_close(in_stream);
+
+        printf("%s uncompressed from %u to %u\n", filename, (uint32_t)total_in, (uint32_t)total_out);
+    }
+
+    mz_stream_os_delete(&in_stream);
+    mz_stream_os_create(&out_stream);
+
+    crc32 = 0;
+
+    snprintf(filename, sizeof(filename), "LICENSE.inflate.%s", method);
+    if (mz_stream_os_open(out_stream, filename, MZ_OPEN_MODE_CREATE | MZ_OPEN_MODE_WRITE) == MZ_OK)
+    {
+        crc32 = mz_crypt_crc32_update(crc32, (const uint8_t *)buf, read);
+
+        mz_stream_os_close(out_stream);
+
+        printf("%s crc 0x%08x\n", filename, crc32);
+    }
+
+    mz_stream_os_delete(&out_stream);
+
+    return MZ_OK;
+}
+
+/***************************************************************************/
+
+#ifdef HAVE_BZIP2
+int test_stream_bzip(void)
+{
+    return test_compress("bzip", mz_stream_bzip_create);
+}
+#endif
+#ifdef HAVE_PKCRYPT
+int test_stream_pkcrypt(void)
+{
+    return test_encrypt("pkcrypt", mz_stream_pkcrypt_create, "hello");
+}
+#endif
+#ifdef HAVE_WZAES
+int test_stream_wzaes(void)
+{
+    int32_t iteration_count = 1000;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    uint8_t key[MZ_HASH_SHA1_SIZE];
+    const char *password = "passwordpasswordpasswordpassword";
+    const char *salt = "8F3472E4EA57F56E36F30246DC22C173";
+
+
+    printf("Pbkdf2 password - %s\n", password);
+    printf("Pbkdf2 salt - %s\n", salt);
+
+    err = mz_crypt_pbkdf2((uint8_t *)password, (int32_t)strlen(password),
+        (uint8_t *)salt, (int32_t)strlen(salt), iteration_count, key, sizeof(key));
+
+    if (err == MZ_OK)
+    {
+        printf("Pbkdf2 key hex\n");
+        for (i = 0; i < (int32_t)sizeof(key); i += 1)
+            printf("%02x", key[i]);
+        printf("\n");
+    }
+    else
+    {
+        printf("Pbkdf2 failed - %" PRId32 "", err);
+        return MZ_CRYPT_ERROR;
+    }
+
+    return test_encrypt("aes", mz_stream_wzaes_create, "hello");
+}
+#endif
+#ifdef HAVE_ZLIB
+int32_t test_stream_zlib(void)
+{
+    return test_compress("zlib", mz_stream_zlib_create);
+}
+
+int32_t test_stream_zlib_mem(void)
+{
+    mz_zip_file file_info;
+    void *read_mem_stream = NULL;
+    void *write_mem_stream = NULL;
+    void *os_stream = NULL;
+    void *zip_handle = NULL;
+    int32_t written = 0;
+    int32_t read = 0;
+    int32_t text_size = 0;
+    int32_t buffer_size = 0;
+    int32_t err = MZ_OK;
+    const uint8_t *buffer_ptr = NULL;
+    char *password = NULL;
+    char *text_name = "test";
+    char *text_ptr = "test string";
+    char temp[120];
+
+
+    memset(&file_info, 0, sizeof(file_info));
+
+    text_size = (int32_t)strlen(text_ptr);
+
+    /* Write zip to memory stream */
+    mz_stream_mem_create(&write_mem_stream);
+    mz_stream_mem_set_grow_size(write_mem_stream, 128 * 1024);
+    mz_stream_open(write_mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    mz_zip_create(&zip_handle);
+    err = mz_zip_open(zip_handle, write_mem_stream, MZ_OPEN_MODE_WRITE);
+
+    if (err == MZ_OK)
+    {
+        file_info.version_madeby = MZ_VERSION_MADEBY;
+        file_info.compression_method = MZ_COMPRESS_METHOD_DEFLATE;
+        file_info.filename = text_name;
+        file_info.uncompressed_size = text_size;
+#ifdef HAVE_WZAES
+        file_info.aes_version = MZ_AES_VERSION;
+        password = "1234";
+#endif
+
+        err = mz_zip_entry_write_open(zip_handle, &file_info, MZ_COMPRESS_LEVEL_DEFAULT, 0, password);
+        if (err == MZ_OK)
+        {
+            written = mz_zip_entry_write(zip_handle, text_ptr, text_size);
+            if (written < MZ_OK)
+                err = written;
+            mz_zip_entry_close(zip_handle);
+        }
+
+        mz_zip_close(zip_handle);
+    }
+    else
+    {
+        err = MZ_INTERNAL_ERROR;
+    }
+
+    mz_zip_delete(&zip_handle);
+
+    mz_stream_mem_get_buffer(write_mem_stream, (const void **)&buffer_ptr);
+    mz_stream_mem_seek(write_mem_stream, 0, MZ_SEEK_END);
+    buffer_size = (int32_t)mz_stream_mem_tell(write_mem_stream);
+
+    if (err == MZ_OK)
+    {
+        /* Create a zip file on disk for inspection */
+        mz_stream_os_create(&os_stream);
+        mz_stream_os_open(os_stream, "mytest.zip", MZ_OPEN_MODE_WRITE | MZ_OPEN_MODE_CREATE);
+        mz_stream_os_write(os_stream, buffer_ptr, buffer_size);
+        mz_stream_os_close(os_stream);
+        mz_stream_os_delete(&os_stream);
+    }
+
+    if (err == MZ_OK)
+    {
+        /* Read from a memory stream */
+        mz_stream_mem_create(&read_mem_stream);
+        mz_stream_mem_set_buffer(read_mem_stream, (void *)buffer_ptr, buffer_size);
+        mz_stream_open(read_mem_stream, NULL, MZ_OPEN_MODE_READ);
+
+        mz_zip_create(&zip_handle);
+        err = mz_zip_open(zip_handle, read_mem_stream, MZ_OPEN_MODE_READ);
+
+        if (err == MZ_OK)
+        {
+            err = mz_zip_goto_first_entry(zip_handle);
+            if (err == MZ_OK)
+                err = mz_zip_entry_read_open(zip_handle, 0, password);
+            if (err == MZ_OK)
+                read = mz_zip_entry_read(zip_handle, temp, sizeof(temp));
+
+            MZ_UNUSED(read);
+
+            mz_zip_entry_close(zip_handle);
+            mz_zip_close(zip_handle);
+        }
+
+        mz_zip_delete(&zip_handle);
+
+        mz_stream_mem_close(&read_mem_stream);
+        mz_stream_mem_delete(&read_mem_stream);
+        read_mem_stream = NULL;
+    }
+
+    mz_stream_mem_close(write_mem_stream);
+    mz_stream_mem_delete(&write_mem_stream);
+    write_mem_stream = NULL;
+
+    return err;
+}
+
+static int32_t test_zip_writer_compress_auto_check(void *reader, const char *filename,
+    uint16_t compression_method, uint8_t *expected, int32_t expected_size, uint8_t *temp)
+{
+    mz_zip_file *file_info = NULL;
+    int32_t err = MZ_OK;
+
+    err = mz_zip_reader_locate_entry(reader, filename, 0);
+    if (err == MZ_OK)
+        err = mz_zip_reader_entry_get_info(reader, &file_info);
+    if (err == MZ_OK && file_info->compression_method != compression_method)
+    {
+        printf("Compress auto %s method %" PRIu16 " expected %" PRIu16 "\n", filename,
+            file_info->compression_method, compression_method);
+        err = MZ_FORMAT_ERROR;
+    }
+    if (err == MZ_OK)
+        err = mz_zip_reader_entry_save_buffer(reader, temp, expected_size);
+    if (err == MZ_OK && memcmp(temp, expected, expected_size) != 0)
+        err = MZ_CRC_ERROR;
+    return err;
+}
+
+static mz_stream_vtbl test_deferred_vtbl;
+static uint8_t test_deferred_closed = 0;
+
+static int32_t test_deferred_open(void *stream, const char *path, int32_t mode)
+{
+    test_deferred_closed = 0;
+    return mz_stream_zlib_open(stream, path, mode);
+}
+
+static int32_t test_deferred_close(void *stream)
+{
+    test_deferred_closed = 1;
+    return mz_stream_zlib_close(stream);
+}
+
+static int32_t test_deferred_get_prop_int64(void *stream, int32_t prop, int64_t *value)
+{
+    /* Like codecs that compress a whole entry at once, no output is counted until closed */
+    if (prop == MZ_STREAM_PROP_TOTAL_OUT && !test_deferred_closed)
+    {
+        *value = 0;
+        return MZ_OK;
+    }
+    return mz_stream_zlib_get_prop_int64(stream, prop, value);
+}
+
+static void *test_codec_deferred_create(void **stream)
+{
+    mz_stream *zlib = (mz_stream *)mz_stream_zlib_create(stream);
+    if (zlib == NULL)
+        return NULL;
+    memcpy(&test_deferred_vtbl, zlib->vtbl, sizeof(test_deferred_vtbl));
+    test_deferred_vtbl.open = test_deferred_open;
+    test_deferred_vtbl.close = test_deferred_close;
+    test_deferred_vtbl.get_prop_int64 = test_deferred_get_prop_int64;
+    zlib->vtbl = &test_deferred_vtbl;
+    return zlib;
+}
+
+int32_t test_zip_writer_compress_auto(void)
+{
+    mz_zip_codec deferred;
+    mz_zip_file file_info;
+    void *write_mem_stream = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    const uint8_t *buffer_ptr = NULL;
+    uint8_t *mixed = NULL;
+    uint8_t *temp = NULL;
+    uint32_t seed = 0x12345678;
+    int32_t mixed_size = 3 * 1024 * 1024;
+    int32_t text_size = 66 * 1024;
+    int32_t random_size = 64 * 1024;
+    int32_t deferred_size = 2400 * 1024;
+    int32_t buffer_size = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    /* Compressible text longer than the sample followed by data that does not compress */
+    mixed = (uint8_t *)MZ_ALLOC(mixed_size);
+    temp = (uint8_t *)MZ_ALLOC(mixed_size);
+    if (mixed == NULL || temp == NULL)
+    {
+        MZ_FREE(mixed);
+        MZ_FREE(temp);
+        return MZ_MEM_ERROR;
+    }
+
+    for (i = 0; i < text_size; i += 1)
+        mixed[i] = "the quick brown fox jumps over the lazy dog "[i % 44];
+    for (i = text_size; i < mixed_size; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        mixed[i] = (uint8_t)(seed >> 24);
+    }
+
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_DEFLATE;
+    file_info.flag = MZ_ZIP_FLAG_UTF8;
+
+    mz_stream_mem_create(&write_mem_stream);
+    mz_stream_mem_set_grow_size(write_mem_stream, 128 * 1024);
+    mz_stream_open(write_mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_compress_auto(writer, 1);
+
+    err = mz_zip_writer_open(writer, write_mem_stream);
+    if (err == MZ_OK)
+    {
+        file_info.filename = "text";
+        file_info.uncompressed_size = text_size;
+        err = mz_zip_writer_add_buffer(writer, mixed, text_size, &file_info);
+    }
+    if (err == MZ_OK)
+    {
+        file_info.filename = "random";
+        file_info.uncompressed_size = random_size;
+        err = mz_zip_writer_add_buffer(writer, mixed + text_size, random_size, &file_info);
+    }
+    if (err == MZ_OK)
+    {
+        file_info.filename = "mixed";
+        file_info.uncompressed_size = mixed_size;
+        err = mz_zip_writer_add_buffer(writer, mixed, mixed_size, &file_info);
+    }
+
+    /* Data that does not compress is found even when the codec holds back its output */
+    memset(&deferred, 0, sizeof(deferred));
+    deferred.method = MZ_COMPRESS_METHOD_DEFLATE;
+    deferred.name = "deferred";
+    deferred.create = test_codec_deferred_create;
+    deferred.flags = MZ_CODEC_COMPRESS | MZ_CODEC_STREAMING;
+    deferred.priority = 1;
+    if (err == MZ_OK)
+        err = mz_zip_codec_register(&deferred);
+    if (err == MZ_OK)
+    {
+        file_info.filename = "deferred";
+        file_info.uncompressed_size = deferred_size;
+        err = mz_zip_writer_add_buffer(writer, mixed, deferred_size, &file_info);
+        if (mz_zip_codec_unregister(MZ_COMPRESS_METHOD_DEFLATE, "deferred") != MZ_OK && err == MZ_OK)
+            err = MZ_EXIST_ERROR;
+    }
+
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    if (err == MZ_OK)
+    {
+        mz_stream_mem_get_buffer(write_mem_stream, (const void **)&buffer_ptr);
+        mz_stream_mem_seek(write_mem_stream, 0, MZ_SEEK_END);
+        buffer_size = (int32_t)mz_stream_mem_tell(write_mem_stream);
+
+        mz_zip_reader_create(&reader);
+        err = mz_zip_reader_open_buffer(reader, (uint8_t *)buffer_ptr, buffer_size, 0);
+        if (err == MZ_OK)
+            err = test_zip_writer_compress_auto_check(reader, "text", MZ_COMPRESS_METHOD_DEFLATE,
+                mixed, text_size, temp);
+        if (err == MZ_OK)
+            err = test_zip_writer_compress_auto_check(reader, "random", MZ_COMPRESS_METHOD_STORE,
+                mixed + text_size, random_size, temp);
+        if (err == MZ_OK)
+            err = test_zip_writer_compress_auto_check(reader, "mixed", MZ_COMPRESS_METHOD_STORE,
+                mixed, mixed_size, temp);
+        if (err == MZ_OK)
+            err = test_zip_writer_compress_auto_check(reader, "deferred", MZ_COMPRESS_METHOD_STORE,
+                mixed, deferred_size, temp);
+        mz_zip_reader_close(reader);
+        mz_zip_reader_delete(&reader);
+    }
+
+    mz_stream_mem_close(write_mem_stream);
+    mz_stream_mem_delete(&write_mem_stream);
+
+    MZ_FREE(mixed);
+    MZ_FREE(temp);
+
+    if (err == MZ_OK)
+        printf("Writer compress auto.. OK\n");
+    return err;
+}
+
+int32_t test_zip_writer_dedup(void)
+{
+    mz_zip_file file_info;
+    mz_zip_file *first_info = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    void *stream = NULL;
+    uint8_t *data = NULL;
+    uint8_t *temp = NULL;
+    int64_t first_compressed_size = 0;
+    uint32_t seed = 0x9abcdef0;
+    int32_t data_size = 256 * 1024;
+    int32_t err = MZ_OK;
+    int32_t pass = 0;
+    int32_t i = 0;
+    const char *path = "dedup.zip";
+    const char *filenames[] = { "first", "other", "copy" };
+
+
+    data = (uint8_t *)MZ_ALLOC(data_size * 2);
+    temp = (uint8_t *)MZ_ALLOC(data_size);
+    if (data == NULL || temp == NULL)
+    {
+        MZ_FREE(data);
+        MZ_FREE(temp);
+        return MZ_MEM_ERROR;
+    }
+
+    /* Two different but compressible buffers */
+    for (i = 0; i < data_size * 2; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)('a' + ((seed >> 24) % 16));
+    }
+
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_DEFLATE;
+    file_info.flag = MZ_ZIP_FLAG_UTF8;
+    file_info.uncompressed_size = data_size;
+
+    /* Second pass writes to a stream that can not be read back so duplicates are compressed again */
+    for (pass = 0; pass < 2 && err == MZ_OK; pass += 1)
+    {
+        mz_zip_writer_create(&writer);
+        mz_zip_writer_set_dedup(writer, 1);
+
+        if (pass == 0)
+        {
+            err = mz_zip_writer_open_file(writer, path, 0, 0);
+        }
+        else
+        {
+            mz_stream_os_create(&stream);
+            err = mz_stream_os_open(stream, path, MZ_OPEN_MODE_WRITE | MZ_OPEN_MODE_CREATE);
+            if (err == MZ_OK)
+                err = mz_zip_writer_open(writer, stream);
+        }
+        for (i = 0; i < 3 && err == MZ_OK; i += 1)
+        {
+            file_info.filename = filenames[i];
+            err = mz_zip_writer_add_buffer(writer, data + (i == 1 ? data_size : 0), data_size, &file_info);
+        }
+        if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+            err = MZ_CLOSE_ERROR;
+        mz_zip_writer_delete(&writer);
+        if (stream != NULL)
+        {
+            mz_stream_os_close(stream);
+            mz_stream_os_delete(&stream);
+        }
+
+        if (err == MZ_OK)
+        {
+            mz_zip_reader_create(&reader);
+            err = mz_zip_reader_open_file(reader, path);
+            for (i = 0; i < 3 && err == MZ_OK; i += 1)
+            {
+                err = mz_zip_reader_locate_entry(reader, filenames[i], 0);
+                if (err == MZ_OK)
+                    err = mz_zip_reader_entry_get_info(reader, &first_info);
+                if (err == MZ_OK && i == 0)
+                    first_compressed_size = first_info->compressed_size;
+                if (err == MZ_OK && i == 2 && first_info->compressed_size != first_compressed_size)
+                    err = MZ_FORMAT_ERROR;
+                if (err == MZ_OK)
+                    err = mz_zip_reader_entry_save_buffer(reader, temp, data_size);
+                if (err == MZ_OK && memcmp(temp, data + (i == 1 ? data_size : 0), data_size) != 0)
+                    err = MZ_CRC_ERROR;
+            }
+            mz_zip_reader_close(reader);
+            mz_zip_reader_delete(&reader);
+        }
+    }
+
+    MZ_FREE(data);
+    MZ_FREE(temp);
+
+    if (err == MZ_OK)
+        printf("Writer dedup.. OK\n");
+    else
+        printf("Writer dedup failed - %" PRId32 "\n", err);
+    return err;
+}
+
+static int32_t test_zip_writer_dictionary_entry(int32_t index, char *buf, int32_t buf_size)
+{
+    int32_t len = 0;
+    int32_t i = 0;
+
+    /* Small records sharing most of their structure */
+    for (i = 0; i < 4; i += 1)
+    {
+        len += snprintf(buf + len, buf_size - len,
+            "{\"id\": %" PRId32 ", \"name\": \"user%" PRId32 "\", \"email\": \"user%" PRId32 "@example.com\", "
+            "\"roles\": [\"reader\", \"writer\"], \"settings\": {\"theme\": \"dark\", "
+            "\"language\": \"en-US\", \"notifications\": true}}\n",
+            index * 4 + i, (index * 7 + i) % 1000, (index * 13 + i) % 1000);
+    }
+    return len;
+}
+
+static int32_t test_zip_writer_dictionary_write(const char *path, uint16_t compression_method,
+    uint16_t odd_compression_method, int32_t dict_size, int32_t count)
+{
+    mz_zip_file file_info;
+    void *writer = NULL;
+    char filename[32];
+    char data[2048];
+    int32_t data_size = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = compression_method;
+    file_info.flag = MZ_ZIP_FLAG_UTF8;
+
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_compress_method(writer, compression_method);
+    mz_zip_writer_set_dictionary_size(writer, dict_size);
+
+    err = mz_zip_writer_open_file(writer, path, 0, 0);
+    for (i = 0; i < count && err == MZ_OK; i += 1)
+    {
+        snprintf(filename, sizeof(filename), "%" PRId32 ".json", i);
+        data_size = test_zip_writer_dictionary_entry(i, data, sizeof(data));
+        file_info.filename = filename;
+        file_info.uncompressed_size = data_size;
+        file_info.compression_method = (i % 2) ? odd_compression_method : compression_method;
+        err = mz_zip_writer_add_buffer(writer, data, data_size, &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+    return err;
+}
+
+static int32_t test_zip_writer_dictionary_header_method(const char *path, int64_t disk_offset,
+    uint16_t *compression_method)
+{
+    void *stream = NULL;
+    int32_t err = MZ_OK;
+
+    /* Method as other zip readers see it in the local header */
+    mz_stream_os_create(&stream);
+    err = mz_stream_os_open(stream, path, MZ_OPEN_MODE_READ);
+    if (err == MZ_OK)
+        err = mz_stream_os_seek(stream, disk_offset + 8, MZ_SEEK_SET);
+    if (err == MZ_OK)
+        err = mz_stream_read_uint16(stream, compression_method);
+    mz_stream_os_close(stream);
+    mz_stream_os_delete(&stream);
+    return err;
+}
+
+static int32_t test_zip_writer_dictionary_verify(const char *path, int32_t count, uint8_t dict,
+    int64_t *total_compressed)
+{
+    mz_zip_file *file_info = NULL;
+    void *reader = NULL;
+    uint16_t header_method = 0;
+    char filename[32];
+    char data[2048];
+    char temp[2048];
+    int32_t data_size = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    *total_compressed = 0;
+
+    mz_zip_reader_create(&reader);
+    err = mz_zip_reader_open_file(reader, path);
+    for (i = 0; i < count && err == MZ_OK; i += 1)
+    {
+        snprintf(filename, sizeof(filename), "%" PRId32 ".json", i);
+        data_size = test_zip_writer_dictionary_entry(i, data, sizeof(data));
+        err = mz_zip_reader_locate_entry(reader, filename, 0);
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_get_info(reader, &file_info);
+        if (err == MZ_OK)
+            *total_compressed += file_info->compressed_size;
+        /* Last entry is written after the dictionary has been trained */
+        if (err == MZ_OK && i == count - 1 &&
+            (mz_zip_extrafield_contains(file_info->extrafield, file_info->extrafield_size,
+                MZ_ZIP_EXTENSION_DICT, NULL) == MZ_OK) != dict)
+            err = MZ_FORMAT_ERROR;
+        /* Readers without dictionary support must see a method they refuse */
+        if (err == MZ_OK && i == count - 1)
+            err = test_zip_writer_dictionary_header_method(path, file_info->disk_offset, &header_method);
+        if (err == MZ_OK && i == count - 1 &&
+            header_method != (dict ? MZ_COMPRESS_METHOD_DICT : file_info->compression_method))
+            err = MZ_FORMAT_ERROR;
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_save_buffer(reader, temp, data_size);
+        if (err == MZ_OK && memcmp(temp, data, data_size) != 0)
+            err = MZ_CRC_ERROR;
+    }
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+    return err;
+}
+
+static int32_t test_zip_writer_dictionary_method(uint16_t compression_method)
+{
+    void *writer = NULL;
+    void *reader = NULL;
+    int64_t plain_compressed = 0;
+    int64_t dict_compressed = 0;
+    int64_t copy_compressed = 0;
+    int32_t count = 200;
+    int32_t err = MZ_OK;
+
+
+    err = test_zip_writer_dictionary_write("nodict.zip", compression_method, compression_method, 0, count);
+    if (err == MZ_OK)
+        err = test_zip_writer_dictionary_verify("nodict.zip", count, 0, &plain_compressed);
+    if (err == MZ_OK)
+        err = test_zip_writer_dictionary_write("dict.zip", compression_method, compression_method, 4096, count);
+    if (err == MZ_OK)
+        err = test_zip_writer_dictionary_verify("dict.zip", count, 1, &dict_compressed);
+    if (err == MZ_OK && dict_compressed >= plain_compressed)
+    {
+        printf("Writer dictionary method %" PRIu16 " compressed %" PRId64 " without %" PRId64 "\n",
+            compression_method, dict_compressed, plain_compressed);
+        err = MZ_FORMAT_ERROR;
+    }
+
+    /* Raw copy must carry the dictionary over to the new zip */
+    if (err == MZ_OK)
+    {
+        mz_zip_reader_create(&reader);
+        mz_zip_writer_create(&writer);
+
+        err = mz_zip_reader_open_file(reader, "dict.zip");
+        if (err == MZ_OK)
+            err = mz_zip_writer_open_file(writer, "dict_copy.zip", 0, 0);
+        if (err == MZ_OK)
+            err = mz_zip_reader_goto_first_entry(reader);
+        while (err == MZ_OK)
+        {
+            err = mz_zip_writer_copy_from_reader(writer, reader);
+            if (err == MZ_OK)
+                err = mz_zip_reader_goto_next_entry(reader);
+        }
+        if (err == MZ_END_OF_LIST)
+            err = MZ_OK;
+
+        if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+            err = MZ_CLOSE_ERROR;
+        mz_zip_reader_close(reader);
+
+        mz_zip_writer_delete(&writer);
+        mz_zip_reader_delete(&reader);
+    }
+    if (err == MZ_OK)
+        err = test_zip_writer_dictionary_verify("dict_copy.zip", count, 1, &copy_compressed);
+    if (err == MZ_OK && copy_compressed != dict_compressed)
+        err = MZ_FORMAT_ERROR;
+    return err;
+}
+
+#ifdef HAVE_ZSTD
+static int32_t test_zip_writer_dictionary_id(mz_zip_file *file_info, uint32_t *dict_id)
+{
+    void *stream = NULL;
+    int32_t err = MZ_OK;
+
+    mz_stream_mem_create(&stream);
+    mz_stream_mem_set_buffer(stream, (void *)file_info->extrafield, file_info->extrafield_size);
+    err = mz_zip_extrafield_find(stream, MZ_ZIP_EXTENSION_DICT, NULL);
+    if (err == MZ_OK)
+        err = mz_stream_read_uint32(stream, dict_id);
+    mz_stream_mem_delete(&stream);
+    return err;
+}
+
+static int32_t test_zip_writer_dictionary_mixed(void)
+{
+    mz_zip_file *file_info = NULL;
+    void *reader = NULL;
+    int64_t compressed = 0;
+    uint32_t dict_ids[2] = { 0, 0 };
+    int32_t count = 400;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    const char *filenames[] = { "398.json", "399.json" };
+
+
+    /* Deflate and zstd entries are each compressed with a dictionary trained from their own samples */
+    err = test_zip_writer_dictionary_write("dict_mixed.zip", MZ_COMPRESS_METHOD_DEFLATE,
+        MZ_COMPRESS_METHOD_ZSTD, 4096, count);
+    if (err == MZ_OK)
+        err = test_zip_writer_dictionary_verify("dict_mixed.zip", count, 1, &compressed);
+    if (err == MZ_OK)
+    {
+        mz_zip_reader_create(&reader);
+        err = mz_zip_reader_open_file(reader, "dict_mixed.zip");
+        for (i = 0; i < 2 && err == MZ_OK; i += 1)
+        {
+            err = mz_zip_reader_locate_entry(reader, filenames[i], 0);
+            if (err == MZ_OK)
+                err = mz_zip_reader_entry_get_info(reader, &file_info);
+            if (err == MZ_OK)
+                err = test_zip_writer_dictionary_id(file_info, &dict_ids[i]);
+        }
+        mz_zip_reader_close(reader);
+        mz_zip_reader_delete(&reader);
+    }
+    if (err == MZ_OK && dict_ids[0] == dict_ids[1])
+        err = MZ_FORMAT_ERROR;
+    return err;
+}
+#endif
+
+static int32_t test_zip_writer_dictionary_recover(int64_t disk_size)
+{
+    mz_zip_file file_info;
+    mz_zip_file *entry_info = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    void *stream = NULL;
+    uint8_t *zip_buf = NULL;
+    char filename[32];
+    char data[2048];
+    char temp[2048];
+    int64_t zip_size = 0;
+    int32_t data_size = 0;
+    int32_t count = 200;
+    int32_t entries = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    const char *path = "dict_recover.zip";
+
+
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_DEFLATE;
+    file_info.flag = MZ_ZIP_FLAG_UTF8;
+
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_compress_method(writer, MZ_COMPRESS_METHOD_DEFLATE);
+    mz_zip_writer_set_dictionary_size(writer, 4096);
+    err = mz_zip_writer_open_file(writer, path, disk_size, 0);
+    for (i = 0; i < count && err == MZ_OK; i += 1)
+    {
+        snprintf(filename, sizeof(filename), "%" PRId32 ".json", i);
+        data_size = test_zip_writer_dictionary_entry(i, data, sizeof(data));
+        file_info.filename = filename;
+        file_info.uncompressed_size = data_size;
+        err = mz_zip_writer_add_buffer(writer, data, data_size, &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    /* Cut off the end of central directory record so the central directory is rebuilt from local headers */
+    zip_size = mz_os_get_file_size(path);
+    if (err == MZ_OK && zip_size <= 22)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK)
+    {
+        zip_buf = (uint8_t *)MZ_ALLOC((int32_t)zip_size);
+        if (zip_buf == NULL)
+            err = MZ_MEM_ERROR;
+    }
+    mz_stream_os_create(&stream);
+    if (err == MZ_OK)
+        err = mz_stream_os_open(stream, path, MZ_OPEN_MODE_READ);
+    if (err == MZ_OK && mz_stream_os_read(stream, zip_buf, (int32_t)zip_size) != (int32_t)zip_size)
+        err = MZ_READ_ERROR;
+    mz_stream_os_close(stream);
+    if (err == MZ_OK)
+        err = mz_stream_os_open(stream, path, MZ_OPEN_MODE_CREATE | MZ_OPEN_MODE_WRITE);
+    if (err == MZ_OK && mz_stream_os_write(stream, zip_buf, (int32_t)zip_size - 22) != (int32_t)zip_size - 22)
+        err = MZ_WRITE_ERROR;
+    mz_stream_os_close(stream);
+    mz_stream_os_delete(&stream);
+    MZ_FREE(zip_buf);
+
+    /* Dictionary record is not an entry and must not show up in the recovered central directory */
+    mz_zip_reader_create(&reader);
+    mz_zip_reader_set_recover(reader, 1);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_file(reader, path);
+    if (err == MZ_OK)
+        err = mz_zip_reader_goto_first_entry(reader);
+    while (err == MZ_OK)
+    {
+        err = mz_zip_reader_entry_get_info(reader, &entry_info);
+        if (err == MZ_OK && sscanf(entry_info->filename, "%" SCNd32 ".json", &i) != 1)
+            err = MZ_FORMAT_ERROR;
+        if (err == MZ_OK)
+        {
+            data_size = test_zip_writer_dictionary_entry(i, data, sizeof(data));
+            err = mz_zip_reader_entry_save_buffer(reader, temp, data_size);
+        }
+        if (err == MZ_OK && memcmp(temp, data, data_size) != 0)
+            err = MZ_CRC_ERROR;
+        if (err == MZ_OK)
+        {
+            entries += 1;
+            err = mz_zip_reader_goto_next_entry(reader);
+        }
+    }
+    if (err == MZ_END_OF_LIST)
+        err = MZ_OK;
+    if (err == MZ_OK && entries != count)
+        err = MZ_FORMAT_ERROR;
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+
+    mz_os_unlink(path);
+    for (i = 1; i < 100; i += 1)
+    {
+        snprintf(filename, sizeof(filename), "dict_recover.z%02" PRId32, i);
+        if (mz_os_unlink(filename) != MZ_OK)
+            break;
+    }
+    return err;
+}
+
+int32_t test_zip_writer_dictionary(void)
+{
+    int32_t err = MZ_OK;
+
+    err = test_zip_writer_dictionary_method(MZ_COMPRESS_METHOD_DEFLATE);
+    if (err == MZ_OK)
+        err = test_zip_writer_dictionary_recover(0);
+    if (err == MZ_OK)
+        err = test_zip_writer_dictionary_recover(16 * 1024);
+#ifdef HAVE_ZSTD
+    if (err == MZ_OK)
+        err = test_zip_writer_dictionary_method(MZ_COMPRESS_METHOD_ZSTD);
+    if (err == MZ_OK)
+        err = test_zip_writer_dictionary_mixed();
+#endif
+
+    if (err == MZ_OK)
+        printf("Writer dictionary.. OK\n");
+    else
+        printf("Writer dictionary failed - %" PRId32 "\n", err);
+    return err;
+}
+
+int32_t test_zip_stats(void)
+{
+    mz_zip_stats write_stats;
+    mz_zip_stats read_stats;
+    mz_zip_file file_info;
+    void *writer = NULL;
+    void *reader = NULL;
+    uint8_t *data = NULL;
+    uint8_t *temp = NULL;
+    uint32_t seed = 0x13572468;
+    int32_t data_size = 128 * 1024;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    const char *path = "stats.zip";
+    const char *filenames[] = { "one", "two", "three", "four" };
+
+
+    data = (uint8_t *)MZ_ALLOC(data_size);
+    temp = (uint8_t *)MZ_ALLOC(data_size);
+    if (data == NULL || temp == NULL)
+    {
+        MZ_FREE(data);
+        MZ_FREE(temp);
+        return MZ_MEM_ERROR;
+    }
+
+    for (i = 0; i < data_size; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)('a' + ((seed >> 24) % 16));
+    }
+
+    memset(&write_stats, 0, sizeof(write_stats));
+    memset(&read_stats, 0, sizeof(read_stats));
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_DEFLATE;
+    file_info.flag = MZ_ZIP_FLAG_UTF8;
+    file_info.uncompressed_size = data_size;
+
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_stats(writer, &write_stats);
+
+    err = mz_zip_writer_open_file(writer, path, 0, 0);
+    for (i = 0; i < 4 && err == MZ_OK; i += 1)
+    {
+        file_info.filename = filenames[i];
+        err = mz_zip_writer_add_buffer(writer, data, data_size, &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    /* Every layer must have seen the data go through it */
+    if (err == MZ_OK && write_stats.compress.bytes_written != (int64_t)data_size * 4)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && (write_stats.crypt.bytes_written == 0 ||
+        write_stats.crypt.bytes_written >= write_stats.compress.bytes_written))
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && write_stats.file.bytes_written < mz_os_get_file_size(path))
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && (write_stats.buffered.buffer_hits == 0 ||
+        write_stats.split.write_calls < write_stats.crypt.write_calls))
+        err = MZ_FORMAT_ERROR;
+
+    if (err == MZ_OK)
+    {
+        mz_zip_reader_create(&reader);
+        mz_zip_reader_set_stats(reader, &read_stats);
+
+        err = mz_zip_reader_open_file(reader, path);
+        if (err == MZ_OK)
+            err = mz_zip_reader_goto_first_entry(reader);
+        while (err == MZ_OK)
+        {
+            err = mz_zip_reader_entry_save_buffer(reader, temp, data_size);
+            if (err == MZ_OK)
+                err = mz_zip_reader_goto_next_entry(reader);
+        }
+        if (err == MZ_END_OF_LIST)
+            err = MZ_OK;
+
+        mz_zip_reader_close(reader);
+        mz_zip_reader_delete(&reader);
+    }
+
+    if (err == MZ_OK && read_stats.compress.bytes_read != (int64_t)data_size * 4)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && read_stats.crypt.bytes_read < write_stats.crypt.bytes_written)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && (read_stats.file.read_calls == 0 || read_stats.file.seek_calls == 0 ||
+        read_stats.buffered.buffer_hits == 0 || read_stats.compress.read_time <= 0))
+        err = MZ_FORMAT_ERROR;
+
+    MZ_FREE(data);
+    MZ_FREE(temp);
+
+    if (err == MZ_OK)
+        printf("Zip stream stats.. OK\n");
+    else
+        printf("Zip stream stats failed - %" PRId32 "\n", err);
+    return err;
+}
+
+typedef struct test_zip_timing_s
+{
+    int32_t count;
+    int32_t filename_error;
+    uint64_t compress_time;
+    uint64_t io_time;
+} test_zip_timing_t;
+
+static void test_zip_timing_cb(void *handle, void *userdata, mz_zip_file *file_info,
+    const mz_zip_entry_timing *timing)
+{
+    test_zip_timing_t *totals = (test_zip_timing_t *)userdata;
+    const char *expected = (totals->count % 2) ? "two" : "one";
+    MZ_UNUSED(handle);
+
+    if (strcmp(file_info->filename, expected) != 0)
+        totals->filename_error = 1;
+    totals->count += 1;
+    totals->compress_time += timing->compress_time;
+    totals->io_time += timing->io_time;
+}
+
+int32_t test_zip_timing(void)
+{
+    test_zip_timing_t write_totals;
+    test_zip_timing_t read_totals;
+    mz_zip_file file_info;
+    void *writer = NULL;
+    void *reader = NULL;
+    uint8_t *data = NULL;
+    uint8_t *temp = NULL;
+    uint32_t seed = 0x2468ace0;
+    int32_t data_size = 256 * 1024;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    const char *path = "timing.zip";
+    const char *filenames[] = { "one", "two" };
+
+
+    data = (uint8_t *)MZ_ALLOC(data_size);
+    temp = (uint8_t *)MZ_ALLOC(data_size);
+    if (data == NULL || temp == NULL)
+    {
+        MZ_FREE(data);
+        MZ_FREE(temp);
+        return MZ_MEM_ERROR;
+    }
+
+    for (i = 0; i < data_size; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)('a' + ((seed >> 24) % 16));
+    }
+
+    memset(&write_totals, 0, sizeof(write_totals));
+    memset(&read_totals, 0, sizeof(read_totals));
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_DEFLATE;
+    file_info.flag = MZ_ZIP_FLAG_UTF8;
+    file_info.uncompressed_size = data_size;
+
+    /* Timings must work without counters supplied by the caller */
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_timing_cb(writer, &write_totals, test_zip_timing_cb);
+
+    err = mz_zip_writer_open_file(writer, path, 0, 0);
+    for (i = 0; i < 2 && err == MZ_OK; i += 1)
+    {
+        file_info.filename = filenames[i];
+        err = mz_zip_writer_add_buffer(writer, data, data_size, &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    if (err == MZ_OK)
+    {
+        mz_zip_reader_create(&reader);
+        mz_zip_reader_set_timing_cb(reader, &read_totals, test_zip_timing_cb);
+
+        err = mz_zip_reader_open_file(reader, path);
+        if (err == MZ_OK)
+            err = mz_zip_reader_goto_first_entry(reader);
+        while (err == MZ_OK)
+        {
+            err = mz_zip_reader_entry_save_buffer(reader, temp, data_size);
+            if (err == MZ_OK)
+                err = mz_zip_reader_goto_next_entry(reader);
+        }
+        if (err == MZ_END_OF_LIST)
+            err = MZ_OK;
+
+        mz_zip_reader_close(reader);
+        mz_zip_reader_delete(&reader);
+    }
+
+    if (err == MZ_OK && (write_totals.count != 2 || read_totals.count != 2 ||
+        write_totals.filename_error || read_totals.filename_error))
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && (write_totals.compress_time == 0 || read_totals.compress_time == 0 ||
+        read_totals.io_time == 0))
+        err = MZ_FORMAT_ERROR;
+
+    MZ_FREE(data);
+    MZ_FREE(temp);
+
+    if (err == MZ_OK)
+        printf("Zip entry timing.. OK\n");
+    else
+        printf("Zip entry timing failed - %" PRId32 "\n", err);
+    return err;
+}
+
+int32_t test_zip_stream_reuse(void)
+{
+    mz_zip_file file_info;
+    void *writer = NULL;
+    void *reader = NULL;
+    uint8_t *data = NULL;
+    uint8_t *temp = NULL;
+    uint8_t partial[100];
+    uint32_t seed = 0x51ed2701;
+    int32_t data_size = 64 * 1024;
+    int32_t entry_size = 0;
+    int32_t entry_count = 12;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    char filename[32];
+    const char *path = "reuse.zip";
+    const char *password = "reuse";
+    const uint16_t methods[] = {
+        MZ_COMPRESS_METHOD_DEFLATE, MZ_COMPRESS_METHOD_STORE,
+#ifdef HAVE_ZSTD
+        MZ_COMPRESS_METHOD_ZSTD
+#else
+        MZ_COMPRESS_METHOD_DEFLATE
+#endif
+    };
+
+
+    data = (uint8_t *)MZ_ALLOC(data_size);
+    temp = (uint8_t *)MZ_ALLOC(data_size);
+    if (data == NULL || temp == NULL)
+    {
+        MZ_FREE(data);
+        MZ_FREE(temp);
+        return MZ_MEM_ERROR;
+    }
+
+    for (i = 0; i < data_size; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)('a' + ((seed >> 24) % 16));
+    }
+
+    /* Alternate methods, levels and encryption so pooled streams switch settings between entries */
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_password(writer, password);
+
+    err = mz_zip_writer_open_file(writer, path, 0, 0);
+    for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+    {
+        snprintf(filename, sizeof(filename), "entry%" PRId32, i);
+        entry_size = data_size - i * 1024;
+
+        memset(&file_info, 0, sizeof(file_info));
+        file_info.version_madeby = MZ_VERSION_MADEBY;
+        file_info.compression_method = methods[i % 3];
+        file_info.flag = MZ_ZIP_FLAG_UTF8;
+        file_info.filename = filename;
+        file_info.uncompressed_size = entry_size;
+#if !defined(MZ_ZIP_NO_ENCRYPTION) && defined(HAVE_PKCRYPT) && defined(HAVE_WZAES)
+        if ((i % 4) >= 2)
+            file_info.flag |= MZ_ZIP_FLAG_ENCRYPTED;
+        if ((i % 4) == 3)
+            file_info.aes_version = MZ_AES_VERSION;
+#endif
+
+        mz_zip_writer_set_compress_level(writer, (i % 2) ? MZ_COMPRESS_LEVEL_BEST : MZ_COMPRESS_LEVEL_FAST);
+        err = mz_zip_writer_add_buffer(writer, data + i * 1024, entry_size, &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    if (err == MZ_OK)
+    {
+        mz_zip_reader_create(&reader);
+        mz_zip_reader_set_password(reader, password);
+
+        err = mz_zip_reader_open_file(reader, path);
+
+        /* Abandon entries part way through so their streams are reused mid-stream */
+        for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+        {
+            snprintf(filename, sizeof(filename), "entry%" PRId32, i);
+            err = mz_zip_reader_locate_entry(reader, filename, 0);
+            if (err == MZ_OK)
+                err = mz_zip_reader_entry_open(reader);
+            if (err == MZ_OK && mz_zip_reader_entry_read(reader, partial, sizeof(partial)) != sizeof(partial))
+                err = MZ_READ_ERROR;
+            if (err == MZ_OK && memcmp(partial, data + i * 1024, sizeof(partial)) != 0)
+                err = MZ_FORMAT_ERROR;
+            mz_zip_reader_entry_close(reader);
+        }
+
+        for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+        {
+            snprintf(filename, sizeof(filename), "entry%" PRId32, i);
+            entry_size = data_size - i * 1024;
+
+            err = mz_zip_reader_locate_entry(reader, filename, 0);
+            if (err == MZ_OK)
+                err = mz_zip_reader_entry_save_buffer(reader, temp, entry_size);
+            if (err == MZ_OK && memcmp(temp, data + i * 1024, entry_size) != 0)
+                err = MZ_FORMAT_ERROR;
+        }
+
+        mz_zip_reader_close(reader);
+        mz_zip_reader_delete(&reader);
+    }
+
+    MZ_FREE(data);
+    MZ_FREE(temp);
+
+    if (err == MZ_OK)
+        printf("Zip stream reuse.. OK\n");
+    else
+        printf("Zip stream reuse failed - %" PRId32 "\n", err);
+    return err;
+}
+
+int32_t test_zip_alloc_arena(void)
+{
+    mz_zip_file file_info;
+    mz_alloc_stats stats;
+    void *arena = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    uint8_t *data = NULL;
+    uint8_t *temp = NULL;
+    uint32_t seed = 0x2b7e1516;
+    int64_t first_alloc_calls = 0;
+    int32_t data_size = 32 * 1024;
+    int32_t entry_count = 16;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    char filename[32];
+    const char *path = "arena.zip";
+
+
+    data = (uint8_t *)MZ_ALLOC(data_size);
+    temp = (uint8_t *)MZ_ALLOC(data_size);
+    mz_alloc_arena_create(&arena);
+    if (data == NULL || temp == NULL || arena == NULL)
+        err = MZ_MEM_ERROR;
+    if (err == MZ_OK)
+        err = mz_alloc_arena_reserve(arena, 1024 * 1024);
+
+    for (i = 0; i < data_size && err == MZ_OK; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)('a' + ((seed >> 24) % 16));
+    }
+
+    /* Codec state is only allocated for the first entry, later entries reuse it */
+    if (err == MZ_OK)
+    {
+        mz_zip_writer_create(&writer);
+        mz_zip_writer_set_alloc(writer, mz_alloc_arena_get_alloc(arena));
+
+        err = mz_zip_writer_open_file(writer, path, 0, 0);
+        for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+        {
+            snprintf(filename, sizeof(filename), "entry%" PRId32, i);
+
+            memset(&file_info, 0, sizeof(file_info));
+            file_info.version_madeby = MZ_VERSION_MADEBY;
+            file_info.compression_method = MZ_COMPRESS_METHOD_DEFLATE;
+            file_info.flag = MZ_ZIP_FLAG_UTF8;
+            file_info.filename = filename;
+            file_info.uncompressed_size = data_size - i;
+
+            err = mz_zip_writer_add_buffer(writer, data + i, data_size - i, &file_info);
+            if (i == 0)
+            {
+                mz_alloc_arena_get_stats(arena, &stats);
+                first_alloc_calls = stats.alloc_calls;
+            }
+        }
+        if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+            err = MZ_CLOSE_ERROR;
+        mz_zip_writer_delete(&writer);
+
+        mz_alloc_arena_get_stats(arena, &stats);
+        if (err == MZ_OK && (first_alloc_calls == 0 || stats.alloc_calls != first_alloc_calls))
+            err = MZ_INTERNAL_ERROR;
+        if (err == MZ_OK && stats.free_calls != stats.alloc_calls)
+            err = MZ_INTERNAL_ERROR;
+    }
+
+    if (err == MZ_OK)
+    {
+        mz_alloc_arena_reset(arena);
+        mz_alloc_arena_get_stats(arena, &stats);
+        first_alloc_calls = stats.alloc_calls;
+
+        mz_zip_reader_create(&reader);
+        mz_zip_reader_set_alloc(reader, mz_alloc_arena_get_alloc(arena));
+
+        err = mz_zip_reader_open_file(reader, path);
+        for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+        {
+            snprintf(filename, sizeof(filename), "entry%" PRId32, i);
+
+            err = mz_zip_reader_locate_entry(reader, filename, 0);
+            if (err == MZ_OK)
+                err = mz_zip_reader_entry_save_buffer(reader, temp, data_size - i);
+            if (err == MZ_OK && memcmp(temp, data + i, data_size - i) != 0)
+                err = MZ_FORMAT_ERROR;
+            if (i == 0)
+            {
+                mz_alloc_arena_get_stats(arena, &stats);
+                first_alloc_calls = stats.alloc_calls;
+            }
+        }
+
+        mz_alloc_arena_get_stats(arena, &stats);
+        if (err == MZ_OK && stats.alloc_calls != first_alloc_calls)
+            err = MZ_INTERNAL_ERROR;
+
+        mz_zip_reader_close(reader);
+        mz_zip_reader_delete(&reader);
+    }
+
+    mz_alloc_arena_get_stats(arena, &stats);
+    if (err == MZ_OK && (stats.fallback_calls != 0 || stats.bytes_peak == 0))
+        err = MZ_INTERNAL_ERROR;
+
+    mz_alloc_arena_delete(&arena);
+    MZ_FREE(data);
+    MZ_FREE(temp);
+
+    if (err == MZ_OK)
+        printf("Zip alloc arena.. OK\n");
+    else
+        printf("Zip alloc arena failed - %" PRId32 "\n", err);
+    return err;
+}
+
+int32_t test_zip_low_memory(void)
+{
+    mz_zip_file file_info;
+    void *mem_stream = NULL;
+    void *buffered_stream = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    uint8_t *data = NULL;
+    uint8_t *temp = NULL;
+    uint8_t partial[1000];
+    uint32_t seed = 0x6a09e667;
+    int32_t data_size = 96 * 1024;
+    int32_t entry_size = 0;
+    int32_t entry_count = 8;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    char filename[32];
+    const char *path = "lowmem.zip";
+    const char *password = "lowmem";
+
+
+    data = (uint8_t *)MZ_ALLOC(data_size);
+    temp = (uint8_t *)MZ_ALLOC(data_size);
+    if (data == NULL || temp == NULL)
+    {
+        MZ_FREE(data);
+        MZ_FREE(temp);
+        return MZ_MEM_ERROR;
+    }
+
+    for (i = 0; i < data_size; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)('a' + ((seed >> 24) % 16));
+    }
+
+    /* Releasing buffers must leave the stream at the same logical position */
+    mz_stream_mem_create(&mem_stream);
+    mz_stream_buffered_create(&buffered_stream);
+    mz_stream_set_base(buffered_stream, mem_stream);
+
+    err = mz_stream_buffered_open(buffered_stream, NULL, MZ_OPEN_MODE_CREATE);
+    if (err == MZ_OK && mz_stream_buffered_write(buffered_stream, data, 4096) != 4096)
+        err = MZ_WRITE_ERROR;
+    if (err == MZ_OK)
+        err = mz_stream_buffered_seek(buffered_stream, 1000, MZ_SEEK_SET);
+    for (i = 0; i < 2 && err == MZ_OK; i += 1)
+    {
+        err = mz_stream_buffered_release(buffered_stream);
+        if (err == MZ_OK && mz_stream_buffered_read(buffered_stream, partial, 100) != 100)
+            err = MZ_READ_ERROR;
+        if (err == MZ_OK && memcmp(partial, data + 1000 + i * 100, 100) != 0)
+            err = MZ_FORMAT_ERROR;
+    }
+    mz_stream_buffered_close(buffered_stream);
+    mz_stream_buffered_delete(&buffered_stream);
+    mz_stream_mem_delete(&mem_stream);
+
+    if (err == MZ_OK)
+    {
+        mz_zip_writer_create(&writer);
+        mz_zip_writer_set_password(writer, password);
+        err = mz_zip_writer_open_file(writer, path, 0, 0);
+    }
+    for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+    {
+        snprintf(filename, sizeof(filename), "entry%" PRId32, i);
+        entry_size = data_size - i * 4096;
+
+        memset(&file_info, 0, sizeof(file_info));
+        file_info.version_madeby = MZ_VERSION_MADEBY;
+        file_info.compression_method = (i % 2) ? MZ_COMPRESS_METHOD_STORE : MZ_COMPRESS_METHOD_DEFLATE;
+        file_info.flag = MZ_ZIP_FLAG_UTF8;
+        file_info.filename = filename;
+        file_info.uncompressed_size = entry_size;
+#if !defined(MZ_ZIP_NO_ENCRYPTION) && defined(HAVE_PKCRYPT)
+        if ((i % 4) >= 2)
+            file_info.flag |= MZ_ZIP_FLAG_ENCRYPTED;
+#endif
+
+        err = mz_zip_writer_add_buffer(writer, data + i * 4096, entry_size, &file_info);
+    }
+    if (writer != NULL)
+    {
+        if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+            err = MZ_CLOSE_ERROR;
+        mz_zip_writer_delete(&writer);
+    }
+
+    if (err == MZ_OK)
+    {
+        mz_zip_reader_create(&reader);
+        mz_zip_reader_set_password(reader, password);
+        mz_zip_reader_set_low_memory(reader, 1);
+
+        err = mz_zip_reader_open_file(reader, path);
+
+        /* Buffers are released between every step so reads must resume at the right offset */
+        for (i = entry_count - 1; i >= 0 && err == MZ_OK; i -= 1)
+        {
+            snprintf(filename, sizeof(filename), "entry%" PRId32, i);
+            err = mz_zip_reader_locate_entry(reader, filename, 0);
+            if (err == MZ_OK)
+                err = mz_zip_reader_entry_open(reader);
+            if (err == MZ_OK && mz_zip_reader_entry_read(reader, partial, sizeof(partial)) != sizeof(partial))
+                err = MZ_READ_ERROR;
+            if (err == MZ_OK && memcmp(partial, data + i * 4096, sizeof(partial)) != 0)
+                err = MZ_FORMAT_ERROR;
+            mz_zip_reader_entry_close(reader);
+        }
+
+        if (err == MZ_OK)
+            err = mz_zip_reader_goto_first_entry(reader);
+        for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+        {
+            entry_size = data_size - i * 4096;
+
+            err = mz_zip_reader_entry_save_buffer(reader, temp, entry_size);
+            if (err == MZ_OK && memcmp(temp, data + i * 4096, entry_size) != 0)
+                err = MZ_FORMAT_ERROR;
+            if (err == MZ_OK)
+                err = mz_zip_reader_goto_next_entry(reader);
+        }
+        if (err == MZ_END_OF_LIST && i == entry_count)
+            err = MZ_OK;
+
+        mz_zip_reader_close(reader);
+        mz_zip_reader_delete(&reader);
+    }
+
+    MZ_FREE(data);
+    MZ_FREE(temp);
+
+    if (err == MZ_OK)
+        printf("Zip low memory.. OK\n");
+    else
+        printf("Zip low memory failed - %" PRId32 "\n", err);
+    return err;
+}
+
+static int32_t test_zip_reader_reopen_write(const char *path, const uint8_t *data, int32_t data_size)
+{
+    mz_zip_file file_info;
+    void *writer = NULL;
+    int32_t err = MZ_OK;
+
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_DEFLATE;
+    file_info.flag = MZ_ZIP_FLAG_UTF8;
+    file_info.filename = "data";
+    file_info.uncompressed_size = data_size;
+
+    mz_zip_writer_create(&writer);
+    err = mz_zip_writer_open_file(writer, path, 0, 0);
+    if (err == MZ_OK)
+        err = mz_zip_writer_add_buffer(writer, (void *)data, data_size, &file_info);
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+    return err;
+}
+
+static int32_t test_zip_reader_reopen_check(void *reader, const char *path, const uint8_t *data, int32_t data_size,
+    uint8_t *temp)
+{
+    int32_t err = MZ_OK;
+
+    err = mz_zip_reader_open_file(reader, path);
+    if (err == MZ_OK)
+        err = mz_zip_reader_locate_entry(reader, "data", 0);
+    if (err == MZ_OK && mz_zip_reader_entry_save_buffer_length(reader) != data_size)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK)
+        err = mz_zip_reader_entry_save_buffer(reader, temp, data_size);
+    if (err == MZ_OK && memcmp(temp, data, data_size) != 0)
+        err = MZ_FORMAT_ERROR;
+    if (mz_zip_reader_close(reader) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    return err;
+}
+
+int32_t test_zip_reader_reopen(void)
+{
+    void *reader = NULL;
+    void *zip_handle = NULL;
+    void *first_zip_handle = NULL;
+    void *file_stream = NULL;
+    uint8_t *data = NULL;
+    uint8_t *temp = NULL;
+    int64_t eocd_pos = 0;
+    int64_t hint_eocd_pos = 0;
+    uint32_t seed = 0x3c6ef372;
+    int32_t data_size = 32 * 1024;
+    int32_t size_a = 20000;
+    int32_t size_b = 12000;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    const char *path_a = "reopen_a.zip";
+    const char *path_b = "reopen_b.zip";
+
+
+    data = (uint8_t *)MZ_ALLOC(data_size);
+    temp = (uint8_t *)MZ_ALLOC(data_size);
+    if (data == NULL || temp == NULL)
+    {
+        MZ_FREE(data);
+        MZ_FREE(temp);
+        return MZ_MEM_ERROR;
+    }
+
+    for (i = 0; i < data_size; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)(seed >> 24);
+    }
+
+    err = test_zip_reader_reopen_write(path_a, data, size_a);
+    if (err == MZ_OK)
+        err = test_zip_reader_reopen_write(path_b, data + 100, size_b);
+
+    mz_zip_reader_create(&reader);
+
+    /* Alternate between archives so the cached end of central dir position is replaced each time */
+    for (i = 0; i < 20 && err == MZ_OK; i += 1)
+    {
+        if (i % 4 < 2)
+            err = test_zip_reader_reopen_check(reader, path_a, data, size_a, temp);
+        else
+            err = test_zip_reader_reopen_check(reader, path_b, data + 100, size_b, temp);
+    }
+
+    /* Same archive opened again must reuse the zip handle */
+    for (i = 0; i < 2 && err == MZ_OK; i += 1)
+    {
+        err = mz_zip_reader_open_file(reader, path_a);
+        if (err == MZ_OK)
+            err = mz_zip_reader_get_zip_handle(reader, &zip_handle);
+        if (err == MZ_OK && i == 0)
+            first_zip_handle = zip_handle;
+        if (err == MZ_OK && zip_handle != first_zip_handle)
+            err = MZ_INTERNAL_ERROR;
+        mz_zip_reader_close(reader);
+    }
+
+    /* Archive that changed since the last open must not be read using the old position */
+    if (err == MZ_OK)
+        err = test_zip_reader_reopen_check(reader, path_a, data, size_a, temp);
+    if (err == MZ_OK)
+        err = test_zip_reader_reopen_write(path_a, data + 200, size_a + 5000);
+    if (err == MZ_OK)
+        err = test_zip_reader_reopen_check(reader, path_a, data + 200, size_a + 5000, temp);
+    if (err == MZ_OK)
+        err = test_zip_reader_reopen_check(reader, path_a, data + 200, size_a + 5000, temp);
+
+    mz_zip_reader_delete(&reader);
+
+    /* Hint that does not point at the end of central dir falls back to searching for it */
+    if (err == MZ_OK)
+    {
+        mz_stream_os_create(&file_stream);
+        mz_zip_create(&zip_handle);
+        err = mz_stream_os_open(file_stream, path_b, MZ_OPEN_MODE_READ);
+        if (err == MZ_OK)
+            err = mz_zip_open(zip_handle, file_stream, MZ_OPEN_MODE_READ);
+        if (err == MZ_OK)
+            err = mz_zip_get_eocd_pos(zip_handle, &eocd_pos);
+        mz_zip_close(zip_handle);
+
+        for (i = 0; i < 2 && err == MZ_OK; i += 1)
+        {
+            mz_zip_set_eocd_pos_hint(zip_handle, (i == 0) ? 4 : eocd_pos);
+            err = mz_zip_open(zip_handle, file_stream, MZ_OPEN_MODE_READ);
+            if (err == MZ_OK)
+                err = mz_zip_get_eocd_pos(zip_handle, &hint_eocd_pos);
+            if (err == MZ_OK && hint_eocd_pos != eocd_pos)
+                err = MZ_FORMAT_ERROR;
+            if (err == MZ_OK)
+                err = mz_zip_locate_entry(zip_handle, "data", 0);
+            mz_zip_close(zip_handle);
+        }
+
+        mz_zip_delete(&zip_handle);
+        mz_stream_os_close(file_stream);
+        mz_stream_os_delete(&file_stream);
+    }
+
+    MZ_FREE(data);
+    MZ_FREE(temp);
+
+    if (err == MZ_OK)
+        printf("Zip reader reopen.. OK\n");
+    else
+        printf("Zip reader reopen failed - %" PRId32 "\n", err);
+    return err;
+}
+
+int32_t test_zip_reader_batch(void)
+{
+    mz_zip_file file_info;
+    mz_zip_reader_batch *entries = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    void *mem_stream = NULL;
+    uint8_t *data = NULL;
+    uint8_t *temp = NULL;
+    uint32_t seed = 0x510e527f;
+    int32_t entry_count = 200;
+    int32_t batch_count = 0;
+    int32_t data_size = 0;
+    int32_t entry = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    char filenames[8][32];
+    const char *path = "batch.zip";
+
+
+    data_size = entry_count * 100 + 1000;
+    data = (uint8_t *)MZ_ALLOC(data_size);
+    temp = (uint8_t *)MZ_ALLOC(entry_count * 1000);
+    entries = (mz_zip_reader_batch *)MZ_ALLOC(entry_count * sizeof(mz_zip_reader_batch));
+    if (data == NULL || temp == NULL || entries == NULL)
+    {
+        MZ_FREE(data);
+        MZ_FREE(temp);
+        MZ_FREE(entries);
+        return MZ_MEM_ERROR;
+    }
+
+    for (i = 0; i < data_size; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)('a' + ((seed >> 24) % 8));
+    }
+
+    /* Entry i holds 100 + i % 900 bytes starting at data + i * 100 */
+    mz_zip_writer_create(&writer);
+    err = mz_zip_writer_open_file(writer, path, 0, 0);
+    for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+    {
+        snprintf(filenames[0], sizeof(filenames[0]), "dir\\entry%03" PRId32, i);
+        memset(&file_info, 0, sizeof(file_info));
+        file_info.version_madeby = MZ_VERSION_MADEBY;
+        file_info.compression_method = (i % 3) ? MZ_COMPRESS_METHOD_DEFLATE : MZ_COMPRESS_METHOD_STORE;
+        file_info.flag = MZ_ZIP_FLAG_UTF8;
+        file_info.filename = filenames[0];
+        file_info.uncompressed_size = 100 + i % 900;
+        err = mz_zip_writer_add_buffer(writer, data + i * 100, 100 + i % 900, &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    mz_zip_reader_create(&reader);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_file(reader, path);
+
+    /* Names and indices out of order, with one name asked for twice */
+    memset(entries, 0, entry_count * sizeof(mz_zip_reader_batch));
+    for (i = 0; i < 8; i += 1)
+    {
+        entry = (i * 73 + 11) % entry_count;
+        snprintf(filenames[i], sizeof(filenames[i]), "dir/entry%03" PRId32, (i == 7) ? 11 : entry);
+        entries[batch_count].filename = filenames[i];
+        entries[batch_count].buf = temp + batch_count * 1000;
+        entries[batch_count].buf_size = 1000;
+        batch_count += 1;
+    }
+    for (i = entry_count - 1; i >= 0; i -= 9)
+    {
+        entries[batch_count].index = i;
+        entries[batch_count].buf = temp + batch_count * 1000;
+        entries[batch_count].buf_size = 100 + i % 900;
+        batch_count += 1;
+    }
+    if (err == MZ_OK)
+        err = mz_zip_reader_read_batch(reader, entries, batch_count);
+    for (i = 0; i < batch_count && err == MZ_OK; i += 1)
+    {
+        if (entries[i].filename != NULL)
+            entry = (i == 7) ? 11 : (i * 73 + 11) % entry_count;
+        else
+            entry = (int32_t)entries[i].index;
+        if (entries[i].err != MZ_OK)
+            err = entries[i].err;
+        else if (entries[i].read != 100 + entry % 900)
+            err = MZ_FORMAT_ERROR;
+        else if (memcmp(entries[i].buf, data + entry * 100, 100 + entry % 900) != 0)
+            err = MZ_FORMAT_ERROR;
+    }
+
+    /* Missing entries and small buffers fail on their own without stopping the others */
+    if (err == MZ_OK)
+    {
+        memset(entries, 0, 4 * sizeof(mz_zip_reader_batch));
+        entries[0].filename = "dir/missing";
+        entries[0].buf = temp;
+        entries[0].buf_size = 1000;
+        entries[1].index = 150;
+        entries[1].buf = temp + 1000;
+        entries[1].buf_size = 100;
+        entries[2].index = entry_count;
+        entries[2].buf = temp + 2000;
+        entries[2].buf_size = 1000;
+        mz_stream_mem_create(&mem_stream);
+        mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+        entries[3].index = 150;
+        entries[3].stream = mem_stream;
+        entries[3].write_cb = mz_stream_mem_write;
+
+        if (mz_zip_reader_read_batch(reader, entries, 4) != MZ_EXIST_ERROR)
+            err = MZ_INTERNAL_ERROR;
+        else if (entries[0].err != MZ_EXIST_ERROR || entries[1].err != MZ_BUF_ERROR || entries[2].err != MZ_EXIST_ERROR)
+            err = MZ_INTERNAL_ERROR;
+        else if (entries[3].err != MZ_OK || entries[3].read != 100 + 150 % 900)
+            err = MZ_FORMAT_ERROR;
+        else if (mz_stream_mem_tell(mem_stream) != entries[3].read)
+            err = MZ_FORMAT_ERROR;
+
+        mz_stream_mem_delete(&mem_stream);
+    }
+
+    /* Reader can still be used one entry at a time afterwards */
+    if (err == MZ_OK)
+        err = mz_zip_reader_locate_entry(reader, "dir/entry005", 0);
+    if (err == MZ_OK)
+        err = mz_zip_reader_entry_save_buffer(reader, temp, 105);
+    if (err == MZ_OK && memcmp(temp, data + 500, 105) != 0)
+        err = MZ_FORMAT_ERROR;
+
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+
+    MZ_FREE(data);
+    MZ_FREE(temp);
+    MZ_FREE(entries);
+
+    if (err == MZ_OK)
+        printf("Zip reader batch.. OK\n");
+    else
+        printf("Zip reader batch failed - %" PRId32 "\n", err);
+    return err;
+}
+
+typedef struct test_zip_order_s
+{
+    char        order[16];
+    int32_t     count;
+} test_zip_order;
+
+static int32_t test_zip_reader_ordered_entry_cb(void *handle, void *userdata, mz_zip_file *file_info, const char *path)
+{
+    test_zip_order *ordered = (test_zip_order *)userdata;
+    MZ_UNUSED(handle);
+    MZ_UNUSED(path);
+    if (ordered->count < (int32_t)sizeof(ordered->order) - 1)
+        ordered->order[ordered->count++] = file_info->filename[3];
+    return MZ_OK;
+}
+
+int32_t test_zip_reader_ordered(void)
+{
+    test_zip_order ordered;
+    mz_zip_file file_info;
+    void *mem_stream = NULL;
+    void *file_stream = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    const uint8_t *buf = NULL;
+    uint8_t *cd = NULL;
+    uint8_t *data = NULL;
+    int64_t record_pos[6];
+    int32_t record_size[6];
+    int32_t record_count = 0;
+    int32_t entry_count = 6;
+    int32_t buf_size = 0;
+    int32_t cd_pos = 0;
+    int32_t cd_size = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    int32_t r = 0;
+    char filename[32];
+    char path[64];
+    const char *zip_path = "ordered.zip";
+
+
+    data = (uint8_t *)MZ_ALLOC(entry_count * 1000);
+    if (data == NULL)
+        return MZ_MEM_ERROR;
+    for (i = 0; i < entry_count * 1000; i += 1)
+        data[i] = (uint8_t)('a' + (i % 17));
+
+    mz_stream_mem_create(&mem_stream);
+    mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    mz_zip_writer_create(&writer);
+    err = mz_zip_writer_open(writer, mem_stream);
+    for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+    {
+        snprintf(filename, sizeof(filename), "ord%" PRId32 ".txt", i);
+        memset(&file_info, 0, sizeof(file_info));
+        file_info.version_madeby = MZ_VERSION_MADEBY;
+        file_info.compression_method = MZ_COMPRESS_METHOD_DEFLATE;
+        file_info.flag = MZ_ZIP_FLAG_UTF8;
+        file_info.filename = filename;
+        file_info.uncompressed_size = 100 + i * 100;
+        err = mz_zip_writer_add_buffer(writer, data + i * 1000, 100 + i * 100, &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    /* Reverse the central directory records so they no longer follow the order entries are stored in */
+    mz_stream_mem_seek(mem_stream, 0, MZ_SEEK_END);
+    buf_size = (int32_t)mz_stream_mem_tell(mem_stream);
+    mz_stream_mem_get_buffer(mem_stream, (const void **)&buf);
+    for (i = 0; i + 46 <= buf_size && err == MZ_OK && record_count < entry_count; i += 1)
+    {
+        if (buf[i] != 'P' || buf[i + 1] != 'K' || buf[i + 2] != 1 || buf[i + 3] != 2)
+            continue;
+        record_pos[record_count] = i;
+        record_size[record_count] = 46 + (buf[i + 28] | (buf[i + 29] << 8)) +
+            (buf[i + 30] | (buf[i + 31] << 8)) + (buf[i + 32] | (buf[i + 33] << 8));
+        cd_size += record_size[record_count];
+        i += record_size[record_count] - 1;
+        record_count += 1;
+    }
+    if (err == MZ_OK && record_count != entry_count)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK)
+    {
+        cd = (uint8_t *)MZ_ALLOC(cd_size);
+        if (cd == NULL)
+            err = MZ_MEM_ERROR;
+    }
+    if (err == MZ_OK)
+    {
+        for (r = entry_count - 1; r >= 0; r -= 1)
+        {
+            memcpy(cd + cd_pos, buf + record_pos[r], record_size[r]);
+            cd_pos += record_size[r];
+        }
+        memcpy((uint8_t *)buf + record_pos[0], cd, cd_size);
+        MZ_FREE(cd);
+    }
+
+    if (err == MZ_OK)
+    {
+        mz_stream_os_create(&file_stream);
+        err = mz_stream_os_open(file_stream, zip_path, MZ_OPEN_MODE_WRITE | MZ_OPEN_MODE_CREATE);
+        if (err == MZ_OK && mz_stream_os_write(file_stream, buf, buf_size) != buf_size)
+            err = MZ_WRITE_ERROR;
+        mz_stream_os_close(file_stream);
+        mz_stream_os_delete(&file_stream);
+    }
+    mz_stream_mem_delete(&mem_stream);
+
+    /* Central dir order is followed by default and stored order when ordered */
+    for (r = 0; r < 2 && err == MZ_OK; r += 1)
+    {
+        memset(&ordered, 0, sizeof(ordered));
+
+        mz_zip_reader_create(&reader);
+        mz_zip_reader_set_ordered(reader, (uint8_t)r);
+        mz_zip_reader_set_drop_cache(reader, (uint8_t)r);
+        mz_zip_reader_set_entry_cb(reader, &ordered, test_zip_reader_ordered_entry_cb);
+        err = mz_zip_reader_open_file(reader, zip_path);
+        if (err == MZ_OK)
+            err = mz_zip_reader_save_all(reader, "ordered_out");
+        mz_zip_reader_close(reader);
+        mz_zip_reader_delete(&reader);
+
+        if (err == MZ_OK && strcmp(ordered.order, (r == 0) ? "543210" : "012345") != 0)
+            err = MZ_INTERNAL_ERROR;
+        for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+        {
+            snprintf(path, sizeof(path), "ordered_out/ord%" PRId32 ".txt", i);
+            if (mz_os_get_file_size(path) != 100 + i * 100)
+                err = MZ_FORMAT_ERROR;
+            mz_os_unlink(path);
+        }
+    }
+
+    MZ_FREE(data);
+
+    if (err == MZ_OK)
+        printf("Zip reader ordered.. OK\n");
+    else
+        printf("Zip reader ordered failed - %" PRId32 "\n", err);
+    return err;
+}
+
+static int32_t test_zip_reader_save_direct_progress_cb(void *handle, void *userdata, mz_zip_file *file_info, int64_t position)
+{
+    int32_t *partial = (int32_t *)userdata;
+    MZ_UNUSED(handle);
+    if (position > 0 && position < file_info->uncompressed_size)
+        *partial += 1;
+    return MZ_OK;
+}
+
+int32_t test_zip_reader_save_direct(void)
+{
+    mz_zip_file file_info;
+    mz_zip_file *file_info_ptr = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    void *file_stream = NULL;
+    uint8_t *data = NULL;
+    uint8_t *temp = NULL;
+    uint32_t seed = 0x9b05688c;
+    int64_t data_pos = 0;
+    int32_t data_size = 1536 * 1024;
+    int32_t partial = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    uint8_t byte = 0;
+    const char *path = "direct.zip";
+    const char *out_path = "direct.bin";
+
+
+    data = (uint8_t *)MZ_ALLOC(data_size);
+    temp = (uint8_t *)MZ_ALLOC(data_size);
+    if (data == NULL || temp == NULL)
+    {
+        MZ_FREE(data);
+        MZ_FREE(temp);
+        return MZ_MEM_ERROR;
+    }
+
+    for (i = 0; i < data_size; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)('a' + ((seed >> 24) % 20));
+    }
+
+    /* Entries large enough to be saved to a file through a mapping */
+    mz_zip_writer_create(&writer);
+    err = mz_zip_writer_open_file(writer, path, 0, 0);
+    for (i = 0; i < 2 && err == MZ_OK; i += 1)
+    {
+        memset(&file_info, 0, sizeof(file_info));
+        file_info.version_madeby = MZ_VERSION_MADEBY;
+        file_info.compression_method = (i == 0) ? MZ_COMPRESS_METHOD_DEFLATE : MZ_COMPRESS_METHOD_STORE;
+        file_info.flag = MZ_ZIP_FLAG_UTF8;
+        file_info.filename = (i == 0) ? "deflate.bin" : "store.bin";
+        file_info.uncompressed_size = data_size;
+        err = mz_zip_writer_add_buffer(writer, data, data_size, &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    /* Progress is reported while the mapped file is filled, not only before and after */
+    mz_zip_reader_create(&reader);
+    mz_zip_reader_set_progress_cb(reader, &partial, test_zip_reader_save_direct_progress_cb);
+    mz_zip_reader_set_progress_interval(reader, 0);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_file(reader, path);
+    for (i = 0; i < 2 && err == MZ_OK; i += 1)
+    {
+        partial = 0;
+        err = mz_zip_reader_locate_entry(reader, (i == 0) ? "deflate.bin" : "store.bin", 0);
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_save_file(reader, out_path);
+        if (err == MZ_OK && partial == 0)
+            err = MZ_INTERNAL_ERROR;
+
+        if (err == MZ_OK && mz_os_get_file_size(out_path) != data_size)
+            err = MZ_FORMAT_ERROR;
+        if (err == MZ_OK)
+        {
+            memset(temp, 0, data_size);
+            mz_stream_os_create(&file_stream);
+            err = mz_stream_os_open(file_stream, out_path, MZ_OPEN_MODE_READ);
+            if (err == MZ_OK && mz_stream_os_read(file_stream, temp, data_size) != data_size)
+                err = MZ_READ_ERROR;
+            mz_stream_os_close(file_stream);
+            mz_stream_os_delete(&file_stream);
+        }
+        if (err == MZ_OK && memcmp(temp, data, data_size) != 0)
+            err = MZ_FORMAT_ERROR;
+        mz_os_unlink(out_path);
+
+        memset(temp, 0, data_size);
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_save_buffer(reader, temp, data_size);
+        if (err == MZ_OK && memcmp(temp, data, data_size) != 0)
+            err = MZ_FORMAT_ERROR;
+    }
+    if (err == MZ_OK)
+        err = mz_zip_reader_entry_get_info(reader, &file_info_ptr);
+    if (err == MZ_OK)
+        data_pos = file_info_ptr->disk_offset + 30 + file_info_ptr->filename_size + file_info_ptr->extrafield_size;
+    mz_zip_reader_close(reader);
+
+    /* Damaged data must still be caught when it is decompressed straight into the destination */
+    if (err == MZ_OK)
+    {
+        mz_stream_os_create(&file_stream);
+        err = mz_stream_os_open(file_stream, path, MZ_OPEN_MODE_READWRITE | MZ_OPEN_MODE_APPEND);
+        if (err == MZ_OK)
+            err = mz_stream_os_seek(file_stream, data_pos + 1000, MZ_SEEK_SET);
+        if (err == MZ_OK && mz_stream_os_read(file_stream, &byte, 1) != 1)
+            err = MZ_READ_ERROR;
+        byte ^= 0x20;
+        if (err == MZ_OK)
+            err = mz_stream_os_seek(file_stream, data_pos + 1000, MZ_SEEK_SET);
+        if (err == MZ_OK && mz_stream_os_write(file_stream, &byte, 1) != 1)
+            err = MZ_WRITE_ERROR;
+        mz_stream_os_close(file_stream);
+        mz_stream_os_delete(&file_stream);
+    }
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_file(reader, path);
+    if (err == MZ_OK)
+        err = mz_zip_reader_locate_entry(reader, "store.bin", 0);
+    if (err == MZ_OK && mz_zip_reader_entry_save_file(reader, out_path) != MZ_CRC_ERROR)
+        err = MZ_INTERNAL_ERROR;
+    if (err == MZ_OK && mz_zip_reader_entry_save_buffer(reader, temp, data_size) != MZ_CRC_ERROR)
+        err = MZ_INTERNAL_ERROR;
+    mz_os_unlink(out_path);
+
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+
+    MZ_FREE(data);
+    MZ_FREE(temp);
+
+    if (err == MZ_OK)
+        printf("Zip reader save direct.. OK\n");
+    else
+        printf("Zip reader save direct failed - %" PRId32 "\n", err);
+    return err;
+}
+
+int32_t test_zip_deflate_whole(void)
+{
+    mz_zip_file file_info;
+    void *writer = NULL;
+    void *reader = NULL;
+    uint8_t *data = NULL;
+    uint8_t *temp = NULL;
+    uint32_t seed = 0x4d2c7a13;
+    int32_t data_size = 1024 * 1024 + 1;
+    int32_t entry_sizes[] = { 0, 4000, 1024 * 1024, 1024 * 1024 + 1 };
+    int32_t entry_count = (int32_t)(sizeof(entry_sizes) / sizeof(entry_sizes[0]));
+    int32_t read = 0;
+    int32_t total = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    char filename[32];
+    const char *path = "whole.zip";
+
+
+    data = (uint8_t *)MZ_ALLOC(data_size);
+    temp = (uint8_t *)MZ_ALLOC(data_size);
+    if (data == NULL || temp == NULL)
+    {
+        MZ_FREE(data);
+        MZ_FREE(temp);
+        return MZ_MEM_ERROR;
+    }
+
+    for (i = 0; i < data_size; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)('a' + ((seed >> 24) % 24));
+    }
+
+    /* Sizes either side of the limit for deflating a whole entry in one call */
+    mz_zip_writer_create(&writer);
+    err = mz_zip_writer_open_file(writer, path, 0, 0);
+    for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+    {
+        snprintf(filename, sizeof(filename), "entry%" PRId32, i);
+        memset(&file_info, 0, sizeof(file_info));
+        file_info.version_madeby = MZ_VERSION_MADEBY;
+        file_info.compression_method = MZ_COMPRESS_METHOD_DEFLATE;
+        file_info.flag = MZ_ZIP_FLAG_UTF8;
+        file_info.filename = filename;
+        file_info.uncompressed_size = entry_sizes[i];
+        err = mz_zip_writer_add_buffer(writer, data, entry_sizes[i], &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    mz_zip_reader_create(&reader);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_file(reader, path);
+    for (i = 0; i < entry_count && err == MZ_OK; i += 1)
+    {
+        snprintf(filename, sizeof(filename), "entry%" PRId32, i);
+        err = mz_zip_reader_locate_entry(reader, filename, 0);
+
+        /* Whole entry in one read */
+        memset(temp, 0, data_size);
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_save_buffer(reader, temp, entry_sizes[i]);
+        if (err == MZ_OK && memcmp(temp, data, entry_sizes[i]) != 0)
+            err = MZ_FORMAT_ERROR;
+
+        /* Small reads are served from the inflated entry */
+        memset(temp, 0, data_size);
+        total = 0;
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_open(reader);
+        while (err == MZ_OK)
+        {
+            read = mz_zip_reader_entry_read(reader, temp + total, 1000);
+            if (read < 0)
+                err = read;
+            if (read <= 0)
+                break;
+            total += read;
+            if (total > entry_sizes[i])
+                err = MZ_FORMAT_ERROR;
+        }
+        if (mz_zip_reader_entry_close(reader) != MZ_OK && err == MZ_OK)
+            err = MZ_CLOSE_ERROR;
+        if (err == MZ_OK && (total != entry_sizes[i] || memcmp(temp, data, total) != 0))
+            err = MZ_FORMAT_ERROR;
+    }
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+
+    MZ_FREE(data);
+    MZ_FREE(temp);
+
+    if (err == MZ_OK)
+        printf("Zip deflate whole entries.. OK\n");
+    else
+        printf("Zip deflate whole entries failed - %" PRId32 "\n", err);
+    return err;
+}
+
+static int32_t test_codec_created = 0;
+
+static void *test_codec_counted_create(void **stream)
+{
+    test_codec_created += 1;
+    return mz_stream_zlib_create(stream);
+}
+
+int32_t test_zip_codec_run(const char *preferred, uint8_t streamed, int32_t *created)
+{
+    mz_zip_file file_info;
+    void *writer = NULL;
+    void *reader = NULL;
+    void *zip_handle = NULL;
+    int32_t err = MZ_OK;
+    char temp[120];
+    const char *path = "codec.zip";
+    const char *test_data = "test data test data test data test data test data";
+    int32_t test_data_len = (int32_t)strlen(test_data);
+
+    test_codec_created = 0;
+
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_DEFLATE;
+    file_info.filename = "test.txt";
+    if (!streamed)
+        file_info.uncompressed_size = test_data_len;
+
+    mz_zip_writer_create(&writer);
+    err = mz_zip_writer_open_file(writer, path, 0, 0);
+    if (err == MZ_OK)
+        err = mz_zip_writer_get_zip_handle(writer, &zip_handle);
+    if (err == MZ_OK)
+        err = mz_zip_set_codec(zip_handle, preferred);
+    if (err == MZ_OK && !streamed)
+        err = mz_zip_writer_add_buffer(writer, (void *)test_data, test_data_len, &file_info);
+    if (err == MZ_OK && streamed)
+    {
+        /* Size is not known until the entry is closed */
+        err = mz_zip_writer_entry_open(writer, &file_info);
+        if (err == MZ_OK && mz_zip_writer_entry_write(writer, test_data, test_data_len) != test_data_len)
+            err = MZ_WRITE_ERROR;
+        if (mz_zip_writer_entry_close(writer) != MZ_OK && err == MZ_OK)
+            err = MZ_CLOSE_ERROR;
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    mz_zip_reader_create(&reader);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_file(reader, path);
+    if (err == MZ_OK)
+        err = mz_zip_reader_get_zip_handle(reader, &zip_handle);
+    if (err == MZ_OK)
+        err = mz_zip_set_codec(zip_handle, preferred);
+    if (err == MZ_OK)
+        err = mz_zip_reader_locate_entry(reader, "test.txt", 0);
+    memset(temp, 0, sizeof(temp));
+    if (err == MZ_OK)
+        err = mz_zip_reader_entry_save_buffer(reader, temp, test_data_len);
+    if (err == MZ_OK && memcmp(temp, test_data, test_data_len) != 0)
+        err = MZ_FORMAT_ERROR;
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+
+    *created = test_codec_created;
+    return err;
+}
+
+int32_t test_zip_codec_registry(void)
+{
+    mz_zip_codec counted;
+    const mz_zip_codec *codec = NULL;
+    int32_t created = 0;
+    int32_t err = MZ_OK;
+
+    memset(&counted, 0, sizeof(counted));
+    counted.method = MZ_COMPRESS_METHOD_DEFLATE;
+    counted.name = "counted";
+    counted.create = test_codec_counted_create;
+    counted.flags = MZ_CODEC_COMPRESS | MZ_CODEC_DECOMPRESS | MZ_CODEC_STREAMING;
+    counted.priority = 1;
+
+    /* Registered codec outranks the built-in one for both writing and reading */
+    err = mz_zip_codec_register(&counted);
+    if (err == MZ_OK)
+        err = test_zip_codec_run(NULL, 0, &created);
+    if (err == MZ_OK && created != 2)
+        err = MZ_FORMAT_ERROR;
+
+    /* Preferred codec wins over priority */
+    if (err == MZ_OK)
+        err = test_zip_codec_run("zlib", 0, &created);
+    if (err == MZ_OK && created != 0)
+        err = MZ_FORMAT_ERROR;
+
+    /* Codec limited to small entries is skipped for larger ones */
+    counted.max_entry_size = 10;
+    if (err == MZ_OK)
+        err = mz_zip_codec_register(&counted);
+    if (err == MZ_OK)
+        err = test_zip_codec_run(NULL, 0, &created);
+    if (err == MZ_OK && created != 0)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK)
+        err = mz_zip_codec_find(MZ_COMPRESS_METHOD_DEFLATE, MZ_CODEC_COMPRESS, 10, NULL, &codec);
+    if (err == MZ_OK && strcmp(codec->name, "counted") != 0)
+        err = MZ_FORMAT_ERROR;
+
+    /* Entry written without a size could outgrow the limit so the codec is skipped */
+    if (err == MZ_OK)
+        err = test_zip_codec_run(NULL, 1, &created);
+    if (err == MZ_OK && created != 0)
+        err = MZ_FORMAT_ERROR;
+
+    /* Only codecs able to take a dictionary are found when one is needed */
+    if (err == MZ_OK)
+        err = mz_zip_codec_find(MZ_COMPRESS_METHOD_DEFLATE,
+            MZ_CODEC_COMPRESS | MZ_CODEC_DICTIONARY, 10, NULL, &codec);
+    if (err == MZ_OK && strcmp(codec->name, "zlib") != 0)
+        err = MZ_FORMAT_ERROR;
+    counted.flags |= MZ_CODEC_DICTIONARY;
+    if (err == MZ_OK && mz_zip_codec_register(&counted) != MZ_PARAM_ERROR)
+        err = MZ_FORMAT_ERROR;
+
+    if (mz_zip_codec_unregister(MZ_COMPRESS_METHOD_DEFLATE, "counted") != MZ_OK && err == MZ_OK)
+        err = MZ_EXIST_ERROR;
+    if (err == MZ_OK && mz_zip_codec_unregister(MZ_COMPRESS_METHOD_DEFLATE, "counted") != MZ_EXIST_ERROR)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && mz_zip_codec_find(0x7fff, MZ_CODEC_DECOMPRESS, 10, NULL, &codec) != MZ_SUPPORT_ERROR)
+        err = MZ_FORMAT_ERROR;
+
+    if (err == MZ_OK)
+        printf("Zip codec registry.. OK\n");
+    else
+        printf("Zip codec registry failed - %" PRId32 "\n", err);
+    return err;
+}
+
+int32_t test_zip_entry_seek(void)
+{
+    mz_zip_file file_info;
+    void *writer = NULL;
+    void *reader = NULL;
+    void *zip_handle = NULL;
+    void *index = NULL;
+    void *loaded = NULL;
+    void *mem_stream = NULL;
+    uint8_t *data = NULL;
+    uint8_t temp[1000];
+    uint32_t seed = 0x1b873593;
+    int64_t offsets[6];
+    int32_t data_size = 3 * 1024 * 1024;
+    int32_t span = 256 * 1024;
+    int32_t count = 0;
+    int32_t read = 0;
+    int32_t expected = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    const char *path = "seek.zip";
+
+
+    data = (uint8_t *)MZ_ALLOC(data_size);
+    if (data == NULL)
+        return MZ_MEM_ERROR;
+    for (i = 0; i < data_size; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)('a' + ((seed >> 24) % 24));
+    }
+
+    offsets[0] = 0;
+    offsets[1] = span - 1;
+    offsets[2] = data_size / 2 + 7;
+    offsets[3] = 17;
+    offsets[4] = data_size - (int64_t)sizeof(temp);
+    offsets[5] = data_size;
+
+    mz_zip_writer_create(&writer);
+    err = mz_zip_writer_open_file(writer, path, 0, 0);
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_DEFLATE;
+    file_info.filename = "large.txt";
+    file_info.uncompressed_size = data_size;
+    if (err == MZ_OK)
+        err = mz_zip_writer_add_buffer(writer, data, data_size, &file_info);
+    file_info.filename = "small.txt";
+    file_info.uncompressed_size = 100;
+    if (err == MZ_OK)
+        err = mz_zip_writer_add_buffer(writer, data, 100, &file_info);
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    mz_stream_zlib_index_create(&index);
+    mz_stream_zlib_index_create(&loaded);
+    mz_stream_mem_create(&mem_stream);
+    mz_stream_mem_set_grow_size(mem_stream, 128 * 1024);
+    mz_stream_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    mz_zip_reader_create(&reader);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_file(reader, path);
+    if (err == MZ_OK)
+        err = mz_zip_reader_get_zip_handle(reader, &zip_handle);
+
+    /* Index is built from one pass over the entry and survives a round trip */
+    if (err == MZ_OK)
+        err = mz_zip_reader_locate_entry(reader, "large.txt", 0);
+    if (err == MZ_OK)
+        err = mz_zip_entry_read_open(zip_handle, 0, NULL);
+    if (err == MZ_OK)
+        err = mz_zip_entry_build_index(zip_handle, index, span);
+    if (err == MZ_OK)
+        err = mz_stream_zlib_index_get_count(index, &count);
+    if (err == MZ_OK && count < data_size / span / 2)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK)
+        err = mz_stream_zlib_index_write(index, mem_stream);
+    if (err == MZ_OK)
+        err = mz_stream_seek(mem_stream, 0, MZ_SEEK_SET);
+    if (err == MZ_OK)
+        err = mz_stream_zlib_index_read(loaded, mem_stream);
+
+    /* Reads after seeking in any order match the data at that offset */
+    for (i = 0; i < (int32_t)(sizeof(offsets) / sizeof(offsets[0])) && err == MZ_OK; i += 1)
+    {
+        err = mz_zip_entry_seek(zip_handle, loaded, offsets[i]);
+        memset(temp, 0, sizeof(temp));
+        if (err == MZ_OK)
+            read = mz_zip_entry_read(zip_handle, temp, sizeof(temp));
+        if (err == MZ_OK && read < 0)
+            err = read;
+        expected = (int32_t)sizeof(temp);
+        if (data_size - offsets[i] < expected)
+            expected = (int32_t)(data_size - offsets[i]);
+        if (err == MZ_OK && read != expected)
+            err = MZ_FORMAT_ERROR;
+        if (err == MZ_OK && read > 0 && memcmp(temp, data + offsets[i], read) != 0)
+            err = MZ_FORMAT_ERROR;
+    }
+    if (mz_zip_entry_close(zip_handle) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+
+    /* Index of another entry is refused */
+    if (err == MZ_OK)
+        err = mz_zip_reader_locate_entry(reader, "small.txt", 0);
+    if (err == MZ_OK)
+        err = mz_zip_entry_read_open(zip_handle, 0, NULL);
+    if (err == MZ_OK && mz_zip_entry_seek(zip_handle, loaded, 10) != MZ_FORMAT_ERROR)
+        err = MZ_FORMAT_ERROR;
+    if (mz_zip_entry_close(zip_handle) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+
+    mz_stream_mem_close(mem_stream);
+    mz_stream_mem_delete(&mem_stream);
+    mz_stream_zlib_index_delete(&loaded);
+    mz_stream_zlib_index_delete(&index);
+    MZ_FREE(data);
+
+    if (err == MZ_OK)
+        printf("Zip entry seek.. OK\n");
+    else
+        printf("Zip entry seek failed - %" PRId32 "\n", err);
+    return err;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+int32_t test_zip_zstd_frames(void)
+{
+    mz_zip_file file_info;
+    void *writer = NULL;
+    void *reader = NULL;
+    void *zip_handle = NULL;
+    uint8_t *data = NULL;
+    uint8_t *temp = NULL;
+    uint32_t seed = 0x2545f491;
+    int64_t offsets[5];
+    int32_t data_size = 1024 * 1024 + 123;
+    int32_t frame_size = 64 * 1024;
+    int32_t read = 0;
+    int32_t expected = 0;
+    int32_t chunk = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    const char *path = "frames.zip";
+
+
+    data = (uint8_t *)MZ_ALLOC(data_size);
+    temp = (uint8_t *)MZ_ALLOC(data_size);
+    if (data == NULL || temp == NULL)
+    {
+        MZ_FREE(data);
+        MZ_FREE(temp);
+        return MZ_MEM_ERROR;
+    }
+    for (i = 0; i < data_size; i += 1)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)('a' + ((seed >> 24) % 24));
+    }
+
+    offsets[0] = 3 * frame_size + 5;
+    offsets[1] = 0;
+    offsets[2] = frame_size - 1;
+    offsets[3] = data_size - 1000;
+    offsets[4] = data_size;
+
+    /* First entry is split into frames, second one is a single frame */
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_frame_size(writer, frame_size);
+    err = mz_zip_writer_open_file(writer, path, 0, 0);
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_ZSTD;
+    file_info.filename = "framed.txt";
+    file_info.uncompressed_size = data_size;
+    if (err == MZ_OK)
+        err = mz_zip_writer_add_buffer(writer, data, data_size, &file_info);
+    if (err == MZ_OK)
+        err = mz_zip_writer_get_zip_handle(writer, &zip_handle);
+    if (err == MZ_OK)
+        err = mz_zip_set_frame_size(zip_handle, 0);
+    file_info.filename = "single.txt";
+    if (err == MZ_OK)
+        err = mz_zip_writer_add_buffer(writer, data, data_size, &file_info);
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    mz_zip_reader_create(&reader);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_file(reader, path);
+    if (err == MZ_OK)
+        err = mz_zip_reader_get_zip_handle(reader, &zip_handle);
+
+    /* Framed entry still decompresses front to back */
+    if (err == MZ_OK)
+        err = mz_zip_reader_locate_entry(reader, "framed.txt", 0);
+    memset(temp, 0, data_size);
+    if (err == MZ_OK)
+        err = mz_zip_reader_entry_save_buffer(reader, temp, data_size);
+    if (err == MZ_OK && memcmp(temp, data, data_size) != 0)
+        err = MZ_FORMAT_ERROR;
+
+    /* Ranges are decoded from the frame holding their start */
+    if (err == MZ_OK)
+        err = mz_zip_entry_read_open(zip_handle, 0, NULL);
+    for (i = 0; i < (int32_t)(sizeof(offsets) / sizeof(offsets[0])) && err == MZ_OK; i += 1)
+    {
+        err = mz_zip_entry_seek(zip_handle, NULL, offsets[i]);
+        expected = 2000;
+        if (data_size - offsets[i] < expected)
+            expected = (int32_t)(data_size - offsets[i]);
+        memset(temp, 0, expected + 1);
+        read = 0;
+        while (err == MZ_OK && read < expected)
+        {
+            chunk = mz_zip_entry_read(zip_handle, temp + read, expected - read);
+            if (chunk < 0)
+                err = chunk;
+            if (chunk <= 0)
+                break;
+            read += chunk;
+        }
+        if (err == MZ_OK && (read != expected || memcmp(temp, data + offsets[i], read) != 0))
+            err = MZ_FORMAT_ERROR;
+    }
+    if (mz_zip_entry_close(zip_handle) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+
+    /* Entry without a seek table can not be seeked */
+    if (err == MZ_OK)
+        err = mz_zip_reader_locate_entry(reader, "single.txt", 0);
+    if (err == MZ_OK)
+        err = mz_zip_entry_read_open(zip_handle, 0, NULL);
+    if (err == MZ_OK && mz_zip_entry_seek(zip_handle, NULL, 10) != MZ_SUPPORT_ERROR)
+        err = MZ_FORMAT_ERROR;
+    if (mz_zip_entry_close(zip_handle) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+
+    MZ_FREE(data);
+    MZ_FREE(temp);
+
+    if (err == MZ_OK)
+        printf("Zip zstd frames.. OK\n");
+    else
+        printf("Zip zstd frames failed - %" PRId32 "\n", err);
+    return err;
+}
+#endif
+
+int32_t test_zip_reader_sidecar_run(const char *path, int32_t entry_count, int32_t expect_sidecar)
+{
+    void *reader = NULL;
+    mz_zip_file *file_info = NULL;
+    char name[64];
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+    mz_zip_reader_create(&reader);
+    mz_zip_reader_set_sidecar(reader, 1);
+    err = mz_zip_reader_open_file(reader, path);
+    if (err == MZ_OK && (mz_zip_reader_has_sidecar(reader) == MZ_OK) != expect_sidecar)
+        err = MZ_EXIST_ERROR;
+
+    /* Every entry is found by its name from the back, ignoring case and slash direction */
+    for (i = entry_count - 1; i >= 0 && err == MZ_OK; i -= 7)
+    {
+        snprintf(name, sizeof(name), "Dir%" PRId32 "\\File%" PRId32 ".TXT", i % 10, i);
+        err = mz_zip_reader_locate_entry(reader, name, 1);
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_get_info(reader, &file_info);
+        snprintf(name, sizeof(name), "dir%" PRId32 "/file%" PRId32 ".txt", i % 10, i);
+        if (err == MZ_OK && strcmp(file_info->filename, name) != 0)
+            err = MZ_FORMAT_ERROR;
+        if (err == MZ_OK)
+            err = mz_zip_reader_locate_entry(reader, name, 0);
+    }
+    /* Names that differ only in case are not found when case matters */
+    if (err == MZ_OK && mz_zip_reader_locate_entry(reader, "DIR0/FILE0.TXT", 0) == MZ_OK)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && mz_zip_reader_locate_entry(reader, "missing.txt", 0) == MZ_OK)
+        err = MZ_FORMAT_ERROR;
+
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+    return err;
+}
+
+int32_t test_zip_reader_sidecar(void)
+{
+    mz_zip_file file_info;
+    void *writer = NULL;
+    void *reader = NULL;
+    char name[64];
+    int32_t entry_count = 500;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    int32_t round = 0;
+    time_t modified_date = 0;
+    const char *path = "sidecar.zip";
+    const char *sidecar_path = "sidecar.zip.mzi";
+
+
+    mz_os_unlink(sidecar_path);
+
+    for (round = 0; round < 2 && err == MZ_OK; round += 1)
+    {
+        /* Second round rewrites the archive with one entry less so the sidecar goes stale */
+        mz_zip_writer_create(&writer);
+        mz_zip_writer_set_compress_method(writer, MZ_COMPRESS_METHOD_STORE);
+        err = mz_zip_writer_open_file(writer, path, 0, 0);
+        memset(&file_info, 0, sizeof(file_info));
+        file_info.version_madeby = MZ_VERSION_MADEBY;
+        file_info.compression_method = MZ_COMPRESS_METHOD_STORE;
+        file_info.filename = name;
+        for (i = 0; i < entry_count - round && err == MZ_OK; i += 1)
+        {
+            snprintf(name, sizeof(name), "dir%" PRId32 "/file%" PRId32 ".txt", i % 10, i);
+            file_info.uncompressed_size = (int64_t)strlen(name);
+            err = mz_zip_writer_add_buffer(writer, name, (int32_t)strlen(name), &file_info);
+        }
+        if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+            err = MZ_CLOSE_ERROR;
+        mz_zip_writer_delete(&writer);
+
+        if (round == 0)
+        {
+            if (err == MZ_OK)
+                err = test_zip_reader_sidecar_run(path, entry_count, 0);
+
+            mz_zip_reader_create(&reader);
+            if (err == MZ_OK)
+                err = mz_zip_reader_open_file(reader, path);
+            if (err == MZ_OK)
+                err = mz_zip_reader_sidecar_save(reader);
+            mz_zip_reader_close(reader);
+            mz_zip_reader_delete(&reader);
+
+            if (err == MZ_OK)
+                err = test_zip_reader_sidecar_run(path, entry_count, 1);
+        }
+        else if (err == MZ_OK)
+        {
+            err = test_zip_reader_sidecar_run(path, entry_count - round, 0);
+        }
+    }
+
+    /* Renaming an entry to a name of the same length keeps the archive size, restoring the
+       date leaves the central directory contents as the only difference */
+    for (round = 0; round < 2 && err == MZ_OK; round += 1)
+    {
+        mz_zip_writer_create(&writer);
+        mz_zip_writer_set_compress_method(writer, MZ_COMPRESS_METHOD_STORE);
+        err = mz_zip_writer_open_file(writer, path, 0, 0);
+        memset(&file_info, 0, sizeof(file_info));
+        file_info.version_madeby = MZ_VERSION_MADEBY;
+        file_info.compression_method = MZ_COMPRESS_METHOD_STORE;
+        file_info.filename = name;
+        for (i = 0; i < 20 && err == MZ_OK; i += 1)
+        {
+            snprintf(name, sizeof(name), "file%02" PRId32 ".txt", i);
+            if (round == 1 && i == 7)
+                strncpy(name, "rename.txt", sizeof(name));
+            file_info.uncompressed_size = (int64_t)strlen(name);
+            err = mz_zip_writer_add_buffer(writer, name, (int32_t)strlen(name), &file_info);
+        }
+        if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+            err = MZ_CLOSE_ERROR;
+        mz_zip_writer_delete(&writer);
+
+        if (round == 0)
+        {
+            if (err == MZ_OK)
+                err = mz_os_get_file_date(path, &modified_date, NULL, NULL);
+            mz_zip_reader_create(&reader);
+            if (err == MZ_OK)
+                err = mz_zip_reader_open_file(reader, path);
+            if (err == MZ_OK)
+                err = mz_zip_reader_sidecar_save(reader);
+            mz_zip_reader_close(reader);
+            mz_zip_reader_delete(&reader);
+        }
+        else if (err == MZ_OK)
+        {
+            err = mz_os_set_file_date(path, modified_date, modified_date, 0);
+
+            mz_zip_reader_create(&reader);
+            mz_zip_reader_set_sidecar(reader, 1);
+            if (err == MZ_OK)
+                err = mz_zip_reader_open_file(reader, path);
+            if (err == MZ_OK && mz_zip_reader_has_sidecar(reader) == MZ_OK)
+                err = MZ_EXIST_ERROR;
+            if (err == MZ_OK)
+                err = mz_zip_reader_locate_entry(reader, "rename.txt", 0);
+            if (err == MZ_OK && mz_zip_reader_locate_entry(reader, "file07.txt", 0) == MZ_OK)
+                err = MZ_FORMAT_ERROR;
+            mz_zip_reader_close(reader);
+            mz_zip_reader_delete(&reader);
+        }
+    }
+
+    mz_os_unlink(sidecar_path);
+
+    if (err == MZ_OK)
+        printf("Zip reader sidecar.. OK\n");
+    else
+        printf("Zip reader sidecar failed - %" PRId32 "\n", err);
+    return err;
+}
+
+static int32_t test_zip_entry_read_at_sizes(void)
+{
+    mz_zip_file file_info;
+    void *mem_stream = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    uint8_t *zip_buf = NULL;
+    uint8_t data[1000];
+    uint8_t buf[4096];
+    const char *names[2] = { "first.bin", "second.bin" };
+    int32_t zip_size = 0;
+    int32_t patched = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    mz_stream_mem_create(&mem_stream);
+    mz_stream_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_compress_method(writer, MZ_COMPRESS_METHOD_STORE);
+    err = mz_zip_writer_open(writer, mem_stream);
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_STORE;
+    file_info.uncompressed_size = sizeof(data);
+    for (i = 0; i < 2 && err == MZ_OK; i += 1)
+    {
+        memset(data, 'a' + i, sizeof(data));
+        file_info.filename = names[i];
+        err = mz_zip_writer_add_buffer(writer, data, sizeof(data), &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    mz_stream_mem_get_buffer(mem_stream, (const void **)&zip_buf);
+    mz_stream_mem_seek(mem_stream, 0, MZ_SEEK_END);
+    zip_size = (int32_t)mz_stream_mem_tell(mem_stream);
+
+    /* Central directory claims the first entry is larger than the data stored for it */
+    for (i = 0; i + 46 + 9 < zip_size && err == MZ_OK; i += 1)
+    {
+        if (memcmp(zip_buf + i, "PK\1\2", 4) != 0 || memcmp(zip_buf + i + 46, names[0], 9) != 0)
+            continue;
+        zip_buf[i + 24] = (uint8_t)(2000 & 0xff);
+        zip_buf[i + 25] = (uint8_t)(2000 >> 8);
+        patched = 1;
+        break;
+    }
+    if (err == MZ_OK && !patched)
+        err = MZ_FORMAT_ERROR;
+
+    mz_zip_reader_create(&reader);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_buffer(reader, zip_buf, zip_size, 0);
+    if (err == MZ_OK)
+        err = mz_zip_reader_locate_entry(reader, names[0], 0);
+    if (err == MZ_OK && mz_zip_reader_entry_open(reader) == MZ_OK)
+    {
+        if (mz_zip_reader_entry_read_at(reader, 0, buf, sizeof(buf)) != MZ_FORMAT_ERROR)
+            err = MZ_FORMAT_ERROR;
+        mz_zip_reader_entry_close(reader);
+    }
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+
+    mz_stream_mem_delete(&mem_stream);
+    return err;
+}
+
+int32_t test_zip_entry_read_at(void)
+{
+    mz_zip_file file_info;
+    void *writer = NULL;
+    void *reader = NULL;
+    uint8_t *data = NULL;
+    uint8_t buf[4096];
+    int64_t offsets[4];
+    int32_t data_size = 300 * 1024 + 17;
+    int32_t read = 0;
+    int32_t expected = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    int32_t in_memory = 0;
+    const char *path = "readat.zip";
+
+
+    data = (uint8_t *)MZ_ALLOC(data_size);
+    if (data == NULL)
+        return MZ_MEM_ERROR;
+    for (i = 0; i < data_size; i += 1)
+        data[i] = (uint8_t)((i * 7) ^ (i >> 9));
+
+    offsets[0] = 123457;
+    offsets[1] = 0;
+    offsets[2] = data_size - 100;
+    offsets[3] = 4096 * 5;
+
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_compress_method(writer, MZ_COMPRESS_METHOD_STORE);
+    err = mz_zip_writer_open_file(writer, path, 0, 0);
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_STORE;
+    file_info.filename = "media.bin";
+    file_info.uncompressed_size = data_size;
+    if (err == MZ_OK)
+        err = mz_zip_writer_add_buffer(writer, data, data_size, &file_info);
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    /* Archive is read from the file and from memory */
+    mz_zip_reader_create(&reader);
+    for (in_memory = 0; in_memory <= 1 && err == MZ_OK; in_memory += 1)
+    {
+        if (in_memory)
+            err = mz_zip_reader_open_file_in_memory(reader, path);
+        else
+            err = mz_zip_reader_open_file(reader, path);
+        if (err == MZ_OK)
+            err = mz_zip_reader_locate_entry(reader, "media.bin", 0);
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_open(reader);
+
+        for (i = 0; i < (int32_t)(sizeof(offsets) / sizeof(offsets[0])) && err == MZ_OK; i += 1)
+        {
+            expected = sizeof(buf);
+            if (data_size - offsets[i] < expected)
+                expected = (int32_t)(data_size - offsets[i]);
+            read = mz_zip_reader_entry_read_at(reader, offsets[i], buf, sizeof(buf));
+            if (read != expected || memcmp(buf, data + offsets[i], read) != 0)
+                err = MZ_FORMAT_ERROR;
+        }
+        if (err == MZ_OK && mz_zip_reader_entry_read_at(reader, data_size, buf, sizeof(buf)) != 0)
+            err = MZ_FORMAT_ERROR;
+
+        /* Sequential reads are not moved by positional reads */
+        expected = 0;
+        while (err == MZ_OK)
+        {
+            read = mz_zip_reader_entry_read(reader, buf, sizeof(buf));
+            if (read < 0)
+                err = read;
+            if (read <= 0)
+                break;
+            if (expected + read > data_size || memcmp(buf, data + expected, read) != 0)
+                err = MZ_FORMAT_ERROR;
+            expected += read;
+        }
+        if (err == MZ_OK && expected != data_size)
+            err = MZ_FORMAT_ERROR;
+
+        if (mz_zip_reader_entry_close(reader) != MZ_OK && err == MZ_OK)
+            err = MZ_CLOSE_ERROR;
+        mz_zip_reader_close(reader);
+    }
+    mz_zip_reader_delete(&reader);
+
+    MZ_FREE(data);
+
+    if (err == MZ_OK)
+        err = test_zip_entry_read_at_sizes();
+
+    if (err == MZ_OK)
+        printf("Zip entry read at.. OK\n");
+    else
+        printf("Zip entry read at failed - %" PRId32 "\n", err);
+    return err;
+}
+
+void test_zip_recover_cd_cb(void *handle, void *userdata, const mz_zip_recover_progress *progress)
+{
+    mz_zip_recover_progress *last = (mz_zip_recover_progress *)userdata;
+    MZ_UNUSED(handle);
+    /* Nothing is reported after the last report */
+    if (last->finished)
+        last->finished = 2;
+    else
+        *last = *progress;
+}
+
+int32_t test_zip_recover_cd(void)
+{
+    mz_zip_recover_progress progress;
+    mz_zip_file file_info;
+    mz_zip_file *entry_info = NULL;
+    void *write_mem_stream = NULL;
+    void *read_mem_stream = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    const uint8_t *zip_buf = NULL;
+    uint8_t *data = NULL;
+    uint8_t *temp = NULL;
+    const char *names[3] = { "first.txt", "big.bin", "last.txt" };
+    int32_t sizes[3] = { 1000, 9 * 1024 * 1024 + 123, 77 };
+    int32_t zip_size = 0;
+    int32_t err = MZ_OK;
+    int32_t threads = 0;
+    int32_t i = 0;
+
+
+    data = (uint8_t *)MZ_ALLOC(sizes[1]);
+    temp = (uint8_t *)MZ_ALLOC(sizes[1]);
+    if (data == NULL || temp == NULL)
+    {
+        MZ_FREE(data);
+        MZ_FREE(temp);
+        return MZ_MEM_ERROR;
+    }
+    for (i = 0; i < sizes[1]; i += 1)
+        data[i] = (uint8_t)('a' + ((i * 13) ^ (i >> 11)) % 26);
+    /* Signatures inside entry data must not be taken for headers */
+    for (i = 4096; i + 4 < sizes[1]; i += 1000003)
+    {
+        memcpy(data + i, "PK\3\4", 4);
+        memcpy(data + i + 100, "PK\1\2", 4);
+    }
+
+    mz_stream_mem_create(&write_mem_stream);
+    mz_stream_mem_set_grow_size(write_mem_stream, 128 * 1024);
+    mz_stream_open(write_mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_compress_method(writer, MZ_COMPRESS_METHOD_STORE);
+    err = mz_zip_writer_open(writer, write_mem_stream);
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_STORE;
+    for (i = 0; i < 3 && err == MZ_OK; i += 1)
+    {
+        file_info.filename = names[i];
+        file_info.uncompressed_size = sizes[i];
+        err = mz_zip_writer_add_buffer(writer, data, sizes[i], &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    /* Cut off the end of central directory record so the central directory is not found */
+    mz_stream_mem_get_buffer(write_mem_stream, (const void **)&zip_buf);
+    mz_stream_mem_seek(write_mem_stream, 0, MZ_SEEK_END);
+    zip_size = (int32_t)mz_stream_mem_tell(write_mem_stream) - 22;
+
+    mz_stream_mem_create(&read_mem_stream);
+    mz_stream_mem_set_buffer(read_mem_stream, (void *)zip_buf, zip_size);
+    mz_stream_open(read_mem_stream, NULL, MZ_OPEN_MODE_READ);
+
+    mz_zip_reader_create(&reader);
+    mz_zip_reader_set_recover(reader, 0);
+    if (err == MZ_OK && mz_zip_reader_open(reader, read_mem_stream) == MZ_OK)
+        err = MZ_FORMAT_ERROR;
+    mz_zip_reader_close(reader);
+
+    /* Recover on the calling thread and then with the archive scanned in parts on threads */
+    for (threads = 1; threads <= 3 && err == MZ_OK; threads += 2)
+    {
+        memset(&progress, 0, sizeof(progress));
+        mz_zip_reader_set_recover(reader, 1);
+        mz_zip_reader_set_recover_cb(reader, &progress, test_zip_recover_cd_cb);
+        mz_zip_reader_set_recover_threads(reader, threads);
+        err = mz_zip_reader_open(reader, read_mem_stream);
+        if (err == MZ_OK && (progress.finished != 1 || progress.entries != 3 ||
+            progress.position != zip_size || progress.total != zip_size))
+            err = MZ_FORMAT_ERROR;
+
+        for (i = 0; i < 3 && err == MZ_OK; i += 1)
+        {
+            err = (i == 0) ? mz_zip_reader_goto_first_entry(reader) : mz_zip_reader_goto_next_entry(reader);
+            if (err == MZ_OK)
+                err = mz_zip_reader_entry_get_info(reader, &entry_info);
+            if (err == MZ_OK && (strcmp(entry_info->filename, names[i]) != 0 ||
+                entry_info->uncompressed_size != sizes[i]))
+                err = MZ_FORMAT_ERROR;
+            if (err == MZ_OK)
+                err = mz_zip_reader_entry_save_buffer(reader, temp, sizes[i]);
+            if (err == MZ_OK && memcmp(temp, data, sizes[i]) != 0)
+                err = MZ_CRC_ERROR;
+        }
+        if (err == MZ_OK && mz_zip_reader_goto_next_entry(reader) != MZ_END_OF_LIST)
+            err = MZ_FORMAT_ERROR;
+
+        mz_zip_reader_close(reader);
+    }
+    mz_zip_reader_delete(&reader);
+
+    mz_stream_mem_delete(&read_mem_stream);
+    mz_stream_mem_delete(&write_mem_stream);
+
+    MZ_FREE(data);
+    MZ_FREE(temp);
+
+    if (err == MZ_OK)
+        printf("Zip recover cd.. OK\n");
+    else
+        printf("Zip recover cd failed - %" PRId32 "\n", err);
+    return err;
+}
+
+int32_t test_zip_split_disks(void)
+{
+    mz_zip_file file_info;
+    void *writer = NULL;
+    void *reader = NULL;
+    uint8_t data[20000];
+    uint8_t temp[20000];
+    char name[32];
+    char part_path[32];
+    int32_t count = 30;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    int32_t x = 0;
+
+
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_STORE;
+    file_info.filename = name;
+    file_info.uncompressed_size = sizeof(data);
+
+    /* Write more disks than there are handles kept open while reading */
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_compress_method(writer, MZ_COMPRESS_METHOD_STORE);
+    err = mz_zip_writer_open_file(writer, "split.zip", 64 * 1024, 0);
+    for (i = 0; i < count && err == MZ_OK; i += 1)
+    {
+        for (x = 0; x < (int32_t)sizeof(data); x += 1)
+            data[x] = (uint8_t)(i * 31 + x);
+        snprintf(name, sizeof(name), "file%" PRId32 ".bin", i);
+        err = mz_zip_writer_add_buffer(writer, data, sizeof(data), &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    if (err == MZ_OK && mz_os_file_exists("split.z09") != MZ_OK)
+        err = MZ_FORMAT_ERROR;
+
+    /* Read the entries out of order so disks are switched back and forth */
+    mz_zip_reader_create(&reader);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_file(reader, "split.zip");
+    for (i = 0; i < count && err == MZ_OK; i += 1)
+    {
+        snprintf(name, sizeof(name), "file%" PRId32 ".bin", (i * 17) % count);
+        err = mz_zip_reader_locate_entry(reader, name, 0);
+        if (err == MZ_OK)
+            err = mz_zip_reader_entry_save_buffer(reader, temp, sizeof(temp));
+        for (x = 0; x < (int32_t)sizeof(temp) && err == MZ_OK; x += 1)
+        {
+            if (temp[x] != (uint8_t)(((i * 17) % count) * 31 + x))
+                err = MZ_CRC_ERROR;
+        }
+    }
+    if (mz_zip_reader_close(reader) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_reader_delete(&reader);
+
+    for (i = 1; i < 100; i += 1)
+    {
+        snprintf(part_path, sizeof(part_path), "split.z%02" PRId32, i);
+        if (mz_os_unlink(part_path) != MZ_OK)
+            break;
+    }
+
+    if (err == MZ_OK)
+        printf("Zip split disks.. OK\n");
+    else
+        printf("Zip split disks failed - %" PRId32 "\n", err);
+    return err;
+}
+
+void test_zip_reader_test_all_cb(void *handle, void *userdata, mz_zip_file *file_info, int32_t result)
+{
+    int32_t *failed_b = (int32_t *)userdata;
+    MZ_UNUSED(handle);
+    if (result != MZ_OK && strcmp(file_info->filename, "b.txt") == 0)
+        *failed_b += 1;
+}
+
+int32_t test_zip_reader_test_all(void)
+{
+    mz_zip_reader_test_result result;
+    mz_zip_file file_info;
+    void *mem_stream = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    uint8_t *zip_buf = NULL;
+    uint8_t data[2000];
+    void *file_stream = NULL;
+    const char *names[5] = { "a.txt", "dir/", "empty.txt", "b.txt", "c.txt" };
+    const char *path = "testall.zip";
+    int32_t sizes[5] = { 1000, 0, 0, 2000, 500 };
+    int32_t failed_b = 0;
+    int32_t zip_size = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    mz_stream_mem_create(&mem_stream);
+    mz_stream_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+    mz_zip_writer_create(&writer);
+    mz_zip_writer_set_compress_method(writer, MZ_COMPRESS_METHOD_STORE);
+    err = mz_zip_writer_open(writer, mem_stream);
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_STORE;
+    for (i = 0; i < 5 && err == MZ_OK; i += 1)
+    {
+        memset(data, names[i][0], sizeof(data));
+        file_info.filename = names[i];
+        file_info.uncompressed_size = sizes[i];
+        err = mz_zip_writer_add_buffer(writer, data, sizes[i], &file_info);
+    }
+    if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+        err = MZ_CLOSE_ERROR;
+    mz_zip_writer_delete(&writer);
+
+    mz_stream_mem_get_buffer(mem_stream, (const void **)&zip_buf);
+    mz_stream_mem_seek(mem_stream, 0, MZ_SEEK_END);
+    zip_size = (int32_t)mz_stream_mem_tell(mem_stream);
+
+    /* Change one byte in the middle of the data of the second file */
+    for (i = 0; i + 100 < zip_size && err == MZ_OK; i += 1)
+    {
+        if (memcmp(zip_buf + i, "bbbbbbbbbbbbbbbb", 16) == 0)
+        {
+            zip_buf[i + 100] = 'x';
+            break;
+        }
+    }
+
+    mz_zip_reader_create(&reader);
+    mz_zip_reader_set_test_cb(reader, &failed_b, test_zip_reader_test_all_cb);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_buffer(reader, zip_buf, zip_size, 0);
+    if (err == MZ_OK && mz_zip_reader_test_all(reader, &result) != MZ_CRC_ERROR)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && (result.entries != 3 || result.skipped != 2 || result.failed != 1 ||
+        result.bytes != sizes[0] + sizes[4] || failed_b != 1))
+        err = MZ_FORMAT_ERROR;
+#ifndef MZ_ZIP_NO_ENCRYPTION
+    if (err == MZ_OK && result.hashed != 3)
+        err = MZ_FORMAT_ERROR;
+#endif
+    mz_zip_reader_close(reader);
+
+    /* Checking on threads gives the same results for an archive opened by path */
+    mz_stream_os_create(&file_stream);
+    if (err == MZ_OK)
+        err = mz_stream_os_open(file_stream, path, MZ_OPEN_MODE_CREATE | MZ_OPEN_MODE_WRITE);
+    if (err == MZ_OK && mz_stream_os_write(file_stream, zip_buf, zip_size) != zip_size)
+        err = MZ_WRITE_ERROR;
+    mz_stream_os_close(file_stream);
+    mz_stream_os_delete(&file_stream);
+
+    failed_b = 0;
+    mz_zip_reader_set_test_threads(reader, 3);
+    if (err == MZ_OK)
+        err = mz_zip_reader_open_file(reader, path);
+    if (err == MZ_OK && mz_zip_reader_test_all(reader, &result) != MZ_CRC_ERROR)
+        err = MZ_FORMAT_ERROR;
+    if (err == MZ_OK && (result.entries != 3 || result.skipped != 2 || result.failed != 1 ||
+        result.bytes != sizes[0] + sizes[4] || failed_b != 1))
+        err = MZ_FORMAT_ERROR;
+#ifndef MZ_ZIP_NO_ENCRYPTION
+    if (err == MZ_OK && result.hashed != 3)
+        err = MZ_FORMAT_ERROR;
+#endif
+    mz_zip_reader_close(reader);
+    mz_zip_reader_delete(&reader);
+    mz_os_unlink(path);
+
+    mz_stream_mem_delete(&mem_stream);
+
+    if (err == MZ_OK)
+        printf("Zip reader test all.. OK\n");
+    else
+        printf("Zip reader test all failed - %" PRId32 "\n", err);
+    return err;
+}
+
+int32_t test_zip_writer_hash_algorithm(void)
+{
+    mz_zip_reader_test_result result;
+    mz_zip_file file_info;
+    void *mem_stream = NULL;
+    void *writer = NULL;
+    void *reader = NULL;
+    uint8_t *zip_buf = NULL;
+    uint8_t data[5000];
+    uint16_t algorithms[3] = { 0, MZ_HASH_SHA1, MZ_HASH_SHA256 };
+    uint16_t digest_sizes[3] = { 0, MZ_HASH_SHA1_SIZE, MZ_HASH_SHA256_SIZE };
+    uint16_t algorithm = 0;
+    uint16_t digest_size = 0;
+    int32_t zip_size = 0;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+
+
+    for (i = 0; i < (int32_t)sizeof(data); i += 1)
+        data[i] = (uint8_t)(i * 7);
+
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.version_madeby = MZ_VERSION_MADEBY;
+    file_info.compression_method = MZ_COMPRESS_METHOD_STORE;
+    file_info.filename = "data.bin";
+    file_info.uncompressed_size = sizeof(data);
+
+    mz_zip_writer_create(&writer);
+    if (mz_zip_writer_set_hash_algorithm(writer, MZ_HASH_MD5) != MZ_PARAM_ERROR)
+        err = MZ_FORMAT_ERROR;
+
+    for (i = 0; i < 3 && err == MZ_OK; i += 1)
+    {
+        mz_stream_mem_create(&mem_stream);
+        mz_stream_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+        mz_zip_writer_set_compress_method(writer, MZ_COMPRESS_METHOD_STORE);
+        err = mz_zip_writer_set_hash_algorithm(writer, algorithms[i]);
+        if (err == MZ_OK)
+            err = mz_zip_writer_open(writer, mem_stream);
+        if (err == MZ_OK)
+            err = mz_zip_writer_add_buffer(writer, data, sizeof(data), &file_info);
+        if (mz_zip_writer_close(writer) != MZ_OK && err == MZ_OK)
+            err = MZ_CLOSE_ERROR;
+
+        mz_stream_mem_get_buffer(mem_stream, (const void **)&zip_buf);
+        mz_stream_mem_seek(mem_stream, 0, MZ_SEEK_END);
+        zip_size = (int32_t)mz_stream_mem_tell(mem_stream);
+
+        /* The hash stored is the one set, and it is checked when the entry is read */
+        mz_zip_reader_create(&reader);
+        if (err == MZ_OK)
+            err = mz_zip_reader_open_buffer(reader, zip_buf, zip_size, 0);
+        if (err == MZ_OK)
+            err = mz_zip_reader_goto_first_entry(reader);
+        if (err == MZ_OK)
+        {
+            algorithm = 0;
+            digest_size = 0;
+            mz_zip_reader_entry_get_first_hash(reader, &algorithm, &digest_size);
+            if (algorithm != algorithms[i] || digest_size != digest_sizes[i])
+                err = MZ_FORMAT_ERROR;
+        }
+        if (err == MZ_OK)
+            err = mz_zip_reader_test_all(reader, &result);
+        if (err == MZ_OK && (result.entries != 1 || result.hashed != (algorithms[i] != 0 ? 1 : 0)))
+            err = MZ_FORMAT_ERROR;
+        mz_zip_reader_close(reader);
+        mz_zip_reader_delete(&reader);
+
+        mz_stream_mem_delete(&mem_stream);
+    }
+
+    mz_zip_writer_delete(&writer);
+
+    if (err == MZ_OK)
+        printf("Zip writer hash algorithm.. OK\n");
+    else
+        printf("Zip writer hash algorithm failed - %" PRId32 "\n", err);
+    return err;
+}
+
+/***************************************************************************/
+
+int32_t test_stream_find_run(char *name, int32_t count, const uint8_t *find, int32_t find_size, mz_stream_find_cb find_cb)
+{
+    void *mem_stream = NULL;
+    int32_t i = 0;
+    int32_t x = 0;
+    int32_t err = MZ_OK;
+    int64_t last_pos = 0;
+    int64_t position = 0;
+
+    MZ_UNUSED(name);
+
+    if (find == NULL || find_size == 0 || find_cb == NULL)
+        return MZ_PARAM_ERROR;
+
+    for (i = 0; i < count; i += 1)
+    {
+#if 1
+        mz_stream_mem_create(&mem_stream);
+        mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+        for (x = 0; x < find_size; x += 1)
+            mz_stream_write_uint8(mem_stream, find[x]);
+        for (x = 0; x < i; x += 1)
+            mz_stream_write_uint8(mem_stream, 0);
+
+        if (find_cb == mz_stream_find)
+            mz_stream_seek(mem_stream, 0, MZ_SEEK_SET);
+
+        err = find_cb(mem_stream, (const void *)find, find_size, (int64_t)i + find_size, &position);
+        last_pos = mz_stream_tell(mem_stream);
+        mz_stream_mem_delete(&mem_stream);
+
+#ifdef TEST_VERBOSE
+        printf("Find postzero - %s (len %" PRId32 " pos %" PRId64 " ok %" PRId32 ")\n",
+            name, find_size, position, (position == 0));
+#endif
+
+        if (position != 0 || last_pos != position)
+            break;
+#endif
+        mz_stream_mem_create(&mem_stream);
+        mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+        for (x = 0; x < i; x += 1)
+            mz_stream_write_uint8(mem_stream, 0);
+        for (x = 0; x < find_size; x += 1)
+            mz_stream_write_uint8(mem_stream, find[x]);
+
+        if (find_cb == mz_stream_find)
+            mz_stream_seek(mem_stream, 0, MZ_SEEK_SET);
+
+        err = find_cb(mem_stream, (const void *)find, find_size, (int64_t)i + find_size, &position);
+        last_pos = mz_stream_tell(mem_stream);
+        mz_stream_mem_delete(&mem_stream);
+
+#ifdef TEST_VERBOSE
+        printf("Find prezero - %s (len %" PRId32 " pos %" PRId64 " ok %" PRId32 ")\n",
+            name, find_size, position, (position == i));
+#endif
+
+        if (position != i || last_pos != position)
+            break;
+
+        mz_stream_mem_create(&mem_stream);
+        mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+        for (x = 0; x < i; x += 1)
+            mz_stream_write_uint8(mem_stream, 0);
+        for (x = 0; x < find_size; x += 1)
+            mz_stream_write_uint8(mem_stream, find[x]);
+        for (x = 0; x < i; x += 1)
+            mz_stream_write_uint8(mem_stream, 0);
+
+        if (find_cb == mz_stream_find)
+            mz_stream_seek(mem_stream, 0, MZ_SEEK_SET);
+
+        err = find_cb(mem_stream, (const void *)find, find_size, (int64_t)i + find_size + i, &position);
+        last_pos = mz_stream_tell(mem_stream);
+        mz_stream_mem_delete(&mem_stream);
+
+#ifdef TEST_VERBOSE
+        printf("Find equalzero - %s (len %" PRId32 " pos %" PRId64 " ok %" PRId32 ")\n",
+            name, find_size, position, (position == i));
+#endif
+
+        if (position != i || last_pos != position)
+            break;
+
+        mz_stream_mem_create(&mem_stream);
+        mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_CREATE);
+
+        for (x = 0; x < i; x += 1)
+            mz_stream_write_uint8(mem_stream, 0);
+        for (x = 0; x < find_size; x += 1)
+            mz_stream_write_uint8(mem_stream, find[x]);
+        for (x = 0; x < i; x += 1)
+            mz_stream_write_uint8(mem_stream, 0);
+        mz_stream_write_uint8(mem_stream, 0);
+
+        if (find_cb == mz_stream_find)
+            mz_stream_seek(mem_stream, 0, MZ_SEEK_SET);
+
+        err = find_cb(mem_stream, (const void *)find, find_size, (int64_t)i + find_size + i + 1, &position);
+        last_pos = mz_stream_tell(mem_stream);
+        mz_stream_mem_delete(&mem_stream);
+
+#ifdef TEST_VERBOSE
+        printf("Find unequalzero - %s (len %" PRId32 " pos %" PRId64 " ok %" PRId32 ")\n",
+            name, find_size, position, (position == i));
+#endif
+
+        if (position != i || last_pos != position)
+            break;
+    }
+
+    return err;
+}
+
+int32_t test_stream_find_window(const char *name, mz_stream_find_cb find_cb)
+{
+    void *mem_stream = NULL;
+    uint8_t *buf = NULL;
+    const uint8_t find[4] = { 'P', 'K', 5, 6 };
+    int64_t offsets[6] = { 0, 1021, 65533, 65536, 131070, 299996 };
+    int64_t position = 0;
+    int64_t max_seek = 0;
+    int32_t buf_size = 300000;
+    int32_t err = MZ_OK;
+    int32_t i = 0;
+    int32_t x = 0;
+
+    /* Partial signatures everywhere so the first byte matches at every other position */
+    buf = (uint8_t *)MZ_ALLOC(buf_size);
+    if (buf == NULL)
+        return MZ_MEM_ERROR;
+    for (x = 0; x < buf_size; x += 1)
+        buf[x] = (x & 1) ? 'K' : 'P';
+
+    for (i = 0; i < 6 && err == MZ_OK; i += 1)
+    {
+        memcpy(buf + offsets[i], find, sizeof(find));
+
+        mz_stream_mem_create(&mem_stream);
+        mz_stream_mem_set_buffer(mem_stream, buf, buf_size);
+        mz_stream_mem_open(mem_stream, NULL, MZ_OPEN_MODE_READ);
+
+        /* Found with just enough room, not found with a byte less, across window boundaries */
+        for (x = 0; x < 2 && err == MZ_OK; x += 1)
+        {
+            if (find_cb == mz_stream_find)
+            {
+                mz_stream_seek(mem_stream, 0, MZ_SEEK_SET);
+                max_seek = offsets[i] + sizeof(find) - x;
+            }
+            else
+            {
+                mz_stream_seek(mem_stream, 0, MZ_SEEK_END);
+                max_seek = buf_size - offsets[i] - x;
+            }
+
+            err = find_cb(mem_stream, find, sizeof(find), max_seek, &position);
+            if (x == 0 && (err != MZ_OK || position != offsets[i] || mz_stream_tell(mem_stream) != position))
+                err = MZ_FORMAT_ERROR;
+            else if (x == 1)
+                err = (err == MZ_EXIST_ERROR) ? MZ_OK : MZ_FORMAT_ERROR;
+        }
+        if (err == MZ_OK)
+        {
+            /* Found from anywhere with no limit */
+            if (find_cb == mz_stream_find)
+                mz_stream_seek(mem_stream, 0, MZ_SEEK_SET);
+            else
+                mz_stream_seek(mem_stream, 0, MZ_SEEK_END);
+            err = find_cb(mem_stream, find, sizeof(find), INT64_MAX, &position);
+            if (err == MZ_OK && position != offsets[i])
+                err = MZ_FORMAT_ERROR;
+        }
+
+        mz_stream_mem_delete(&mem_stream);
+
+#ifdef TEST_VERBOSE
+        printf("Find window - %s (pos %" PRId64 " ok %" PRId32 ")\n", name, offsets[i], (err == MZ_OK));
+#else
+        MZ_UNUSED(name);
+#endif
+
+        memcpy(buf + offsets[i], "PKPK", sizeof(find));
+    }
+
+    MZ_FREE(buf);
+    return err;
+}
+
+int32_t test_stream_find(void)
+{
+    int32_t c = 1;
+    int32_t err = MZ_OK;
+    char *find = "0123456789";
+
+    printf("Find stream.. ");
+    for (c = 1; c < (int32_t)strlen(find); c += 1)
+    {
+        err = test_stream_find_run("forward", 2096, (uint8_t *)find, c, mz_stream_find);
+        if (err != MZ_OK)
+            return err;
+    }
+    err = test_stream_find_window("forward", mz_stream_find);
+    if (err != MZ_OK)
+        return err;
+
+    printf("OK\n");
+    return MZ_OK;
+}
+
+int32_t test_stream_find_reverse(void)
+{
+    int32_t c = 1;
+    int32_t err = MZ_OK;
+    char *find = "0123456789";
+
+    printf("Find reverse stream.. ");
+    for (c = 1; c < (int32_t)strlen(find); c += 1)
+    {
+        err = test_stream_find_run("backward", 2096, (uint8_t *)find, c, mz_stream_find_reverse);
+        if (err != MZ_OK)
+            return err;
+    }
+    err = test_stream_find_window("backward", mz_stream_find_reverse);
+    if (err != MZ_OK)
+        return err;
+
+    printf("OK\n");
+    return MZ_OK;
+}
+
+/***************************************************************************/
+
+int32_t convert_buffer_to_hex_string(uint8_t *buf, int32_t buf_size, char *hex_string, int32_t max_hex_string)
+{
+    int32_t p = 0;
+    int32_t i = 0;
+
+    if (max_hex_string > 0)
+        hex_string[0] = 0;
+    for (i = 0, p = 0; i < (int32_t)buf_size && p < max_hex_string; i += 1, p += 2)
+        snprintf(hex_string + p, max_hex_string - p, "%02x", buf[i]);
+    if (p < max_hex_string)
+        hex_string[p] = 0;
+    return MZ_OK;
+}
+
+#ifndef MZ_ZIP_NO_ENCRYPTION
+int32_t test_crypt_sha(void)
+{
+    void *sha1 = NULL;
+    void *sha256 = NULL;
+    char *test = "the quick and lazy fox did his thang";
+    char computed_hash[320];
+    uint8_t hash[MZ_HASH_SHA1_SIZE];
+    uint8_t hash256[MZ_HASH_SHA256_SIZE];
+
+    printf("Sha hash input - %s\n", test);
+
+    memset(hash, 0, sizeof(hash));
+
+    mz_crypt_sha_create(&sha1);
+    mz_crypt_sha_set_algorithm(sha1, MZ_HASH_SHA1);
+    mz_crypt_sha_begin(sha1);
+    mz_crypt_sha_update(sha1, test, (int32_t)strlen(test));
+    mz_crypt_sha_end(sha1, hash, sizeof(hash));
+    mz_crypt_sha_delete(&sha1);
+
+    convert_buffer_to_hex_string(hash, sizeof(hash), computed_hash, sizeof(computed_hash));
+
+    printf("Sha1 hash computed - %s\n", computed_hash);
+    printf("Sha1 hash expected - 3efb8392b6cd8e14bd76bd08081521dc73df418c\n");
+
+    if (strcmp(computed_hash, "3efb8392b6cd8e14bd76bd08081521dc73df418c") != 0)
+        return MZ_HASH_ERROR;
+
+    memset(hash256, 0, sizeof(hash256));
+
+    mz_crypt_sha_create(&sha256);
+    mz_crypt_sha_set_algorithm(sha256, MZ_HASH_SHA256);
+    mz_crypt_sha_begin(sha256);
+    mz_crypt_sha_update(sha256, test, (int32_t)strlen(test));
+    mz_crypt_sha_end(sha256, hash256, sizeof(hash256));
+    mz_crypt_sha_delete(&sha256);
+
+    convert_buffer_to_hex_string(hash256, sizeof(hash256), computed_hash, sizeof(computed_hash));
+
+    printf("Sha256 hash computed - %s\n", computed_hash);
+    printf("Sha256 hash expected - 7a31ea0848525f7ebfeec9ee532bcc5d6d26772427e097b86cf440a56546541c\n");
+
+    if (strcmp(computed_hash, "7a31ea0848525f7ebfeec9ee532bcc5d6d26772427e097b86cf440a56546541c") != 0)
+        return MZ_HASH_ERROR;
+
+    printf("Sha.. OK\n");
+    return MZ_OK;
+}
+
+int test_crypt_aes(void)
+{
+    void *aes = NULL;
+    char *key = "awesomekeythisis";
+    char *test = "youknowitsogrowi";
+    char computed_hash[320];
+    int32_t key_length = 0;
+    int32_t test_length = 0;
+    uint8_t buf[120];
+    uint8_t hash[MZ_HASH_SHA256_SIZE];
+
+    printf("Aes key - %s\n", key);
+    printf("Aes input - %s\n", test);
+
+    memset(hash, 0, sizeof(hash));
+
+    key_length = (int32_t)strlen(key);
+    test_length = (int32_t)strlen(test);
+
+    strncpy((char *)buf, test, sizeof(buf));
+
+    printf("Aes input hex\n");
+    convert_buffer_to_hex_string(buf, test_length, computed_hash, sizeof(computed_hash));
+    printf("%s\n", computed_hash);
+
+    mz_crypt_aes_create(&aes);
+    mz_crypt_aes_set_mode(aes, MZ_AES_ENCRYPTION_MODE_256);
+    mz_crypt_aes_set_encrypt_key(aes, key, key_length);
+    mz_crypt_aes_encrypt(aes, buf, test_length);
+    mz_crypt_aes_delete(&aes);
+
+    printf("Aes encrypted\n");
+    convert_buffer_to_hex_string(buf, test_length, computed_hash, sizeof(computed_hash));
+    printf("%s\n", computed_hash);
+
+    mz_crypt_aes_create(&aes);
+    mz_crypt_aes_set_mode(aes, MZ_AES_ENCRYPTION_MODE_256);
+    mz_crypt_aes_set_decrypt_key(aes, key, key_length);
+    mz_crypt_aes_decrypt(aes, buf, test_length);
+    mz_crypt_aes_delete(&aes);
+
+    printf("Aes decrypted\n");
+    convert_buffer_to_hex_string(buf, test_length, computed_hash, sizeof(computed_hash));
+    printf("%s\n", computed_hash);
+
+    if (strcmp((char *)buf, test) != 0)
+        return MZ_CRYPT_ERROR;
+
+    printf("Aes.. OK\n");
+    return MZ_OK;
+}
+
+int32_t test_crypt_hmac(void)
+{
+    void *hmac;
+    char *key = "hm123";
+    char *test = "12345678";
+    char computed_hash[320];
+    int32_t key_length = 0;
+    int32_t test_length = 0;
+    uint8_t hash[MZ_HASH_SHA1_SIZE];
+    uint8_t hash256[MZ_HASH_SHA256_SIZE];
+
+    key_length = (int32_t)strlen(key);
+    test_length = (int32_t)strlen(test);
+
+    printf("Hmac sha1 key - %s\n", key);
+    printf("Hmac sha1 input - %s\n", test);
+
+    mz_crypt_hmac_create(&hmac);
+    mz_crypt_hmac_set_algorithm(hmac, MZ_HASH_SHA1);
+    mz_crypt_hmac_init(hmac, key, key_length);
+    mz_crypt_hmac_update(hmac, test, test_length);
+    mz_crypt_hmac_end(hmac, hash, sizeof(hash));
+    mz_crypt_hmac_delete(&hmac);
+
+    printf("Hmac sha1 output hash hex\n");
+    convert_buffer_to_hex_string(hash, sizeof(hash), computed_hash, sizeof(computed_hash));
+    printf("%s\n", computed_hash);
+
+    printf("Hmac sha1 expected\n");
+    printf("c785a02ff303c886c304d9a4c06073dfe4c24aa9\n");
+
+    if (strcmp(computed_hash, "c785a02ff303c886c304d9a4c06073dfe4c24aa9") != 0)
+        return MZ_CRYPT_ERROR;
+
+    printf("Hmac sha256 key - %s\n", key);
+    printf("Hmac sha256 input - %s\n", test);
+
+    mz_crypt_hmac_create(&hmac);
+    mz_crypt_hmac_set_algorithm(hmac, MZ_HASH_SHA256);
+    mz_crypt_hmac_init(hmac, key, key_length);
+    mz_crypt_hmac_update(hmac, test, test_length);
+    mz_crypt_hmac_end(hmac, hash256, sizeof(hash256));
+    mz_crypt_hmac_delete(&hmac);
+
+    printf("Hmac sha256 output hash hex\n");
+    convert_buffer_to_hex_string(hash256, sizeof(hash256), computed_hash, sizeof(computed_hash));
+    printf("%s\n", computed_hash);
+
+    printf("Hmac sha256 expected\n");
+    printf("fb22a9c715a47a06bad4f6cee9badc31c921562f5d6b24adf2be009f73181f7a\n");
+
+    if (strcmp(computed_hash, "fb22a9c715a47a06bad4f6cee9badc31c921562f5d6b24adf2be009f73181f7a") != 0)
+        return MZ_CRYPT_ERROR;
+
+    printf("Hmac.. OK\n");
+    return MZ_OK;
+}
+#endif
+
+#if defined(HAVE_COMPAT) && defined(HAVE_ZLIB)
+int32_t test_zip_compat_int(zipFile zip, char *filename)
+{
+    int32_t err = ZIP_OK;
+    zip_fileinfo file_info;
+    char *buffer = "test data";
+
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.dosDate = mz_zip_time_t_to_dos_date(1588561637);
+
+    err = zipOpenNewFileInZip(zip, filename, &file_info, NULL, 0, NULL, 0, "test local comment",
+        Z_DEFLATED, 1);
+    if (err != ZIP_OK)
+    {
+        printf("Failed to create new file in zip (%" PRId32 ")\n", err);
+        return err;
+    }
+    err = zipWriteInFileInZip(zip, buffer, (uint32_t)strlen(buffer));
+    if (err != ZIP_OK)
+    {
+        printf("Failed to write file in zip (%" PRId32 ")\n", err);
+        return err;
+    }
+    err = zipCloseFileInZip(zip);
+    if (err != ZIP_OK)
+    {
+        printf("Failed to close file in zip (%" PRId32 ")\n", err);
+        return err;
+    }
+
+    return ZIP_OK;
+}
+
+int32_t test_zip_compat(void)
+{
+    int32_t err = ZIP_OK;
+    zipFile zip;
+
+
+    zip = zipOpen64("compat.zip", APPEND_STATUS_CREATE);
+
+    if (zip == NULL)
+    {
+        printf("Failed to create test zip file\n");
+        return ZIP_PARAMERROR;
+    }
+    err = test_zip_compat_int(zip, "test.txt");
+    if (err != ZIP_OK)
+        return err;
+    err = test_zip_compat_int(zip, "test2.txt");
+    if (err != ZIP_OK)
+        return err;
+
+    zipClose(zip, "test global comment");
+
+    if (err != ZIP_OK)
+        return err;
+
+    printf("Compat zip.. OK\n");
+
+    return ZIP_OK;
+}
+
+static int32_t test_unzip_compat_int(unzFile unzip)
+{
+    unz_global_info64 global_info64;
+    unz_global_info global_info;
+    unz_file_info64 file_info64;
+    unz_file_info file_info;
+    unz_file_pos file_pos;
+    int32_t err = UNZ_OK;
+    int32_t bytes_read = 0;
+    char comment[120];
+    char filename[120];
+    char buffer[120];
+    char *test_data = "test data";
+
+    memset(&file_info, 0, sizeof(file_info));
+    memset(&file_info64, 0, sizeof(file_info64));
+    memset(&global_info, 0, sizeof(global_info));
+    memset(&global_info64, 0, sizeof(global_info64));
+
+    comment[0] = 0;
+    err = unzGetGlobalComment(unzip, comment, sizeof(comment));
+    if (err != UNZ_OK)
+    {
+        printf("Failed to get global comment (%" PRId32 ")\n", err);
+        return err;
+    }
+    if (strcmp(comment, "test global comment") != 0)
+    {
+        printf("Unexpected global comment value (%s)\n", comment);
+        return err;
+    }
+    err = unzGetGlobalInfo(unzip, &global_info);
+    if (err != UNZ_OK)
+    {
+        printf("Failed to get global info  (%" PRId32 ")\n", err);
+        return err;
+    }
+    err = unzGetGlobalInfo64(unzip, &global_info64);
+    if (err != UNZ_OK)
+    {
+        printf("Failed to get global info 64-bit (%" PRId32 ")\n", err);
+        return err;
+    }
+    if (global_info.number_entry != 2 || global_info64.number_entry != 2)
+    {
+        printf("Invalid number of entries in zip (%" PRId32 ")\n", global_info.number_entry);
+        return err;
+    }
+    if (global_info.number_disk_with_CD != 0 || global_info64.number_disk_with_CD != 0)
+    {
+        printf("Invalid disk with cd (%" PRIu32 ")\n", global_info.number_disk_with_CD);
+        return err;
+    }
+
+    err = unzLocateFile(unzip, "test.txt", (void *)1);
+    if (err != UNZ_OK)
+    {
+        printf("Failed to locate test file (%" PRId32 ")\n", err);
+        return err;
+    }
+
+    err = unzGoToFirstFile(unzip);
+    if (err == UNZ_OK)
+    {
+        filename[0] = 0;
+        err = unzGetCurrentFileInfo64(unzip, &file_info64, filename, sizeof(filename), NULL, 0, NULL, 0);
+        if (err != UNZ_OK)
+        {
+            printf("Failed to get current file info 64-bit (%" PRId32 ")\n", err);
+            return err;
+        }
+
+        err = unzOpenCurrentFile(unzip);
+        if (err != UNZ_OK)
+        {
+            printf("Failed to open current file (%" PRId32 ")\n", err);
+            return err;
+        }
+        bytes_read = unzReadCurrentFile(unzip, buffer, sizeof(buffer));
+        if (bytes_read != (int32_t)strlen(test_data))
+        {
+            printf("Failed to read zip entry data (%" PRId32 ")\n", err);
+            unzCloseCurrentFile(unzip);
+            return err;
+        }
+        if (unzEndOfFile(unzip) != 1)
+        {
+            printf("End of unzip not reported correctly\n");
+            return UNZ_INTERNALERROR;
+        }
+        err = unzCloseCurrentFile(unzip);
+        if (err != UNZ_OK)
+        {
+            printf("Failed to close current file (%" PRId32 ")\n", err);
+            return err;
+        }
+
+        if (unztell(unzip) != bytes_read)
+        {
+            printf("Unzip position not reported correctly\n");
+            return UNZ_INTERNALERROR;
+        }
+
+        err = unzGoToNextFile(unzip);
+        if (err != UNZ_OK)
+        {
+            printf("Failed to get next file info (%" PRId32 ")\n", err);
+            return err;
+        }
+
+        comment[0] = 0;
+        err = unzGetCurrentFileInfo(unzip, &file_info, filename, sizeof(filename), NULL, 0, comment, sizeof(comment));
+        if (err != UNZ_OK)
+        {
+            printf("Failed to get current file info (%" PRId32 ")\n", err);
+            return err;
+        }
+        if (strcmp(comment, "test local comment") != 0)
+        {
+            printf("Unexpected local comment value (%s)\n", comment);
+            return err;
+        }
+
+        err = unzGetFilePos(unzip, &file_pos);
+        if (err != UNZ_OK)
+        {
+            printf("Failed to get file position (%" PRId32 ")\n", err);
+            return err;
+        }
+        if (file_pos.num_of_file != 1)
+        {
+            printf("Unzip file position not reported correctly\n");
+            return UNZ_INTERNALERROR;
+        }
+
+        err = unzGetOffset(unzip);
+        if (err <= 0)
+        {
+            printf("Unzip invalid offset reported\n");
+            return UNZ_INTERNALERROR;
+        }
+
+        err = unzGoToNextFile(unzip);
+
+        if (err != UNZ_END_OF_LIST_OF_FILE)
+        {
+            printf("Failed to reach end of zip entries (%" PRId32 ")\n", err);
+            unzCloseCurrentFile(unzip);
+            return err;
+        }
+        err = unzSeek64(unzip, 0, SEEK_SET);
+    }
+
+    return UNZ_OK;
+}
+
+int32_t test_unzip_compat(void)
+{
+    unzFile unzip;
+    int32_t err = UNZ_OK;
+
+    unzip = unzOpen("compat.zip");
+    if (unzip == NULL)
+    {
+        printf("Failed to open test zip file\n");
+        return UNZ_PARAMERROR;
+    }
+    err = test_unzip_compat_int(unzip);
+    unzClose(unzip);
+
+    if (err != UNZ_OK)
+        return err;
+
+    printf("Compat unzip.. OK\n");
+
+    return UNZ_OK;
+}
+#endif
+
+/***************************************************************************/
+
+int main(int argc, const char *argv[])
+{
+    int32_t err = MZ_OK;
+
+    MZ_UNUSED(argc);
+    MZ_UNUSED(argv);
+
+    err |= test_path_resolve();
+    err |= test_path_compare_wc();
+    err |= test_path_pattern();
+    err |= test_utf8();
+    err |= test_stream_find();
+    err |= test_stream_find_reverse();
+    err |= test_zip_entry_read_at();
+    err |= test_zip_reader_sidecar();
+    err |= test_zip_recover_cd();
+    err |= test_zip_split_disks();
+    err |= test_zip_reader_test_all();
+#ifndef MZ_ZIP_NO_ENCRYPTION
+    err |= test_zip_writer_hash_algorithm();
+#endif
+
+#if !defined(MZ_ZIP_NO_COMPRESSION) && !defined(MZ_ZIP_NO_DECOMPRESSION)
+#ifdef HAVE_BZIP2
+    err |= test_stream_bzip();
+#endif
+#ifdef HAVE_ZLIB
+    err |= test_stream_zlib();
+    err |= test_stream_zlib_mem();
+    err |= test_zip_writer_compress_auto();
+    err |= test_zip_writer_dedup();
+    err |= test_zip_writer_dictionary();
+    err |= test_zip_stats();
+    err |= test_zip_timing();
+    err |= test_zip_stream_reuse();
+    err |= test_zip_alloc_arena();
+    err |= test_zip_low_memory();
+    err |= test_zip_reader_reopen();
+    err |= test_zip_reader_batch();
+    err |= test_zip_reader_ordered();
+    err |= test_zip_reader_save_direct();
+    err |= test_zip_deflate_whole();
+    err |= test_zip_codec_registry();
+    err |= test_zip_entry_seek();
+#ifdef HAVE_COMPAT
+    err |= test_zip_compat();
+    err |= test_unzip_compat();
+#endif
+#endif
+#ifdef HAVE_ZSTD
+    err |= test_zip_zstd_frames();
+#endif
+#endif
+
+#if !defined(MZ_ZIP_NO_ENCRYPTION)
+#ifdef HAVE_PKCRYPT
+    err |= test_stream_pkcrypt();
+#endif
+#ifdef HAVE_WZAES
+    err |= test_stream_wzaes();
+#endif
+    err |= test_crypt_sha();
+    err |= test_crypt_aes();
+    err |= test_crypt_hmac();
+#endif
+
+    return err;
+}
+
+/***************************************************************************/
@@ -0,0 +1,51 @@
+#ifndef _MZ_TEST_H
+#define _MZ_TEST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************************************************/
+
+int32_t test_stream_bzip(void);
+int32_t test_stream_pkcrypt(void);
+int32_t test_stream_wzaes(void);
+int32_t test_stream_zlib(void);
+int32_t test_stream_zlib_mem(void);
+int32_t test_stream_find(void);
+int32_t test_stream_find_reverse(void);
+
+int32_t test_zip_writer_compress_auto(void);
+int32_t test_zip_writer_dedup(void);
+int32_t test_zip_writer_dictionary(void);
+int32_t test_zip_stats(void);
+int32_t test_zip_timing(void);
+int32_t test_zip_stream_reuse(void);
+int32_t test_zip_alloc_arena(void);
+int32_t test_zip_low_memory(void);
+int32_t test_zip_reader_reopen(void);
+int32_t test_zip_reader_batch(void);
+int32_t test_zip_reader_ordered(void);
+int32_t test_zip_reader_save_direct(void);
+int32_t test_zip_deflate_whole(void);
+int32_t test_zip_codec_registry(void);
+int32_t test_zip_entry_seek(void);
+int32_t test_zip_zstd_frames(void);
+int32_t test_zip_entry_read_at(void);
+int32_t test_zip_reader_sidecar(void);
+int32_t test_zip_recover_cd(void);
+int32_t test_zip_split_disks(void);
+int32_t test_zip_reader_test_all(void);
+int32_t test_zip_writer_hash_algorithm(void);
+
+int32_t test_crypt_sha(void);
+int32_t test_crypt_aes(void);
+int32_t test_crypt_hmac(void);
+
+/***************************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif